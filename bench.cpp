@@ -0,0 +1,1315 @@
+/*/////////////////////////////////////////////////////////////////////////////
+/// @summary Implements a throughput benchmark and golden-output regression
+/// check for the image codec kernels. Every kernel is run against a fixed,
+/// procedurally generated image under each instruction set level supported
+/// by the host; its output is hashed and compared against a stored golden
+/// hash, so that SIMD kernels are validated automatically, and its throughput
+/// is reported in MB/s of input and blocks per second. imutils.cpp is
+/// included directly so that the internal kernels can be measured in
+/// isolation. Build and run with `make -f Makefile.linux bench`. Run with
+/// `-q [image.ppm ...]` to instead compare the PSNR, SSIM and throughput of
+/// the integer and floating-point DCT pipelines across quality levels.
+/// @author Russell Klenk (contact@russellklenk.com)
+///////////////////////////////////////////////////////////////////////////80*/
+
+/*////////////////
+//   Includes   //
+////////////////*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "imutils.cpp"
+
+/*/////////////////
+//   Constants   //
+/////////////////*/
+/// @summary The dimensions of the generated source image, in pixels. Both
+/// must be multiples of the tile size.
+#define BENCH_IMAGE_WIDTH    256
+#define BENCH_IMAGE_HEIGHT   256
+
+/// @summary The dimensions of the tiles extracted by copy_tile().
+#define BENCH_TILE_SIZE      64
+
+/// @summary The quality level used to generate the quantization tables.
+#define BENCH_QUALITY        50
+
+/// @summary The lambda used by the RDO quantization benchmark.
+#define BENCH_RDO_LAMBDA     6.0f
+
+/// @summary The number of threads used by the encode_image() benchmark. The
+/// output does not depend on it.
+#define BENCH_THREADS        4
+
+/// @summary The minimum time spent timing each kernel, in nanoseconds.
+#define BENCH_MIN_TIME_NS    20000000ULL
+
+/// @summary The number of timing trials per kernel; the fastest is reported.
+#define BENCH_TRIALS         3
+
+/*////////////////
+//  Data Types  //
+////////////////*/
+/// @summary Stores the inputs and outputs shared by all benchmarks. Inputs
+/// are generated once by bench_data_init() and are never modified.
+struct bench_data_t
+{
+    size_t   McuCount;       /// The number of 16x16 blocks in the image
+    size_t   BlockCount;     /// The number of 8x8 luma blocks in the image
+    uint8_t *Image;          /// The source image, in RGBA8 format
+    size_t   Pitch;          /// The number of bytes per row of Image
+    uint8_t *ImageRGB;       /// Image in RGB8 format, with rows Pitch bytes apart
+    uint16_t*Image16;        /// Image in RGBA16 format, with rows Pitch * 2 bytes apart
+    uint8_t *Alpha;          /// McuCount * 256 alpha samples
+    int16_t *SampY;          /// BlockCount * 64 luma samples
+    float   *SampF;          /// BlockCount * 64 luma samples, as float
+    int16_t *CoefI;          /// BlockCount * 64 unquantized luma coefficients
+    int16_t *CoefY;          /// BlockCount * 64 quantized luma coefficients
+    int16_t *CoefCo;         /// McuCount * 64 quantized Co coefficients
+    int16_t *CoefCg;         /// McuCount * 64 quantized Cg coefficients
+    float   *CoefF;          /// BlockCount * 64 quantized float coefficients
+    int16_t  Qluma[64];      /// The integer FDCT luma table
+    int16_t  Qchroma[64];    /// The integer FDCT chroma table
+    int16_t  Dluma[64];      /// The integer IDCT luma table
+    int16_t  Dchroma[64];    /// The integer IDCT chroma table
+    float    Qfloat[64];     /// The float FDCT luma table
+    float    Dfloat[64];     /// The float IDCT luma table
+    uint8_t *Stream;         /// The encode_tile() stream for the whole image
+    size_t   StreamSize;     /// The size of Stream, in bytes
+    uint8_t *Page;           /// The encode_tile_budget() page for the whole image
+    size_t   PageSize;       /// The size of Page, in bytes
+    int      PageQuality;    /// The quality level Page was encoded with
+    uint8_t *Output;         /// The output buffer for the current benchmark
+    size_t   OutputSize;     /// The number of valid bytes in Output
+    size_t   OutputMax;      /// The capacity of Output, in bytes
+};
+
+/// @summary Runs one benchmark over the whole data set, writing its output
+/// to data->Output and data->OutputSize.
+/// @param data The shared benchmark state.
+/// @param bytes On return, stores the number of input bytes processed.
+/// @return The number of blocks processed.
+typedef size_t (*bench_fn)(bench_data_t *data, size_t *bytes);
+
+/// @summary Describes a single benchmark and its expected output.
+struct bench_desc_t
+{
+    char const *Name;        /// The name of the benchmarked kernel
+    char const *Unit;        /// The kind of block counted, such as "8x8" or "16x16"
+    bench_fn    Run;         /// The function that runs the benchmark
+    uint64_t    Golden;      /// The FNV-1a hash of the expected output
+};
+
+/*///////////////////////
+//   Local Functions   //
+///////////////////////*/
+/// @summary Calculates the 64-bit FNV-1a hash of a buffer.
+/// @param data The buffer to hash.
+/// @param size The number of bytes to hash.
+/// @return The hash value.
+static uint64_t fnv1a64(void const *data, size_t size)
+{
+    uint8_t const *p = (uint8_t const*) data;
+    uint64_t       h = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/// @summary Reads the monotonic clock.
+/// @return The current time, in nanoseconds.
+static uint64_t nanotime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/// @summary Retrieves a short display name for an instruction set level.
+/// @param isa One of the cpu_isa_e values.
+/// @return A pointer to a static, NULL-terminated string.
+static char const* isa_name(int32_t isa)
+{
+    switch (isa)
+    {
+        case CPU_ISA_SCALAR: return "scalar";
+        case CPU_ISA_SSE2:   return "sse2";
+        case CPU_ISA_AVX2:   return "avx2";
+        case CPU_ISA_AVX512: return "avx512";
+        default:             return "unknown";
+    }
+}
+
+/// @summary Generates the source image and derives the inputs for each
+/// stage of the codec from it. The image combines smooth gradients, a hard
+/// edge and a deterministic noise term so that the coefficient blocks cover
+/// the DC-only, sparse and dense IDCT paths.
+/// @param data The benchmark state to initialize.
+static void bench_data_init(bench_data_t *data)
+{
+    size_t const W = BENCH_IMAGE_WIDTH;
+    size_t const H = BENCH_IMAGE_HEIGHT;
+    size_t const M = (W / 16) * (H / 16);
+    uint32_t     s = 0x12345678U;
+
+    data->McuCount   = M;
+    data->BlockCount = M * 4;
+    data->Pitch      = W * 4;
+    data->Image      = (uint8_t*) malloc(W * H * 4);
+    data->ImageRGB   = (uint8_t*) malloc(W * H * 4);
+    data->Image16    = (uint16_t*)malloc(W * H * 8);
+    data->Alpha      = (uint8_t*) malloc(M * 256);
+    data->SampY      = (int16_t*) malloc(M * 256 * sizeof(int16_t));
+    data->SampF      = (float  *) malloc(M * 256 * sizeof(float));
+    data->CoefF      = (float  *) malloc(M * 256 * sizeof(float));
+    data->CoefI      = (int16_t*) malloc(M * 256 * sizeof(int16_t));
+
+    for (size_t y = 0; y < H; ++y)
+    {
+        uint8_t *row = data->Image + y * data->Pitch;
+        for (size_t x = 0; x < W; ++x)
+        {
+            s = s * 1664525U + 1013904223U;
+            uint32_t n  = (y < H / 2) ? 0 : (s >> 24) & 31;
+            row[x * 4 + 0] = (uint8_t) ((x + n) & 0xFF);
+            row[x * 4 + 1] = (uint8_t) (((x + y) / 2 + n) & 0xFF);
+            row[x * 4 + 2] = (uint8_t) ((x < W / 2) ? 32 : 224);
+            row[x * 4 + 3] = (uint8_t) (255 - (y & 0x7F));
+        }
+    }
+
+    // the 16-bit image expands each value exactly, so it rounds back to the
+    // 8-bit image; the RGB image keeps the same pitch as the RGBA image.
+    for (size_t y = 0; y < H; ++y)
+    {
+        for (size_t x = 0; x < W * 4; ++x)
+        {
+            uint8_t v = data->Image[y * data->Pitch + x];
+            data->Image16[y * W * 4 + x] = (uint16_t) (v * 257);
+            if ((x & 3) != 3) data->ImageRGB[y * data->Pitch + (x / 4) * 3 + (x & 3)] = v;
+        }
+    }
+
+    float Qfloat_c[64]; // chroma tables are not used by the float kernels.
+    qtables_encode(data->Qluma,  data->Qchroma, BENCH_QUALITY);
+    qtables_decode(data->Dluma,  data->Dchroma, BENCH_QUALITY);
+    qtables_encode(data->Qfloat, Qfloat_c,      BENCH_QUALITY);
+    qtables_decode(data->Dfloat, Qfloat_c,      BENCH_QUALITY);
+
+    for (size_t m = 0; m < M; ++m)
+    {
+        uint8_t const *pix = data->Image + (m / (W / 16)) * 16 * data->Pitch + (m % (W / 16)) * 64;
+        int16_t        Co[64];
+        int16_t        Cg[64];
+        split16x16i(&data->SampY[m * 256], Co, Cg, &data->Alpha[m * 256], pix, data->Pitch);
+    }
+    for (size_t i = 0; i < M * 256; ++i)
+        data->SampF[i] = (float) data->SampY[i];
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        fdct8x8fq_base(&data->CoefF[i * 64], &data->SampF[i * 64], data->Qfloat);
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        fdct8x8i_base(&data->CoefI[i * 64], &data->SampY[i * 64]);
+
+    image_tile_t tile;
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth    = W;
+    tile.TileHeight   = H;
+    tile.BytesPerRow  = data->Pitch;
+    tile.BytesPerTile = data->Pitch * H;
+    tile.Pixels       = data->Image;
+    data->StreamSize  = tile_stream_size(&tile);
+    data->Stream      = (uint8_t*) malloc(data->StreamSize);
+    encode_tile(data->Stream, data->StreamSize, &tile, BENCH_QUALITY);
+    data->CoefY       = (int16_t*) data->Stream;
+    data->CoefCo      = data->CoefY  + M * 256;
+    data->CoefCg      = data->CoefCo + M * 64;
+    data->Page        = (uint8_t*) malloc(tile.BytesPerTile);
+    data->PageSize    = encode_tile_budget(data->Page, tile.BytesPerTile / 2, &tile, &data->PageQuality);
+
+    data->OutputMax   = W * H * 8;
+    data->Output      = (uint8_t*) malloc(data->OutputMax);
+    data->OutputSize  = 0;
+}
+
+/// @summary Frees the memory allocated by bench_data_init().
+/// @param data The benchmark state to free.
+static void bench_data_free(bench_data_t *data)
+{
+    free(data->Output);
+    free(data->Page);
+    free(data->Stream);
+    free(data->CoefI);
+    free(data->CoefF);
+    free(data->SampF);
+    free(data->SampY);
+    free(data->Alpha);
+    free(data->Image16);
+    free(data->ImageRGB);
+    free(data->Image);
+    memset(data, 0, sizeof(bench_data_t));
+}
+
+/*//////////////////
+//   Benchmarks   //
+//////////////////*/
+static size_t bench_split16x16i(bench_data_t *data, size_t *bytes)
+{
+    size_t   M     = data->McuCount;
+    size_t   mcu_x = BENCH_IMAGE_WIDTH / 16;
+    int16_t *Y     = (int16_t*) data->Output;
+    int16_t *Co    = Y  + M * 256;
+    int16_t *Cg    = Co + M * 64;
+    uint8_t *A     = (uint8_t*) (Cg + M * 64);
+    for (size_t m = 0; m < M; ++m)
+    {
+        uint8_t const *pix = data->Image + (m / mcu_x) * 16 * data->Pitch + (m % mcu_x) * 64;
+        split16x16i(&Y[m * 256], &Co[m * 64], &Cg[m * 64], &A[m * 256], pix, data->Pitch);
+    }
+    data->OutputSize = M * (384 * sizeof(int16_t) + 256);
+    *bytes = M * 1024;
+    return M;
+}
+
+static size_t bench_fdct8x8i(bench_data_t *data, size_t *bytes)
+{
+    int16_t *dst = (int16_t*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        fdct8x8i(&dst[i * 64], &data->SampY[i * 64]);
+    data->OutputSize = data->BlockCount * 64 * sizeof(int16_t);
+    *bytes = data->BlockCount * 64 * sizeof(int16_t);
+    return data->BlockCount;
+}
+
+static size_t bench_fdct8x8iq(bench_data_t *data, size_t *bytes)
+{
+    int16_t *dst = (int16_t*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        fdct8x8iq(&dst[i * 64], &data->SampY[i * 64], data->Qluma);
+    data->OutputSize = data->BlockCount * 64 * sizeof(int16_t);
+    *bytes = data->BlockCount * 64 * sizeof(int16_t);
+    return data->BlockCount;
+}
+
+static size_t bench_fdct8x8iq_batch(bench_data_t *data, size_t *bytes)
+{
+    int16_t *dst = (int16_t*) data->Output;
+    fdct8x8iq_batch(dst, data->SampY, &quant_context(BENCH_QUALITY)->Luma, data->BlockCount);
+    data->OutputSize = data->BlockCount * 64 * sizeof(int16_t);
+    *bytes = data->BlockCount * 64 * sizeof(int16_t);
+    return data->BlockCount;
+}
+
+static size_t bench_quantize8x8_base(bench_data_t *data, size_t *bytes)
+{
+    int16_t             *dst = (int16_t*) data->Output;
+    quant_table_t const *Q   = &quant_context(BENCH_QUALITY)->Luma;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+    {
+        memcpy(&dst[i * 64], &data->CoefI[i * 64], 64 * sizeof(int16_t));
+        quantize8x8_base(&dst[i * 64], Q);
+    }
+    data->OutputSize = data->BlockCount * 64 * sizeof(int16_t);
+    *bytes = data->BlockCount * 64 * sizeof(int16_t);
+    return data->BlockCount;
+}
+
+static size_t bench_quantize8x8i(bench_data_t *data, size_t *bytes)
+{
+    int16_t *dst = (int16_t*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+    {
+        memcpy(&dst[i * 64], &data->CoefI[i * 64], 64 * sizeof(int16_t));
+        quantize8x8i(&dst[i * 64], BENCH_QUALITY, false);
+    }
+    data->OutputSize = data->BlockCount * 64 * sizeof(int16_t);
+    *bytes = data->BlockCount * 64 * sizeof(int16_t);
+    return data->BlockCount;
+}
+
+static size_t bench_fdct8x8f(bench_data_t *data, size_t *bytes)
+{
+    float *dst = (float*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        fdct8x8f(&dst[i * 64], &data->SampF[i * 64]);
+    data->OutputSize = data->BlockCount * 64 * sizeof(float);
+    *bytes = data->BlockCount * 64 * sizeof(float);
+    return data->BlockCount;
+}
+
+static size_t bench_fdct8x8fq(bench_data_t *data, size_t *bytes)
+{
+    float *dst = (float*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        fdct8x8fq(&dst[i * 64], &data->SampF[i * 64], data->Qfloat);
+    data->OutputSize = data->BlockCount * 64 * sizeof(float);
+    *bytes = data->BlockCount * 64 * sizeof(float);
+    return data->BlockCount;
+}
+
+/// @summary Rounds float kernel output to 16-bit integers in place, so that
+/// the golden hash tolerates the last-bit differences of the FMA kernels.
+/// @param data The shared benchmark state; Output holds BlockCount blocks.
+static void bench_round_output(bench_data_t *data)
+{
+    float   *src = (float*)   data->Output;
+    int16_t *dst = (int16_t*) data->Output;
+    for (size_t i = 0; i < data->BlockCount * 64; ++i)
+        dst[i] = (int16_t) (int32_t) (src[i] + ((src[i] < 0.0f) ? -0.5f : 0.5f));
+    data->OutputSize = data->BlockCount * 64 * sizeof(int16_t);
+}
+
+static size_t bench_fdct8x8fq_batch(bench_data_t *data, size_t *bytes)
+{
+    fdct8x8fq_batch((float*) data->Output, data->SampF, data->Qfloat, data->BlockCount);
+    bench_round_output(data);
+    *bytes = data->BlockCount * 64 * sizeof(float);
+    return data->BlockCount;
+}
+
+static size_t bench_idct8x8i(bench_data_t *data, size_t *bytes)
+{
+    int16_t *dst = (int16_t*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        idct8x8i(&dst[i * 64], &data->CoefY[i * 64]);
+    data->OutputSize = data->BlockCount * 64 * sizeof(int16_t);
+    *bytes = data->BlockCount * 64 * sizeof(int16_t);
+    return data->BlockCount;
+}
+
+static size_t bench_idct8x8id(bench_data_t *data, size_t *bytes)
+{
+    int16_t *dst = (int16_t*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        idct8x8id(&dst[i * 64], &data->CoefY[i * 64], data->Dluma);
+    data->OutputSize = data->BlockCount * 64 * sizeof(int16_t);
+    *bytes = data->BlockCount * 64 * sizeof(int16_t);
+    return data->BlockCount;
+}
+
+static size_t bench_idct8x8f(bench_data_t *data, size_t *bytes)
+{
+    float *dst = (float*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        idct8x8f(&dst[i * 64], &data->CoefF[i * 64]);
+    data->OutputSize = data->BlockCount * 64 * sizeof(float);
+    *bytes = data->BlockCount * 64 * sizeof(float);
+    return data->BlockCount;
+}
+
+static size_t bench_idct8x8fd(bench_data_t *data, size_t *bytes)
+{
+    float *dst = (float*) data->Output;
+    for (size_t i = 0; i < data->BlockCount; ++i)
+        idct8x8fd(&dst[i * 64], &data->CoefF[i * 64], data->Dfloat);
+    data->OutputSize = data->BlockCount * 64 * sizeof(float);
+    *bytes = data->BlockCount * 64 * sizeof(float);
+    return data->BlockCount;
+}
+
+static size_t bench_idct8x8fd_batch(bench_data_t *data, size_t *bytes)
+{
+    idct8x8fd_batch((float*) data->Output, data->CoefF, data->Dfloat, data->BlockCount);
+    bench_round_output(data);
+    *bytes = data->BlockCount * 64 * sizeof(float);
+    return data->BlockCount;
+}
+
+static size_t bench_encode16x16i(bench_data_t *data, size_t *bytes)
+{
+    size_t   M  = data->McuCount;
+    int16_t *Y  = (int16_t*) data->Output;
+    int16_t *Co = Y  + M * 256;
+    int16_t *Cg = Co + M * 64;
+    uint8_t *A  = (uint8_t*) (Cg + M * 64);
+    uint8_t  RGBA[1024];
+    for (size_t m = 0; m < M; ++m)
+    {
+        // encode16x16i() expects a packed 16x16 block.
+        uint8_t const *pix = data->Image + (m / (BENCH_IMAGE_WIDTH / 16)) * 16 * data->Pitch + (m % (BENCH_IMAGE_WIDTH / 16)) * 64;
+        for (size_t row = 0; row < 16; ++row)
+            memcpy(&RGBA[row * 64], pix + row * data->Pitch, 64);
+        encode16x16i(&Y[m * 256], &Co[m * 64], &Cg[m * 64], &A[m * 256], data->Qluma, data->Qchroma, RGBA);
+    }
+    data->OutputSize = M * (384 * sizeof(int16_t) + 256);
+    *bytes = M * 1024;
+    return M;
+}
+
+static size_t bench_decode16x16i_rgb(bench_data_t *data, size_t *bytes)
+{
+    for (size_t m = 0; m < data->McuCount; ++m)
+        decode16x16i_rgb(&data->Output[m * 768], &data->CoefY[m * 256], &data->CoefCo[m * 64], &data->CoefCg[m * 64], data->Dluma, data->Dchroma);
+    data->OutputSize = data->McuCount * 768;
+    *bytes = data->McuCount * 384 * sizeof(int16_t);
+    return data->McuCount;
+}
+
+static size_t bench_decode16x16i_rgba(bench_data_t *data, size_t *bytes)
+{
+    for (size_t m = 0; m < data->McuCount; ++m)
+        decode16x16i_rgba(&data->Output[m * 1024], &data->CoefY[m * 256], &data->CoefCo[m * 64], &data->CoefCg[m * 64], &data->Alpha[m * 256], data->Dluma, data->Dchroma);
+    data->OutputSize = data->McuCount * 1024;
+    *bytes = data->McuCount * (384 * sizeof(int16_t) + 256);
+    return data->McuCount;
+}
+
+/// @summary Transcodes every MCU of the image to a block-compressed format,
+/// laid out as rows of 4x4 blocks across the full image width.
+/// @param data The benchmark state.
+/// @param bytes On return, the number of bytes of coefficient data consumed.
+/// @param format One of bc_format_e.
+/// @return The number of MCUs transcoded.
+static size_t bench_decode16x16i_bc(bench_data_t *data, size_t *bytes, int32_t format)
+{
+    size_t const mcu_x = BENCH_IMAGE_WIDTH / 16;
+    size_t const bs    = bc_block_size(format);
+    size_t const pitch = (BENCH_IMAGE_WIDTH / 4) * bs;
+    for (size_t m = 0; m < data->McuCount; ++m)
+    {
+        uint8_t *dst = &data->Output[(m / mcu_x) * 4 * pitch + (m % mcu_x) * 4 * bs];
+        decode16x16i_bc(dst, pitch, format, &data->CoefY[m * 256], &data->CoefCo[m * 64], &data->CoefCg[m * 64], &data->Alpha[m * 256], data->Dluma, data->Dchroma);
+    }
+    data->OutputSize = data->McuCount * 16 * bs;
+    *bytes = data->McuCount * (384 * sizeof(int16_t) + 256);
+    return data->McuCount;
+}
+
+static size_t bench_decode16x16i_bc1(bench_data_t *data, size_t *bytes)
+{
+    return bench_decode16x16i_bc(data, bytes, BC_FORMAT_BC1);
+}
+
+static size_t bench_decode16x16i_bc3(bench_data_t *data, size_t *bytes)
+{
+    return bench_decode16x16i_bc(data, bytes, BC_FORMAT_BC3);
+}
+
+static size_t bench_decode16x16i_bc3_ycocg(bench_data_t *data, size_t *bytes)
+{
+    return bench_decode16x16i_bc(data, bytes, BC_FORMAT_BC3_YCOCG);
+}
+
+static size_t bench_encode_tile(bench_data_t *data, size_t *bytes)
+{
+    image_tile_t tile;
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth    = BENCH_IMAGE_WIDTH;
+    tile.TileHeight   = BENCH_IMAGE_HEIGHT;
+    tile.BytesPerRow  = data->Pitch;
+    tile.BytesPerTile = data->Pitch * BENCH_IMAGE_HEIGHT;
+    tile.Pixels       = data->Image;
+    data->OutputSize  = encode_tile(data->Output, data->OutputMax, &tile, BENCH_QUALITY);
+    *bytes = tile.BytesPerTile;
+    return data->McuCount;
+}
+
+static size_t bench_decode_tile(bench_data_t *data, size_t *bytes)
+{
+    image_tile_t tile;
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth    = BENCH_IMAGE_WIDTH;
+    tile.TileHeight   = BENCH_IMAGE_HEIGHT;
+    tile.BytesPerRow  = data->Pitch;
+    tile.BytesPerTile = data->Pitch * BENCH_IMAGE_HEIGHT;
+    tile.Pixels       = data->Output;
+    decode_tile(&tile, data->Stream, data->StreamSize, BENCH_QUALITY);
+    data->OutputSize  = tile.BytesPerTile;
+    *bytes = data->StreamSize;
+    return data->McuCount;
+}
+
+static size_t bench_encode_tile_budget(bench_data_t *data, size_t *bytes)
+{
+    image_tile_t tile;
+    int          quality;
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth    = BENCH_IMAGE_WIDTH;
+    tile.TileHeight   = BENCH_IMAGE_HEIGHT;
+    tile.BytesPerRow  = data->Pitch;
+    tile.BytesPerTile = data->Pitch * BENCH_IMAGE_HEIGHT;
+    tile.Pixels       = data->Image;
+    data->OutputSize  = encode_tile_budget(data->Output, tile.BytesPerTile / 2, &tile, &quality);
+    *bytes = tile.BytesPerTile;
+    return data->McuCount;
+}
+
+static size_t bench_encode_tile_budget_rdo(bench_data_t *data, size_t *bytes)
+{
+    image_tile_t tile;
+    int          quality;
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth    = BENCH_IMAGE_WIDTH;
+    tile.TileHeight   = BENCH_IMAGE_HEIGHT;
+    tile.BytesPerRow  = data->Pitch;
+    tile.BytesPerTile = data->Pitch * BENCH_IMAGE_HEIGHT;
+    tile.Pixels       = data->Image;
+    data->OutputSize  = encode_tile_budget_rdo(data->Output, tile.BytesPerTile / 2, &tile, BENCH_RDO_LAMBDA, &quality);
+    *bytes = tile.BytesPerTile;
+    return data->McuCount;
+}
+
+static size_t bench_decode_tile_page(bench_data_t *data, size_t *bytes)
+{
+    image_tile_t tile;
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth    = BENCH_IMAGE_WIDTH;
+    tile.TileHeight   = BENCH_IMAGE_HEIGHT;
+    tile.BytesPerRow  = data->Pitch;
+    tile.BytesPerTile = data->Pitch * BENCH_IMAGE_HEIGHT;
+    tile.Pixels       = data->Output;
+    decode_tile_page(&tile, data->Page, data->PageSize, data->PageQuality);
+    data->OutputSize  = tile.BytesPerTile;
+    *bytes = data->PageSize;
+    return data->McuCount;
+}
+
+/// @summary Decodes a reduced-resolution preview of the whole-image page.
+/// @param data The shared benchmark state.
+/// @param bytes On return, stores the number of input bytes processed.
+/// @param scale The reduction factor, 4 or 8.
+/// @return The number of blocks processed.
+static size_t bench_decode_tile_page_preview(bench_data_t *data, size_t *bytes, size_t scale)
+{
+    image_tile_t tile;
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth    = BENCH_IMAGE_WIDTH;
+    tile.TileHeight   = BENCH_IMAGE_HEIGHT;
+    tile.BytesPerRow  = (BENCH_IMAGE_WIDTH / scale) * 4;
+    tile.BytesPerTile = tile.BytesPerRow * (BENCH_IMAGE_HEIGHT / scale);
+    tile.Pixels       = data->Output;
+    decode_tile_page_preview(&tile, scale, data->Page, data->PageSize, data->PageQuality);
+    data->OutputSize  = tile.BytesPerTile;
+    *bytes = data->PageSize;
+    return data->McuCount;
+}
+
+static size_t bench_decode_tile_page_preview4(bench_data_t *data, size_t *bytes)
+{
+    return bench_decode_tile_page_preview(data, bytes, 4);
+}
+
+static size_t bench_decode_tile_page_preview8(bench_data_t *data, size_t *bytes)
+{
+    return bench_decode_tile_page_preview(data, bytes, 8);
+}
+
+/// @summary Builds the mipmap chain of the source image below level 0.
+/// @param data The shared benchmark state.
+/// @param bytes On return, stores the number of input bytes processed.
+/// @param flags A combination of mipmap_filter_e values.
+/// @return The number of pixels written.
+static size_t bench_generate_mipmaps(bench_data_t *data, size_t *bytes, uint32_t flags)
+{
+    mipmap_level_t levels[16];
+    size_t         count  = 0;
+    size_t         pixels = 0;
+    uint8_t       *out    = data->Output;
+    levels[0].Width       = BENCH_IMAGE_WIDTH;
+    levels[0].Height      = BENCH_IMAGE_HEIGHT;
+    levels[0].BytesPerRow = data->Pitch;
+    levels[0].Pixels      = data->Image;
+    for (count = 1; levels[count - 1].Width > 1 || levels[count - 1].Height > 1; ++count)
+    {
+        mipmap_level_t *l = &levels[count];
+        l->Width       = (levels[count - 1].Width  > 1) ? levels[count - 1].Width  >> 1 : 1;
+        l->Height      = (levels[count - 1].Height > 1) ? levels[count - 1].Height >> 1 : 1;
+        l->BytesPerRow = l->Width * 4;
+        l->Pixels      = out;
+        out    += l->BytesPerRow * l->Height;
+        pixels += l->Width * l->Height;
+    }
+    generate_mipmaps(levels, count, 4, flags, 1);
+    data->OutputSize = (size_t) (out - data->Output);
+    *bytes = data->Pitch * BENCH_IMAGE_HEIGHT;
+    return pixels;
+}
+
+static size_t bench_generate_mipmaps_box(bench_data_t *data, size_t *bytes)
+{
+    return bench_generate_mipmaps(data, bytes, MIPMAP_FILTER_BOX);
+}
+
+static size_t bench_generate_mipmaps_srgb(bench_data_t *data, size_t *bytes)
+{
+    return bench_generate_mipmaps(data, bytes, MIPMAP_FILTER_SRGB);
+}
+
+static size_t bench_generate_mipmaps_alpha(bench_data_t *data, size_t *bytes)
+{
+    return bench_generate_mipmaps(data, bytes, MIPMAP_FILTER_ALPHA);
+}
+
+static size_t bench_copy_tile_format(bench_data_t *data, size_t *bytes, int32_t format, void *pixels, size_t pitch)
+{
+    image_tiler_config_t config;
+    image_tile_t         tile;
+    size_t               ntiles;
+    config.TileWidth    = BENCH_TILE_SIZE;
+    config.TileHeight   = BENCH_TILE_SIZE;
+    config.ImageWidth   = BENCH_IMAGE_WIDTH;
+    config.ImageHeight  = BENCH_IMAGE_HEIGHT - 8; // exercise partial tiles
+    config.BorderSize   = 2;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = format;
+    config.SourcePitch  = pitch;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = pixels;
+    ntiles = tile_count(NULL, NULL, &config);
+    memset(&tile, 0, sizeof(tile));
+    data->OutputSize = 0;
+    *bytes = 0;
+    for (size_t i = 0; i < ntiles; ++i)
+    {
+        tile.Pixels = &data->Output[data->OutputSize];
+        copy_tile(&tile, &config, i);
+        data->OutputSize += tile.BytesPerTile;
+        *bytes += tile.SourceWidth * tile.SourceHeight * source_format_size(format);
+    }
+    return ntiles;
+}
+
+static size_t bench_copy_tile(bench_data_t *data, size_t *bytes)
+{
+    return bench_copy_tile_format(data, bytes, SOURCE_FORMAT_RGBA8, data->Image, 0);
+}
+
+static size_t bench_copy_tile_rgb8(bench_data_t *data, size_t *bytes)
+{
+    return bench_copy_tile_format(data, bytes, SOURCE_FORMAT_RGB8, data->ImageRGB, data->Pitch);
+}
+
+static size_t bench_copy_tile_rgba16(bench_data_t *data, size_t *bytes)
+{
+    // rounds back to the RGBA8 image, so the output matches copy_tile.
+    return bench_copy_tile_format(data, bytes, SOURCE_FORMAT_RGBA16, data->Image16, 0);
+}
+
+/// @summary Reads rows of the benchmark image for band_tiler_open().
+static bool bench_band_read(void *context, void *dst, size_t first_row, size_t row_count)
+{
+    bench_data_t *data = (bench_data_t*) context;
+    memcpy(dst, data->Image + first_row * data->Pitch, row_count * data->Pitch);
+    return true;
+}
+
+static size_t bench_band_tiler(bench_data_t *data, size_t *bytes)
+{
+    image_tiler_config_t config;
+    image_tile_t         tile;
+    band_tiler_t        *tiler;
+    size_t               ntiles = 0;
+    config.TileWidth    = BENCH_TILE_SIZE;
+    config.TileHeight   = BENCH_TILE_SIZE;
+    config.ImageWidth   = BENCH_IMAGE_WIDTH;
+    config.ImageHeight  = BENCH_IMAGE_HEIGHT - 8; // exercise partial tiles
+    config.BorderSize   = 2;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = NULL;
+    data->OutputSize   = 0;
+    *bytes = 0;
+    // the tiles are packed as copy_tile() writes them, so the output matches.
+    if ((tiler = band_tiler_open(&config, bench_band_read, data)) == NULL)
+        return 0;
+    while (band_tiler_next(tiler, &tile))
+    {
+        for (size_t r = 0; r < tile.TileHeight; ++r)
+        {
+            memcpy(&data->Output[data->OutputSize], (uint8_t*) tile.Pixels + r * tile.BytesPerRow, tile.TileWidth * 4);
+            data->OutputSize += tile.TileWidth * 4;
+        }
+        *bytes += tile.SourceWidth * tile.SourceHeight * 4;
+        ntiles++;
+    }
+    band_tiler_close(tiler);
+    return ntiles;
+}
+
+static size_t bench_tile_hash(bench_data_t *data, size_t *bytes)
+{
+    image_tiler_config_t config;
+    image_tile_t         tile;
+    size_t               ntiles;
+    config.TileWidth    = BENCH_TILE_SIZE;
+    config.TileHeight   = BENCH_TILE_SIZE;
+    config.ImageWidth   = BENCH_IMAGE_WIDTH;
+    config.ImageHeight  = BENCH_IMAGE_HEIGHT;
+    config.BorderSize   = 0;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = data->Image;
+    ntiles = tile_count(NULL, NULL, &config);
+    data->OutputSize = 0;
+    *bytes = 0;
+    for (size_t i = 0; i < ntiles; ++i)
+    {
+        // every tile is interior, so each is hashed in place.
+        view_tile(&tile, &config, i);
+        uint64_t h = tile_hash(&tile);
+        memcpy(&data->Output[data->OutputSize], &h, sizeof(h));
+        data->OutputSize += sizeof(h);
+        *bytes += tile.BytesPerTile;
+    }
+    return ntiles;
+}
+
+/*//////////////////////
+//  Quality Report    //
+//////////////////////*/
+/// @summary The quality levels compared by the -q quality report.
+static int const QualityLevels[] = { 10, 25, 50, 75, 90, 100 };
+
+/// @summary Stores an image split into the planar YCoCg sample blocks
+/// consumed by the forward DCT, along with the buffers for each pipeline.
+struct quality_image_t
+{
+    size_t   Width;          /// The image width, in pixels; a multiple of 16
+    size_t   Height;         /// The image height, in pixels; a multiple of 16
+    size_t   McuCount;       /// The number of 16x16 blocks in the image
+    uint8_t *Source;         /// The source image, in RGB8 format
+    int16_t *SampY;          /// McuCount * 256 luma samples
+    int16_t *SampC;          /// McuCount * 128 chroma samples; Co then Cg per MCU
+    float   *SampYf;         /// SampY converted to float
+    float   *SampCf;         /// SampC converted to float
+    int16_t *CoefY;          /// McuCount * 256 quantized luma coefficients
+    int16_t *CoefC;          /// McuCount * 128 quantized chroma coefficients
+    float   *CoefYf;         /// McuCount * 256 float luma coefficients
+    float   *CoefCf;         /// McuCount * 128 float chroma coefficients
+    int16_t *OutY;           /// McuCount * 256 reconstructed luma samples
+    int16_t *OutC;           /// McuCount * 128 reconstructed chroma samples
+    float   *OutYf;          /// McuCount * 256 float luma samples
+    float   *OutCf;          /// McuCount * 128 float chroma samples
+    uint8_t *Result;         /// The reconstructed image, in RGB8 format
+};
+
+/// @summary Reads the next whitespace-delimited decimal value from a PPM
+/// header, skipping comment lines.
+/// @param fp The file, positioned within the header.
+/// @param value On return, stores the value read.
+/// @return true if a value was read.
+static bool ppm_header_value(FILE *fp, size_t *value)
+{
+    int c = fgetc(fp);
+    for ( ; ; )
+    {
+        while (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            c = fgetc(fp);
+        if (c != '#')
+            break;
+        while (c != '\n' && c != EOF)
+            c = fgetc(fp);
+    }
+    if (c < '0' || c > '9')
+        return false;
+    *value = 0;
+    while (c >= '0' && c <= '9')
+    {
+        *value = *value * 10 + (size_t) (c - '0');
+        c = fgetc(fp);
+    }
+    // the single whitespace character after the header is consumed here.
+    return true;
+}
+
+/// @summary Loads a binary (P6) PPM file with 8 bits per channel as RGBA8,
+/// cropped to a whole number of 16x16 blocks.
+/// @param path The path of the file to load.
+/// @param width On return, stores the cropped width, in pixels.
+/// @param height On return, stores the cropped height, in pixels.
+/// @return The image pixels, which the caller must free(), or NULL.
+static uint8_t* load_ppm(char const *path, size_t *width, size_t *height)
+{
+    FILE    *fp = fopen(path, "rb");
+    uint8_t *px = NULL;
+    size_t   w  = 0, h = 0, maxval = 0;
+    if (fp == NULL)
+        return NULL;
+    if (fgetc(fp) != 'P' || fgetc(fp) != '6' ||
+       !ppm_header_value(fp, &w) || !ppm_header_value(fp, &h) ||
+       !ppm_header_value(fp, &maxval) || maxval != 255 || w < 16 || h < 16)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    *width  = w & ~size_t(15);
+    *height = h & ~size_t(15);
+    px = (uint8_t*) malloc(*width * *height * 4);
+    for (size_t y = 0; y < *height; ++y)
+    {
+        uint8_t row[3];
+        for (size_t x = 0; x < w; ++x)
+        {
+            if (fread(row, 3, 1, fp) != 1)
+            {
+                free(px);
+                fclose(fp);
+                return NULL;
+            }
+            if (x < *width)
+            {
+                uint8_t *dst = &px[(y * *width + x) * 4];
+                dst[0] = row[0];
+                dst[1] = row[1];
+                dst[2] = row[2];
+                dst[3] = 0xFF;
+            }
+        }
+    }
+    fclose(fp);
+    return px;
+}
+
+/// @summary Splits an RGBA8 image into planar sample blocks and allocates the
+/// per-pipeline buffers.
+/// @param img The image state to initialize.
+/// @param pixels The source image, in RGBA8 format.
+/// @param width The image width, in pixels; a multiple of 16.
+/// @param height The image height, in pixels; a multiple of 16.
+/// @param pitch The number of bytes per row of pixels.
+static void quality_image_init(quality_image_t *img, uint8_t const *pixels, size_t width, size_t height, size_t pitch)
+{
+    size_t const M = (width / 16) * (height / 16);
+    img->Width    = width;
+    img->Height   = height;
+    img->McuCount = M;
+    img->Source   = (uint8_t*) malloc(width * height * 3);
+    img->Result   = (uint8_t*) malloc(width * height * 3);
+    img->SampY    = (int16_t*) malloc(M * 384 * sizeof(int16_t));
+    img->CoefY    = (int16_t*) malloc(M * 384 * sizeof(int16_t));
+    img->OutY     = (int16_t*) malloc(M * 384 * sizeof(int16_t));
+    img->SampYf   = (float  *) malloc(M * 384 * sizeof(float));
+    img->CoefYf   = (float  *) malloc(M * 384 * sizeof(float));
+    img->OutYf    = (float  *) malloc(M * 384 * sizeof(float));
+    img->SampC    = img->SampY  + M * 256;
+    img->CoefC    = img->CoefY  + M * 256;
+    img->OutC     = img->OutY   + M * 256;
+    img->SampCf   = img->SampYf + M * 256;
+    img->CoefCf   = img->CoefYf + M * 256;
+    img->OutCf    = img->OutYf  + M * 256;
+
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            memcpy(&img->Source[(y * width + x) * 3], &pixels[y * pitch + x * 4], 3);
+        }
+    }
+    for (size_t m = 0; m < M; ++m)
+    {
+        uint8_t const *pix = pixels + (m / (width / 16)) * 16 * pitch + (m % (width / 16)) * 64;
+        uint8_t        A[256];
+        split16x16i(&img->SampY[m * 256], &img->SampC[m * 128], &img->SampC[m * 128 + 64], A, pix, pitch);
+    }
+    for (size_t i = 0; i < M * 384; ++i)
+        img->SampYf[i] = (float) img->SampY[i];
+}
+
+/// @summary Frees the memory allocated by quality_image_init().
+/// @param img The image state to free.
+static void quality_image_free(quality_image_t *img)
+{
+    free(img->OutYf);
+    free(img->CoefYf);
+    free(img->SampYf);
+    free(img->OutY);
+    free(img->CoefY);
+    free(img->SampY);
+    free(img->Result);
+    free(img->Source);
+    memset(img, 0, sizeof(quality_image_t));
+}
+
+/// @summary Rounds float values to the nearest int16_t.
+/// @param dst The destination buffer of count values.
+/// @param src The source buffer of count values.
+/// @param count The number of values to round.
+static void quality_round(int16_t *dst, float const *src, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = (int16_t) (int32_t) (src[i] + (src[i] < 0.0f ? -0.5f : 0.5f));
+}
+
+/// @summary Runs the Bink 2 integer DCT pipeline: forward transform and
+/// quantization followed by dequantization and the inverse transform.
+/// @param img The image state; OutY and OutC receive the reconstructed samples.
+/// @param Q The quantization context for the quality level.
+/// @param Dluma The integer IDCT luma table for the quality level.
+/// @param Dchroma The integer IDCT chroma table for the quality level.
+static void quality_run_int(quality_image_t *img, quant_context_t const *Q, int16_t const *Dluma, int16_t const *Dchroma)
+{
+    size_t const M = img->McuCount;
+    fdct8x8iq_batch(img->CoefY, img->SampY, &Q->Luma,   M * 4);
+    fdct8x8iq_batch(img->CoefC, img->SampC, &Q->Chroma, M * 2);
+    for (size_t i = 0; i < M * 4; ++i)
+        idct8x8id(&img->OutY[i * 64], &img->CoefY[i * 64], Dluma);
+    for (size_t i = 0; i < M * 2; ++i)
+        idct8x8id(&img->OutC[i * 64], &img->CoefC[i * 64], Dchroma);
+}
+
+/// @summary Runs the AA&N floating-point DCT pipeline. The coefficients are
+/// rounded to integers between the forward and inverse transforms, as they
+/// would be when stored, and the output is rounded to int16_t samples.
+/// @param img The image state; OutY and OutC receive the reconstructed samples.
+/// @param Q The float FDCT tables for the quality level; luma then chroma.
+/// @param D The float IDCT tables for the quality level; luma then chroma.
+static void quality_run_float(quality_image_t *img, float const (*Q)[64], float const (*D)[64])
+{
+    size_t const M = img->McuCount;
+    fdct8x8fq_batch(img->CoefYf, img->SampYf, Q[0], M * 4);
+    fdct8x8fq_batch(img->CoefCf, img->SampCf, Q[1], M * 2);
+    quality_round(img->CoefY, img->CoefYf, M * 384);
+    for (size_t i = 0; i < M * 384; ++i)
+        img->CoefYf[i] = (float) img->CoefY[i];
+    idct8x8fd_batch(img->OutYf, img->CoefYf, D[0], M * 4);
+    idct8x8fd_batch(img->OutCf, img->CoefCf, D[1], M * 2);
+    quality_round(img->OutY, img->OutYf, M * 384);
+}
+
+/// @summary Converts the reconstructed planar samples back to RGB8 in
+/// img->Result, shared by both pipelines.
+/// @param img The image state.
+static void quality_reconstruct(quality_image_t *img)
+{
+    size_t const mcu_x = img->Width / 16;
+    for (size_t m = 0; m < img->McuCount; ++m)
+    {
+        int16_t const *Y   = &img->OutY[m * 256];
+        int16_t const *Co  = &img->OutC[m * 128];
+        int16_t const *Cg  = Co + 64;
+        uint8_t       *dst = img->Result + ((m / mcu_x) * 16 * img->Width + (m % mcu_x) * 16) * 3;
+        for (size_t i = 0; i < 16; ++i)
+        {
+            int16_t const *y0 = &Y[(i >> 3) * 128 + (i & 7) * 8];
+            ycocg_row_rgb(dst + i * img->Width * 3, y0, y0 + 64, &Co[(i >> 1) * 8], &Cg[(i >> 1) * 8]);
+        }
+    }
+}
+
+/// @summary Calculates the peak signal-to-noise ratio of the reconstructed
+/// image over all three color channels.
+/// @param img The image state.
+/// @return The PSNR, in decibels.
+static double quality_psnr(quality_image_t const *img)
+{
+    size_t const n   = img->Width * img->Height * 3;
+    double       sse = 0.0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        double d = (double) img->Source[i] - (double) img->Result[i];
+        sse += d * d;
+    }
+    if (sse == 0.0)
+        return 99.0;
+    return 10.0 * log10(255.0 * 255.0 * (double) n / sse);
+}
+
+/// @summary Calculates the mean structural similarity of the luma channel of
+/// the reconstructed image over non-overlapping 8x8 windows.
+/// @param img The image state.
+/// @return The mean SSIM, in [-1, 1].
+static double quality_ssim(quality_image_t const *img)
+{
+    double const C1  = (0.01 * 255.0) * (0.01 * 255.0);
+    double const C2  = (0.03 * 255.0) * (0.03 * 255.0);
+    double       sum = 0.0;
+    size_t       n   = 0;
+    for (size_t by = 0; by + 8 <= img->Height; by += 8)
+    {
+        for (size_t bx = 0; bx + 8 <= img->Width; bx += 8)
+        {
+            double sa = 0, sb = 0, saa = 0, sbb = 0, sab = 0;
+            for (size_t y = by; y < by + 8; ++y)
+            {
+                for (size_t x = bx; x < bx + 8; ++x)
+                {
+                    uint8_t const *p = &img->Source[(y * img->Width + x) * 3];
+                    uint8_t const *q = &img->Result[(y * img->Width + x) * 3];
+                    double a = 0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2];
+                    double b = 0.299 * q[0] + 0.587 * q[1] + 0.114 * q[2];
+                    sa += a; sb += b; saa += a * a; sbb += b * b; sab += a * b;
+                }
+            }
+            double ma = sa / 64.0, mb = sb / 64.0;
+            double va = saa / 64.0 - ma * ma;
+            double vb = sbb / 64.0 - mb * mb;
+            double cv = sab / 64.0 - ma * mb;
+            sum += ((2.0 * ma * mb + C1) * (2.0 * cv + C2)) / ((ma * ma + mb * mb + C1) * (va + vb + C2));
+            n++;
+        }
+    }
+    return sum / (double) n;
+}
+
+/// @summary Prints the PSNR, SSIM and transform throughput of the integer
+/// and floating-point pipelines for one image at each quality level. The
+/// throughput covers the forward and inverse transforms only; the color
+/// conversion is shared and excluded.
+/// @param name The name to print for the image.
+/// @param img The image state.
+/// @param timing Specify true to measure throughput.
+static void quality_report(char const *name, quality_image_t *img, bool timing)
+{
+    for (size_t l = 0; l < sizeof(QualityLevels) / sizeof(QualityLevels[0]); ++l)
+    {
+        int                    q = QualityLevels[l];
+        quant_context_t const *Q = quant_context(q);
+        int16_t                Dl[64], Dc[64];
+        float                  Qf[2][64], Df[2][64];
+        qtables_decode(Dl, Dc, q);
+        qtables_encode(Qf[0], Qf[1], q);
+        qtables_decode(Df[0], Df[1], q);
+
+        for (int pipeline = 0; pipeline < 2; ++pipeline)
+        {
+            double best = 0.0;
+            for (size_t trial = 0; trial < (timing ? BENCH_TRIALS : 1); ++trial)
+            {
+                uint64_t start = nanotime();
+                uint64_t now   = start;
+                size_t   iters = 0;
+                do
+                {
+                    if (pipeline == 0) quality_run_int  (img, Q, Dl, Dc);
+                    else               quality_run_float(img, Qf, Df);
+                    now = nanotime();
+                    iters++;
+                } while (timing && now - start < BENCH_MIN_TIME_NS);
+                double rate = (double) iters * (double) img->McuCount / ((double) (now - start) * 1e-9);
+                if (rate > best) best = rate;
+            }
+            quality_reconstruct(img);
+            printf("%-24s %7d %-6s %9.2f %8.4f %12.0f\n", name, q, pipeline ? "float" : "int",
+                quality_psnr(img), quality_ssim(img), timing ? best : 0.0);
+        }
+    }
+}
+
+/// @summary Appends each page emitted by encode_image() to the benchmark output.
+static bool bench_encode_image_page(void *context, size_t index, void const *page, size_t page_size, int quality)
+{
+    bench_data_t *data = (bench_data_t*) context;
+    (void) index;
+    (void) quality;
+    memcpy(&data->Output[data->OutputSize], page, page_size);
+    data->OutputSize += page_size;
+    return true;
+}
+
+static size_t bench_encode_image_border(bench_data_t *data, size_t *bytes, size_t border)
+{
+    image_tiler_config_t config;
+    encode_stats_t       stats;
+    config.TileWidth    = BENCH_TILE_SIZE;
+    config.TileHeight   = BENCH_TILE_SIZE;
+    config.ImageWidth   = BENCH_IMAGE_WIDTH;
+    config.ImageHeight  = BENCH_IMAGE_HEIGHT - 8; // exercise partial tiles
+    config.BorderSize   = border;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = data->Image;
+    data->OutputSize   = 0;
+    encode_image(&config, BENCH_TILE_SIZE * BENCH_TILE_SIZE * 2, BENCH_RDO_LAMBDA, BENCH_THREADS, bench_encode_image_page, data, &stats);
+    *bytes = config.ImageWidth * config.ImageHeight * 4;
+    return stats.TileCount;
+}
+
+static size_t bench_encode_image(bench_data_t *data, size_t *bytes)
+{
+    return bench_encode_image_border(data, bytes, 2);
+}
+
+static size_t bench_encode_image_view(bench_data_t *data, size_t *bytes)
+{
+    // without borders, every tile but the bottom row is read in place.
+    return bench_encode_image_border(data, bytes, 0);
+}
+
+/*////////////////////
+//   Golden Table   //
+////////////////////*/
+/// @summary The list of benchmarks, in the order they are run, and the hash
+/// of the output each must produce. Regenerate the hashes with `benchapp -g`
+/// only when an output change is intentional.
+static bench_desc_t const Benchmarks[] =
+{
+    { "split16x16i",       "16x16", bench_split16x16i,       0x3D34E9852B3ABF93ULL },
+    { "fdct8x8i",          "8x8",   bench_fdct8x8i,          0xB68C1CB41A0E2DD5ULL },
+    { "fdct8x8iq",         "8x8",   bench_fdct8x8iq,         0x4D92AA4114A2B6C1ULL },
+    { "fdct8x8iq_batch",   "8x8",   bench_fdct8x8iq_batch,   0x4D92AA4114A2B6C1ULL },
+    { "quantize8x8_base",  "8x8",   bench_quantize8x8_base,  0x4D92AA4114A2B6C1ULL },
+    { "quantize8x8i",      "8x8",   bench_quantize8x8i,      0x4D92AA4114A2B6C1ULL },
+    { "fdct8x8f",          "8x8",   bench_fdct8x8f,          0xE59BD0A326DF97B4ULL },
+    { "fdct8x8fq",         "8x8",   bench_fdct8x8fq,         0x768C929079B02F2EULL },
+    { "fdct8x8fq_batch",   "8x8",   bench_fdct8x8fq_batch,   0xDF4EB4F9F7D2F1BFULL },
+    { "idct8x8i",          "8x8",   bench_idct8x8i,          0x46CC93E2993315E8ULL },
+    { "idct8x8id",         "8x8",   bench_idct8x8id,         0x1B88EE8C56F561F3ULL },
+    { "idct8x8f",          "8x8",   bench_idct8x8f,          0x75327C0BFF5787BBULL },
+    { "idct8x8fd",         "8x8",   bench_idct8x8fd,         0xA8F7A0A250A71F8DULL },
+    { "idct8x8fd_batch",   "8x8",   bench_idct8x8fd_batch,   0x8F5C1AA5E99628BEULL },
+    { "encode16x16i",      "16x16", bench_encode16x16i,      0xB1F5EF9EB3C75B9EULL },
+    { "decode16x16i_rgb",  "16x16", bench_decode16x16i_rgb,  0xC47551F2EE6F1C06ULL },
+    { "decode16x16i_rgba", "16x16", bench_decode16x16i_rgba, 0x7575804AE36542B6ULL },
+    { "decode16x16i_bc1",  "16x16", bench_decode16x16i_bc1,  0xDCB982A214833F6AULL },
+    { "decode16x16i_bc3",  "16x16", bench_decode16x16i_bc3,  0x40D03CD6CF0C5F12ULL },
+    { "decode16x16i_bc3_ycocg", "16x16", bench_decode16x16i_bc3_ycocg, 0xF273C4C04CE01915ULL },
+    { "encode_tile",       "16x16", bench_encode_tile,       0xB1F5EF9EB3C75B9EULL },
+    { "decode_tile",       "16x16", bench_decode_tile,       0x713988AEB3D02946ULL },
+    { "encode_tile_budget", "16x16", bench_encode_tile_budget, 0xB773B33A114E62DAULL },
+    { "encode_tile_budget_rdo", "16x16", bench_encode_tile_budget_rdo, 0xA8624420EA3381E6ULL },
+    { "decode_tile_page",  "16x16", bench_decode_tile_page,  0x212165C10B781C89ULL },
+    { "decode_tile_page_preview4", "16x16", bench_decode_tile_page_preview4, 0xDE36EA61D7230778ULL },
+    { "decode_tile_page_preview8", "16x16", bench_decode_tile_page_preview8, 0x4AD63B23E548EE1EULL },
+    { "generate_mipmaps_box", "pixel", bench_generate_mipmaps_box, 0x2D4D7A686F4164C5ULL },
+    { "generate_mipmaps_srgb", "pixel", bench_generate_mipmaps_srgb, 0x285D6382A5106D69ULL },
+    { "generate_mipmaps_alpha", "pixel", bench_generate_mipmaps_alpha, 0x37C83111EFFF45AEULL },
+    { "encode_image",      "tile",  bench_encode_image,      0xC4F98F5E39C03B7DULL },
+    { "encode_image_view", "tile",  bench_encode_image_view, 0x9E5660D19D3017BDULL },
+    { "copy_tile",         "tile",  bench_copy_tile,         0x0182DE844034E969ULL },
+    { "copy_tile_rgb8",    "tile",  bench_copy_tile_rgb8,    0x7D0C73F835A276A1ULL },
+    { "copy_tile_rgba16",  "tile",  bench_copy_tile_rgba16,  0x0182DE844034E969ULL },
+    { "band_tiler",        "tile",  bench_band_tiler,        0x0182DE844034E969ULL },
+    { "tile_hash",         "tile",  bench_tile_hash,         0x4D6AE4DE4CCDFE45ULL },
+};
+
+/*///////////////////////
+//  Public Functions   //
+///////////////////////*/
+int main(int argc, char **argv)
+{
+    // -g prints the golden table for the current output instead of checking.
+    // -n checks the outputs without timing them.
+    // -q [image.ppm ...] prints the quality report for each image, or for
+    // the generated image if none are given.
+    bool          golden = false;
+    bool          timing = true;
+    bool          report = false;
+    int           nfiles = 0;
+    size_t        failed = 0;
+    size_t const  count  = sizeof(Benchmarks) / sizeof(Benchmarks[0]);
+    bench_data_t  data;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-g") == 0) golden = true;
+        if (strcmp(argv[i], "-n") == 0) timing = false;
+        if (strcmp(argv[i], "-q") == 0) report = true;
+        else if (argv[i][0] != '-') nfiles++;
+    }
+
+    bench_data_init(&data);
+    if (report)
+    {
+        quality_image_t img;
+        printf("%-24s %7s %-6s %9s %8s %12s\n", "image", "quality", "dct", "PSNR(dB)", "SSIM", "MCU/s");
+        if (nfiles == 0)
+        {
+            quality_image_init(&img, data.Image, BENCH_IMAGE_WIDTH, BENCH_IMAGE_HEIGHT, data.Pitch);
+            quality_report("(generated)", &img, timing);
+            quality_image_free(&img);
+        }
+        for (int i = 1; i < argc; ++i)
+        {
+            size_t   w, h;
+            uint8_t *px = NULL;
+            if (argv[i][0] == '-')
+                continue;
+            if ((px = load_ppm(argv[i], &w, &h)) == NULL)
+            {
+                printf("%s: not a binary 8-bit PPM file\n", argv[i]);
+                failed++;
+                continue;
+            }
+            quality_image_init(&img, px, w, h, w * 4);
+            quality_report(argv[i], &img, timing);
+            quality_image_free(&img);
+            free(px);
+        }
+        bench_data_free(&data);
+        return (failed == 0) ? 0 : 1;
+    }
+    if (golden)
+    {
+        select_kernels(CPU_ISA_SCALAR);
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t bytes = 0;
+            Benchmarks[i].Run(&data, &bytes);
+            char   name[64];
+            char   unit[16];
+            char   func[64];
+            snprintf(name, sizeof(name), "\"%s\",", Benchmarks[i].Name);
+            snprintf(unit, sizeof(unit), "\"%s\",", Benchmarks[i].Unit);
+            snprintf(func, sizeof(func), "bench_%s,",   Benchmarks[i].Name);
+            printf("    { %-20s %-8s %-24s 0x%016llXULL },\n", name, unit, func,
+                (unsigned long long) fnv1a64(data.Output, data.OutputSize));
+        }
+        bench_data_free(&data);
+        return 0;
+    }
+
+    printf("%-18s %-6s %10s %14s  %s\n", "kernel", "isa", "MB/s", "blocks/s", "output");
+    for (int32_t isa = CPU_ISA_SCALAR; isa <= cpu_isa_supported(); ++isa)
+    {
+        if (select_kernels(isa) != isa)
+            continue;
+        for (size_t i = 0; i < count; ++i)
+        {
+            bench_desc_t const &b = Benchmarks[i];
+            size_t   bytes  = 0;
+            size_t   blocks = b.Run(&data, &bytes);
+            uint64_t hash   = fnv1a64(data.Output, data.OutputSize);
+            bool     match  = (hash == b.Golden);
+            double   best   = 0.0;
+            if (!match) failed++;
+
+            for (size_t trial = 0; timing && trial < BENCH_TRIALS; ++trial)
+            {
+                uint64_t start = nanotime();
+                uint64_t now   = start;
+                size_t   iters = 0;
+                do
+                {
+                    b.Run(&data, &bytes);
+                    now = nanotime();
+                    iters++;
+                } while (now - start < BENCH_MIN_TIME_NS);
+                double rate = (double) iters / ((double) (now - start) * 1e-9);
+                if (rate > best) best = rate;
+            }
+            if (timing)
+            {
+                printf("%-18s %-6s %10.1f %14.0f  %s\n", b.Name, isa_name(isa),
+                    best * (double) bytes / (1024.0 * 1024.0), best * (double) blocks,
+                    match ? "ok" : "MISMATCH");
+            }
+            else
+            {
+                printf("%-18s %-6s %10s %14s  %s\n", b.Name, isa_name(isa), "-", "-",
+                    match ? "ok" : "MISMATCH");
+            }
+            if (!match)
+            {
+                printf("  expected 0x%016llX, got 0x%016llX\n",
+                    (unsigned long long) b.Golden, (unsigned long long) hash);
+            }
+        }
+    }
+    select_kernels(CPU_ISA_BEST);
+    bench_data_free(&data);
+    printf("bench: %s (%u mismatched outputs)\n", failed ? "FAIL" : "PASS", (unsigned) failed);
+    return (failed == 0) ? 0 : 1;
+}
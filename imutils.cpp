@@ -26,6 +26,49 @@
 #include <string.h>
 #include "imutils.hpp"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define IM_ENABLE_SSE2  1
+    #include <emmintrin.h>
+#else
+    #define IM_ENABLE_SSE2  0
+#endif
+
+// AVX2 kernels are compiled into every x86 build and selected at runtime,
+// so they must not depend on -mavx2. GCC and clang need a per-function target
+// attribute to emit AVX2 instructions; MSVC accepts the intrinsics as-is.
+#if IM_ENABLE_SSE2 && (defined(__GNUC__) || defined(__clang__))
+    #define IM_ENABLE_AVX2  1
+    #define IM_TARGET_AVX2  __attribute__((target("avx2")))
+    #define IM_TARGET_FMA   __attribute__((target("avx2,fma")))
+    #include <immintrin.h>
+    #include <cpuid.h>
+#elif IM_ENABLE_SSE2 && defined(_MSC_VER)
+    #define IM_ENABLE_AVX2  1
+    #define IM_TARGET_AVX2
+    #define IM_TARGET_FMA
+    #include <immintrin.h>
+    #include <intrin.h>
+#else
+    #define IM_ENABLE_AVX2  0
+    #define IM_TARGET_AVX2
+    #define IM_TARGET_FMA
+#endif
+
+#if defined(_MSC_VER)
+    #define IM_THREAD_LOCAL __declspec(thread)
+#else
+    #define IM_THREAD_LOCAL __thread
+#endif
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #include <process.h>
+#else
+    #include <pthread.h>
+    #include <time.h>
+#endif
+
 /*////////////////
 //  Data Types  //
 ////////////////*/
@@ -211,156 +254,318 @@ static inline uint8_t clamp(int32_t v)
     return (uint8_t) ((v < 0) ? 0 : ((v > 255) ? 255 : v));
 }
 
-/// @summary Convert a block of 16x16 RGBA pixels to YCoCgA format. The alpha
-/// channel is extracted and stored in a separate output buffer.
-/// @param ycocg The 768 element output buffer for storing the YCoCg channels.
-/// The YCoCg data has a range of [-255, 255] for any 8-bit unsigned RGB tuple.
-/// @param alpha The 256 byte output buffer for storing the alpha channel.
-/// @param rgba The 1024 byte input buffer of 256 pixels in RGBA8 format.
-static void rgba_to_ycocga(
-    int16_t       * restrict ycocg,
-    uint8_t       * restrict alpha,
-    uint8_t const * restrict rgba)
-{
-    uint8_t const * RGBA   = (uint8_t const*) rgba;
-    int16_t       * YCoCg  = (int16_t      *) ycocg;
-    uint8_t       * A      = (uint8_t      *) alpha;
-    for (size_t i = 0; i < 256; ++i)
-    {
-        int16_t r = *RGBA++;
-        int16_t g = *RGBA++;
-        int16_t b = *RGBA++;
-        *A++      = *RGBA++;
-        int16_t Co= r  -  b;
-        int16_t t = b  + (Co >> 1);
-        int16_t Cg= g  -  t;
-        int16_t Y = t  + (Cg >> 1);
-        *YCoCg++  = Y;
-        *YCoCg++  = Co;
-        *YCoCg++  = Cg;
-    }
-}
-
-/// @summary Convert a block of 16x16 YCoCgA pixels to RGBA format. The alpha
-/// channel is stored separately from the luma and chroma channels.
-/// @param rgba The 1024 byte buffer to which RGBA values will be written.
-/// @param ycocg The 768 byte input buffer storing the YCoCg channels. The
-/// YCoCg data has a range of [-255, 255] for any 8-bit unsigned RGB tuple; the
-/// Y channel is always in [0, 255] while Co and Cg are in [-255, 255].
-/// @param alpha The 256 byte buffer storing the alpha channel.
-static void ycocga_to_rgba(
-    uint8_t       *          rgba,
-    int16_t const * restrict ycocg,
-    uint8_t const * restrict alpha)
-{
-    int16_t const *YCoCg  = (int16_t const*) ycocg;
-    uint8_t const *A      = (uint8_t const*) alpha;
-    uint8_t       *RGBA   = (uint8_t      *) rgba;
-    for (size_t i = 0; i < 256; ++i)
-    {
-        int16_t y =*YCoCg++;
-        int16_t co=*YCoCg++;
-        int16_t cg=*YCoCg++;
-        int16_t t = y  - (cg >> 1);
-        int16_t g = cg +  t;
-        int16_t b = t  - (co >> 1);
-        int16_t r = b  +  co;
-        *RGBA++   = clamp(r);
-        *RGBA++   = clamp(g);
-        *RGBA++   = clamp(b);
-        *RGBA++   = *A++;
-    }
+/// @summary Determines the index of the least significant set bit.
+/// @param v The value, which must be non-zero.
+/// @return The bit index, in [0, 63].
+static inline uint32_t lowbit64(uint64_t v)
+{
+#if defined(__GNUC__)
+    return (uint32_t) __builtin_ctzll(v);
+#else
+    uint32_t r = 0;
+    while ((v & 1) == 0) { v >>= 1; ++r; }
+    return r;
+#endif
 }
 
-/// @summary Determines the border color to use at the edge of a tile.
-/// @param config The tiler configuration.
-/// @param edge A pointer to the edge pixel.
-/// @return The packed RGBA8 color to use for the border.
-static inline uint32_t sample_border(image_tiler_config_t const *config, uint32_t const *edge)
+/// @summary Rounds a 16-bit channel value to the nearest 8-bit value, that
+/// is, computes round(v / 257) without a divide. Write v = 256a + b; then
+/// v / 257 = a + (b - a) / 257, and |b - a| < 257, so the rounding moves a
+/// by at most one.
+/// @param v The 16-bit value.
+/// @return The 8-bit value.
+static inline uint8_t round16to8(uint32_t v)
 {
-    switch (config->BorderMode)
-    {
-        case BORDER_CLAMP_TO_EDGE:  return *edge;
-        case BORDER_CONSTANT_COLOR: return config->BorderColor;
-        default: break;
-    }
-    return 0;
+    int32_t a = (int32_t) (v >> 8);
+    int32_t d = (int32_t) (v & 0xFF) - a;
+    return (uint8_t) (a + (d >= 129) - (d <= -129));
 }
 
-/// @summary Reads one row of pixels for a tile from the source image, applying
-/// borders to the left and right edges, and padding to the right edge.
-/// @param row_buf A buffer capable of holding one row of pixels in the tile.
-/// @param src_row Pointer to the first pixel in the source image to copy.
-/// @param src_num The number of pixels to copy from the source image.
-/// @param pad_right The number of pixels of padding to apply to the right side
-/// of the row, if the tile extends past the right edge of the source image.
-/// @param config The tiler configuration, specifying how to sample borders.
-static void read_row(
-    uint32_t       * restrict   row_buf,
-    uint32_t const * restrict   src_row,
-    size_t                      src_num,
-    size_t                      pad_right,
-    image_tiler_config_t const *config)
+/// @summary Expands a row of source pixels to RGBA8.
+/// @param dst The destination row of @a count RGBA8 pixels.
+/// @param src The first source pixel.
+/// @param count The number of pixels to expand.
+/// @param format One of source_format_e.
+static void expand_row_base(
+    uint32_t      * restrict dst,
+    uint8_t const * restrict src,
+    size_t                   count,
+    int32_t                  format)
 {
-    uint32_t const *left_edge    = src_row;
-    uint32_t const *right_edge   = src_row + (src_num - 1);
+    uint8_t *out = (uint8_t*) dst;
+    switch (format)
+    {
+        case SOURCE_FORMAT_RGB8:
+            for (size_t i = 0; i < count; ++i, out += 4, src += 3)
+            {
+                out[0] = src[0];
+                out[1] = src[1];
+                out[2] = src[2];
+                out[3] = 0xFF;
+            }
+            break;
 
-    // write the left-side border.
-    uint32_t left_border = sample_border(config, left_edge);
-    for (size_t i = 0; i < config->BorderSize; ++i)
-        *row_buf++= left_border;
+        case SOURCE_FORMAT_R8:
+            for (size_t i = 0; i < count; ++i, out += 4, src += 1)
+            {
+                out[0] = out[1] = out[2] = src[0];
+                out[3] = 0xFF;
+            }
+            break;
 
-    // copy the source data from the image.
-    for (size_t i = 0; i < src_num; ++i)
-        *row_buf++= *src_row++;
+        case SOURCE_FORMAT_RG8:
+            for (size_t i = 0; i < count; ++i, out += 4, src += 2)
+            {
+                out[0] = out[1] = out[2] = src[0];
+                out[3] = src[1];
+            }
+            break;
 
-    // add padding to the right side of the image.
-    uint32_t right_pixel = *right_edge;
-    for (size_t i = 0; i < pad_right; ++i)
-        *row_buf++= right_pixel;
+        case SOURCE_FORMAT_RGBA16:
+            {
+                uint16_t const *s16 = (uint16_t const*) src;
+                for (size_t i = 0; i < count * 4; ++i)
+                    out[i] = round16to8(s16[i]);
+            }
+            break;
 
-    // write the right-side border.
-    uint32_t right_border= sample_border(config, right_edge);
-    for (size_t i = 0; i < config->BorderSize; ++i)
-        *row_buf++= right_border;
+        default:
+            memcpy(dst, src, count * 4);
+            break;
+    }
 }
 
-/// @summary Reads one row of pixels for a tile from the source image, applying
-/// borders to the left and right edges, and padding to the right edge, for
-/// rows that are part of the top and bottom borders of the image.
-/// @param row_buf A buffer capable of holding one row of pixels in the tile.
-/// @param row_num The number of pixels in a single row of the tile.
-/// @param src_row Pointer to the first pixel in the source image to copy.
-/// @param src_num The number of pixels to copy from the source image.
-/// @param pad_right The number of pixels of padding to apply to the right side
-/// of the row, if the tile extends past the right edge of the source image.
-/// @param config The tiler configuration, specifying how to sample borders.
-static void read_row_border(
-    uint32_t       * restrict   row_buf,
-    size_t                      row_num,
-    uint32_t const * restrict   src_row,
-    size_t                      src_num,
-    size_t                      pad_right,
-    image_tiler_config_t const *config)
+#if IM_ENABLE_SSE2
+/// @summary Rounds eight 16-bit channel values to 8 bits, as round16to8().
+/// @param v Eight unsigned 16-bit values.
+/// @return Eight values in [0, 255], one per 16-bit lane.
+static inline __m128i round16to8_sse2(__m128i v)
 {
-    switch (config->BorderMode)
+    __m128i a = _mm_srli_epi16(v, 8);
+    __m128i d = _mm_sub_epi16(_mm_and_si128(v, _mm_set1_epi16(0xFF)), a);
+    __m128i u = _mm_cmpgt_epi16(d, _mm_set1_epi16( 128)); // -1 where d >=  129
+    __m128i l = _mm_cmpgt_epi16(_mm_set1_epi16(-128), d); // -1 where d <= -129
+    return _mm_add_epi16(_mm_sub_epi16(a, u), l);
+}
+
+/// @summary Expands a row of source pixels to RGBA8 using SSE2. Gray, gray
+/// and alpha, and 16-bit rows are expanded sixteen or eight pixels at a time;
+/// RGB8 rows are left to the portable kernel.
+/// @param dst The destination row of @a count RGBA8 pixels.
+/// @param src The first source pixel.
+/// @param count The number of pixels to expand.
+/// @param format One of source_format_e.
+static void expand_row_sse2(
+    uint32_t      * restrict dst,
+    uint8_t const * restrict src,
+    size_t                   count,
+    int32_t                  format)
+{
+    __m128i const ones = _mm_set1_epi8((char) 0xFF);
+    __m128i      *out  = (__m128i*) dst;
+    size_t        i    = 0;
+    switch (format)
     {
-        case BORDER_CLAMP_TO_EDGE:
+        case SOURCE_FORMAT_R8:
+            for ( ; i + 16 <= count; i += 16, out += 4)
             {
-                // the standard read_row() already does the right thing.
-                read_row(row_buf, src_row, src_num, pad_right, config);
+                __m128i g  = _mm_loadu_si128((__m128i const*) &src[i]);
+                __m128i gg = _mm_unpacklo_epi8(g, g);
+                __m128i hh = _mm_unpackhi_epi8(g, g);
+                __m128i ga = _mm_unpacklo_epi8(g, ones);
+                __m128i ha = _mm_unpackhi_epi8(g, ones);
+                _mm_storeu_si128(&out[0], _mm_unpacklo_epi16(gg, ga));
+                _mm_storeu_si128(&out[1], _mm_unpackhi_epi16(gg, ga));
+                _mm_storeu_si128(&out[2], _mm_unpacklo_epi16(hh, ha));
+                _mm_storeu_si128(&out[3], _mm_unpackhi_epi16(hh, ha));
             }
+            expand_row_base((uint32_t*) out, &src[i], count - i, format);
             break;
 
-        case BORDER_CONSTANT_COLOR:
+        case SOURCE_FORMAT_RG8:
+            for ( ; i + 8 <= count; i += 8, out += 2)
             {
-                // duplicate the constant color across the entire row.
-                for (size_t i = 0; i < row_num; ++i)
-                    *row_buf++= config->BorderColor;
+                __m128i v  = _mm_loadu_si128((__m128i const*) &src[i * 2]);
+                __m128i g  = _mm_and_si128(v, _mm_set1_epi16(0xFF));
+                __m128i gg = _mm_or_si128 (g, _mm_slli_epi16(g, 8));
+                _mm_storeu_si128(&out[0], _mm_unpacklo_epi16(gg, v));
+                _mm_storeu_si128(&out[1], _mm_unpackhi_epi16(gg, v));
+            }
+            expand_row_base((uint32_t*) out, &src[i * 2], count - i, format);
+            break;
+
+        case SOURCE_FORMAT_RGBA16:
+            for ( ; i + 8 <= count; i += 8, out += 2)
+            {
+                __m128i const *s = (__m128i const*) &src[i * 8];
+                __m128i v0 = round16to8_sse2(_mm_loadu_si128(&s[0]));
+                __m128i v1 = round16to8_sse2(_mm_loadu_si128(&s[1]));
+                __m128i v2 = round16to8_sse2(_mm_loadu_si128(&s[2]));
+                __m128i v3 = round16to8_sse2(_mm_loadu_si128(&s[3]));
+                _mm_storeu_si128(&out[0], _mm_packus_epi16(v0, v1));
+                _mm_storeu_si128(&out[1], _mm_packus_epi16(v2, v3));
             }
+            expand_row_base((uint32_t*) out, &src[i * 8], count - i, format);
+            break;
+
+        default:
+            expand_row_base(dst, src, count, format);
             break;
     }
 }
+#endif /* IM_ENABLE_SSE2 */
+
+#if IM_ENABLE_AVX2
+/// @summary Expands a row of source pixels to RGBA8 using AVX2. RGB8 rows
+/// are expanded sixteen pixels at a time with byte shuffles; all other
+/// formats use the SSE2 kernel.
+/// @param dst The destination row of @a count RGBA8 pixels.
+/// @param src The first source pixel.
+/// @param count The number of pixels to expand.
+/// @param format One of source_format_e.
+IM_TARGET_AVX2
+static void expand_row_avx2(
+    uint32_t      * restrict dst,
+    uint8_t const * restrict src,
+    size_t                   count,
+    int32_t                  format)
+{
+    if (format != SOURCE_FORMAT_RGB8)
+    {
+        expand_row_sse2(dst, src, count, format);
+        return;
+    }
+    // each shuffle spreads four 3-byte pixels over 16 bytes; the alpha bytes
+    // are zeroed by the shuffle and then set.
+    __m128i const mask  = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    __m128i const alpha = _mm_set1_epi32((int) 0xFF000000U);
+    __m128i      *out   = (__m128i*) dst;
+    size_t        i     = 0;
+    for ( ; i + 16 <= count; i += 16, out += 4)
+    {
+        __m128i const *s = (__m128i const*) &src[i * 3];
+        __m128i a = _mm_loadu_si128(&s[0]);
+        __m128i b = _mm_loadu_si128(&s[1]);
+        __m128i c = _mm_loadu_si128(&s[2]);
+        _mm_storeu_si128(&out[0], _mm_or_si128(_mm_shuffle_epi8(a, mask), alpha));
+        _mm_storeu_si128(&out[1], _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask), alpha));
+        _mm_storeu_si128(&out[2], _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b,  8), mask), alpha));
+        _mm_storeu_si128(&out[3], _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128 (c, 4),    mask), alpha));
+    }
+    expand_row_base((uint32_t*) out, &src[i * 3], count - i, format);
+}
+#endif /* IM_ENABLE_AVX2 */
+
+/// @summary The number of 32-bit lanes of the tile hash. Word i of each row
+/// is mixed into lane i % TileHashLanes, so every kernel gives the same hash.
+static const size_t   TileHashLanes  = 8;
+
+/// @summary The multipliers of the tile hash lanes, from xxHash32.
+static const uint32_t TileHashPrime1 = 0x9E3779B1U;
+static const uint32_t TileHashPrime2 = 0x85EBCA77U;
+
+/// @summary Mixes one 32-bit word into a lane of the tile hash, as one round
+/// of xxHash32.
+/// @param h The lane.
+/// @param w The word.
+/// @return The updated lane.
+static inline uint32_t hash_round(uint32_t h, uint32_t w)
+{
+    h += w * TileHashPrime2;
+    h  = (h << 13) | (h >> 19);
+    return h * TileHashPrime1;
+}
+
+/// @summary Mixes a row of 32-bit words into the lanes of the tile hash.
+/// @param lanes The TileHashLanes lanes of the hash.
+/// @param src The first word of the row. Need not be aligned.
+/// @param count The number of words in the row.
+static void hash_row_base(
+    uint32_t      * restrict lanes,
+    uint8_t const * restrict src,
+    size_t                   count)
+{
+    for (size_t i = 0; i < count; ++i, src += 4)
+    {
+        uint32_t w;
+        memcpy(&w, src, 4);
+        lanes[i % TileHashLanes] = hash_round(lanes[i % TileHashLanes], w);
+    }
+}
+
+#if IM_ENABLE_SSE2
+/// @summary Multiplies the 32-bit lanes of two vectors, keeping the low 32
+/// bits of each product. SSE2 has only the even-lane 32x32->64 multiply.
+/// @param a The first vector.
+/// @param b The second vector.
+/// @return The four low halves of the products.
+static inline __m128i mullo_epi32_sse2(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+/// @summary Mixes a row of 32-bit words into the lanes of the tile hash using
+/// SSE2, eight words at a time in two vectors.
+/// @param lanes The TileHashLanes lanes of the hash.
+/// @param src The first word of the row. Need not be aligned.
+/// @param count The number of words in the row.
+static void hash_row_sse2(
+    uint32_t      * restrict lanes,
+    uint8_t const * restrict src,
+    size_t                   count)
+{
+    __m128i const p1 = _mm_set1_epi32((int) TileHashPrime1);
+    __m128i const p2 = _mm_set1_epi32((int) TileHashPrime2);
+    __m128i       h0 = _mm_loadu_si128((__m128i const*) &lanes[0]);
+    __m128i       h1 = _mm_loadu_si128((__m128i const*) &lanes[4]);
+    size_t        i  = 0;
+    for ( ; i + 8 <= count; i += 8)
+    {
+        __m128i w0 = _mm_loadu_si128((__m128i const*) &src[i * 4]);
+        __m128i w1 = _mm_loadu_si128((__m128i const*) &src[i * 4 + 16]);
+        h0 = _mm_add_epi32(h0, mullo_epi32_sse2(w0, p2));
+        h1 = _mm_add_epi32(h1, mullo_epi32_sse2(w1, p2));
+        h0 = _mm_or_si128 (_mm_slli_epi32(h0, 13), _mm_srli_epi32(h0, 19));
+        h1 = _mm_or_si128 (_mm_slli_epi32(h1, 13), _mm_srli_epi32(h1, 19));
+        h0 = mullo_epi32_sse2(h0, p1);
+        h1 = mullo_epi32_sse2(h1, p1);
+    }
+    _mm_storeu_si128((__m128i*) &lanes[0], h0);
+    _mm_storeu_si128((__m128i*) &lanes[4], h1);
+    hash_row_base(lanes, &src[i * 4], count - i);
+}
+#endif /* IM_ENABLE_SSE2 */
+
+#if IM_ENABLE_AVX2
+/// @summary Mixes a row of 32-bit words into the lanes of the tile hash using
+/// AVX2, eight words at a time in one vector.
+/// @param lanes The TileHashLanes lanes of the hash.
+/// @param src The first word of the row. Need not be aligned.
+/// @param count The number of words in the row.
+IM_TARGET_AVX2
+static void hash_row_avx2(
+    uint32_t      * restrict lanes,
+    uint8_t const * restrict src,
+    size_t                   count)
+{
+    __m256i const p1 = _mm256_set1_epi32((int) TileHashPrime1);
+    __m256i const p2 = _mm256_set1_epi32((int) TileHashPrime2);
+    __m256i       h  = _mm256_loadu_si256((__m256i const*) lanes);
+    size_t        i  = 0;
+    for ( ; i + 8 <= count; i += 8)
+    {
+        __m256i w = _mm256_loadu_si256((__m256i const*) &src[i * 4]);
+        h = _mm256_add_epi32  (h, _mm256_mullo_epi32(w, p2));
+        h = _mm256_or_si256   (_mm256_slli_epi32(h, 13), _mm256_srli_epi32(h, 19));
+        h = _mm256_mullo_epi32(h, p1);
+    }
+    _mm256_storeu_si256((__m256i*) lanes, h);
+    hash_row_base(lanes, &src[i * 4], count - i);
+}
+#endif /* IM_ENABLE_AVX2 */
 
 /// @summary Generates a set of Contrast Sensitivity Function coefficients from
 /// an existing quantization table, and places the output coefficients into the
@@ -440,6 +645,38 @@ static void scaled_qtable_int16(
     }
 }
 
+/// @summary Builds the reciprocal form of an integer quantization table so
+/// that the FDCT can quantize with a multiply and shift instead of a divide.
+/// For a divisor d in [1, 255] with l = ceil(log2(d)), the shift is 15 + l and
+/// the multiplier is ceil(2^shift / d), which fits in 16 bits. The rounding
+/// error of the multiplier is less than d, and every magnitude is at most
+/// 2^15, so the error term stays below 2^shift and (|x| * m) >> shift equals
+/// |x| / d exactly, matching C truncating division once the sign is restored.
+/// @param Q The quantization table to initialize.
+/// @param Qidct The 64-element dequantization table, as output by the
+/// scaled_qtable_int16() function.
+/// @param Qfdct The 64-element quantization table, as output by the
+/// scaled_qtable_int16() function. Values are in the range [1, 255]; a
+/// divisor of zero or less is stored as one.
+static void reciprocal_qtable_int16(
+    quant_table_t * restrict Q,
+    int16_t const * restrict Qidct,
+    int16_t const * restrict Qfdct)
+{
+    #define DCTSIZE 8U
+    for (size_t i = 0; i < DCTSIZE * DCTSIZE; ++i)
+    {
+        uint32_t d   = (Qfdct[i] > 0) ? (uint32_t) Qfdct[i] : 1U;
+        uint32_t l   = 0;
+        while ((1U << l) < d) ++l;
+        uint32_t k   = 15 + l;
+        Q->Qidct[i]  = Qidct[i];
+        Q->Qfdct[i]  = (int16_t) d;
+        Q->Recip[i]  = (uint16_t) (((1U << k) + d - 1) / d);
+        Q->Shift[i]  = (uint16_t)   k;
+    }
+}
+
 /// @summary Performs a 2D forward DCT on an 8x8 block of a single channel.
 /// This is performed after the RGBA pixels are converted to YCoCg, and after
 /// subsampling to 4:2:0, so this routine is called four times for luma and
@@ -759,6 +996,126 @@ static void fdct8x8fq_base(
         dst[i] *= quant[i];
 }
 
+/// @summary Quantizes an 8x8 block of DCT coefficients in place by multiply
+/// and shift on the magnitude. See reciprocal_qtable_int16() for why this
+/// matches C truncating division by the Qfdct table.
+/// @param coeff The 64-element array of coefficients to quantize.
+/// @param quant The reciprocal quantization table, as output by the
+/// reciprocal_qtable_int16() function.
+static inline void quantize8x8_base(int16_t *coeff, quant_table_t const *quant)
+{
+    for (size_t i = 0; i < 64; ++i)
+    {
+        int32_t  x = coeff[i];
+        int32_t  s = x >> 31;
+        uint32_t n = (uint32_t) ((x ^ s) - s);
+        int32_t  q = (int32_t)  ((n * quant->Recip[i]) >> quant->Shift[i]);
+        coeff[i]   = (int16_t)  ((q ^ s) - s);
+    }
+}
+
+/// @summary Computes one entry of the quantization table for a quality
+/// level, exactly as quantization_table() does. When both arguments are
+/// compile-time constants the whole computation folds to a constant.
+/// @param base The base JPEG quantization coefficient.
+/// @param quality The quality level, in [1, 100].
+/// @return The divisor, in [1, 255].
+static inline uint32_t fixed_qdivisor(int32_t base, int quality)
+{
+    int32_t q = (quality < 50) ? (5000 / quality) : (200 - quality * 2);
+    return (uint32_t) qmin(qmax((base * q + 50) / 100, 1), 255);
+}
+
+/// @summary Computes the shift paired with a divisor, exactly as
+/// reciprocal_qtable_int16() does.
+/// @param d The divisor, in [1, 255].
+/// @return The shift amount, 15 + ceil(log2(d)).
+static inline uint32_t fixed_qshift(uint32_t d)
+{
+    uint32_t l = 0;
+    while ((1U << l) < d) ++l;
+    return 15 + l;
+}
+
+/// @summary Quantizes element I of an 8x8 block with the divisor for a
+/// quality level known at compile time, then recurses to element I + 1 so
+/// that the compiler emits one straight-line sequence per block with every
+/// multiplier and shift as an immediate operand.
+/// @param Quality The quality level, in [1, 100].
+/// @param Chroma true to use the chroma table, false to use the luma table.
+/// @param I The index of the coefficient to quantize.
+template <int Quality, bool Chroma, size_t I>
+struct quantize8x8_fixed_t
+{
+    static inline void apply(int16_t *coeff)
+    {
+        uint32_t d = fixed_qdivisor(Chroma ? JPEGChromaQuant[I] : JPEGLumaQuant[I], Quality);
+        uint32_t k = fixed_qshift(d);
+        uint32_t m = ((1U << k) + d - 1) / d;
+        int32_t  x = coeff[I];
+        int32_t  s = x >> 31;
+        uint32_t n = (uint32_t) ((x ^ s) - s);
+        int32_t  q = (int32_t)  ((n * m) >> k);
+        coeff[I]   = (int16_t)  ((q ^ s) - s);
+        quantize8x8_fixed_t<Quality, Chroma, I + 1>::apply(coeff);
+    }
+};
+
+/// @summary Terminates the recursion of quantize8x8_fixed_t.
+template <int Quality, bool Chroma>
+struct quantize8x8_fixed_t<Quality, Chroma, 64>
+{
+    static inline void apply(int16_t *)
+    { /* empty */ }
+};
+
+/// @summary Quantizes an 8x8 block of DCT coefficients in place for a fixed
+/// quality level. The output is identical to quantize8x8_base() with the
+/// table returned by quant_context(Quality).
+/// @param coeff The 64-element array of coefficients to quantize.
+template <int Quality, bool Chroma>
+static void quantize8x8_fixed(int16_t *coeff)
+{
+    quantize8x8_fixed_t<Quality, Chroma, 0>::apply(coeff);
+}
+
+/// @summary The signature of a quantizer specialized for one quality level
+/// and channel.
+typedef void (*quantize8x8_fixed_fn)(int16_t *coeff);
+
+/// @summary The luma and chroma quantizers specialized for one quality level.
+struct fixed_quantizer_t
+{
+    int                  Quality; /// The quality level, in [1, 100].
+    quantize8x8_fixed_fn Luma;    /// Quantizes one block of luma coefficients.
+    quantize8x8_fixed_fn Chroma;  /// Quantizes one block of chroma coefficients.
+};
+
+/// @summary The quality levels the tools actually ship at get a quantizer
+/// with the table folded in; all other levels use quantize8x8_base().
+static fixed_quantizer_t const FixedQuantizers[] =
+{
+    { 50, quantize8x8_fixed<50, false>, quantize8x8_fixed<50, true> },
+    { 75, quantize8x8_fixed<75, false>, quantize8x8_fixed<75, true> },
+    { 85, quantize8x8_fixed<85, false>, quantize8x8_fixed<85, true> },
+    { 90, quantize8x8_fixed<90, false>, quantize8x8_fixed<90, true> },
+    { 95, quantize8x8_fixed<95, false>, quantize8x8_fixed<95, true> }
+};
+
+/// @summary Selects the specialized quantizers for a quality level.
+/// @param quality The quality level, in [1, 100].
+/// @return The quantizers for the level, or NULL if the level has none.
+static fixed_quantizer_t const* fixed_quantizer(int quality)
+{
+    size_t count = sizeof(FixedQuantizers) / sizeof(FixedQuantizers[0]);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (FixedQuantizers[i].Quality == quality)
+            return &FixedQuantizers[i];
+    }
+    return NULL;
+}
+
 /// @summary Performs a 2D forward DCT on an 8x8 block of a single channel.
 /// This is performed after the RGBA pixels are converted to YCoCg, and after
 /// subsampling to 4:2:0, so this routine is called four times for luma and
@@ -766,12 +1123,12 @@ static void fdct8x8fq_base(
 /// coefficients are quantized and descaled.
 /// @param dst A 64-element array to be filled with quantized DCT coefficients.
 /// @param src A 64-element array representing an 8x8 block of input.
-/// @param quant The 64-element scaled quantization coefficient array, as
-/// output by the scaled_qtable_int16() function.
+/// @param quant The reciprocal quantization table, as output by the
+/// reciprocal_qtable_int16() function.
 static void fdct8x8iq_base(
-    int16_t       * restrict dst,
-    int16_t const * restrict src,
-    int16_t const * restrict quant)
+    int16_t             * restrict dst,
+    int16_t       const * restrict src,
+    quant_table_t const * restrict quant)
 {
     #define DCTSIZE 8U
 
@@ -879,9 +1236,306 @@ static void fdct8x8iq_base(
         out[DCTSIZE * 7]  = (int16_t) d7;
         out++;
     }
-    for (size_t i = 0;  i < DCTSIZE * DCTSIZE; ++i)
-        dst[i]   /= quant[i];
+    quantize8x8_base(dst, quant);
+}
+
+#if IM_ENABLE_SSE2
+/// @summary Transposes an 8x8 block of 16-bit values stored as eight rows of
+/// eight values, one row per register.
+/// @param r An array of eight registers; on return, r[i] holds column i.
+static inline void transpose8x8_epi16(__m128i *r)
+{
+    __m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+    __m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+    __m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+    __m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+    __m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+    __m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+    __m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+    __m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+    r[0] = _mm_unpacklo_epi64(b0, b4);
+    r[1] = _mm_unpackhi_epi64(b0, b4);
+    r[2] = _mm_unpacklo_epi64(b1, b5);
+    r[3] = _mm_unpackhi_epi64(b1, b5);
+    r[4] = _mm_unpacklo_epi64(b2, b6);
+    r[5] = _mm_unpackhi_epi64(b2, b6);
+    r[6] = _mm_unpacklo_epi64(b3, b7);
+    r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/// @summary Truncates each 32-bit lane to 16 bits and sign-extends the result
+/// back to 32 bits. This matches the (int16_t) casts in the scalar code.
+/// @param v The four 32-bit lanes to wrap.
+/// @return The wrapped lanes.
+static inline __m128i wrap16_epi32(__m128i v)
+{
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+/// @summary Performs the 1D Bink 2 forward DCT used by fdct8x8iq_base() on
+/// four independent sets of eight samples, one set per 32-bit lane. The
+/// output coefficients are written back in natural order and wrapped to 16
+/// bits, exactly as the scalar implementation does.
+/// @param x An array of eight registers holding inputs 0-7 on entry and the
+/// coefficients 0-7 on return.
+static inline void fdct8_epi32_sse2(__m128i *x)
+{
+    __m128i a0 = _mm_add_epi32(x[0], x[7]);
+    __m128i a1 = _mm_add_epi32(x[1], x[6]);
+    __m128i a2 = _mm_add_epi32(x[2], x[5]);
+    __m128i a3 = _mm_add_epi32(x[3], x[4]);
+    __m128i a4 = _mm_sub_epi32(x[0], x[7]);
+    __m128i a5 = _mm_sub_epi32(x[1], x[6]);
+    __m128i a6 = _mm_sub_epi32(x[2], x[5]);
+    __m128i a7 = _mm_sub_epi32(x[3], x[4]);
+    __m128i b0 = _mm_add_epi32(a0, a3);
+    __m128i b1 = _mm_add_epi32(a1, a2);
+    __m128i b2 = _mm_sub_epi32(a0, a3);
+    __m128i b3 = _mm_sub_epi32(a1, a2);
+    __m128i c0 = _mm_add_epi32(b0, b1);
+    __m128i c1 = _mm_sub_epi32(b0, b1);
+    __m128i c2 = _mm_add_epi32(_mm_add_epi32(b2, _mm_srai_epi32(b2, 2)), _mm_srai_epi32(b3, 1));
+    __m128i c3 = _mm_sub_epi32(_mm_sub_epi32(_mm_srai_epi32(b2, 1), b3), _mm_srai_epi32(b3, 2));
+    __m128i b4 = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(_mm_srai_epi32(a7, 2), a4), _mm_srai_epi32(a4, 2)), _mm_srai_epi32(a4, 4));
+    __m128i b7 = _mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(_mm_srai_epi32(a4, 2), a7), _mm_srai_epi32(a7, 2)), _mm_srai_epi32(a7, 4));
+    __m128i b5 = _mm_sub_epi32(_mm_sub_epi32(_mm_add_epi32(a5, a6), _mm_srai_epi32(a6, 2)), _mm_srai_epi32(a6, 4));
+    __m128i b6 = _mm_add_epi32(_mm_add_epi32(_mm_sub_epi32(a6, a5), _mm_srai_epi32(a5, 2)), _mm_srai_epi32(a5, 4));
+    __m128i c4 = _mm_add_epi32(b4, b5);
+    __m128i c5 = _mm_sub_epi32(b4, b5);
+    __m128i c6 = _mm_add_epi32(b6, b7);
+    __m128i c7 = _mm_sub_epi32(b6, b7);
+    x[0] = wrap16_epi32(c0);
+    x[1] = wrap16_epi32(c4);
+    x[2] = wrap16_epi32(c2);
+    x[3] = wrap16_epi32(_mm_sub_epi32(c5, c7));
+    x[4] = wrap16_epi32(c1);
+    x[5] = wrap16_epi32(_mm_add_epi32(c5, c7));
+    x[6] = wrap16_epi32(c3);
+    x[7] = wrap16_epi32(c6);
+}
+
+/// @summary Quantizes four 32-bit coefficients, each in [-32768, 32767], by
+/// a common divisor using its reciprocal multiplier and shift. The magnitude
+/// fits in the low 16 bits of each lane, so the 32-bit product is assembled
+/// from the low and high halves of a 16-bit unsigned multiply.
+/// @param x The coefficients to quantize.
+/// @param m The reciprocal multiplier, replicated in each 32-bit lane.
+/// @param k The shift count, in the low 64 bits.
+/// @return The quantized coefficients, truncated toward zero.
+static inline __m128i quantize_epi32_sse2(__m128i x, __m128i m, __m128i k)
+{
+    __m128i s  = _mm_srai_epi32(x, 31);
+    __m128i n  = _mm_sub_epi32(_mm_xor_si128(x, s), s);
+    __m128i lo = _mm_mullo_epi16(n, m);
+    __m128i hi = _mm_mulhi_epu16(n, m);
+    __m128i q  = _mm_srl_epi32(_mm_or_si128(lo, _mm_slli_epi32(hi, 16)), k);
+    return _mm_sub_epi32(_mm_xor_si128(q, s), s);
+}
+
+/// @summary Performs a 2D forward DCT with quantization on eight 8x8 blocks
+/// at once using SSE2. Each block occupies one 32-bit lane (four blocks per
+/// register), so the row and column passes are plain vertical arithmetic and
+/// no lane ever holds more than one block. The output is bit-for-bit
+/// identical to calling fdct8x8iq_base() on each block in turn.
+/// @param dst A 512-element array to be filled with quantized coefficients
+/// for eight consecutive blocks.
+/// @param src A 512-element array specifying eight consecutive 8x8 blocks.
+/// @param quant The reciprocal quantization table, as output by the
+/// reciprocal_qtable_int16() function.
+static void fdct8x8iq_x8_sse2(
+    int16_t             * restrict dst,
+    int16_t       const * restrict src,
+    quant_table_t const * restrict quant)
+{
+    #define DCTSIZE 8U
+
+    __m128i lo[64];  // blocks 0-3, one coefficient position per register
+    __m128i hi[64];  // blocks 4-7, one coefficient position per register
+    __m128i r [8];
+    __m128i xl[8];
+    __m128i xh[8];
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // gather row i of each block so that each register holds one column
+        // position across all eight blocks, then widen to 32-bit lanes.
+        for (size_t k = 0; k < 8; ++k)
+            r[k] = _mm_loadu_si128((__m128i const*) &src[k * 64 + i * DCTSIZE]);
+        transpose8x8_epi16(r);
+        for (size_t j = 0; j < DCTSIZE; ++j)
+        {
+            xl[j] = _mm_srai_epi32(_mm_unpacklo_epi16(r[j], r[j]), 16);
+            xh[j] = _mm_srai_epi32(_mm_unpackhi_epi16(r[j], r[j]), 16);
+        }
+        fdct8_epi32_sse2(xl);
+        fdct8_epi32_sse2(xh);
+        for (size_t j = 0; j < DCTSIZE; ++j)
+        {
+            lo[i * DCTSIZE + j] = xl[j];
+            hi[i * DCTSIZE + j] = xh[j];
+        }
+    }
+
+    for (size_t j = 0; j < DCTSIZE; ++j)
+    {
+        // process columns, then quantize. every lane of a register shares
+        // one coefficient position, so the multiplier and shift are uniform.
+        for (size_t i = 0; i < DCTSIZE; ++i)
+        {
+            xl[i] = lo[i * DCTSIZE + j];
+            xh[i] = hi[i * DCTSIZE + j];
+        }
+        fdct8_epi32_sse2(xl);
+        fdct8_epi32_sse2(xh);
+        for (size_t i = 0; i < DCTSIZE; ++i)
+        {
+            __m128i m = _mm_set1_epi32(quant->Recip[i * DCTSIZE + j]);
+            __m128i k = _mm_cvtsi32_si128(quant->Shift[i * DCTSIZE + j]);
+            lo[i * DCTSIZE + j] = quantize_epi32_sse2(xl[i], m, k);
+            hi[i * DCTSIZE + j] = quantize_epi32_sse2(xh[i], m, k);
+        }
+    }
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // narrow back to 16 bits and scatter row i to each output block.
+        for (size_t j = 0; j < DCTSIZE; ++j)
+            r[j] = _mm_packs_epi32(lo[i * DCTSIZE + j], hi[i * DCTSIZE + j]);
+        transpose8x8_epi16(r);
+        for (size_t k = 0; k < 8; ++k)
+            _mm_storeu_si128((__m128i*) &dst[k * 64 + i * DCTSIZE], r[k]);
+    }
+}
+#endif /* IM_ENABLE_SSE2 */
+
+#if IM_ENABLE_AVX2
+/// @summary Truncates each 32-bit lane to 16 bits and sign-extends the result
+/// back to 32 bits. This matches the (int16_t) casts in the scalar code.
+/// @param v The eight 32-bit lanes to wrap.
+/// @return The wrapped lanes.
+IM_TARGET_AVX2
+static inline __m256i wrap16_epi32(__m256i v)
+{
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+/// @summary Performs the 1D Bink 2 forward DCT used by fdct8x8iq_base() on
+/// eight independent sets of eight samples, one set per 32-bit lane. The
+/// output coefficients are written back in natural order and wrapped to 16
+/// bits, exactly as the scalar implementation does.
+/// @param x An array of eight registers holding inputs 0-7 on entry and the
+/// coefficients 0-7 on return.
+IM_TARGET_AVX2
+static inline void fdct8_epi32_avx2(__m256i *x)
+{
+    __m256i a0 = _mm256_add_epi32(x[0], x[7]);
+    __m256i a1 = _mm256_add_epi32(x[1], x[6]);
+    __m256i a2 = _mm256_add_epi32(x[2], x[5]);
+    __m256i a3 = _mm256_add_epi32(x[3], x[4]);
+    __m256i a4 = _mm256_sub_epi32(x[0], x[7]);
+    __m256i a5 = _mm256_sub_epi32(x[1], x[6]);
+    __m256i a6 = _mm256_sub_epi32(x[2], x[5]);
+    __m256i a7 = _mm256_sub_epi32(x[3], x[4]);
+    __m256i b0 = _mm256_add_epi32(a0, a3);
+    __m256i b1 = _mm256_add_epi32(a1, a2);
+    __m256i b2 = _mm256_sub_epi32(a0, a3);
+    __m256i b3 = _mm256_sub_epi32(a1, a2);
+    __m256i c0 = _mm256_add_epi32(b0, b1);
+    __m256i c1 = _mm256_sub_epi32(b0, b1);
+    __m256i c2 = _mm256_add_epi32(_mm256_add_epi32(b2, _mm256_srai_epi32(b2, 2)), _mm256_srai_epi32(b3, 1));
+    __m256i c3 = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_srai_epi32(b2, 1), b3), _mm256_srai_epi32(b3, 2));
+    __m256i b4 = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_srai_epi32(a7, 2), a4), _mm256_srai_epi32(a4, 2)), _mm256_srai_epi32(a4, 4));
+    __m256i b7 = _mm256_add_epi32(_mm256_sub_epi32(_mm256_sub_epi32(_mm256_srai_epi32(a4, 2), a7), _mm256_srai_epi32(a7, 2)), _mm256_srai_epi32(a7, 4));
+    __m256i b5 = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_add_epi32(a5, a6), _mm256_srai_epi32(a6, 2)), _mm256_srai_epi32(a6, 4));
+    __m256i b6 = _mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(a6, a5), _mm256_srai_epi32(a5, 2)), _mm256_srai_epi32(a5, 4));
+    __m256i c4 = _mm256_add_epi32(b4, b5);
+    __m256i c5 = _mm256_sub_epi32(b4, b5);
+    __m256i c6 = _mm256_add_epi32(b6, b7);
+    __m256i c7 = _mm256_sub_epi32(b6, b7);
+    x[0] = wrap16_epi32(c0);
+    x[1] = wrap16_epi32(c4);
+    x[2] = wrap16_epi32(c2);
+    x[3] = wrap16_epi32(_mm256_sub_epi32(c5, c7));
+    x[4] = wrap16_epi32(c1);
+    x[5] = wrap16_epi32(_mm256_add_epi32(c5, c7));
+    x[6] = wrap16_epi32(c3);
+    x[7] = wrap16_epi32(c6);
+}
+
+/// @summary Performs a 2D forward DCT with quantization on eight 8x8 blocks
+/// at once using AVX2. Each block occupies one 32-bit lane of a 256-bit
+/// register. The output is bit-for-bit identical to calling fdct8x8iq_base()
+/// on each block in turn.
+/// @param dst A 512-element array to be filled with quantized coefficients
+/// for eight consecutive blocks.
+/// @param src A 512-element array specifying eight consecutive 8x8 blocks.
+/// @param quant The reciprocal quantization table, as output by the
+/// reciprocal_qtable_int16() function.
+IM_TARGET_AVX2
+static void fdct8x8iq_x8_avx2(
+    int16_t             * restrict dst,
+    int16_t       const * restrict src,
+    quant_table_t const * restrict quant)
+{
+    #define DCTSIZE 8U
+
+    __m256i ws[64];  // blocks 0-7, one coefficient position per register
+    __m128i r [8];
+    __m256i x [8];
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // gather row i of each block so that each register holds one column
+        // position across all eight blocks, then widen to 32-bit lanes.
+        for (size_t k = 0; k < 8; ++k)
+            r[k] = _mm_loadu_si128((__m128i const*) &src[k * 64 + i * DCTSIZE]);
+        transpose8x8_epi16(r);
+        for (size_t j = 0; j < DCTSIZE; ++j)
+            x[j] = _mm256_cvtepi16_epi32(r[j]);
+        fdct8_epi32_avx2(x);
+        for (size_t j = 0; j < DCTSIZE; ++j)
+            ws[i * DCTSIZE + j] = x[j];
+    }
+
+    for (size_t j = 0; j < DCTSIZE; ++j)
+    {
+        // process columns, then quantize with a uniform multiply-shift.
+        for (size_t i = 0; i < DCTSIZE; ++i)
+            x[i] = ws[i * DCTSIZE + j];
+        fdct8_epi32_avx2(x);
+        for (size_t i = 0; i < DCTSIZE; ++i)
+        {
+            __m256i m = _mm256_set1_epi32(quant->Recip[i * DCTSIZE + j]);
+            __m128i k = _mm_cvtsi32_si128(quant->Shift[i * DCTSIZE + j]);
+            __m256i s = _mm256_srai_epi32(x[i], 31);
+            __m256i n = _mm256_abs_epi32(x[i]);
+            __m256i q = _mm256_srl_epi32(_mm256_mullo_epi32(n, m), k);
+            ws[i * DCTSIZE + j] = _mm256_sub_epi32(_mm256_xor_si256(q, s), s);
+        }
+    }
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // narrow back to 16 bits and scatter row i to each output block.
+        for (size_t j = 0; j < DCTSIZE; ++j)
+        {
+            __m256i v = ws[i * DCTSIZE + j];
+            r[j] = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        }
+        transpose8x8_epi16(r);
+        for (size_t k = 0; k < 8; ++k)
+            _mm_storeu_si128((__m128i*) &dst[k * 64 + i * DCTSIZE], r[k]);
+    }
 }
+#endif /* IM_ENABLE_AVX2 */
 
 /// @summary Performs an inverse 2D DCT on an 8x8 block of DCT coefficients to
 /// retrieve sample values. The DCT coefficients are assumed to have been
@@ -1264,6 +1918,7 @@ static void idct8x8id_base(
         wsp[DCTSIZE*6]  = a1 - a5;
         wsp[DCTSIZE*7]  = a0 - a4;
         wsp++;
+        qtp++;
         inp++;
     }
 
@@ -1312,537 +1967,4857 @@ static void idct8x8id_base(
     }
 }
 
-/// @summary Loads an 8x8 sub-block from a 16x16 block of pixels. This routine
-/// is used to grab sub-blocks of the luma channel.
-/// @param samples A 64-element array used to store the sampled data.
-/// @param ycocg The 768 element array of YCoCg pixel data being sampled.
-/// @param x The quadrant of the sub-block to sample, 0 = left, 1 = right.
-/// @param y The quadrant of the sub-block to sample, 0 = top, 1 = bottom.
-/// @param c The channel index to sample, 0 = Y, 1 = Co, 2 = Cg.
-template <typename T>
-static void subblock(
-    T             * restrict samples,
-    int16_t const * restrict YCoCg,
-    size_t                   x,
-    size_t                   y,
-    size_t                   channel)
-{
-    int16_t const *src = NULL;
-    T             *dst = samples;
-    // each column has three elements, so a row has 16 * 3 = 48 elements.
-    // convert x to a column index by multiplying by 8 * 3 = 24 for x[0, 1].
-    // convert y to a row index by multiplying by 8 for y[0, 1].
-    x = (x * 24)  + channel;
-    y = (y *  8);
-    for (size_t i = 0; i < 8; ++i)
-    {
-         src   =&YCoCg[(y + i)  *  48] + x;
-        *dst++ =   src[(0 * 3)];
-        *dst++ =   src[(1 * 3)];
-        *dst++ =   src[(2 * 3)];
-        *dst++ =   src[(3 * 3)];
-        *dst++ =   src[(4 * 3)];
-        *dst++ =   src[(5 * 3)];
-        *dst++ =   src[(6 * 3)];
-        *dst++ =   src[(7 * 3)];
-    }
-}
-
-/// @summary Loads an 8x8 sub-block from a 16x16 block of pixels, performing
-/// downsampling by half in each of the horizontal and vertical dimensions,
-/// such that the resulting 8x8 sub-block contains a downsampled version of the
-/// entire 16x16 source block, instead of just an 8x8 sub-region. This routine
-/// is used to subsample the chroma channels, Co and Cg.
-/// @param samples A 64-element array used to store the sampled data.
-/// @param ycocg The 768 element array of YCoCg pixel data being sampled.
-/// @param channel The channel index to sample, 0 = Y, 1 = Co, 2 = Cg.
-template <typename T>
-static void subsample(
-    T             * restrict samples,
-    int16_t const * restrict YCoCg,
-    size_t                   channel)
-{
-    int16_t const *src1  = NULL;
-    int16_t const *src2  = NULL;
-    T             *dst   = samples;
-    for (size_t i = 0; i < 16; i += 2)
-    {
-         src1  =&YCoCg[(i + 0) * 48] + channel;
-         src2  =&YCoCg[(i + 1) * 48] + channel;
-        *dst++ = ((src1[0 * 3] + src1[1 * 3] + src2[0 * 3] + src2[1 * 3]) >> 2);
-        *dst++ = ((src1[2 * 3] + src1[3 * 3] + src2[2 * 3] + src2[3 * 3]) >> 2);
-        *dst++ = ((src1[4 * 3] + src1[5 * 3] + src2[4 * 3] + src2[5 * 3]) >> 2);
-        *dst++ = ((src1[6 * 3] + src1[7 * 3] + src2[6 * 3] + src2[7 * 3]) >> 2);
-        *dst++ = ((src1[8 * 3] + src1[9 * 3] + src2[8 * 3] + src2[9 * 3]) >> 2);
-        *dst++ = ((src1[10* 3] + src1[11* 3] + src2[10* 3] + src2[11* 3]) >> 2);
-        *dst++ = ((src1[12* 3] + src1[13* 3] + src2[12* 3] + src2[13* 3]) >> 2);
-        *dst++ = ((src1[14* 3] + src1[15* 3] + src2[14* 3] + src2[15* 3]) >> 2);
-    }
-}
-
-/// @summary Combine four packed 8x8 blocks stored in a contiguous array back
-/// into a single 16x16 block. This is used to undo the effect of splitting the
-/// luma channel from a 16x16 block into four 8x8 blocks.
-/// @param dst A 256 element array to store the output 16x16 block.
-/// @param src A 256 element array storing the packed 8x8 input blocks.
-template <typename T>
-static void merge_blocks(T * restrict dst, T const * restrict src)
-{
-    T const * restrict src0 = &src[0];     // src[0...63]
-    T const * restrict src1 = &src[64];    // src[64...127]
-    T const * restrict src2 = &src[128];   // src[128...191]
-    T const * restrict src3 = &src[192];   // src[192...255]
-    T       * restrict dst0 = &dst[0];     // col[0...7],  row[0...7]
-    T       * restrict dst1 = &dst[8];     // col[8...15], row[0...7]
-    T       * restrict dst2 = &dst[128];   // col[0...7],  row[8...15]
-    T       * restrict dst3 = &dst[128+8]; // col[8...15], row[8...15]
-    for (size_t i = 0; i < 8; ++i)
-    {
-        // copy each row from source to destination.
-        for (size_t j = 0; j < 8; ++j)
-        {
-            // copy each column from source to destination.
-            dst0[j] = src0[j];
-            dst1[j] = src1[j];
-            dst2[j] = src2[j];
-            dst3[j] = src3[j];
-        }
-        src0 +=  8; dst0 += 16;
-        src1 +=  8; dst1 += 16;
-        src2 +=  8; dst2 += 16;
-        src3 +=  8; dst3 += 16;
-    }
-}
-
-/// @summary Scale an 8x8 block of samples up to 16x16 by sample doubling. This
-/// is used to scale the chroma-orange and chroma-green blocks back up to 16x16
-/// for easy merging with the luma channel values.
-/// @param dst A 256-element array to store the output 16x16 block.
-/// @param src A 64-element array specifying the 8x8 input block.
-template <typename T>
-static void scale_block(T * restrict dst, T const * restrict src)
+/// @summary Dequantizes and performs an inverse 2D DCT on an 8x8 block whose
+/// only non-zero coefficient is the DC term. Every output sample is the same
+/// value, and the result is bit-for-bit identical to idct8x8id_base().
+/// @param dst A 64-element buffer to be filled with de-quantized sample data.
+/// @param src A 64-element buffer containing the quantized DCT coefficients.
+/// @param quant The scaled quantization table for the IDCT.
+static void idct8x8id_dc(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict quant)
 {
-    T const * restrict srcRow  = src;
-    T       * restrict dstRow0 =&dst[0];
-    T       * restrict dstRow1 =&dst[16];
-    for (size_t i = 0; i < 8; ++i)
-    {
-        // copy each row from source to destination.
-        for (size_t j = 0; j < 8; ++j)
-        {
-            // each sample in src becomes a 2x2 block in dst.
-            dstRow0[j * 2 + 0] = srcRow[j];
-            dstRow0[j * 2 + 1] = srcRow[j];
-            dstRow1[j * 2 + 0] = srcRow[j];
-            dstRow1[j * 2 + 1] = srcRow[j];
-        }
-        srcRow     += 8;
-        dstRow0    += 32;
-        dstRow1    += 32;
-    }
+    // the DC term passes through both 1D transforms unchanged.
+    int16_t dc = (int16_t) ((src[0] * quant[0]) >> 6);
+    for (size_t i = 0; i < 64; ++i)
+        dst[i] = dc;
 }
 
-size_t tile_count(size_t *num_x, size_t *num_y, image_tiler_config_t const *config)
+/// @summary Dequantizes and performs an inverse 2D DCT on an 8x8 block whose
+/// non-zero coefficients all lie in the top-left 4x4 region. The result is
+/// bit-for-bit identical to idct8x8id_base().
+/// @param dst A 64-element buffer to be filled with de-quantized sample data.
+/// @param src A 64-element buffer containing the quantized DCT coefficients.
+/// @param quant The scaled quantization table for the IDCT.
+static void idct8x8id_4x4_base(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict quant)
+{
+    #define DCTSIZE       8U
+    #define COLUMNID(x)  (inp[DCTSIZE*x] * qtp[DCTSIZE*x])
+
+    int32_t        workspace[32]; // columns 0-3 of each row
+    int16_t const *qtp = (int16_t const*) quant;
+    int16_t const *inp = (int16_t const*) src;
+    int32_t       *wsp = (int32_t*) workspace;
+
+    // with inputs 4-7 known to be zero, c1, d5, c3 and d7 vanish; the
+    // remaining terms are identical to the full transform.
+    for (size_t i = DCTSIZE / 2; i > 0; --i)
+    {
+        // process columns 0-3 from the input; rows 4-7 are zero.
+        int32_t c0 = COLUMNID(0);
+        int32_t c4 = COLUMNID(1);
+        int32_t c2 = COLUMNID(2);
+        int32_t d6 = COLUMNID(3);
+        int32_t b4 = c4 + d6;
+        int32_t b5 = c4 - d6;
+        int32_t b6 =    - d6;
+        int32_t b7 =      d6;
+        int32_t b2 = c2 +(c2 >> 2);
+        int32_t b3 =(c2 >> 1);
+        int32_t a4 =(b7 >> 2) + b4 + (b4 >> 2) - (b4 >> 4);
+        int32_t a7 =(b4 >> 2) - b7 - (b7 >> 2) + (b7 >> 4);
+        int32_t a5 = b5       - b6 + (b6 >> 2) + (b6 >> 4);
+        int32_t a6 = b6       + b5 - (b5 >> 2) - (b5 >> 4);
+        int32_t a0 = c0 + b2;
+        int32_t a3 = c0 - b2;
+        int32_t a1 = c0 + b3;
+        int32_t a2 = c0 - b3;
+        wsp[4*0]        = a0 + a4;
+        wsp[4*1]        = a1 + a5;
+        wsp[4*2]        = a2 + a6;
+        wsp[4*3]        = a3 + a7;
+        wsp[4*4]        = a3 - a7;
+        wsp[4*5]        = a2 - a6;
+        wsp[4*6]        = a1 - a5;
+        wsp[4*7]        = a0 - a4;
+        wsp++;
+        qtp++;
+        inp++;
+    }
+
+    wsp = workspace;
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // now process rows from the work array; columns 4-7 are zero.
+        int32_t c0 = wsp[0];
+        int32_t c4 = wsp[1];
+        int32_t c2 = wsp[2];
+        int32_t d6 = wsp[3];
+        int32_t b4 = c4 + d6;
+        int32_t b5 = c4 - d6;
+        int32_t b6 =    - d6;
+        int32_t b7 =      d6;
+        int32_t b2 = c2 +(c2 >> 2);
+        int32_t b3 =(c2 >> 1);
+        int32_t a4 =(b7 >> 2) + b4 + (b4 >> 2) - (b4 >> 4);
+        int32_t a7 =(b4 >> 2) - b7 - (b7 >> 2) + (b7 >> 4);
+        int32_t a5 = b5       - b6 + (b6 >> 2) + (b6 >> 4);
+        int32_t a6 = b6       + b5 - (b5 >> 2) - (b5 >> 4);
+        int32_t a0 = c0 + b2;
+        int32_t a3 = c0 - b2;
+        int32_t a1 = c0 + b3;
+        int32_t a2 = c0 - b3;
+        dst[0]     =(int16_t) ((a0 + a4) >> 6);   // descale by 64
+        dst[1]     =(int16_t) ((a1 + a5) >> 6);   // descale by 64
+        dst[2]     =(int16_t) ((a2 + a6) >> 6);   // descale by 64
+        dst[3]     =(int16_t) ((a3 + a7) >> 6);   // descale by 64
+        dst[4]     =(int16_t) ((a3 - a7) >> 6);   // descale by 64
+        dst[5]     =(int16_t) ((a2 - a6) >> 6);   // descale by 64
+        dst[6]     =(int16_t) ((a1 - a5) >> 6);   // descale by 64
+        dst[7]     =(int16_t) ((a0 - a4) >> 6);   // descale by 64
+        dst       += DCTSIZE;
+        wsp       += 4;
+    }
+}
+
+#if IM_ENABLE_SSE2
+/// @summary Transposes a 4x4 block of 32-bit values stored as four rows of
+/// four values, one row per register.
+/// @param r0 Row 0 on entry; column 0 on return.
+/// @param r1 Row 1 on entry; column 1 on return.
+/// @param r2 Row 2 on entry; column 2 on return.
+/// @param r3 Row 3 on entry; column 3 on return.
+static inline void transpose4x4_epi32(__m128i *r0, __m128i *r1, __m128i *r2, __m128i *r3)
+{
+    __m128i t0 = _mm_unpacklo_epi32(*r0, *r1);
+    __m128i t1 = _mm_unpacklo_epi32(*r2, *r3);
+    __m128i t2 = _mm_unpackhi_epi32(*r0, *r1);
+    __m128i t3 = _mm_unpackhi_epi32(*r2, *r3);
+    *r0 = _mm_unpacklo_epi64(t0, t1);
+    *r1 = _mm_unpackhi_epi64(t0, t1);
+    *r2 = _mm_unpacklo_epi64(t2, t3);
+    *r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+/// @summary Performs the 1D Bink 2 inverse DCT used by idct8x8id_base() on
+/// four independent sets of eight coefficients, one set per 32-bit lane.
+/// @param x An array of eight registers holding coefficients 0-7 on entry and
+/// the output samples 0-7 on return. No descaling is performed.
+static inline void idct8_epi32_sse2(__m128i *x)
+{
+    __m128i c0 = x[0];
+    __m128i c4 = x[1];
+    __m128i c2 = x[2];
+    __m128i d6 = x[3];
+    __m128i c1 = x[4];
+    __m128i d5 = x[5];
+    __m128i c3 = x[6];
+    __m128i c6 = x[7];
+    __m128i c5 = _mm_add_epi32(d5, d6);
+    __m128i c7 = _mm_sub_epi32(d5, d6);
+    __m128i b4 = _mm_add_epi32(c4, c5);
+    __m128i b5 = _mm_sub_epi32(c4, c5);
+    __m128i b6 = _mm_add_epi32(c6, c7);
+    __m128i b7 = _mm_sub_epi32(c6, c7);
+    __m128i b0 = _mm_add_epi32(c0, c1);
+    __m128i b1 = _mm_sub_epi32(c0, c1);
+    __m128i b2 = _mm_add_epi32(_mm_add_epi32(c2, _mm_srai_epi32(c2, 2)), _mm_srai_epi32(c3, 1));
+    __m128i b3 = _mm_sub_epi32(_mm_sub_epi32(_mm_srai_epi32(c2, 1), c3), _mm_srai_epi32(c3, 2));
+    __m128i a4 = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(_mm_srai_epi32(b7, 2), b4), _mm_srai_epi32(b4, 2)), _mm_srai_epi32(b4, 4));
+    __m128i a7 = _mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(_mm_srai_epi32(b4, 2), b7), _mm_srai_epi32(b7, 2)), _mm_srai_epi32(b7, 4));
+    __m128i a5 = _mm_add_epi32(_mm_add_epi32(_mm_sub_epi32(b5, b6), _mm_srai_epi32(b6, 2)), _mm_srai_epi32(b6, 4));
+    __m128i a6 = _mm_sub_epi32(_mm_sub_epi32(_mm_add_epi32(b6, b5), _mm_srai_epi32(b5, 2)), _mm_srai_epi32(b5, 4));
+    __m128i a0 = _mm_add_epi32(b0, b2);
+    __m128i a3 = _mm_sub_epi32(b0, b2);
+    __m128i a1 = _mm_add_epi32(b1, b3);
+    __m128i a2 = _mm_sub_epi32(b1, b3);
+    x[0] = _mm_add_epi32(a0, a4);
+    x[1] = _mm_add_epi32(a1, a5);
+    x[2] = _mm_add_epi32(a2, a6);
+    x[3] = _mm_add_epi32(a3, a7);
+    x[4] = _mm_sub_epi32(a3, a7);
+    x[5] = _mm_sub_epi32(a2, a6);
+    x[6] = _mm_sub_epi32(a1, a5);
+    x[7] = _mm_sub_epi32(a0, a4);
+}
+
+/// @summary Dequantizes and performs an inverse 2D DCT on an 8x8 block of
+/// quantized DCT coefficients using SSE2. The block is held entirely in
+/// registers as 32-bit lanes; the column pass operates on rows directly, the
+/// row pass operates on the transposed block, and the final 16-bit transpose
+/// restores row-major order. The output is bit-for-bit identical to
+/// idct8x8id_base().
+/// @summary dst A 64-element array where the output will be written.
+/// @summary src A 64-element array of quantized DCT coefficient values.
+/// @summary quant The 64-element scaled quantization coefficient array, as
+/// output by the scaled_qtable_int16() function.
+static void idct8x8id_sse2(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict quant)
+{
+    #define DCTSIZE 8U
+
+    __m128i lo[8];  // columns 0-3 of each row
+    __m128i hi[8];  // columns 4-7 of each row
+    __m128i r [8];
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // dequantize; the full 32-bit products are formed from the low and
+        // high halves of the 16x16-bit multiply.
+        __m128i c  = _mm_loadu_si128((__m128i const*) &src  [i * DCTSIZE]);
+        __m128i q  = _mm_loadu_si128((__m128i const*) &quant[i * DCTSIZE]);
+        __m128i pl = _mm_mullo_epi16(c, q);
+        __m128i ph = _mm_mulhi_epi16(c, q);
+        lo[i] = _mm_unpacklo_epi16(pl, ph);
+        hi[i] = _mm_unpackhi_epi16(pl, ph);
+    }
+
+    // process columns; each register holds one row, so this is vertical.
+    idct8_epi32_sse2(lo);
+    idct8_epi32_sse2(hi);
+
+    // transpose so that each register holds one column of four rows.
+    transpose4x4_epi32(&lo[0], &lo[1], &lo[2], &lo[3]);
+    transpose4x4_epi32(&hi[0], &hi[1], &hi[2], &hi[3]);
+    transpose4x4_epi32(&lo[4], &lo[5], &lo[6], &lo[7]);
+    transpose4x4_epi32(&hi[4], &hi[5], &hi[6], &hi[7]);
+    __m128i top[8] = { lo[0], lo[1], lo[2], lo[3], hi[0], hi[1], hi[2], hi[3] };
+    __m128i bot[8] = { lo[4], lo[5], lo[6], lo[7], hi[4], hi[5], hi[6], hi[7] };
+
+    // process rows, then descale by 64 and wrap to 16 bits in one shift pair.
+    idct8_epi32_sse2(top);
+    idct8_epi32_sse2(bot);
+    for (size_t j = 0; j < DCTSIZE; ++j)
+    {
+        __m128i t = _mm_srai_epi32(_mm_slli_epi32(top[j], 10), 16);
+        __m128i b = _mm_srai_epi32(_mm_slli_epi32(bot[j], 10), 16);
+        r[j] = _mm_packs_epi32(t, b);
+    }
+    transpose8x8_epi16(r);
+    for (size_t i = 0; i < DCTSIZE; ++i)
+        _mm_storeu_si128((__m128i*) &dst[i * DCTSIZE], r[i]);
+}
+/// @summary Performs the 1D Bink 2 inverse DCT used by idct8x8id_4x4_base() on
+/// four independent sets of coefficients, where coefficients 4-7 are zero.
+/// @param x An array of eight registers. On entry, x[0]-x[3] hold coefficients
+/// 0-3; on return, x[0]-x[7] hold the output samples 0-7.
+static inline void idct4_epi32_sse2(__m128i *x)
+{
+    __m128i c0 = x[0];
+    __m128i c4 = x[1];
+    __m128i c2 = x[2];
+    __m128i d6 = x[3];
+    __m128i b4 = _mm_add_epi32(c4, d6);
+    __m128i b5 = _mm_sub_epi32(c4, d6);
+    __m128i b6 = _mm_sub_epi32(_mm_setzero_si128(), d6);
+    __m128i b7 = d6;
+    __m128i b2 = _mm_add_epi32(c2, _mm_srai_epi32(c2, 2));
+    __m128i b3 = _mm_srai_epi32(c2, 1);
+    __m128i a4 = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(_mm_srai_epi32(b7, 2), b4), _mm_srai_epi32(b4, 2)), _mm_srai_epi32(b4, 4));
+    __m128i a7 = _mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(_mm_srai_epi32(b4, 2), b7), _mm_srai_epi32(b7, 2)), _mm_srai_epi32(b7, 4));
+    __m128i a5 = _mm_add_epi32(_mm_add_epi32(_mm_sub_epi32(b5, b6), _mm_srai_epi32(b6, 2)), _mm_srai_epi32(b6, 4));
+    __m128i a6 = _mm_sub_epi32(_mm_sub_epi32(_mm_add_epi32(b6, b5), _mm_srai_epi32(b5, 2)), _mm_srai_epi32(b5, 4));
+    __m128i a0 = _mm_add_epi32(c0, b2);
+    __m128i a3 = _mm_sub_epi32(c0, b2);
+    __m128i a1 = _mm_add_epi32(c0, b3);
+    __m128i a2 = _mm_sub_epi32(c0, b3);
+    x[0] = _mm_add_epi32(a0, a4);
+    x[1] = _mm_add_epi32(a1, a5);
+    x[2] = _mm_add_epi32(a2, a6);
+    x[3] = _mm_add_epi32(a3, a7);
+    x[4] = _mm_sub_epi32(a3, a7);
+    x[5] = _mm_sub_epi32(a2, a6);
+    x[6] = _mm_sub_epi32(a1, a5);
+    x[7] = _mm_sub_epi32(a0, a4);
+}
+
+/// @summary Dequantizes and performs an inverse 2D DCT on an 8x8 block whose
+/// non-zero coefficients all lie in the top-left 4x4 region, using SSE2. Only
+/// columns 0-3 are transformed in the first pass, and only the first four
+/// inputs of each row are non-zero in the second pass. The output is bit-for-
+/// bit identical to idct8x8id_4x4_base().
+/// @param dst A 64-element buffer to be filled with de-quantized sample data.
+/// @param src A 64-element buffer containing the quantized DCT coefficients.
+/// @param quant The scaled quantization table for the IDCT.
+static void idct8x8id_4x4_sse2(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict quant)
+{
+    #define DCTSIZE 8U
+
+    __m128i lo[8];  // columns 0-3 of each row
+    __m128i r [8];
+
+    for (size_t i = 0; i < DCTSIZE / 2; ++i)
+    {
+        // dequantize columns 0-3 of rows 0-3.
+        __m128i c  = _mm_loadl_epi64((__m128i const*) &src  [i * DCTSIZE]);
+        __m128i q  = _mm_loadl_epi64((__m128i const*) &quant[i * DCTSIZE]);
+        __m128i pl = _mm_mullo_epi16(c, q);
+        __m128i ph = _mm_mulhi_epi16(c, q);
+        lo[i] = _mm_unpacklo_epi16(pl, ph);
+    }
+
+    // process columns 0-3, then transpose into columns of four rows.
+    idct4_epi32_sse2(lo);
+    transpose4x4_epi32(&lo[0], &lo[1], &lo[2], &lo[3]);
+    transpose4x4_epi32(&lo[4], &lo[5], &lo[6], &lo[7]);
+    __m128i top[8] = { lo[0], lo[1], lo[2], lo[3] };
+    __m128i bot[8] = { lo[4], lo[5], lo[6], lo[7] };
+
+    // process rows, then descale by 64 and wrap to 16 bits in one shift pair.
+    idct4_epi32_sse2(top);
+    idct4_epi32_sse2(bot);
+    for (size_t j = 0; j < DCTSIZE; ++j)
+    {
+        __m128i t = _mm_srai_epi32(_mm_slli_epi32(top[j], 10), 16);
+        __m128i b = _mm_srai_epi32(_mm_slli_epi32(bot[j], 10), 16);
+        r[j] = _mm_packs_epi32(t, b);
+    }
+    transpose8x8_epi16(r);
+    for (size_t i = 0; i < DCTSIZE; ++i)
+        _mm_storeu_si128((__m128i*) &dst[i * DCTSIZE], r[i]);
+}
+#endif /* IM_ENABLE_SSE2 */
+
+#if IM_ENABLE_AVX2
+/// @summary Transposes an 8x8 block of 32-bit values stored as eight rows of
+/// eight values, one row per register.
+/// @param r An array of eight registers; on return, r[i] holds column i.
+IM_TARGET_AVX2
+static inline void transpose8x8_epi32(__m256i *r)
+{
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/// @summary Performs the 1D Bink 2 inverse DCT used by idct8x8id_base() on
+/// eight independent sets of eight coefficients, one set per 32-bit lane.
+/// @param x An array of eight registers holding coefficients 0-7 on entry and
+/// the output samples 0-7 on return. No descaling is performed.
+IM_TARGET_AVX2
+static inline void idct8_epi32_avx2(__m256i *x)
+{
+    __m256i c0 = x[0];
+    __m256i c4 = x[1];
+    __m256i c2 = x[2];
+    __m256i d6 = x[3];
+    __m256i c1 = x[4];
+    __m256i d5 = x[5];
+    __m256i c3 = x[6];
+    __m256i c6 = x[7];
+    __m256i c5 = _mm256_add_epi32(d5, d6);
+    __m256i c7 = _mm256_sub_epi32(d5, d6);
+    __m256i b4 = _mm256_add_epi32(c4, c5);
+    __m256i b5 = _mm256_sub_epi32(c4, c5);
+    __m256i b6 = _mm256_add_epi32(c6, c7);
+    __m256i b7 = _mm256_sub_epi32(c6, c7);
+    __m256i b0 = _mm256_add_epi32(c0, c1);
+    __m256i b1 = _mm256_sub_epi32(c0, c1);
+    __m256i b2 = _mm256_add_epi32(_mm256_add_epi32(c2, _mm256_srai_epi32(c2, 2)), _mm256_srai_epi32(c3, 1));
+    __m256i b3 = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_srai_epi32(c2, 1), c3), _mm256_srai_epi32(c3, 2));
+    __m256i a4 = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_srai_epi32(b7, 2), b4), _mm256_srai_epi32(b4, 2)), _mm256_srai_epi32(b4, 4));
+    __m256i a7 = _mm256_add_epi32(_mm256_sub_epi32(_mm256_sub_epi32(_mm256_srai_epi32(b4, 2), b7), _mm256_srai_epi32(b7, 2)), _mm256_srai_epi32(b7, 4));
+    __m256i a5 = _mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(b5, b6), _mm256_srai_epi32(b6, 2)), _mm256_srai_epi32(b6, 4));
+    __m256i a6 = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_add_epi32(b6, b5), _mm256_srai_epi32(b5, 2)), _mm256_srai_epi32(b5, 4));
+    __m256i a0 = _mm256_add_epi32(b0, b2);
+    __m256i a3 = _mm256_sub_epi32(b0, b2);
+    __m256i a1 = _mm256_add_epi32(b1, b3);
+    __m256i a2 = _mm256_sub_epi32(b1, b3);
+    x[0] = _mm256_add_epi32(a0, a4);
+    x[1] = _mm256_add_epi32(a1, a5);
+    x[2] = _mm256_add_epi32(a2, a6);
+    x[3] = _mm256_add_epi32(a3, a7);
+    x[4] = _mm256_sub_epi32(a3, a7);
+    x[5] = _mm256_sub_epi32(a2, a6);
+    x[6] = _mm256_sub_epi32(a1, a5);
+    x[7] = _mm256_sub_epi32(a0, a4);
+}
+
+/// @summary Dequantizes and performs an inverse 2D DCT on an 8x8 block of
+/// quantized DCT coefficients using AVX2. Each row of the block occupies one
+/// register of eight 32-bit lanes. The output is bit-for-bit identical to
+/// idct8x8id_base().
+/// @summary dst A 64-element array where the output will be written.
+/// @summary src A 64-element array of quantized DCT coefficient values.
+/// @summary quant The 64-element scaled quantization coefficient array, as
+/// output by the scaled_qtable_int16() function.
+IM_TARGET_AVX2
+static void idct8x8id_avx2(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict quant)
+{
+    #define DCTSIZE 8U
+
+    __m256i x[8];
+    __m128i r[8];
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // dequantize. q is zero-extended so that the multiply-add of each
+        // 16-bit pair reduces to the exact 32-bit product c * q.
+        __m256i c = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i const*) &src  [i * DCTSIZE]));
+        __m256i q = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i const*) &quant[i * DCTSIZE]));
+        x[i] = _mm256_madd_epi16(c, q);
+    }
+
+    // process columns (vertical), transpose, then process rows.
+    idct8_epi32_avx2(x);
+    transpose8x8_epi32(x);
+    idct8_epi32_avx2(x);
+
+    // descale by 64 and wrap to 16 bits in one shift pair, then narrow and
+    // restore row-major order.
+    for (size_t j = 0; j < DCTSIZE; ++j)
+    {
+        __m256i v = _mm256_srai_epi32(_mm256_slli_epi32(x[j], 10), 16);
+        r[j] = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    }
+    transpose8x8_epi16(r);
+    for (size_t i = 0; i < DCTSIZE; ++i)
+        _mm_storeu_si128((__m128i*) &dst[i * DCTSIZE], r[i]);
+}
+/// @summary Performs the 1D Bink 2 inverse DCT used by idct8x8id_4x4_base() on
+/// eight independent sets of coefficients, where coefficients 4-7 are zero.
+/// @param x An array of eight registers. On entry, x[0]-x[3] hold coefficients
+/// 0-3; on return, x[0]-x[7] hold the output samples 0-7.
+IM_TARGET_AVX2
+static inline void idct4_epi32_avx2(__m256i *x)
+{
+    __m256i c0 = x[0];
+    __m256i c4 = x[1];
+    __m256i c2 = x[2];
+    __m256i d6 = x[3];
+    __m256i b4 = _mm256_add_epi32(c4, d6);
+    __m256i b5 = _mm256_sub_epi32(c4, d6);
+    __m256i b6 = _mm256_sub_epi32(_mm256_setzero_si256(), d6);
+    __m256i b7 = d6;
+    __m256i b2 = _mm256_add_epi32(c2, _mm256_srai_epi32(c2, 2));
+    __m256i b3 = _mm256_srai_epi32(c2, 1);
+    __m256i a4 = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_srai_epi32(b7, 2), b4), _mm256_srai_epi32(b4, 2)), _mm256_srai_epi32(b4, 4));
+    __m256i a7 = _mm256_add_epi32(_mm256_sub_epi32(_mm256_sub_epi32(_mm256_srai_epi32(b4, 2), b7), _mm256_srai_epi32(b7, 2)), _mm256_srai_epi32(b7, 4));
+    __m256i a5 = _mm256_add_epi32(_mm256_add_epi32(_mm256_sub_epi32(b5, b6), _mm256_srai_epi32(b6, 2)), _mm256_srai_epi32(b6, 4));
+    __m256i a6 = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_add_epi32(b6, b5), _mm256_srai_epi32(b5, 2)), _mm256_srai_epi32(b5, 4));
+    __m256i a0 = _mm256_add_epi32(c0, b2);
+    __m256i a3 = _mm256_sub_epi32(c0, b2);
+    __m256i a1 = _mm256_add_epi32(c0, b3);
+    __m256i a2 = _mm256_sub_epi32(c0, b3);
+    x[0] = _mm256_add_epi32(a0, a4);
+    x[1] = _mm256_add_epi32(a1, a5);
+    x[2] = _mm256_add_epi32(a2, a6);
+    x[3] = _mm256_add_epi32(a3, a7);
+    x[4] = _mm256_sub_epi32(a3, a7);
+    x[5] = _mm256_sub_epi32(a2, a6);
+    x[6] = _mm256_sub_epi32(a1, a5);
+    x[7] = _mm256_sub_epi32(a0, a4);
+}
+
+/// @summary Dequantizes and performs an inverse 2D DCT on an 8x8 block whose
+/// non-zero coefficients all lie in the top-left 4x4 region, using AVX2. The
+/// column pass only touches the 4x4 input region, so it runs on 128-bit
+/// registers; the row pass processes all eight rows at once. The output is
+/// bit-for-bit identical to idct8x8id_4x4_base().
+/// @param dst A 64-element buffer to be filled with de-quantized sample data.
+/// @param src A 64-element buffer containing the quantized DCT coefficients.
+/// @param quant The scaled quantization table for the IDCT.
+IM_TARGET_AVX2
+static void idct8x8id_4x4_avx2(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict quant)
+{
+    #define DCTSIZE 8U
+
+    __m128i lo[8];  // columns 0-3 of each row
+    __m256i x [8];  // one column of eight rows per register
+    __m128i r [8];
+
+    for (size_t i = 0; i < DCTSIZE / 2; ++i)
+    {
+        // dequantize columns 0-3 of rows 0-3.
+        __m128i c = _mm_cvtepi16_epi32(_mm_loadl_epi64((__m128i const*) &src  [i * DCTSIZE]));
+        __m128i q = _mm_cvtepu16_epi32(_mm_loadl_epi64((__m128i const*) &quant[i * DCTSIZE]));
+        lo[i] = _mm_madd_epi16(c, q);
+    }
+
+    // process columns 0-3, then transpose the 8x4 result so that each
+    // register holds one column of all eight rows.
+    idct4_epi32_sse2(lo);
+    transpose4x4_epi32(&lo[0], &lo[1], &lo[2], &lo[3]);
+    transpose4x4_epi32(&lo[4], &lo[5], &lo[6], &lo[7]);
+    x[0] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo[0]), lo[4], 1);
+    x[1] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo[1]), lo[5], 1);
+    x[2] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo[2]), lo[6], 1);
+    x[3] = _mm256_inserti128_si256(_mm256_castsi128_si256(lo[3]), lo[7], 1);
+
+    // process rows, descale and wrap, then restore row-major order.
+    idct4_epi32_avx2(x);
+    for (size_t j = 0; j < DCTSIZE; ++j)
+    {
+        __m256i v = _mm256_srai_epi32(_mm256_slli_epi32(x[j], 10), 16);
+        r[j] = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    }
+    transpose8x8_epi16(r);
+    for (size_t i = 0; i < DCTSIZE; ++i)
+        _mm_storeu_si128((__m128i*) &dst[i * DCTSIZE], r[i]);
+}
+#endif /* IM_ENABLE_AVX2 */
+
+#if IM_ENABLE_AVX2
+/// @summary Performs the 1D AA&N forward DCT used by fdct8x8fq_base() on
+/// eight independent sets of eight samples, one set per lane. The multiply-
+/// adds are fused, so results may differ from the scalar code in the last
+/// bit.
+/// @param x An array of eight registers holding inputs 0-7 on entry and the
+/// coefficients 0-7 on return.
+IM_TARGET_FMA
+static inline void fdct8_ps_fma(__m256 *x)
+{
+    __m256 const kf13 = _mm256_set1_ps(0.707106781f);
+    __m256 const kf05 = _mm256_set1_ps(0.382683433f);
+    __m256 const kf02 = _mm256_set1_ps(0.541196100f);
+    __m256 const kf04 = _mm256_set1_ps(1.306563965f);
+    __m256 t00 = _mm256_add_ps(x[0], x[7]);
+    __m256 t07 = _mm256_sub_ps(x[0], x[7]);
+    __m256 t01 = _mm256_add_ps(x[1], x[6]);
+    __m256 t06 = _mm256_sub_ps(x[1], x[6]);
+    __m256 t02 = _mm256_add_ps(x[2], x[5]);
+    __m256 t05 = _mm256_sub_ps(x[2], x[5]);
+    __m256 t03 = _mm256_add_ps(x[3], x[4]);
+    __m256 t04 = _mm256_sub_ps(x[3], x[4]);
+    __m256 t10 = _mm256_add_ps(t00, t03);
+    __m256 t13 = _mm256_sub_ps(t00, t03);
+    __m256 t11 = _mm256_add_ps(t01, t02);
+    __m256 t12 = _mm256_sub_ps(t01, t02);
+    __m256 z01 = _mm256_mul_ps(_mm256_add_ps(t12, t13), kf13);
+    x[0] = _mm256_add_ps(t10, t11);
+    x[4] = _mm256_sub_ps(t10, t11);
+    x[2] = _mm256_add_ps(t13, z01);
+    x[6] = _mm256_sub_ps(t13, z01);
+    t10  = _mm256_add_ps(t04, t05);
+    t11  = _mm256_add_ps(t05, t06);
+    t12  = _mm256_add_ps(t06, t07);
+    __m256 z05 = _mm256_mul_ps(_mm256_sub_ps(t10, t12), kf05);
+    __m256 z02 = _mm256_fmadd_ps(kf02, t10, z05);
+    __m256 z04 = _mm256_fmadd_ps(kf04, t12, z05);
+    __m256 z03 = _mm256_mul_ps(kf13, t11);
+    __m256 z11 = _mm256_add_ps(t07, z03);
+    __m256 z13 = _mm256_sub_ps(t07, z03);
+    x[5] = _mm256_add_ps(z13, z02);
+    x[3] = _mm256_sub_ps(z13, z02);
+    x[1] = _mm256_add_ps(z11, z04);
+    x[7] = _mm256_sub_ps(z11, z04);
+}
+
+/// @summary Performs the 1D AA&N inverse DCT used by idct8x8fd_base() on
+/// eight independent sets of eight coefficients, one set per lane.
+/// @param x An array of eight registers holding coefficients 0-7 on entry and
+/// the output samples 0-7 on return.
+IM_TARGET_FMA
+static inline void idct8_ps_fma(__m256 *x)
+{
+    __m256 const ki13 = _mm256_set1_ps(1.414213562f);
+    __m256 const ki05 = _mm256_set1_ps(1.847759065f);
+    __m256 const ki10 = _mm256_set1_ps(1.08239220f);
+    __m256 const ki12 = _mm256_set1_ps(-2.61312593f);
+    __m256 t10 = _mm256_add_ps(x[0], x[4]);
+    __m256 t11 = _mm256_sub_ps(x[0], x[4]);
+    __m256 t13 = _mm256_add_ps(x[2], x[6]);
+    __m256 t12 = _mm256_fmsub_ps(_mm256_sub_ps(x[2], x[6]), ki13, t13);
+    __m256 t00 = _mm256_add_ps(t10, t13);
+    __m256 t03 = _mm256_sub_ps(t10, t13);
+    __m256 t01 = _mm256_add_ps(t11, t12);
+    __m256 t02 = _mm256_sub_ps(t11, t12);
+    __m256 z13 = _mm256_add_ps(x[5], x[3]);
+    __m256 z10 = _mm256_sub_ps(x[5], x[3]);
+    __m256 z11 = _mm256_add_ps(x[1], x[7]);
+    __m256 z12 = _mm256_sub_ps(x[1], x[7]);
+    __m256 t07 = _mm256_add_ps(z11, z13);
+    __m256 z05 = _mm256_mul_ps(_mm256_add_ps(z10, z12), ki05);
+    t11        = _mm256_mul_ps(_mm256_sub_ps(z11, z13), ki13);
+    t10        = _mm256_fmsub_ps(ki10, z12, z05);
+    t12        = _mm256_fmadd_ps(ki12, z10, z05);
+    __m256 t06 = _mm256_sub_ps(t12, t07);
+    __m256 t05 = _mm256_sub_ps(t11, t06);
+    __m256 t04 = _mm256_add_ps(t10, t05);
+    x[0] = _mm256_add_ps(t00, t07);
+    x[7] = _mm256_sub_ps(t00, t07);
+    x[1] = _mm256_add_ps(t01, t06);
+    x[6] = _mm256_sub_ps(t01, t06);
+    x[2] = _mm256_add_ps(t02, t05);
+    x[5] = _mm256_sub_ps(t02, t05);
+    x[4] = _mm256_add_ps(t03, t04);
+    x[3] = _mm256_sub_ps(t03, t04);
+}
+
+/// @summary Transposes an 8x8 block of floats stored as eight rows of eight
+/// values, one row per register.
+/// @param r An array of eight registers; on return, r[i] holds column i.
+IM_TARGET_AVX2
+static inline void transpose8x8_ps(__m256 *r)
+{
+    __m256i v[8];
+    for (size_t i = 0; i < 8; ++i)
+        v[i] = _mm256_castps_si256(r[i]);
+    transpose8x8_epi32(v);
+    for (size_t i = 0; i < 8; ++i)
+        r[i] = _mm256_castsi256_ps(v[i]);
+}
+
+/// @summary Performs a 2D forward DCT with quantization on eight 8x8 blocks
+/// of floats at once using AVX2 and FMA. Each block occupies one lane. The
+/// output matches fdct8x8fq_base() to within floating-point rounding.
+/// @param dst A 512-element array to be filled with quantized coefficients
+/// for eight consecutive blocks.
+/// @param src A 512-element array specifying eight consecutive 8x8 blocks.
+/// @param quant The 64-element scaled quantization table.
+IM_TARGET_FMA
+static void fdct8x8fq_x8_avx2(
+    float       * restrict dst,
+    float const * restrict src,
+    float const * restrict quant)
+{
+    #define DCTSIZE 8U
+
+    __m256 ws[64];  // blocks 0-7, one coefficient position per register
+    __m256 x [8];
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // gather row i of each block so that each register holds one column
+        // position across all eight blocks.
+        for (size_t k = 0; k < 8; ++k)
+            x[k] = _mm256_loadu_ps(&src[k * 64 + i * DCTSIZE]);
+        transpose8x8_ps(x);
+        fdct8_ps_fma(x);
+        for (size_t j = 0; j < DCTSIZE; ++j)
+            ws[i * DCTSIZE + j] = x[j];
+    }
+
+    for (size_t j = 0; j < DCTSIZE; ++j)
+    {
+        // process columns, then quantize and descale.
+        for (size_t i = 0; i < DCTSIZE; ++i)
+            x[i] = ws[i * DCTSIZE + j];
+        fdct8_ps_fma(x);
+        for (size_t i = 0; i < DCTSIZE; ++i)
+            ws[i * DCTSIZE + j] = _mm256_mul_ps(x[i], _mm256_set1_ps(quant[i * DCTSIZE + j]));
+    }
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // scatter row i to each output block.
+        for (size_t j = 0; j < DCTSIZE; ++j)
+            x[j] = ws[i * DCTSIZE + j];
+        transpose8x8_ps(x);
+        for (size_t k = 0; k < 8; ++k)
+            _mm256_storeu_ps(&dst[k * 64 + i * DCTSIZE], x[k]);
+    }
+}
+
+/// @summary Performs a 2D inverse DCT with dequantization on eight 8x8 blocks
+/// of floats at once using AVX2 and FMA. Each block occupies one lane. The
+/// output matches idct8x8fd_base() to within floating-point rounding.
+/// @param dst A 512-element array to be filled with sample values for eight
+/// consecutive blocks.
+/// @param src A 512-element array of quantized DCT coefficients.
+/// @param quant The 64-element scaled dequantization table.
+IM_TARGET_FMA
+static void idct8x8fd_x8_avx2(
+    float       * restrict dst,
+    float const * restrict src,
+    float const * restrict quant)
+{
+    #define DCTSIZE 8U
+
+    __m256 ws[64];  // blocks 0-7, one coefficient position per register
+    __m256 x [8];
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // gather row i of each block and dequantize it.
+        for (size_t k = 0; k < 8; ++k)
+            x[k] = _mm256_loadu_ps(&src[k * 64 + i * DCTSIZE]);
+        transpose8x8_ps(x);
+        for (size_t j = 0; j < DCTSIZE; ++j)
+            ws[i * DCTSIZE + j] = _mm256_mul_ps(x[j], _mm256_set1_ps(quant[i * DCTSIZE + j]));
+    }
+
+    for (size_t j = 0; j < DCTSIZE; ++j)
+    {
+        // process columns, as idct8x8fd_base() does.
+        for (size_t i = 0; i < DCTSIZE; ++i)
+            x[i] = ws[i * DCTSIZE + j];
+        idct8_ps_fma(x);
+        for (size_t i = 0; i < DCTSIZE; ++i)
+            ws[i * DCTSIZE + j] = x[i];
+    }
+
+    for (size_t i = 0; i < DCTSIZE; ++i)
+    {
+        // process rows, then scatter row i to each output block.
+        for (size_t j = 0; j < DCTSIZE; ++j)
+            x[j] = ws[i * DCTSIZE + j];
+        idct8_ps_fma(x);
+        transpose8x8_ps(x);
+        for (size_t k = 0; k < 8; ++k)
+            _mm256_storeu_ps(&dst[k * 64 + i * DCTSIZE], x[k]);
+    }
+}
+#endif /* IM_ENABLE_AVX2 */
+
+/// @summary Performs a forward DCT and quantization on eight consecutive 8x8
+/// float blocks using the portable implementation. This is the scalar
+/// counterpart of fdct8x8fq_x8_avx2().
+/// @param dst The 512-element destination array.
+/// @param src The 512-element source array.
+/// @param quant The scaled quantization table.
+static void fdct8x8fq_x8_base(
+    float       * restrict dst,
+    float const * restrict src,
+    float const * restrict quant)
+{
+    for (size_t i = 0; i < 8; ++i)
+        fdct8x8fq_base(&dst[i * 64], &src[i * 64], quant);
+}
+
+/// @summary Performs a dequantization and inverse DCT on eight consecutive 8x8
+/// float blocks using the portable implementation. This is the scalar
+/// counterpart of idct8x8fd_x8_avx2().
+/// @param dst The 512-element destination array.
+/// @param src The 512-element source array.
+/// @param quant The scaled dequantization table.
+static void idct8x8fd_x8_base(
+    float       * restrict dst,
+    float const * restrict src,
+    float const * restrict quant)
+{
+    for (size_t i = 0; i < 8; ++i)
+        idct8x8fd_base(&dst[i * 64], &src[i * 64], quant);
+}
+
+/// @summary Performs a forward DCT and quantization on eight consecutive 8x8
+/// blocks using the portable implementation. This is the scalar counterpart
+/// of fdct8x8iq_x8_sse2() and fdct8x8iq_x8_avx2().
+/// @param dst The 512-element destination array.
+/// @param src The 512-element source array.
+/// @param quant The reciprocal quantization table.
+static void fdct8x8iq_x8_base(
+    int16_t             * restrict dst,
+    int16_t       const * restrict src,
+    quant_table_t const * restrict quant)
+{
+    for (size_t i = 0; i < 8; ++i)
+        fdct8x8iq_base(&dst[i * 64], &src[i * 64], quant);
+}
+
+/// @summary Stores the set of DCT kernels selected for the host CPU. Every
+/// public entry point calls through this table, so the selection made by
+/// select_kernels() applies uniformly to the whole library.
+struct kernel_table_t
+{
+    int32_t  Isa;
+    void   (*fdct8x8f    )(float*,   float const*);
+    void   (*fdct8x8i    )(int16_t*, int16_t const*);
+    void   (*fdct8x8fq   )(float*,   float const*,   float const*);
+    void   (*fdct8x8fq_x8)(float*,   float const*,   float const*);
+    void   (*fdct8x8iq   )(int16_t*, int16_t const*, quant_table_t const*);
+    void   (*fdct8x8iq_x8)(int16_t*, int16_t const*, quant_table_t const*);
+    void   (*idct8x8f    )(float*,   float const*);
+    void   (*idct8x8i    )(int16_t*, int16_t const*);
+    void   (*idct8x8fd   )(float*,   float const*,   float const*);
+    void   (*idct8x8fd_x8)(float*,   float const*,   float const*);
+    void   (*idct8x8id   )(int16_t*, int16_t const*, int16_t const*);
+    void   (*idct8x8id_4x4)(int16_t*, int16_t const*, int16_t const*);
+    void   (*expand_row  )(uint32_t*, uint8_t const*, size_t, int32_t);
+    void   (*hash_row    )(uint32_t*, uint8_t const*, size_t);
+};
+
+/// @summary The active kernel table. Statically initialized to the portable
+/// kernels so that it is valid even before the startup selection runs.
+static kernel_table_t Kernels =
+{
+    CPU_ISA_SCALAR,
+    fdct8x8f_base,
+    fdct8x8i_base,
+    fdct8x8fq_base,
+    fdct8x8fq_x8_base,
+    fdct8x8iq_base,
+    fdct8x8iq_x8_base,
+    idct8x8f_base,
+    idct8x8i_base,
+    idct8x8fd_base,
+    idct8x8fd_x8_base,
+    idct8x8id_base,
+    idct8x8id_4x4_base,
+    expand_row_base,
+    hash_row_base
+};
+
+/// @summary Executes the cpuid instruction for a given leaf and sub-leaf.
+/// @param regs On return, stores the EAX, EBX, ECX and EDX values.
+/// @param leaf The value of EAX on input.
+/// @param subleaf The value of ECX on input.
+/// @return true if the leaf is supported by the host CPU.
+static bool cpuid(uint32_t regs[4], uint32_t leaf, uint32_t subleaf)
+{
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#if   IM_ENABLE_SSE2 && defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0);
+    if ((uint32_t) r[0] < leaf) return false;
+    __cpuidex(r, (int) leaf, (int) subleaf);
+    regs[0] = (uint32_t) r[0]; regs[1] = (uint32_t) r[1];
+    regs[2] = (uint32_t) r[2]; regs[3] = (uint32_t) r[3];
+    return true;
+#elif IM_ENABLE_SSE2
+    if (__get_cpuid_max(0, NULL) < leaf) return false;
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+    return true;
+#else
+    (void) leaf; (void) subleaf;
+    return false;
+#endif
+}
+
+/// @summary Reads the XCR0 register to determine which register states the
+/// operating system saves on a context switch.
+/// @return The low 32 bits of XCR0, or zero if xgetbv is not available.
+static uint32_t xgetbv0(void)
+{
+#if   IM_ENABLE_SSE2 && defined(_MSC_VER)
+    return (uint32_t) _xgetbv(0);
+#elif IM_ENABLE_SSE2
+    uint32_t eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return eax;
+#else
+    return 0;
+#endif
+}
+
+/// @summary Selects the default kernel set before main() runs. The override
+/// environment variable IMUTILS_ISA (scalar, sse2, avx2 or avx512) may be used
+/// to force a lower level without rebuilding.
+static struct kernel_init_t
+{
+    kernel_init_t(void)
+    {
+        char const *env = getenv("IMUTILS_ISA");
+        int32_t     isa = CPU_ISA_BEST;
+        if (env != NULL)
+        {
+            if (strcmp(env, "scalar") == 0) isa = CPU_ISA_SCALAR;
+            if (strcmp(env, "sse2"  ) == 0) isa = CPU_ISA_SSE2;
+            if (strcmp(env, "avx2"  ) == 0) isa = CPU_ISA_AVX2;
+            if (strcmp(env, "avx512") == 0) isa = CPU_ISA_AVX512;
+        }
+        select_kernels(isa);
+    }
+} KernelInit;
+
+/// @summary Per-thread counts of the blocks decoded by each IDCT path.
+static IM_THREAD_LOCAL idct_counters_t IdctCounters;
+
+/// @summary Per-thread cache of the reciprocal tables most recently built for
+/// the entry points that accept a divisor table directly. Two entries cover
+/// callers that alternate between a luma and a chroma table.
+static IM_THREAD_LOCAL quant_table_t   RecipCache[2];
+static IM_THREAD_LOCAL uint32_t        RecipCacheNext;
+
+/// @summary Retrieves the reciprocal form of a divisor table, rebuilding it
+/// only when the table differs from the ones most recently seen on the
+/// calling thread.
+/// @param Qfdct The 64-element quantization table, as output by the
+/// scaled_qtable_int16() function.
+/// @param keep A table previously returned that the caller still needs, and
+/// which must not be evicted, or NULL.
+/// @return The reciprocal table, valid until the next call on this thread
+/// that does not keep it.
+static quant_table_t const* reciprocal_qtable_cached(int16_t const *Qfdct, quant_table_t const *keep)
+{
+    for (size_t i = 0; i < 2; ++i)
+    {
+        // an entry is built once its shift is set, which is at least 15.
+        if (RecipCache[i].Shift[0] != 0 && memcmp(RecipCache[i].Qfdct, Qfdct, sizeof(RecipCache[i].Qfdct)) == 0)
+            return &RecipCache[i];
+    }
+    uint32_t slot  = RecipCacheNext;
+    if (&RecipCache[slot] == keep)
+        slot ^= 1;
+    RecipCacheNext = slot ^ 1;
+    reciprocal_qtable_int16(&RecipCache[slot], Qfdct, Qfdct);
+    return &RecipCache[slot];
+}
+
+/// @summary Defines the reduced IDCT paths a block may take.
+enum idct_path_e
+{
+    IDCT_PATH_DC                = 0,
+    IDCT_PATH_4X4               = 1,
+    IDCT_PATH_FULL              = 2
+};
+
+/// @summary Determines which IDCT path can decode a block exactly, by
+/// checking which regions of the block contain non-zero coefficients.
+/// @param src A 64-element buffer containing the quantized DCT coefficients.
+/// @return One of the idct_path_e values.
+static inline int32_t idct_path(int16_t const *src)
+{
+#if IM_ENABLE_SSE2
+    __m128i const *p  = (__m128i const*) src;
+    __m128i top = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p + 0), _mm_loadu_si128(p + 1)),
+                               _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+    __m128i bot = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p + 4), _mm_loadu_si128(p + 5)),
+                               _mm_or_si128(_mm_loadu_si128(p + 6), _mm_loadu_si128(p + 7)));
+    __m128i z   = _mm_setzero_si128();
+    // bits 0-7 of the masks cover columns 0-3, bits 8-15 cover columns 4-7.
+    int     mt  = _mm_movemask_epi8(_mm_cmpeq_epi16(top, z));
+    int     mb  = _mm_movemask_epi8(_mm_cmpeq_epi16(bot, z));
+    if (mb != 0xFFFF || (mt & 0xFF00) != 0xFF00)
+        return IDCT_PATH_FULL;
+    __m128i ac  = _mm_or_si128(_mm_srli_si128(_mm_loadu_si128(p + 0), 2), _mm_or_si128(
+                  _mm_or_si128(_mm_loadu_si128(p + 1), _mm_loadu_si128(p + 2)), _mm_loadu_si128(p + 3)));
+    return (_mm_movemask_epi8(_mm_cmpeq_epi16(ac, z)) == 0xFFFF) ? IDCT_PATH_DC : IDCT_PATH_4X4;
+#else
+    bool dc = true;
+    for (size_t i = 0; i < 64; ++i)
+    {
+        if (src[i] == 0) continue;
+        if ((i >> 3) >= 4 || (i & 7) >= 4) return IDCT_PATH_FULL;
+        if (i != 0) dc = false;
+    }
+    return dc ? IDCT_PATH_DC : IDCT_PATH_4X4;
+#endif
+}
+
+/// @summary Dequantizes and performs an inverse 2D DCT on an 8x8 block using
+/// the cheapest kernel that produces an exact result, and counts the path.
+/// @param dst A 64-element buffer to be filled with de-quantized sample data.
+/// @param src A 64-element buffer containing the quantized DCT coefficients.
+/// @param quant The scaled quantization table for the IDCT.
+/// @param path One of the idct_path_e values, as returned by idct_path().
+static inline void idct8x8id_path(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict quant,
+    int32_t                  path)
+{
+    switch (path)
+    {
+        case IDCT_PATH_DC:
+            IdctCounters.DcOnly++;
+            idct8x8id_dc(dst, src, quant);
+            break;
+        case IDCT_PATH_4X4:
+            IdctCounters.Sparse4x4++;
+            Kernels.idct8x8id_4x4(dst, src, quant);
+            break;
+        default:
+            IdctCounters.Full++;
+            Kernels.idct8x8id(dst, src, quant);
+            break;
+    }
+}
+
+/// @summary Converts one row of a decoded 16x16 block from YCoCg to RGB and
+/// writes it to the destination. The luma samples are read directly from the
+/// two 8x8 IDCT output blocks covering the row, and each chroma sample covers
+/// two horizontally adjacent pixels, so no merged or upscaled copies of the
+/// channels are required. Values outside of [0, 255] are clamped.
+/// @param dst The destination for 16 pixels (48 bytes) of RGB data.
+/// @param y0 The 8 luma samples for columns [0, 8).
+/// @param y1 The 8 luma samples for columns [8, 16).
+/// @param co The 8 chroma-orange samples for the row.
+/// @param cg The 8 chroma-green samples for the row.
+static void ycocg_row_rgb(
+    uint8_t       * restrict dst,
+    int16_t const * restrict y0,
+    int16_t const * restrict y1,
+    int16_t const * restrict co,
+    int16_t const * restrict cg)
+{
+    for (size_t i = 0; i < 16; ++i)
+    {
+        int32_t y = (i < 8) ? y0[i] : y1[i - 8];
+        int32_t o = co[i >> 1];
+        int32_t g = cg[i >> 1];
+        int16_t t = y  - (g >> 1);
+        int16_t G = g  +  t;
+        int16_t B = t  - (o >> 1);
+        int16_t R = B  +  o;
+        *dst++    = clamp(R);
+        *dst++    = clamp(G);
+        *dst++    = clamp(B);
+    }
+}
+
+/// @summary Converts one row of a decoded 16x16 block from YCoCg to RGBA and
+/// writes it to the destination. See ycocg_row_rgb() for the input layout.
+/// @param dst The destination for 16 pixels (64 bytes) of RGBA data.
+/// @param y0 The 8 luma samples for columns [0, 8).
+/// @param y1 The 8 luma samples for columns [8, 16).
+/// @param co The 8 chroma-orange samples for the row.
+/// @param cg The 8 chroma-green samples for the row.
+/// @param a The 16 alpha values for the row.
+static void ycocg_row_rgba(
+    uint8_t       * restrict dst,
+    int16_t const * restrict y0,
+    int16_t const * restrict y1,
+    int16_t const * restrict co,
+    int16_t const * restrict cg,
+    uint8_t const * restrict a)
+{
+#if IM_ENABLE_SSE2
+    // the scalar conversion truncates each intermediate to 16 bits, so it
+    // matches 16-bit wrapping arithmetic exactly; packus performs the clamp.
+    __m128i o   = _mm_loadu_si128((__m128i const*) co);
+    __m128i g   = _mm_loadu_si128((__m128i const*) cg);
+    __m128i olo = _mm_unpacklo_epi16(o, o);
+    __m128i ohi = _mm_unpackhi_epi16(o, o);
+    __m128i glo = _mm_unpacklo_epi16(g, g);
+    __m128i ghi = _mm_unpackhi_epi16(g, g);
+    __m128i tlo = _mm_sub_epi16(_mm_loadu_si128((__m128i const*) y0), _mm_srai_epi16(glo, 1));
+    __m128i thi = _mm_sub_epi16(_mm_loadu_si128((__m128i const*) y1), _mm_srai_epi16(ghi, 1));
+    __m128i Glo = _mm_add_epi16(glo, tlo);
+    __m128i Ghi = _mm_add_epi16(ghi, thi);
+    __m128i Blo = _mm_sub_epi16(tlo, _mm_srai_epi16(olo, 1));
+    __m128i Bhi = _mm_sub_epi16(thi, _mm_srai_epi16(ohi, 1));
+    __m128i Rlo = _mm_add_epi16(Blo, olo);
+    __m128i Rhi = _mm_add_epi16(Bhi, ohi);
+    __m128i R   = _mm_packus_epi16(Rlo, Rhi);
+    __m128i G   = _mm_packus_epi16(Glo, Ghi);
+    __m128i B   = _mm_packus_epi16(Blo, Bhi);
+    __m128i A   = _mm_loadu_si128((__m128i const*) a);
+    __m128i RGl = _mm_unpacklo_epi8(R, G);
+    __m128i RGh = _mm_unpackhi_epi8(R, G);
+    __m128i BAl = _mm_unpacklo_epi8(B, A);
+    __m128i BAh = _mm_unpackhi_epi8(B, A);
+    _mm_storeu_si128((__m128i*) &dst[ 0], _mm_unpacklo_epi16(RGl, BAl));
+    _mm_storeu_si128((__m128i*) &dst[16], _mm_unpackhi_epi16(RGl, BAl));
+    _mm_storeu_si128((__m128i*) &dst[32], _mm_unpacklo_epi16(RGh, BAh));
+    _mm_storeu_si128((__m128i*) &dst[48], _mm_unpackhi_epi16(RGh, BAh));
+#else
+    for (size_t i = 0; i < 16; ++i)
+    {
+        int32_t y = (i < 8) ? y0[i] : y1[i - 8];
+        int32_t o = co[i >> 1];
+        int32_t g = cg[i >> 1];
+        int16_t t = y  - (g >> 1);
+        int16_t G = g  +  t;
+        int16_t B = t  - (o >> 1);
+        int16_t R = B  +  o;
+        *dst++    = clamp(R);
+        *dst++    = clamp(G);
+        *dst++    = clamp(B);
+        *dst++    = a[i];
+    }
+#endif
+}
+
+#if IM_ENABLE_SSE2
+/// @summary Converts one row of a 16x16 block of RGBA8 pixels to YCoCgA for
+/// split16x16i(), storing the luma and alpha and returning the full-width
+/// chroma for the caller to downsample.
+/// @param co On return, stores the left and right halves of the Co row.
+/// @param cg On return, stores the left and right halves of the Cg row.
+/// @param Y The 256-element luma block array.
+/// @param A The 256-element alpha array.
+/// @param src The first pixel of the row.
+/// @param row The zero-based row index within the block.
+static inline void split16x16i_row_sse2(
+    __m128i       * restrict co,
+    __m128i       * restrict cg,
+    int16_t       * restrict Y,
+    uint8_t       * restrict A,
+    uint8_t const * restrict src,
+    size_t                   row)
+{
+    // load 16 pixels and separate the channels into 32-bit lanes, then
+    // narrow to one register of eight 16-bit values per half-row.
+    __m128i const mask = _mm_set1_epi32(0xFF);
+    __m128i p[4];
+    __m128i r[2], g[2], b[2], a[4];
+    for (size_t i = 0; i < 4; ++i)
+    {
+        p[i] = _mm_loadu_si128((__m128i const*) (src + i * 16));
+        a[i] = _mm_srli_epi32(p[i], 24);
+    }
+    for (size_t h = 0; h < 2; ++h)
+    {
+        __m128i lo = p[h * 2 + 0];
+        __m128i hi = p[h * 2 + 1];
+        r[h] = _mm_packs_epi32(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+        g[h] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8),  mask), _mm_and_si128(_mm_srli_epi32(hi, 8),  mask));
+        b[h] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), mask), _mm_and_si128(_mm_srli_epi32(hi, 16), mask));
+    }
+    _mm_storeu_si128((__m128i*) &A[row * 16], _mm_packus_epi16(_mm_packs_epi32(a[0], a[1]), _mm_packs_epi32(a[2], a[3])));
+
+    // YCoCg-R forward lifting; the left and right halves of the row
+    // belong to horizontally adjacent luma blocks.
+    int16_t *yrow = &Y[(row >> 3) * 128 + (row & 7) * 8];
+    for (size_t h = 0; h < 2; ++h)
+    {
+        co[h]     = _mm_sub_epi16(r[h], b[h]);
+        __m128i t = _mm_add_epi16(b[h], _mm_srai_epi16(co[h], 1));
+        cg[h]     = _mm_sub_epi16(g[h], t);
+        __m128i y = _mm_add_epi16(t, _mm_srai_epi16(cg[h], 1));
+        _mm_storeu_si128((__m128i*) &yrow[h * 64], y);
+    }
+}
+#endif /* IM_ENABLE_SSE2 */
+
+/// @summary Converts a 16x16 block of RGBA8 pixels to YCoCgA and splits it
+/// into the 8x8 sample blocks consumed by the forward DCT: four luma blocks,
+/// and one 2x2-downsampled block for each chroma channel. Each row is
+/// converted once and written straight to its planar destination, with the
+/// chroma box filter applied as each pair of rows completes, so no
+/// interleaved intermediate is built and no strided gathers are needed.
+/// @param Y A 256-element array to store the luma blocks, in the order
+/// top-left, top-right, bottom-left, bottom-right.
+/// @param Co A 64-element array to store the chroma-orange block.
+/// @param Cg A 64-element array to store the chroma-green block.
+/// @param A A 256-element array to store the untransformed alpha channel.
+/// @param RGBA The top-left pixel of the 16x16 block.
+/// @param pitch The number of bytes between the start of consecutive rows.
+static void split16x16i(
+    int16_t       * restrict Y,
+    int16_t       * restrict Co,
+    int16_t       * restrict Cg,
+    uint8_t       * restrict A,
+    uint8_t const * restrict RGBA,
+    size_t                   pitch)
+{
+#if IM_ENABLE_SSE2
+    __m128i const ones = _mm_set1_epi16(1);
+    for (size_t row = 0; row < 16; row += 2)
+    {
+        __m128i co_even[2], cg_even[2];
+        __m128i co_odd [2], cg_odd [2];
+        split16x16i_row_sse2(co_even, cg_even, Y, A, RGBA + (row + 0) * pitch, row + 0);
+        split16x16i_row_sse2(co_odd,  cg_odd,  Y, A, RGBA + (row + 1) * pitch, row + 1);
+
+        // average each 2x2 chroma neighborhood of the row pair.
+        // madd sums horizontally adjacent pairs into 32-bit lanes.
+        __m128i o0 = _mm_srai_epi32(_mm_madd_epi16(_mm_add_epi16(co_even[0], co_odd[0]), ones), 2);
+        __m128i o1 = _mm_srai_epi32(_mm_madd_epi16(_mm_add_epi16(co_even[1], co_odd[1]), ones), 2);
+        __m128i g0 = _mm_srai_epi32(_mm_madd_epi16(_mm_add_epi16(cg_even[0], cg_odd[0]), ones), 2);
+        __m128i g1 = _mm_srai_epi32(_mm_madd_epi16(_mm_add_epi16(cg_even[1], cg_odd[1]), ones), 2);
+        _mm_storeu_si128((__m128i*) &Co[(row >> 1) * 8], _mm_packs_epi32(o0, o1));
+        _mm_storeu_si128((__m128i*) &Cg[(row >> 1) * 8], _mm_packs_epi32(g0, g1));
+    }
+#else
+    int16_t co[2][16];
+    int16_t cg[2][16];
+    for (size_t row = 0; row < 16; ++row)
+    {
+        uint8_t const *src  = RGBA + row * pitch;
+        int16_t       *yrow = &Y[(row >> 3) * 128 + (row & 7) * 8];
+        for (size_t i = 0; i < 16; ++i)
+        {
+            int16_t r = src[i * 4 + 0];
+            int16_t g = src[i * 4 + 1];
+            int16_t b = src[i * 4 + 2];
+            int16_t c = r  -  b;
+            int16_t t = b  + (c >> 1);
+            int16_t G = g  -  t;
+            A[row * 16 + i] = src[i * 4 + 3];
+            yrow[(i >> 3) * 64 + (i & 7)] = t + (G >> 1);
+            co[row & 1][i] = c;
+            cg[row & 1][i] = G;
+        }
+        if ((row & 1) == 0)
+            continue;
+        for (size_t i = 0; i < 8; ++i)
+        {
+            Co[(row >> 1) * 8 + i] = (int16_t) ((co[0][i * 2] + co[0][i * 2 + 1] + co[1][i * 2] + co[1][i * 2 + 1]) >> 2);
+            Cg[(row >> 1) * 8 + i] = (int16_t) ((cg[0][i * 2] + cg[0][i * 2 + 1] + cg[1][i * 2] + cg[1][i * 2 + 1]) >> 2);
+        }
+    }
+#endif
+}
+
+/// @summary Determines the border color to use at the edge of a tile.
+/// @param config The tiler configuration.
+/// @param edge A pointer to the edge pixel.
+/// @return The packed RGBA8 color to use for the border.
+static inline uint32_t sample_border(image_tiler_config_t const *config, uint32_t const *edge)
+{
+    switch (config->BorderMode)
+    {
+        case BORDER_CLAMP_TO_EDGE:  return *edge;
+        case BORDER_CONSTANT_COLOR: return config->BorderColor;
+        default: break;
+    }
+    return 0;
+}
+
+/// @summary Reads one row of pixels for a tile from the source image, applying
+/// borders to the left and right edges, and padding to the right edge. The
+/// source pixels are expanded to RGBA8 directly into the tile row.
+/// @param row_buf A buffer capable of holding one row of pixels in the tile.
+/// @param src_row Pointer to the first pixel in the source image to copy, in
+/// the source format.
+/// @param src_num The number of pixels to copy from the source image.
+/// @param pad_right The number of pixels of padding to apply to the right side
+/// of the row, if the tile extends past the right edge of the source image.
+/// @param config The tiler configuration, specifying how to sample borders.
+static void read_row(
+    uint32_t       * restrict   row_buf,
+    uint8_t  const * restrict   src_row,
+    size_t                      src_num,
+    size_t                      pad_right,
+    image_tiler_config_t const *config)
+{
+    // convert the source data from the image.
+    Kernels.expand_row(row_buf + config->BorderSize, src_row, src_num, config->SourceFormat);
+    uint32_t const *left_edge    = row_buf + config->BorderSize;
+    uint32_t const *right_edge   = row_buf + config->BorderSize + (src_num - 1);
+
+    // write the left-side border.
+    uint32_t left_border = sample_border(config, left_edge);
+    for (size_t i = 0; i < config->BorderSize; ++i)
+        *row_buf++= left_border;
+    row_buf += src_num;
+
+    // add padding to the right side of the image.
+    uint32_t right_pixel = *right_edge;
+    for (size_t i = 0; i < pad_right; ++i)
+        *row_buf++= right_pixel;
+
+    // write the right-side border.
+    uint32_t right_border= sample_border(config, right_edge);
+    for (size_t i = 0; i < config->BorderSize; ++i)
+        *row_buf++= right_border;
+}
+
+/// @summary Reads one row of pixels for a tile from the source image, applying
+/// borders to the left and right edges, and padding to the right edge, for
+/// rows that are part of the top and bottom borders of the image.
+/// @param row_buf A buffer capable of holding one row of pixels in the tile.
+/// @param row_num The number of pixels in a single row of the tile.
+/// @param src_row Pointer to the first pixel in the source image to copy, in
+/// the source format.
+/// @param src_num The number of pixels to copy from the source image.
+/// @param pad_right The number of pixels of padding to apply to the right side
+/// of the row, if the tile extends past the right edge of the source image.
+/// @param config The tiler configuration, specifying how to sample borders.
+static void read_row_border(
+    uint32_t       * restrict   row_buf,
+    size_t                      row_num,
+    uint8_t  const * restrict   src_row,
+    size_t                      src_num,
+    size_t                      pad_right,
+    image_tiler_config_t const *config)
+{
+    switch (config->BorderMode)
+    {
+        case BORDER_CLAMP_TO_EDGE:
+            {
+                // the standard read_row() already does the right thing.
+                read_row(row_buf, src_row, src_num, pad_right, config);
+            }
+            break;
+
+        case BORDER_CONSTANT_COLOR:
+            {
+                // duplicate the constant color across the entire row.
+                for (size_t i = 0; i < row_num; ++i)
+                    *row_buf++= config->BorderColor;
+            }
+            break;
+    }
+}
+
+/// @summary Calculates the number of bytes between rows of the source image.
+/// @param config The tiler configuration.
+/// @return The source row pitch, in bytes.
+static inline size_t source_pitch(image_tiler_config_t const *config)
+{
+    if (config->SourcePitch != 0)
+        return config->SourcePitch;
+    return config->ImageWidth * source_format_size(config->SourceFormat);
+}
+
+size_t source_format_size(int32_t format)
+{
+    switch (format)
+    {
+        case SOURCE_FORMAT_RGBA8:  return 4;
+        case SOURCE_FORMAT_RGB8:   return 3;
+        case SOURCE_FORMAT_R8:     return 1;
+        case SOURCE_FORMAT_RG8:    return 2;
+        case SOURCE_FORMAT_RGBA16: return 8;
+        default: break;
+    }
+    return 0;
+}
+
+size_t tile_count(size_t *num_x, size_t *num_y, image_tiler_config_t const *config)
+{
+    size_t  borders   = (size_t)(config->BorderSize * 2);
+    float   image_w   = (float) (config->ImageWidth);
+    float   image_h   = (float) (config->ImageHeight);
+    float   tile_w    = (float) (config->TileWidth  - borders);
+    float   tile_h    = (float) (config->TileHeight - borders);
+    size_t  tiles_x   = (size_t) ceilf(image_w / tile_w);
+    size_t  tiles_y   = (size_t) ceilf(image_h / tile_h);
+    if (num_x) *num_x = tiles_x;
+    if (num_y) *num_y = tiles_y;
+    return (tiles_x   * tiles_y);
+}
+
+bool tile_alloc(image_tile_t *tile, image_tiler_config_t const *config)
+{
+    tile->SourceX         = 0;
+    tile->SourceY         = 0;
+    tile->SourceWidth     = 0;
+    tile->SourceHeight    = 0;
+    tile->TileX           = 0;
+    tile->TileY           = 0;
+    tile->TileIndex       = 0;
+    tile->TileWidth       = 0;
+    tile->TileHeight      = 0;
+    tile->BytesPerRow     = 0;
+    tile->BytesPerTile    = 0;
+    tile->Pixels          = malloc(config->TileWidth * config->TileHeight * 4);
+    return (tile->Pixels != NULL);
+}
+
+void tile_free(image_tile_t *tile)
+{
+    if (tile->Pixels != NULL)
+    {
+        free(tile->Pixels);
+        tile->Pixels  = NULL;
+    }
+}
+
+bool copy_tile(image_tile_t *tile, image_tiler_config_t const *config, size_t index)
+{
+    size_t tiles_x = 0;
+    size_t tiles_y = 0;
+    size_t tiles_n = tile_count(&tiles_x, &tiles_y, config);
+
+    if (index >= tiles_n || source_format_size(config->SourceFormat) == 0)
+        return false;
+
+    // convert index into x,y in tile space, and from there, figure
+    // out the tile bounding rectangle on the source image.
+    size_t  tile_y    = index  / tiles_x;
+    size_t  tile_x    = index  % tiles_x;
+    size_t  source_w  = config->TileWidth  - (config->BorderSize * 2); // px
+    size_t  source_h  = config->TileHeight - (config->BorderSize * 2); // px
+    size_t  source_x  = tile_x * source_w; // px
+    size_t  source_y  = tile_y * source_h; // px
+
+    // calculate the pointer to the first row of the tile on the source image.
+    size_t    pitch   = source_pitch(config);
+    uint8_t  *src_row =(uint8_t  *)config->Pixels;
+    src_row          +=(source_y * pitch);
+    src_row          +=(source_x * source_format_size(config->SourceFormat));
+
+    // calculate the pointer to the first row of the destination tile.
+    uint32_t *dst_row = (uint32_t*)tile->Pixels;
+    size_t    dst_num = config->TileWidth; // px
+    size_t    pad_right  = 0;              // px
+    size_t    pad_bottom = 0;              // rows
+
+    // calculate how much padding we have on the right/bottom edges, if any.
+    if (source_x  + source_w > config->ImageWidth)
+    {   // this tile includes data outisde of the right edge of the source.
+        size_t n  = config->ImageWidth - source_x;
+        pad_right = source_w - n;
+        source_w  = n;
+    }
+    if (source_y  + source_h > config->ImageHeight)
+    {   // this tile includes data outside of the bottom edge of the source.
+        size_t n  = config->ImageHeight - source_y;
+        pad_bottom= source_h - n;
+        source_h  = n;
+    }
+
+    // generate the top border of the tile.
+    for (size_t i = 0; i < config->BorderSize; ++i)
+    {
+        read_row_border(dst_row, dst_num, src_row, source_w, pad_right, config);
+        dst_row += dst_num;
+    }
+
+    // copy padded rows out of the source image into the tile.
+    for (size_t i = 0; i < source_h; ++i)
+    {
+        read_row(dst_row, src_row, source_w, pad_right, config);
+        src_row += pitch;
+        dst_row += dst_num;
+    }
+
+    // duplicate the last row to pad out the bottom edge.
+    uint32_t *last_row = dst_row - dst_num;
+    for (size_t i = 0; i < pad_bottom; ++i)
+    {
+        uint32_t *row = last_row;
+        for (size_t j = 0; j < dst_num; ++j)
+            *dst_row++= *row++;
+    }
+
+    // generate the bottom border of the tile. at the bottom edge of the
+    // image, clamp to the last row rather than reading past the end.
+    if (source_y + source_h >= config->ImageHeight)
+        src_row -= pitch;
+    for (size_t i = 0; i < config->BorderSize; ++i)
+    {
+        read_row_border(dst_row, dst_num, src_row, source_w, pad_right, config);
+        dst_row += dst_num;
+    }
+
+    // finally, fill out metadata in the tile record and clean up.
+    tile->SourceX       = source_x;
+    tile->SourceY       = source_y;
+    tile->SourceWidth   = source_w;
+    tile->SourceHeight  = source_h;
+    tile->TileX         = tile_x;
+    tile->TileY         = tile_y;
+    tile->TileIndex     = index;
+    tile->TileWidth     = config->TileWidth;
+    tile->TileHeight    = config->TileHeight;
+    tile->BytesPerRow   = config->TileWidth  * 4;
+    tile->BytesPerTile  = config->TileWidth * config->TileHeight * 4;
+    return true;
+}
+
+bool view_tile(image_tile_t *tile, image_tiler_config_t const *config, size_t index)
+{
+    size_t tiles_x = 0;
+    size_t tiles_y = 0;
+    size_t tiles_n = tile_count(&tiles_x, &tiles_y, config);
+
+    // a border is always generated from the edge pixels of the tile itself,
+    // so only unbordered tiles can be read in place, and only in RGBA8.
+    if (index >= tiles_n || config->BorderSize != 0 || config->SourceFormat != SOURCE_FORMAT_RGBA8)
+        return false;
+
+    size_t  tile_y    = index  / tiles_x;
+    size_t  tile_x    = index  % tiles_x;
+    size_t  source_w  = config->TileWidth;  // px
+    size_t  source_h  = config->TileHeight; // px
+    size_t  source_x  = tile_x * source_w;  // px
+    size_t  source_y  = tile_y * source_h;  // px
+
+    // tiles that extend past the right or bottom edge need padding.
+    if (source_x + source_w > config->ImageWidth || source_y + source_h > config->ImageHeight)
+        return false;
+
+    size_t    pitch   = source_pitch(config);
+    uint8_t  *src_row =(uint8_t  *)config->Pixels;
+    src_row          +=(source_y * pitch);
+    src_row          +=(source_x * 4);
+
+    tile->SourceX       = source_x;
+    tile->SourceY       = source_y;
+    tile->SourceWidth   = source_w;
+    tile->SourceHeight  = source_h;
+    tile->TileX         = tile_x;
+    tile->TileY         = tile_y;
+    tile->TileIndex     = index;
+    tile->TileWidth     = config->TileWidth;
+    tile->TileHeight    = config->TileHeight;
+    tile->BytesPerRow   = pitch;
+    tile->BytesPerTile  = config->TileWidth  * config->TileHeight * 4;
+    tile->Pixels        = src_row;
+    return true;
+}
+
+uint64_t tile_hash(image_tile_t const *tile)
+{
+    uint32_t       lanes[TileHashLanes];
+    uint8_t const *row = (uint8_t const*) tile->Pixels;
+    uint64_t       h   = ((uint64_t) tile->TileWidth << 32) | (uint64_t) tile->TileHeight;
+    for (size_t i = 0; i < TileHashLanes; ++i)
+        lanes[i] = TileHashPrime1 * (uint32_t) (i + 1);
+    for (size_t y = 0; y < tile->TileHeight; ++y, row += tile->BytesPerRow)
+        Kernels.hash_row(lanes, row, tile->TileWidth);
+    // fold the lanes into 64 bits, mixing after each one.
+    for (size_t i = 0; i < TileHashLanes; ++i)
+    {
+        h ^= lanes[i];
+        h *= 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+/// @summary Stores the sort key of one tile while a tile_layout_t is built.
+struct tile_layout_key_t
+{
+    uint64_t Key;            /// The distance of the tile along the curve
+    uint32_t Tile;           /// The raster index of the tile
+};
+
+/// @summary Computes the distance of a cell along a Z-order curve by
+/// interleaving the bits of its coordinates, x in the even bits.
+/// @param x The column of the cell.
+/// @param y The row of the cell.
+/// @return The distance along the curve.
+static inline uint64_t morton_key(uint32_t x, uint32_t y)
+{
+    uint64_t a = x;
+    uint64_t b = y;
+    a = (a | (a << 16)) & 0x0000FFFF0000FFFFULL;
+    a = (a | (a <<  8)) & 0x00FF00FF00FF00FFULL;
+    a = (a | (a <<  4)) & 0x0F0F0F0F0F0F0F0FULL;
+    a = (a | (a <<  2)) & 0x3333333333333333ULL;
+    a = (a | (a <<  1)) & 0x5555555555555555ULL;
+    b = (b | (b << 16)) & 0x0000FFFF0000FFFFULL;
+    b = (b | (b <<  8)) & 0x00FF00FF00FF00FFULL;
+    b = (b | (b <<  4)) & 0x0F0F0F0F0F0F0F0FULL;
+    b = (b | (b <<  2)) & 0x3333333333333333ULL;
+    b = (b | (b <<  1)) & 0x5555555555555555ULL;
+    return a | (b << 1);
+}
+
+/// @summary Computes the distance of a cell along a Hilbert curve that fills
+/// a square grid, starting at (0, 0). The quadrants are visited in the same
+/// order for every grid size, so a larger grid only extends the curve.
+/// @param x The column of the cell.
+/// @param y The row of the cell.
+/// @param bits The base-2 logarithm of the grid dimension, at most 32.
+/// @return The distance along the curve.
+static uint64_t hilbert_key(uint32_t x, uint32_t y, uint32_t bits)
+{
+    uint64_t d = 0;
+    for (uint32_t s = (bits > 0) ? (uint32_t) (1ULL << (bits - 1)) : 0; s > 0; s >>= 1)
+    {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        d += (uint64_t) s * s * ((3 * rx) ^ ry);
+        // rotate the quadrant so the sub-curve starts and ends at the right
+        // corners; only the bits below s are used from here on.
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            uint32_t t = x; x = y; y = t;
+        }
+    }
+    return d;
+}
+
+/// @summary Orders the keys of a tile_layout_t by distance along the curve.
+static int compare_tile_layout_keys(void const *a, void const *b)
+{
+    tile_layout_key_t const *ka = (tile_layout_key_t const*) a;
+    tile_layout_key_t const *kb = (tile_layout_key_t const*) b;
+    if (ka->Key != kb->Key) return (ka->Key < kb->Key) ? -1 : 1;
+    return 0;
+}
+
+bool tile_layout_init(tile_layout_t *layout, image_tiler_config_t const *config, size_t level_count, int32_t order)
+{
+    memset(layout, 0, sizeof(tile_layout_t));
+    if (level_count < 1 || config->ImageWidth == 0 || config->ImageHeight == 0)
+        return false;
+    if (config->TileWidth <= config->BorderSize * 2 || config->TileHeight <= config->BorderSize * 2)
+        return false;
+    if (order != TILE_ORDER_ROW_MAJOR && order != TILE_ORDER_MORTON && order != TILE_ORDER_HILBERT)
+        return false;
+
+    layout->Order      = order;
+    layout->LevelCount = level_count;
+    layout->TilesX     = (size_t*) malloc(level_count * sizeof(size_t));
+    layout->TilesY     = (size_t*) malloc(level_count * sizeof(size_t));
+    layout->LevelBase  = (size_t*) malloc(level_count * sizeof(size_t));
+    if (layout->TilesX == NULL || layout->TilesY == NULL || layout->LevelBase == NULL)
+    {
+        tile_layout_free(layout);
+        return false;
+    }
+
+    image_tiler_config_t level = *config;
+    size_t               count = 0;
+    for (size_t i = 0; i < level_count; ++i)
+    {
+        layout->LevelBase[i] = count;
+        count += tile_count(&layout->TilesX[i], &layout->TilesY[i], &level);
+        level.ImageWidth     = (level.ImageWidth  > 1) ? level.ImageWidth  / 2 : 1;
+        level.ImageHeight    = (level.ImageHeight > 1) ? level.ImageHeight / 2 : 1;
+    }
+    layout->PageCount  = count;
+    layout->PageOfTile = (uint32_t*) ((count <= 0xFFFFFFFFU) ? malloc(count * sizeof(uint32_t)) : NULL);
+    layout->TileOfPage = (uint32_t*) ((count <= 0xFFFFFFFFU) ? malloc(count * sizeof(uint32_t)) : NULL);
+    if (layout->PageOfTile == NULL || layout->TileOfPage == NULL)
+    {
+        tile_layout_free(layout);
+        return false;
+    }
+
+    if (order == TILE_ORDER_ROW_MAJOR)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            layout->PageOfTile[i] = (uint32_t) i;
+            layout->TileOfPage[i] = (uint32_t) i;
+        }
+        return true;
+    }
+
+    // curve distances are unique within a level, so sorting each level by
+    // them gives its order. both curves visit every aligned block of the
+    // grid as one run, so a region needs about one run per block it touches.
+    tile_layout_key_t *keys = (tile_layout_key_t*) malloc(layout->TilesX[0] * layout->TilesY[0] * sizeof(tile_layout_key_t));
+    if (keys == NULL)
+    {
+        tile_layout_free(layout);
+        return false;
+    }
+    for (size_t i = 0; i < level_count; ++i)
+    {
+        size_t   base = layout->LevelBase[i];
+        size_t   span = layout->TilesX[i] > layout->TilesY[i] ? layout->TilesX[i] : layout->TilesY[i];
+        size_t   n    = layout->TilesX[i] * layout->TilesY[i];
+        uint32_t bits = 0;
+        while (bits < 32 && ((size_t) 1 << bits) < span)
+            bits++;
+        for (size_t j = 0; j < n; ++j)
+        {
+            uint32_t x = (uint32_t) (j % layout->TilesX[i]);
+            uint32_t y = (uint32_t) (j / layout->TilesX[i]);
+            keys[j].Key  = (order == TILE_ORDER_MORTON) ? morton_key(x, y) : hilbert_key(x, y, bits);
+            keys[j].Tile = (uint32_t) (base + j);
+        }
+        qsort(keys, n, sizeof(tile_layout_key_t), compare_tile_layout_keys);
+        for (size_t j = 0; j < n; ++j)
+        {
+            layout->TileOfPage[base + j] = keys[j].Tile;
+            layout->PageOfTile[keys[j].Tile] = (uint32_t) (base + j);
+        }
+    }
+    free(keys);
+    return true;
+}
+
+void tile_layout_free(tile_layout_t *layout)
+{
+    free(layout->TileOfPage);
+    free(layout->PageOfTile);
+    free(layout->LevelBase);
+    free(layout->TilesY);
+    free(layout->TilesX);
+    layout->TileOfPage = NULL;
+    layout->PageOfTile = NULL;
+    layout->LevelBase  = NULL;
+    layout->TilesY     = NULL;
+    layout->TilesX     = NULL;
+    layout->PageCount  = 0;
+    layout->LevelCount = 0;
+}
+
+size_t tile_page_index(tile_layout_t const *layout, size_t tile_x, size_t tile_y, size_t level)
+{
+    if (level >= layout->LevelCount || tile_x >= layout->TilesX[level] || tile_y >= layout->TilesY[level])
+        return layout->PageCount;
+    return layout->PageOfTile[layout->LevelBase[level] + tile_y * layout->TilesX[level] + tile_x];
+}
+
+bool tile_page_position(tile_layout_t const *layout, size_t page, size_t *tile_x, size_t *tile_y, size_t *level)
+{
+    if (page >= layout->PageCount)
+        return false;
+
+    size_t tile = layout->TileOfPage[page];
+    size_t l    = layout->LevelCount - 1;
+    while (layout->LevelBase[l] > tile)
+        l--;
+    tile -= layout->LevelBase[l];
+    if (tile_x) *tile_x = tile % layout->TilesX[l];
+    if (tile_y) *tile_y = tile / layout->TilesX[l];
+    if (level)  *level  = l;
+    return true;
+}
+
+void quantization_table(
+    int16_t       * restrict Q,
+    int16_t const * restrict Qbase,
+    int                      quality)
+{
+    if (quality < 1)   quality =  1;
+    if (quality > 100) quality =  100;
+    int16_t q = (quality < 50) ? (5000 / quality) : (200 - quality * 2);
+    for (size_t i = 0; i < 64; ++i)
+    {
+        int16_t c = (Qbase[i] * q + 50) / 100;
+        *Q++      =  qmin(qmax (c,   1),  255);
+    }
+}
+
+void quantization_table_luma(int16_t *Qluma, int32_t quality)
+{
+    quantization_table(Qluma, JPEGLumaQuant, quality);
+}
+
+void quantization_table_chroma(int16_t *Qchroma, int32_t quality)
+{
+    quantization_table(Qchroma, JPEGChromaQuant, quality);
+}
+
+void quantization_table_scale(
+    float         * restrict Qidct,
+    float         * restrict Qfdct,
+    int16_t const * restrict Qbase)
+{
+    float  CSFtable[64];
+    csf_from_qtable(CSFtable, Qbase);
+    scaled_qtable_float(Qidct, Qfdct, CSFtable);
+}
+
+void quantization_table_scale(
+    int16_t       * restrict Qidct,
+    int16_t       * restrict Qfdct,
+    int16_t const * restrict Qbase)
+{
+    scaled_qtable_int16(Qidct, Qfdct, Qbase);
+}
+
+void qtables_encode(float * restrict Qluma, float * restrict Qchroma, int quality)
+{
+    int16_t Qbase_y[64]; // base quantization table for the luma channel.
+    int16_t Qbase_c[64]; // base quantization table for the chroma channel.
+    float   Qidct_x[64]; // discarded; not used during encode/FDCT.
+    quantization_table_luma  (Qbase_y, quality);
+    quantization_table_chroma(Qbase_c, quality);
+    quantization_table_scale (Qidct_x, Qluma, Qbase_y);
+    quantization_table_scale (Qidct_x, Qchroma, Qbase_c);
+}
+
+void qtables_encode(int16_t * restrict Qluma, int16_t * restrict Qchroma, int quality)
+{
+    quant_context_t const *ctx = quant_context(quality);
+    memcpy(Qluma,   ctx->Luma.Qfdct,   64 * sizeof(int16_t));
+    memcpy(Qchroma, ctx->Chroma.Qfdct, 64 * sizeof(int16_t));
+}
+
+void qtables_decode(float * restrict Qluma, float * restrict Qchroma, int quality)
+{
+    int16_t Qbase_y[64]; // base quantization table for the luma channel.
+    int16_t Qbase_c[64]; // base quantization table for the chroma channel.
+    float   Qfdct_x[64]; // discarded; not used during decode/IDCT.
+    quantization_table_luma  (Qbase_y, quality);
+    quantization_table_chroma(Qbase_c, quality);
+    quantization_table_scale (Qluma,   Qfdct_x, Qbase_y);
+    quantization_table_scale (Qchroma, Qfdct_x, Qbase_c);
+}
+
+void qtables_decode(int16_t * restrict Qluma, int16_t * restrict Qchroma, int quality)
+{
+    quant_context_t const *ctx = quant_context(quality);
+    memcpy(Qluma,   ctx->Luma.Qidct,   64 * sizeof(int16_t));
+    memcpy(Qchroma, ctx->Chroma.Qidct, 64 * sizeof(int16_t));
+}
+
+void quant_context_init(quant_context_t *ctx, int quality)
+{
+    int16_t Qbase_y[64]; // base quantization table for the luma channel.
+    int16_t Qbase_c[64]; // base quantization table for the chroma channel.
+    int16_t Qidct_y[64], Qfdct_y[64];
+    int16_t Qidct_c[64], Qfdct_c[64];
+    if (quality < 1)   quality =  1;
+    if (quality > 100) quality =  100;
+    quantization_table_luma  (Qbase_y, quality);
+    quantization_table_chroma(Qbase_c, quality);
+    quantization_table_scale (Qidct_y, Qfdct_y, Qbase_y);
+    quantization_table_scale (Qidct_c, Qfdct_c, Qbase_c);
+    reciprocal_qtable_int16  (&ctx->Luma,   Qidct_y, Qfdct_y);
+    reciprocal_qtable_int16  (&ctx->Chroma, Qidct_c, Qfdct_c);
+    ctx->Quality = quality;
+}
+
+quant_context_t const* quant_context(int quality)
+{
+    // the cache is a function-local static so that it is built exactly once,
+    // on first use, even when first called from another static constructor
+    // or from several threads at the same time.
+    static struct quant_cache_t
+    {
+        quant_context_t Levels[100];
+        quant_cache_t(void)
+        {
+            for (int i = 0; i < 100; ++i)
+                quant_context_init(&Levels[i], i + 1);
+        }
+    } Cache;
+    if (quality < 1)   quality =  1;
+    if (quality > 100) quality =  100;
+    return &Cache.Levels[quality - 1];
+}
+
+void quantize8x8i(int16_t *coeff, int quality, bool chroma)
+{
+    fixed_quantizer_t const *F = fixed_quantizer(quality);
+    if (F != NULL)
+    {
+        if (chroma) F->Chroma(coeff);
+        else        F->Luma(coeff);
+        return;
+    }
+    quant_context_t const *Q = quant_context(quality);
+    quantize8x8_base(coeff, chroma ? &Q->Chroma : &Q->Luma);
+}
+
+int32_t cpu_isa_supported(void)
+{
+    uint32_t r[4];
+    uint32_t xcr0;
+    if (!cpuid(r, 1, 0) || (r[3] & (1U << 26)) == 0)
+        return CPU_ISA_SCALAR;           // no SSE2
+    if ((r[2] & (1U << 27)) == 0)
+        return CPU_ISA_SSE2;             // no OSXSAVE; xgetbv unavailable
+    if (((xcr0 = xgetbv0()) & 0x06) != 0x06)
+        return CPU_ISA_SSE2;             // OS does not save YMM state
+    if (!cpuid(r, 7, 0) || (r[1] & (1U << 5)) == 0)
+        return CPU_ISA_SSE2;             // no AVX2
+    if ((r[1] & (1U << 16)) == 0 || (xcr0 & 0xE6) != 0xE6)
+        return CPU_ISA_AVX2;             // no AVX-512F or no ZMM state
+    return CPU_ISA_AVX512;
+}
+
+#if IM_ENABLE_AVX2
+/// @summary Determines whether the host CPU supports the FMA3 instructions
+/// used by the float kernels. Every AVX2 CPU to date also supports FMA3, but
+/// the two are reported separately.
+/// @return true if FMA3 is supported.
+static bool cpu_has_fma(void)
+{
+    uint32_t r[4];
+    return cpuid(r, 1, 0) && (r[2] & (1U << 12)) != 0;
+}
+#endif
+
+int32_t select_kernels(int32_t isa)
+{
+    int32_t host = cpu_isa_supported();
+    if (isa < 0 || isa > host)
+        isa = host;
+#if !IM_ENABLE_AVX2
+    if (isa > CPU_ISA_SSE2)
+        isa = CPU_ISA_SSE2;
+#endif
+#if !IM_ENABLE_SSE2
+    isa = CPU_ISA_SCALAR;
+#endif
+
+    kernel_table_t k =
+    {
+        isa,
+        fdct8x8f_base,
+        fdct8x8i_base,
+        fdct8x8fq_base,
+        fdct8x8fq_x8_base,
+        fdct8x8iq_base,
+        fdct8x8iq_x8_base,
+        idct8x8f_base,
+        idct8x8i_base,
+        idct8x8fd_base,
+        idct8x8fd_x8_base,
+        idct8x8id_base,
+        idct8x8id_4x4_base,
+        expand_row_base,
+        hash_row_base
+    };
+#if IM_ENABLE_SSE2
+    if (isa >= CPU_ISA_SSE2)
+    {
+        k.fdct8x8iq_x8 = fdct8x8iq_x8_sse2;
+        k.idct8x8id    = idct8x8id_sse2;
+        k.idct8x8id_4x4= idct8x8id_4x4_sse2;
+        k.expand_row   = expand_row_sse2;
+        k.hash_row     = hash_row_sse2;
+    }
+#endif
+#if IM_ENABLE_AVX2
+    if (isa >= CPU_ISA_AVX2)
+    {
+        k.fdct8x8iq_x8 = fdct8x8iq_x8_avx2;
+        k.idct8x8id    = idct8x8id_avx2;
+        k.idct8x8id_4x4= idct8x8id_4x4_avx2;
+        k.expand_row   = expand_row_avx2;
+        k.hash_row     = hash_row_avx2;
+    }
+    if (isa >= CPU_ISA_AVX2 && cpu_has_fma())
+    {
+        k.fdct8x8fq_x8 = fdct8x8fq_x8_avx2;
+        k.idct8x8fd_x8 = idct8x8fd_x8_avx2;
+    }
+#endif
+    Kernels = k;
+    return isa;
+}
+
+int32_t kernel_isa(void)
+{
+    return Kernels.Isa;
+}
+
+void fdct8x8f(float * restrict dst, float const * restrict src)
+{
+    Kernels.fdct8x8f(dst, src);
+}
+
+void fdct8x8i(int16_t * restrict dst, int16_t const * restrict src)
+{
+    Kernels.fdct8x8i(dst, src);
+}
+
+void fdct8x8fq(
+    float         * restrict dst,
+    float   const * restrict src,
+    float   const * restrict Qfdct)
+{
+    Kernels.fdct8x8fq(dst, src, Qfdct);
+}
+
+void fdct8x8iq(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict Qfdct)
+{
+    Kernels.fdct8x8iq(dst, src, reciprocal_qtable_cached(Qfdct, NULL));
+}
+
+void fdct8x8iq_batch(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict Qfdct,
+    size_t                   count)
+{
+    fdct8x8iq_batch(dst, src, reciprocal_qtable_cached(Qfdct, NULL), count);
+}
+
+void fdct8x8iq_batch(
+    int16_t             * restrict dst,
+    int16_t       const * restrict src,
+    quant_table_t const * restrict Q,
+    size_t                         count)
+{
+    size_t i = 0;
+    for ( ; i + 8 <= count; i += 8)
+        Kernels.fdct8x8iq_x8(&dst[i * 64], &src[i * 64], Q);
+    for ( ; i < count; ++i)
+        Kernels.fdct8x8iq(&dst[i * 64], &src[i * 64], Q);
+}
+
+void fdct8x8fq_batch(
+    float       * restrict dst,
+    float const * restrict src,
+    float const * restrict Qfdct,
+    size_t                 count)
+{
+    size_t i = 0;
+    for ( ; i + 8 <= count; i += 8)
+        Kernels.fdct8x8fq_x8(&dst[i * 64], &src[i * 64], Qfdct);
+    for ( ; i < count; ++i)
+        Kernels.fdct8x8fq(&dst[i * 64], &src[i * 64], Qfdct);
+}
+
+void idct8x8f(float * restrict dst, float const * restrict src)
+{
+    Kernels.idct8x8f(dst, src);
+}
+
+void idct8x8i(int16_t * restrict dst, int16_t const * restrict src)
+{
+    Kernels.idct8x8i(dst, src);
+}
+
+void idct8x8fd(
+    float         * restrict dst,
+    float   const * restrict src,
+    float   const * restrict Qidct)
+{
+    Kernels.idct8x8fd(dst, src, Qidct);
+}
+
+void idct8x8fd_batch(
+    float       * restrict dst,
+    float const * restrict src,
+    float const * restrict Qidct,
+    size_t                 count)
+{
+    size_t i = 0;
+    for ( ; i + 8 <= count; i += 8)
+        Kernels.idct8x8fd_x8(&dst[i * 64], &src[i * 64], Qidct);
+    for ( ; i < count; ++i)
+        Kernels.idct8x8fd(&dst[i * 64], &src[i * 64], Qidct);
+}
+
+void idct8x8id(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict Qidct)
+{
+    idct8x8id_path(dst, src, Qidct, idct_path(src));
+}
+
+void idct8x8id_eob(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict Qidct,
+    size_t                   eob)
+{
+    // zig-zag positions [0, 10) all lie within the top-left 4x4 region.
+    int32_t path = (eob <= 1) ? IDCT_PATH_DC : ((eob <= 10) ? IDCT_PATH_4X4 : IDCT_PATH_FULL);
+    idct8x8id_path(dst, src, Qidct, path);
+}
+
+void idct_counters(idct_counters_t *counters, bool reset)
+{
+    if (counters != NULL)
+       *counters = IdctCounters;
+    if (reset)
+    {
+        IdctCounters.DcOnly    = 0;
+        IdctCounters.Sparse4x4 = 0;
+        IdctCounters.Full      = 0;
+    }
+}
+
+void encode16x16i(
+    int16_t       * restrict Y,
+    int16_t       * restrict Co,
+    int16_t       * restrict Cg,
+    uint8_t       * restrict A,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma,
+    uint8_t const * restrict RGBA)
+{
+    // the chroma lookup keeps the luma table, so neither evicts the other.
+    quant_table_t const *Ql = reciprocal_qtable_cached(Qluma, NULL);
+    quant_table_t const *Qc = reciprocal_qtable_cached(Qchroma, Ql);
+    int16_t sampY [256];
+    int16_t sampCo[64];
+    int16_t sampCg[64];
+
+    // perform colorspace conversion and split into 8x8 blocks.
+    split16x16i(sampY, sampCo, sampCg, A, RGBA, 64);
+
+    // quantize the four luma blocks and the two chroma blocks.
+    Kernels.fdct8x8iq(&Y[0],   &sampY[0],   Ql);
+    Kernels.fdct8x8iq(&Y[64],  &sampY[64],  Ql);
+    Kernels.fdct8x8iq(&Y[128], &sampY[128], Ql);
+    Kernels.fdct8x8iq(&Y[192], &sampY[192], Ql);
+    Kernels.fdct8x8iq(Co, sampCo, Qc);
+    Kernels.fdct8x8iq(Cg, sampCg, Qc);
+}
+
+void encode16x16i(
+    int16_t               * restrict Y,
+    int16_t               * restrict Co,
+    int16_t               * restrict Cg,
+    uint8_t               * restrict A,
+    quant_context_t const * restrict ctx,
+    uint8_t const         * restrict RGBA)
+{
+    int16_t sampY [256];
+    int16_t sampCo[64];
+    int16_t sampCg[64];
+
+    // perform colorspace conversion and split into 8x8 blocks.
+    split16x16i(sampY, sampCo, sampCg, A, RGBA, 64);
+
+    // quantize the four luma blocks and the two chroma blocks.
+    Kernels.fdct8x8iq(&Y[0],   &sampY[0],   &ctx->Luma);
+    Kernels.fdct8x8iq(&Y[64],  &sampY[64],  &ctx->Luma);
+    Kernels.fdct8x8iq(&Y[128], &sampY[128], &ctx->Luma);
+    Kernels.fdct8x8iq(&Y[192], &sampY[192], &ctx->Luma);
+    Kernels.fdct8x8iq(Co, sampCo, &ctx->Chroma);
+    Kernels.fdct8x8iq(Cg, sampCg, &ctx->Chroma);
+}
+
+void decode16x16i_rgb(
+    uint8_t       * restrict RGB,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma)
+{
+    decode16x16i_rgb_strided(RGB, 48, Y, Co, Cg, Qluma, Qchroma);
+}
+
+void decode16x16i_rgba(
+    uint8_t       * restrict RGBA,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    uint8_t const * restrict A,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma)
+{
+    decode16x16i_rgba_strided(RGBA, 64, Y, Co, Cg, A, Qluma, Qchroma);
+}
+
+/// @summary One row of alpha values for an opaque block, used when the
+/// caller does not supply an alpha channel.
+static uint8_t const AlphaOpaque[16] =
+{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+/// @summary Identifies where the MCU decoder gets the alpha channel of its
+/// output. The mode is a template argument, so it is resolved once per
+/// instantiation rather than once per row.
+enum mcu_alpha_e
+{
+    MCU_ALPHA_NONE       = 0, /// RGB output; there is no alpha channel.
+    MCU_ALPHA_OPAQUE     = 1, /// RGBA output with every alpha value 255.
+    MCU_ALPHA_PLANE      = 2  /// RGBA output with alpha from a 16x16 plane.
+};
+
+/// @summary Transforms a 16x16 block of quantized DCT coefficients back into
+/// RGB or RGBA pixels, writing each row of output directly into a larger
+/// destination image. The channel count and alpha mode are compile-time
+/// constants, so each instantiation contains only its own conversion loop.
+/// @param Channels The number of output channels, 3 or 4.
+/// @param AlphaMode One of mcu_alpha_e; MCU_ALPHA_NONE when Channels is 3.
+/// @param dst The destination of the top-left pixel of the 16x16 block.
+/// @param pitch The number of bytes between the start of consecutive rows in
+/// the destination.
+/// @param Y A 256-element array specifying the four 8x8 blocks of quantized
+/// DCT coefficients for the luma channel.
+/// @param Co A 64-element array specifying the 8x8 block of quantized DCT
+/// coefficients for the chroma-orange channel.
+/// @param Cg A 64-element array specifying the 8x8 block of quantized DCT
+/// coefficients for the chroma-green channel.
+/// @param A A 256-element array specifying the alpha channel. Only read when
+/// AlphaMode is MCU_ALPHA_PLANE.
+/// @param Qluma The 64 scaled quantization coefficients for the luma channel.
+/// @param Qchroma The 64 scaled quantization coefficients for the chroma
+/// channels.
+template <size_t Channels, int AlphaMode>
+static inline void decode16x16i_mcu(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    uint8_t const * restrict A,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma)
+{
+    int16_t Yd[256]; // dequantized luma blocks, in block order
+    int16_t Od[64];  // dequantized chroma-orange
+    int16_t Gd[64];  // dequantized chroma-green
+
+    // dequantize and IDCT all six blocks, taking the reduced path for
+    // DC-only and 4x4 blocks. the luma blocks are stored top-left,
+    // top-right, bottom-left, bottom-right.
+    idct8x8id_path(&Yd[0],   &Y[0],   Qluma,   idct_path(&Y[0]));
+    idct8x8id_path(&Yd[64],  &Y[64],  Qluma,   idct_path(&Y[64]));
+    idct8x8id_path(&Yd[128], &Y[128], Qluma,   idct_path(&Y[128]));
+    idct8x8id_path(&Yd[192], &Y[192], Qluma,   idct_path(&Y[192]));
+    idct8x8id_path(Od, Co, Qchroma, idct_path(Co));
+    idct8x8id_path(Gd, Cg, Qchroma, idct_path(Cg));
+
+    // convert each output row directly from the IDCT output. each
+    // chroma row covers two rows of output pixels.
+    for (size_t i = 0; i < 16; ++i)
+    {
+        int16_t const *y0 = &Yd[(i >> 3) * 128 + (i & 7) * 8];
+        int16_t const *o  = &Od[(i >> 1) * 8];
+        int16_t const *g  = &Gd[(i >> 1) * 8];
+        if (Channels == 3)
+            ycocg_row_rgb (dst, y0, y0 + 64, o, g);
+        else if (AlphaMode == MCU_ALPHA_PLANE)
+            ycocg_row_rgba(dst, y0, y0 + 64, o, g, &A[i * 16]);
+        else
+            ycocg_row_rgba(dst, y0, y0 + 64, o, g, AlphaOpaque);
+        dst += pitch;
+    }
+}
+
+void decode16x16i_rgb_strided(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma)
+{
+    decode16x16i_mcu<3, MCU_ALPHA_NONE>(dst, pitch, Y, Co, Cg, NULL, Qluma, Qchroma);
+}
+
+void decode16x16i_rgba_strided(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    uint8_t const * restrict A,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma)
+{
+    if (A != NULL) decode16x16i_mcu<4, MCU_ALPHA_PLANE >(dst, pitch, Y, Co, Cg, A,    Qluma, Qchroma);
+    else           decode16x16i_mcu<4, MCU_ALPHA_OPAQUE>(dst, pitch, Y, Co, Cg, NULL, Qluma, Qchroma);
+}
+
+/// @summary Converts an 8-bit color to the nearest RGB565 value.
+/// @param r The red component, in [0, 255].
+/// @param g The green component, in [0, 255].
+/// @param b The blue component, in [0, 255].
+/// @return The packed 16-bit color.
+static inline uint32_t rgb565(int32_t r, int32_t g, int32_t b)
+{
+    return (uint32_t) ((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+}
+
+/// @summary Expands a packed RGB565 color to 8 bits per component, as the
+/// texture hardware does.
+/// @param c The packed 16-bit color.
+/// @param rgb The three expanded components.
+static inline void rgb565_expand(uint32_t c, int32_t *rgb)
+{
+    int32_t r = (c >> 11) & 31;
+    int32_t g = (c >>  5) & 63;
+    int32_t b =  c        & 31;
+    rgb[0]    = (r << 3) | (r >> 2);
+    rgb[1]    = (g << 2) | (g >> 4);
+    rgb[2]    = (b << 3) | (b >> 2);
+}
+
+/// @summary Interleaves the bits of two 16-bit masks, so that bit i of @a lo
+/// lands in bit 2i and bit i of @a hi lands in bit 2i+1.
+/// @param lo The mask supplying the even bits.
+/// @param hi The mask supplying the odd bits.
+/// @return The 32-bit interleaved mask.
+static inline uint32_t interleave16(uint32_t lo, uint32_t hi)
+{
+    uint32_t x = lo | (hi << 16);
+    x = (x & 0xFF0000FFU) | ((x >> 8) & 0x0000FF00U) | ((x << 8) & 0x00FF0000U);
+    x = (x & 0xF00FF00FU) | ((x >> 4) & 0x00F000F0U) | ((x << 4) & 0x0F000F00U);
+    x = (x & 0xC3C3C3C3U) | ((x >> 2) & 0x0C0C0C0CU) | ((x << 2) & 0x30303030U);
+    x = (x & 0x99999999U) | ((x >> 1) & 0x22222222U) | ((x << 1) & 0x44444444U);
+    return x;
+}
+
+/// @summary Encodes the RGB components of a 4x4 block of RGBA8 pixels as a
+/// BC1 color block in four-color mode. The endpoints span the bounding box of
+/// the block, inset by 1/16 of its range, along the diagonal that matches the
+/// sign of the red-green and blue-green covariance. Each pixel selects the
+/// palette entry nearest its projection onto the endpoint axis.
+/// @param dst The 8-byte destination block.
+/// @param src The top-left pixel of the 4x4 block.
+/// @param pitch The number of bytes between rows of @a src.
+static void bc1_color_block(uint8_t * restrict dst, uint8_t const * restrict src, size_t pitch)
+{
+    int32_t  lo[3], hi[3], sum[3], sRG, sBG;
+#if IM_ENABLE_SSE2
+    __m128i const rgb  = _mm_set1_epi32(0x00FFFFFF);
+    __m128i const even = _mm_set1_epi32(0x00FF00FF);
+    __m128i const one0 = _mm_set1_epi32(0x00000001);
+    __m128i const one1 = _mm_set1_epi32(0x00010000);
+    __m128i RB[4], GA[4];
+    __m128i vmin = _mm_set1_epi8((char) 0xFF);
+    __m128i vmax = _mm_setzero_si128();
+    __m128i sR   = _mm_setzero_si128();
+    __m128i sG   = _mm_setzero_si128();
+    __m128i sB   = _mm_setzero_si128();
+    __m128i pRG  = _mm_setzero_si128();
+    __m128i pBG  = _mm_setzero_si128();
+    for (size_t i = 0; i < 4; ++i)
+    {
+        // split each row into [R, B] and [G, 0] 16-bit pairs per pixel, so
+        // that pmaddwd forms per-pixel sums, products and dot products.
+        __m128i x = _mm_and_si128(_mm_loadu_si128((__m128i const*) (src + i * pitch)), rgb);
+        vmin  = _mm_min_epu8(vmin, x);
+        vmax  = _mm_max_epu8(vmax, x);
+        RB[i] = _mm_and_si128(x, even);
+        GA[i] = _mm_and_si128(_mm_srli_epi32(x, 8), even);
+        sR    = _mm_add_epi32(sR,  _mm_madd_epi16(RB[i], one0));
+        sB    = _mm_add_epi32(sB,  _mm_madd_epi16(RB[i], one1));
+        sG    = _mm_add_epi32(sG,  GA[i]);
+        pRG   = _mm_add_epi32(pRG, _mm_madd_epi16(RB[i], GA[i]));
+        pBG   = _mm_add_epi32(pBG, _mm_madd_epi16(RB[i], _mm_slli_epi32(GA[i], 16)));
+    }
+    vmin = _mm_min_epu8(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmax = _mm_max_epu8(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmin = _mm_min_epu8(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+    vmax = _mm_max_epu8(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+    // transpose the five accumulators so that one pass of adds reduces them.
+    __m128i t0 = _mm_unpacklo_epi32(sR, sG);  // R0 G0 R1 G1
+    __m128i t1 = _mm_unpackhi_epi32(sR, sG);  // R2 G2 R3 G3
+    __m128i t2 = _mm_unpacklo_epi32(sB, pRG); // B0 P0 B1 P1
+    __m128i t3 = _mm_unpackhi_epi32(sB, pRG); // B2 P2 B3 P3
+    __m128i s0 = _mm_add_epi32(t0, t1);       // R G R G
+    __m128i s1 = _mm_add_epi32(t2, t3);       // B P B P
+    __m128i s2 = _mm_add_epi32(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+    __m128i s3 = _mm_add_epi32(pBG, _mm_shuffle_epi32(pBG, _MM_SHUFFLE(1, 0, 3, 2)));
+    uint32_t mn = (uint32_t) _mm_cvtsi128_si32(vmin);
+    uint32_t mx = (uint32_t) _mm_cvtsi128_si32(vmax);
+    int32_t  S[4];
+    _mm_storeu_si128((__m128i*) S, s2);
+    sum[0] = S[0];
+    sum[1] = S[1];
+    sum[2] = S[2];
+    sRG    = S[3];
+    sBG    = _mm_cvtsi128_si32(_mm_add_epi32(s3, _mm_shuffle_epi32(s3, _MM_SHUFFLE(2, 3, 0, 1))));
+    for (size_t c = 0; c < 3; ++c)
+    {
+        lo[c] = (mn >> (c * 8)) & 0xFF;
+        hi[c] = (mx >> (c * 8)) & 0xFF;
+    }
+#else
+    lo[0] = lo[1] = lo[2] = 255;
+    hi[0] = hi[1] = hi[2] = 0;
+    sum[0] = sum[1] = sum[2] = sRG = sBG = 0;
+    for (size_t i = 0; i < 16; ++i)
+    {
+        uint8_t const *p = src + (i >> 2) * pitch + (i & 3) * 4;
+        for (size_t c = 0; c < 3; ++c)
+        {
+            lo [c] = (p[c] < lo[c]) ? p[c] : lo[c];
+            hi [c] = (p[c] > hi[c]) ? p[c] : hi[c];
+            sum[c] += p[c];
+        }
+        sRG += p[0] * p[1];
+        sBG += p[2] * p[1];
+    }
+#endif
+
+    // inset the bounding box, then flip it onto the anti-diagonal for any
+    // component that is negatively correlated with green.
+    for (size_t c = 0; c < 3; ++c)
+    {
+        int32_t inset = (hi[c] - lo[c]) >> 4;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+    if (16 * sRG < sum[0] * sum[1]) { int32_t t = lo[0]; lo[0] = hi[0]; hi[0] = t; }
+    if (16 * sBG < sum[2] * sum[1]) { int32_t t = lo[2]; lo[2] = hi[2]; hi[2] = t; }
+
+    // four-color mode requires c0 > c1; a solid block uses c0 == c1, which
+    // selects three-color mode, and every index is zero.
+    uint32_t c0 = rgb565(hi[0], hi[1], hi[2]);
+    uint32_t c1 = rgb565(lo[0], lo[1], lo[2]);
+    uint32_t ix = 0;
+    if (c0 < c1) { uint32_t t = c0; c0 = c1; c1 = t; }
+    if (c0 != c1)
+    {
+        // a pixel's level along the axis from c1 (0) to c0 (3) is the number
+        // of midpoints its projection exceeds. everything is scaled by six
+        // to keep the midpoints integral.
+        int32_t e0[3], e1[3], d[3];
+        rgb565_expand(c0, e0);
+        rgb565_expand(c1, e1);
+        d[0] = e0[0] - e1[0];
+        d[1] = e0[1] - e1[1];
+        d[2] = e0[2] - e1[2];
+        int32_t t1   = e1[0] * d[0] + e1[1] * d[1] + e1[2] * d[2];
+        int32_t span = e0[0] * d[0] + e0[1] * d[1] + e0[2] * d[2] - t1;
+        int32_t T0   = 6 * t1 + 1 * span;
+        int32_t T1   = 6 * t1 + 3 * span;
+        int32_t T2   = 6 * t1 + 5 * span;
+        // level 3, 0, 2, 1 maps to index 0, 1, 2, 3, so bit 0 of the index
+        // is (level < 2) and bit 1 is (level == 1 || level == 2).
+#if IM_ENABLE_SSE2
+        __m128i const dRB = _mm_set1_epi32((int32_t) (((uint32_t) d[0] & 0xFFFF) | ((uint32_t) d[2] << 16)));
+        __m128i const dGA = _mm_set1_epi32((int32_t) (((uint32_t) d[1] & 0xFFFF)));
+        __m128i const vT0 = _mm_set1_epi32(T0);
+        __m128i const vT1 = _mm_set1_epi32(T1);
+        __m128i const vT2 = _mm_set1_epi32(T2);
+        __m128i b0[4], b1[4];
+        for (size_t i = 0; i < 4; ++i)
+        {
+            __m128i dot = _mm_add_epi32(_mm_madd_epi16(RB[i], dRB), _mm_madd_epi16(GA[i], dGA));
+            __m128i v6  = _mm_add_epi32(_mm_slli_epi32(dot, 2), _mm_slli_epi32(dot, 1));
+            __m128i g0  = _mm_cmpgt_epi32(v6, vT0);
+            __m128i g1  = _mm_cmpgt_epi32(v6, vT1);
+            __m128i g2  = _mm_cmpgt_epi32(v6, vT2);
+            b0[i] = g1;
+            b1[i] = _mm_andnot_si128(g2, g0);
+        }
+        __m128i m0 = _mm_packs_epi16(_mm_packs_epi32(b0[0], b0[1]), _mm_packs_epi32(b0[2], b0[3]));
+        __m128i m1 = _mm_packs_epi16(_mm_packs_epi32(b1[0], b1[1]), _mm_packs_epi32(b1[2], b1[3]));
+        ix = interleave16((uint32_t) ~_mm_movemask_epi8(m0) & 0xFFFF, (uint32_t) _mm_movemask_epi8(m1));
+#else
+        for (size_t i = 0; i < 16; ++i)
+        {
+            uint8_t const *p   = src + (i >> 2) * pitch + (i & 3) * 4;
+            int32_t        v6  = 6 * (p[0] * d[0] + p[1] * d[1] + p[2] * d[2]);
+            uint32_t       bit0 = (v6 > T1) ? 0 : 1;
+            uint32_t       bit1 = (v6 > T0 && v6 <= T2) ? 1 : 0;
+            ix |= (bit0 | (bit1 << 1)) << (i * 2);
+        }
+#endif
+    }
+    dst[0] = (uint8_t) (c0 & 0xFF);
+    dst[1] = (uint8_t) (c0 >> 8);
+    dst[2] = (uint8_t) (c1 & 0xFF);
+    dst[3] = (uint8_t) (c1 >> 8);
+    dst[4] = (uint8_t) (ix & 0xFF);
+    dst[5] = (uint8_t) (ix >> 8);
+    dst[6] = (uint8_t) (ix >> 16);
+    dst[7] = (uint8_t) (ix >> 24);
+}
+
+/// @summary Encodes the alpha components of a 4x4 block of RGBA8 pixels as a
+/// BC3 alpha block in eight-value mode, with the endpoints at the minimum and
+/// maximum alpha of the block.
+/// @param dst The 8-byte destination block.
+/// @param src The top-left pixel of the 4x4 block.
+/// @param pitch The number of bytes between rows of @a src.
+static void bc3_alpha_block(uint8_t * restrict dst, uint8_t const * restrict src, size_t pitch)
+{
+    // a value's level between a1 (0) and a0 (7) is the number of midpoints
+    // it exceeds; levels 7, 0, 6, 5, ... 1 map to indices 0, 1, 2, 3, ... 7.
+    uint8_t  ix[16];
+    int32_t  a0, a1;
+#if IM_ENABLE_SSE2
+    __m128i r0 = _mm_srli_epi32(_mm_loadu_si128((__m128i const*) (src + 0 * pitch)), 24);
+    __m128i r1 = _mm_srli_epi32(_mm_loadu_si128((__m128i const*) (src + 1 * pitch)), 24);
+    __m128i r2 = _mm_srli_epi32(_mm_loadu_si128((__m128i const*) (src + 2 * pitch)), 24);
+    __m128i r3 = _mm_srli_epi32(_mm_loadu_si128((__m128i const*) (src + 3 * pitch)), 24);
+    __m128i lo = _mm_packs_epi32(r0, r1);
+    __m128i hi = _mm_packs_epi32(r2, r3);
+    __m128i mn = _mm_min_epi16(lo, hi);
+    __m128i mx = _mm_max_epi16(lo, hi);
+    mn = _mm_min_epi16(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(1, 0, 3, 2)));
+    mx = _mm_max_epi16(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(1, 0, 3, 2)));
+    mn = _mm_min_epi16(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(2, 3, 0, 1)));
+    mx = _mm_max_epi16(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(2, 3, 0, 1)));
+    mn = _mm_min_epi16(mn, _mm_shufflelo_epi16(mn, _MM_SHUFFLE(2, 3, 0, 1)));
+    mx = _mm_max_epi16(mx, _mm_shufflelo_epi16(mx, _MM_SHUFFLE(2, 3, 0, 1)));
+    a0 = _mm_cvtsi128_si32(mx) & 0xFFFF;
+    a1 = _mm_cvtsi128_si32(mn) & 0xFFFF;
+    __m128i const k14   = _mm_set1_epi16(14);
+    __m128i const base  = _mm_set1_epi16((int16_t) a1);
+    __m128i const range = _mm_set1_epi16((int16_t) (a0 - a1));
+    __m128i const seven = _mm_set1_epi16(7);
+    __m128i const two   = _mm_set1_epi16(2);
+    __m128i const one   = _mm_set1_epi16(1);
+    __m128i vlo = _mm_mullo_epi16(_mm_sub_epi16(lo, base), k14);
+    __m128i vhi = _mm_mullo_epi16(_mm_sub_epi16(hi, base), k14);
+    __m128i Llo = _mm_setzero_si128();
+    __m128i Lhi = _mm_setzero_si128();
+    __m128i T   = range;
+    for (size_t k = 0; k < 7; ++k)
+    {   // thresholds (2k + 1) * range; the compare results are -1.
+        Llo = _mm_sub_epi16(Llo, _mm_cmpgt_epi16(vlo, T));
+        Lhi = _mm_sub_epi16(Lhi, _mm_cmpgt_epi16(vhi, T));
+        T   = _mm_add_epi16(T, _mm_add_epi16(range, range));
+    }
+    __m128i tlo = _mm_and_si128(_mm_sub_epi16(_mm_set1_epi16(8), Llo), seven);
+    __m128i thi = _mm_and_si128(_mm_sub_epi16(_mm_set1_epi16(8), Lhi), seven);
+    tlo = _mm_xor_si128(tlo, _mm_and_si128(_mm_cmpgt_epi16(two, tlo), one));
+    thi = _mm_xor_si128(thi, _mm_and_si128(_mm_cmpgt_epi16(two, thi), one));
+    _mm_storeu_si128((__m128i*) ix, _mm_packus_epi16(tlo, thi));
+#else
+    a0 = 0;
+    a1 = 255;
+    for (size_t i = 0; i < 16; ++i)
+    {
+        int32_t a = src[(i >> 2) * pitch + (i & 3) * 4 + 3];
+        a0 = (a > a0) ? a : a0;
+        a1 = (a < a1) ? a : a1;
+    }
+    for (size_t i = 0; i < 16; ++i)
+    {
+        int32_t  v = (src[(i >> 2) * pitch + (i & 3) * 4 + 3] - a1) * 14;
+        uint32_t L = 0;
+        for (int32_t k = 0; k < 7; ++k)
+            L += (v > (2 * k + 1) * (a0 - a1)) ? 1 : 0;
+        uint32_t t = (8 - L) & 7;
+        ix[i] = (uint8_t) (t ^ ((t < 2) ? 1 : 0));
+    }
+#endif
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 16; ++i)
+        bits |= (uint64_t) ix[i] << (i * 3);
+    dst[0] = (uint8_t) a0;
+    dst[1] = (uint8_t) a1;
+    for (size_t i = 0; i < 6; ++i)
+        dst[2 + i] = (uint8_t) (bits >> (i * 8));
+}
+
+size_t bc_block_size(int32_t format)
+{
+    return (format == BC_FORMAT_BC1) ? 8 : 16;
+}
+
+void compress16x16_bc(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int32_t                  format,
+    uint8_t const * restrict src,
+    size_t                   src_pitch)
+{
+    for (size_t by = 0; by < 4; ++by)
+    {
+        uint8_t       *out = dst + by * pitch;
+        uint8_t const *row = src + by * 4 * src_pitch;
+        for (size_t bx = 0; bx < 4; ++bx)
+        {
+            if (format == BC_FORMAT_BC1)
+            {
+                bc1_color_block(out, row + bx * 16, src_pitch);
+                out += 8;
+            }
+            else
+            {
+                bc3_alpha_block(out,     row + bx * 16, src_pitch);
+                bc1_color_block(out + 8, row + bx * 16, src_pitch);
+                out += 16;
+            }
+        }
+    }
+}
+
+void decode16x16i_bc(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int32_t                  format,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    uint8_t const * restrict A,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma)
+{
+    uint8_t px[1024]; // the 16x16 block in cache, as RGBA8 or scaled YCoCg
+
+    if (format != BC_FORMAT_BC3_YCOCG)
+    {
+        decode16x16i_rgba_strided(px, 64, Y, Co, Cg, A, Qluma, Qchroma);
+        compress16x16_bc(dst, pitch, format, px, 64);
+        return;
+    }
+
+    int16_t Yd[256]; // dequantized luma blocks, in block order
+    int16_t Od[64];  // dequantized chroma-orange
+    int16_t Gd[64];  // dequantized chroma-green
+    idct8x8id_path(&Yd[0],   &Y[0],   Qluma,   idct_path(&Y[0]));
+    idct8x8id_path(&Yd[64],  &Y[64],  Qluma,   idct_path(&Y[64]));
+    idct8x8id_path(&Yd[128], &Y[128], Qluma,   idct_path(&Y[128]));
+    idct8x8id_path(&Yd[192], &Y[192], Qluma,   idct_path(&Y[192]));
+    idct8x8id_path(Od, Co, Qchroma, idct_path(Co));
+    idct8x8id_path(Gd, Cg, Qchroma, idct_path(Cg));
+
+    // each 4x4 block covers 2x2 chroma samples. the chroma is stored at
+    // half the YCoCg-R scale, multiplied by the largest scale (1, 2 or 4)
+    // that keeps the block in range, so that small chroma keeps precision.
+    int16_t scale[4][4];
+    for (size_t by = 0; by < 4; ++by)
+    {
+        for (size_t bx = 0; bx < 4; ++bx)
+        {
+            int32_t m = 0;
+            for (size_t j = 0; j < 2; ++j)
+            {
+                for (size_t i = 0; i < 2; ++i)
+                {
+                    int32_t o = Od[(by * 2 + j) * 8 + bx * 2 + i];
+                    int32_t g = Gd[(by * 2 + j) * 8 + bx * 2 + i];
+                    o = (o < 0) ? -o : o;
+                    g = (g < 0) ? -g : g;
+                    m = (o > m) ? o : m;
+                    m = (g > m) ? g : m;
+                }
+            }
+            scale[by][bx] = (int16_t) ((m < 64) ? 4 : ((m < 128) ? 2 : 1));
+        }
+    }
+    for (size_t row = 0; row < 16; ++row)
+    {
+        int16_t const *y0  = &Yd[(row >> 3) * 128 + (row & 7) * 8];
+        int16_t const *co  = &Od[(row >> 1) * 8];
+        int16_t const *cg  = &Gd[(row >> 1) * 8];
+        int16_t const *sc  = scale[row >> 2];
+        uint8_t       *out = &px[row * 64];
+#if IM_ENABLE_SSE2
+        // the chroma samples and block scales are widened to one lane per
+        // pixel; packus performs the clamps.
+        __m128i const k128 = _mm_set1_epi16(128);
+        __m128i const one  = _mm_set1_epi16(1);
+        __m128i s   = _mm_loadl_epi64((__m128i const*) sc);
+        __m128i s2  = _mm_unpacklo_epi16(s, s);
+        __m128i slo = _mm_unpacklo_epi32(s2, s2);
+        __m128i shi = _mm_unpackhi_epi32(s2, s2);
+        __m128i o   = _mm_loadu_si128((__m128i const*) co);
+        __m128i g   = _mm_loadu_si128((__m128i const*) cg);
+        __m128i Rlo = _mm_add_epi16(_mm_srai_epi16(_mm_mullo_epi16(_mm_unpacklo_epi16(o, o), slo), 1), k128);
+        __m128i Rhi = _mm_add_epi16(_mm_srai_epi16(_mm_mullo_epi16(_mm_unpackhi_epi16(o, o), shi), 1), k128);
+        __m128i Glo = _mm_add_epi16(_mm_srai_epi16(_mm_mullo_epi16(_mm_unpacklo_epi16(g, g), slo), 1), k128);
+        __m128i Ghi = _mm_add_epi16(_mm_srai_epi16(_mm_mullo_epi16(_mm_unpackhi_epi16(g, g), shi), 1), k128);
+        __m128i R   = _mm_packus_epi16(Rlo, Rhi);
+        __m128i G   = _mm_packus_epi16(Glo, Ghi);
+        __m128i B   = _mm_packus_epi16(_mm_slli_epi16(_mm_sub_epi16(slo, one), 3), _mm_slli_epi16(_mm_sub_epi16(shi, one), 3));
+        __m128i A   = _mm_packus_epi16(_mm_loadu_si128((__m128i const*) y0), _mm_loadu_si128((__m128i const*) (y0 + 64)));
+        __m128i RGl = _mm_unpacklo_epi8(R, G);
+        __m128i RGh = _mm_unpackhi_epi8(R, G);
+        __m128i BAl = _mm_unpacklo_epi8(B, A);
+        __m128i BAh = _mm_unpackhi_epi8(B, A);
+        _mm_storeu_si128((__m128i*) &out[ 0], _mm_unpacklo_epi16(RGl, BAl));
+        _mm_storeu_si128((__m128i*) &out[16], _mm_unpackhi_epi16(RGl, BAl));
+        _mm_storeu_si128((__m128i*) &out[32], _mm_unpacklo_epi16(RGh, BAh));
+        _mm_storeu_si128((__m128i*) &out[48], _mm_unpackhi_epi16(RGh, BAh));
+#else
+        for (size_t x = 0; x < 16; ++x)
+        {
+            int32_t k = sc[x >> 2];
+            *out++ = clamp(((co[x >> 1] * k) >> 1) + 128);
+            *out++ = clamp(((cg[x >> 1] * k) >> 1) + 128);
+            *out++ = (uint8_t) ((k - 1) << 3);
+            *out++ = clamp((x < 8) ? y0[x] : y0[x + 56]);
+        }
+#endif
+    }
+    compress16x16_bc(dst, pitch, format, px, 64);
+}
+
+size_t coefficient_pack_bound(size_t block_count)
+{
+    // 64 pairs of one token byte and an int16 level, plus the marker.
+    return block_count * (64 * 3 + 1);
+}
+
+size_t pack_coefficients(
+    uint8_t       * restrict dst,
+    int16_t const * restrict src,
+    size_t                   block_count)
+{
+    uint8_t *out = dst;
+    for (size_t b = 0; b < block_count; ++b, src += 64)
+    {
+        // build a mask of the non-zero coefficients in zig-zag order, so
+        // that zero-runs can be skipped rather than tested individually.
+        uint64_t nz = 0;
+        for (size_t k = 0; k < 64; ++k)
+            nz |= (uint64_t) (src[ZigZag[k]] != 0) << k;
+
+        size_t next = 0;
+        while (nz != 0)
+        {
+            size_t  k     = (size_t) lowbit64(nz);
+            size_t  run   = k - next;
+            int16_t level = src[ZigZag[k]];
+            if (level >= -128 && level <= 127)
+            {
+                *out++ = (uint8_t) ((run << 2) | 1);
+                *out++ = (uint8_t) level;
+            }
+            else
+            {
+                *out++ = (uint8_t) ((run << 2) | 2);
+                *out++ = (uint8_t) ((uint16_t) level & 0xFF);
+                *out++ = (uint8_t) ((uint16_t) level >> 8);
+            }
+            nz  &= nz - 1;
+            next = k + 1;
+        }
+        *out++ = 0; // end-of-block
+    }
+    return (size_t) (out - dst);
+}
+
+size_t unpack_coefficients(
+    int16_t       * restrict dst,
+    uint8_t       * restrict eob,
+    uint8_t const * restrict src,
+    size_t                   src_size,
+    size_t                   block_count)
+{
+    uint8_t const *in  = src;
+    uint8_t const *end = src + src_size;
+    for (size_t b = 0; b < block_count; ++b, dst += 64)
+    {
+        size_t next = 0;
+        memset(dst, 0, 64 * sizeof(int16_t));
+        for ( ; ; )
+        {
+            if (in >= end)
+                return 0;
+            uint32_t token = *in++;
+            uint32_t size  = token & 3;
+            if (size == 0)
+                break;     // end-of-block
+            next += token >> 2;
+            if (next >= 64 || size == 3 || in + size > end)
+                return 0;
+            int16_t level  = (size == 1) ? (int16_t) (int8_t) in[0] : (int16_t) (in[0] | (in[1] << 8));
+            dst[ZigZag[next++]] = level;
+            in += size;
+        }
+        if (eob != NULL) eob[b] = (uint8_t) next;
+    }
+    return (size_t) (in - src);
+}
+
+/// @summary Copies the alpha channel of an MCU into four 8x8 sample blocks,
+/// stored top-left, top-right, bottom-left, bottom-right as for luma.
+/// @param S The 256-element destination sample blocks.
+/// @param A The 256-element alpha channel, in row-major order.
+static void alpha_blocks16x16(int16_t * restrict S, uint8_t const * restrict A)
+{
+    for (size_t i = 0; i < 16; ++i)
+    {
+        int16_t *s0 = &S[(i >> 3) * 128 + (i & 7) * 8];
+        for (size_t j = 0; j < 8; ++j)
+        {
+            s0[j]      = A[i * 16 + j];
+            s0[j + 64] = A[i * 16 + j + 8];
+        }
+    }
+}
+
+/// @summary Converts four 8x8 blocks of reconstructed alpha samples back into
+/// the row-major alpha channel of an MCU. The inverse of alpha_blocks16x16().
+/// @param A The 256-element destination alpha channel.
+/// @param S The 256-element sample blocks, as output by the integer IDCT.
+static void alpha_unblock16x16(uint8_t * restrict A, int16_t const * restrict S)
+{
+    for (size_t i = 0; i < 16; ++i)
+    {
+        int16_t const *s0 = &S[(i >> 3) * 128 + (i & 7) * 8];
+        for (size_t j = 0; j < 8; ++j)
+        {
+            A[i * 16 + j]     = clamp(s0[j]);
+            A[i * 16 + j + 8] = clamp(s0[j + 64]);
+        }
+    }
+}
+
+/// @summary Reconstructs the alpha channel of an MCU from the dequantized
+/// inverse DCT of its four blocks of alpha coefficients.
+/// @param A The 256-element destination alpha channel.
+/// @param C The 256-element quantized coefficients, 64 values per block.
+/// @param Qidct The 64 scaled quantization coefficients for the luma channel.
+static void alpha_idct16x16(uint8_t * restrict A, int16_t const * restrict C, int16_t const * restrict Qidct)
+{
+    int16_t S[256];
+    for (size_t b = 0; b < 4; ++b)
+        idct8x8id_path(&S[b * 64], &C[b * 64], Qidct, idct_path(&C[b * 64]));
+    alpha_unblock16x16(A, S);
+}
+
+int32_t alpha_mode16x16(uint8_t const *A, quant_table_t const *Q)
+{
+    // a single pass finds the range of the block, and whether every value
+    // is at one of the two extremes.
+#if IM_ENABLE_SSE2
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const ones = _mm_set1_epi8((char) 0xFF);
+    __m128i lo  = ones;
+    __m128i hi  = zero;
+    __m128i ext = ones;
+    for (size_t i = 0; i < 256; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((__m128i const*) &A[i]);
+        lo  = _mm_min_epu8(lo, a);
+        hi  = _mm_max_epu8(hi, a);
+        ext = _mm_and_si128(ext, _mm_or_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(a, ones)));
+    }
+    lo  = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+    hi  = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+    lo  = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+    hi  = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+    lo  = _mm_min_epu8(lo, _mm_srli_si128(lo, 2));
+    hi  = _mm_max_epu8(hi, _mm_srli_si128(hi, 2));
+    lo  = _mm_min_epu8(lo, _mm_srli_si128(lo, 1));
+    hi  = _mm_max_epu8(hi, _mm_srli_si128(hi, 1));
+    uint32_t vmin   = (uint32_t) _mm_cvtsi128_si32(lo) & 0xFF;
+    uint32_t vmax   = (uint32_t) _mm_cvtsi128_si32(hi) & 0xFF;
+    bool     binary = _mm_movemask_epi8(ext) == 0xFFFF;
+#else
+    uint32_t vmin   = 255;
+    uint32_t vmax   = 0;
+    bool     binary = true;
+    for (size_t i = 0; i < 256; ++i)
+    {
+        uint32_t a = A[i];
+        vmin   = (a < vmin) ? a : vmin;
+        vmax   = (a > vmax) ? a : vmax;
+        binary = binary && (a == 0 || a == 255);
+    }
+#endif
+    if (vmin == vmax)
+        return (vmin == 255) ? ALPHA_MODE_OPAQUE : ALPHA_MODE_CONSTANT;
+    if (binary)
+        return ALPHA_MODE_BINARY;
+    if (Q == NULL)
+        return ALPHA_MODE_RAW;
+
+    // noisy alpha can pack larger than the raw samples, and then gains
+    // nothing from being lossy.
+    int16_t S[256];
+    int16_t C[256];
+    uint8_t P[4 * (64 * 3 + 1)];
+    alpha_blocks16x16(S, A);
+    fdct8x8iq_batch(C, S, Q, 4);
+    return (pack_coefficients(P, C, 4) < 256) ? ALPHA_MODE_DCT : ALPHA_MODE_RAW;
+}
+
+size_t alpha_pack_bound(void)
+{
+    // the mode byte plus the larger of the raw and DCT-coded payloads.
+    return 1 + coefficient_pack_bound(4);
+}
+
+size_t encode_alpha16x16(
+    uint8_t             * restrict dst,
+    uint8_t const       * restrict A,
+    int32_t                        mode,
+    quant_table_t const * restrict Q)
+{
+    uint8_t *out = dst + 1;
+    switch (mode)
+    {
+        case ALPHA_MODE_OPAQUE:
+            break;
+        case ALPHA_MODE_CONSTANT:
+            *out++ = A[0];
+            break;
+        case ALPHA_MODE_BINARY:
+            for (size_t i = 0; i < 256; i += 8)
+            {
+                uint32_t bits = 0;
+                for (size_t j = 0; j < 8; ++j)
+                    bits |= (uint32_t) (A[i + j] != 0) << j;
+                *out++ = (uint8_t) bits;
+            }
+            break;
+        case ALPHA_MODE_DCT:
+            {
+                int16_t S[256];
+                int16_t C[256];
+                alpha_blocks16x16(S, A);
+                fdct8x8iq_batch(C, S, Q, 4);
+                size_t n = pack_coefficients(out, C, 4);
+                if (n < 256)
+                {
+                    out += n;
+                    break;
+                }
+            }
+            // fall through - the coefficients are larger than the samples.
+        default:
+            mode = ALPHA_MODE_RAW;
+            memcpy(out, A, 256);
+            out += 256;
+            break;
+    }
+    dst[0] = (uint8_t) mode;
+    return (size_t) (out - dst);
+}
+
+size_t decode_alpha16x16(
+    uint8_t       * restrict A,
+    uint8_t const * restrict src,
+    size_t                   src_size,
+    int16_t const * restrict Qidct)
+{
+    if (src_size == 0)
+        return 0;
+
+    uint8_t const *in    = src + 1;
+    size_t         avail = src_size - 1;
+    switch (src[0])
+    {
+        case ALPHA_MODE_OPAQUE:
+            memset(A, 0xFF, 256);
+            break;
+        case ALPHA_MODE_CONSTANT:
+            if (avail < 1)
+                return 0;
+            memset(A, *in++, 256);
+            break;
+        case ALPHA_MODE_BINARY:
+            if (avail < 32)
+                return 0;
+            for (size_t i = 0; i < 256; ++i)
+                A[i] = (uint8_t) (0 - ((in[i >> 3] >> (i & 7)) & 1));
+            in += 32;
+            break;
+        case ALPHA_MODE_DCT:
+            {
+                int16_t C[256];
+                size_t  used = unpack_coefficients(C, NULL, in, avail, 4);
+                if (used == 0)
+                    return 0;
+                alpha_idct16x16(A, C, Qidct);
+                in += used;
+            }
+            break;
+        case ALPHA_MODE_RAW:
+            if (avail < 256)
+                return 0;
+            memcpy(A, in, 256);
+            in += 256;
+            break;
+        default:
+            return 0;
+    }
+    return (size_t) (in - src);
+}
+
+size_t tile_stream_size(image_tile_t const *tile)
+{
+    if ((tile->TileWidth & 15) != 0 || (tile->TileHeight & 15) != 0)
+        return 0;
+    size_t mcus = (tile->TileWidth / 16) * (tile->TileHeight / 16);
+    return mcus * (384 * sizeof(int16_t) + 256);
+}
+
+/// @summary Converts, transforms and quantizes every MCU of a tile into the
+/// planar stream layout described by tile_stream_size().
+/// @param stream The destination buffer, of at least tile_stream_size() bytes.
+/// @param tile The source tile. TileWidth and TileHeight must be multiples of 16.
+/// @param Qluma The reciprocal quantization table for the luma plane.
+/// @param Qchroma The reciprocal quantization table for the chroma planes.
+static void encode_tile_planes(
+    void                *stream,
+    image_tile_t const  *tile,
+    quant_table_t const *Qluma,
+    quant_table_t const *Qchroma)
+{
+    size_t const GROUP = 8; // MCUs per batch; one batched FDCT per chroma plane.
+    size_t   mcu_x = tile->TileWidth / 16;
+    size_t   mcus  = mcu_x * (tile->TileHeight / 16);
+    int16_t *Y     = (int16_t*) stream;
+    int16_t *Co    = Y  + mcus * 256;
+    int16_t *Cg    = Co + mcus * 64;
+    uint8_t *A     = (uint8_t*) (Cg + mcus * 64);
+    uint8_t *src   = (uint8_t*) tile->Pixels;
+    size_t   pitch = tile->BytesPerRow;
+
+    // the planar layout stores the blocks of consecutive MCUs contiguously,
+    // so each group of MCUs is split into sample blocks and then transformed
+    // with one batched FDCT call per plane.
+    int16_t  sampY [GROUP * 256];
+    int16_t  sampCo[GROUP * 64];
+    int16_t  sampCg[GROUP * 64];
+    for (size_t base = 0; base < mcus; base += GROUP)
+    {
+        size_t n = (mcus - base < GROUP) ? (mcus - base) : GROUP;
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t   mcu = base + i;
+            uint8_t *pix = src + (mcu / mcu_x) * 16 * pitch + (mcu % mcu_x) * 64;
+#if IM_ENABLE_SSE2
+            // pull in the rows of the next MCU while this one is converted.
+            if (mcu + 1 < mcus)
+            {
+                uint8_t *next = src + ((mcu + 1) / mcu_x) * 16 * pitch + ((mcu + 1) % mcu_x) * 64;
+                for (size_t row = 0; row < 16; ++row)
+                    _mm_prefetch((char const*) (next + row * pitch), _MM_HINT_T0);
+            }
+#endif
+            split16x16i(&sampY[i * 256], &sampCo[i * 64], &sampCg[i * 64], &A[mcu * 256], pix, pitch);
+        }
+        fdct8x8iq_batch(&Y [base * 256], sampY,  Qluma,   n * 4);
+        fdct8x8iq_batch(&Co[base * 64],  sampCo, Qchroma, n);
+        fdct8x8iq_batch(&Cg[base * 64],  sampCg, Qchroma, n);
+    }
+}
+
+size_t encode_tile(
+    void               *stream,
+    size_t              stream_size,
+    image_tile_t const *tile,
+    int                 quality)
+{
+    size_t nbytes = tile_stream_size(tile);
+    if (nbytes == 0 || nbytes > stream_size)
+        return 0;
+
+    quant_context_t const *Q = quant_context(quality);
+    encode_tile_planes(stream, tile, &Q->Luma, &Q->Chroma);
+    return nbytes;
+}
+
+bool decode_tile(
+    image_tile_t       *tile,
+    void const         *stream,
+    size_t              stream_size,
+    int                 quality)
+{
+    size_t nbytes = tile_stream_size(tile);
+    if (nbytes == 0 || nbytes > stream_size)
+        return false;
+
+    quant_context_t const *Q = quant_context(quality);
+
+    size_t         mcu_x = tile->TileWidth / 16;
+    size_t         mcus  = mcu_x * (tile->TileHeight / 16);
+    int16_t const *Y     = (int16_t const*) stream;
+    int16_t const *Co    = Y  + mcus * 256;
+    int16_t const *Cg    = Co + mcus * 64;
+    uint8_t const *A     = (uint8_t const*) (Cg + mcus * 64);
+    uint8_t       *dst   = (uint8_t*) tile->Pixels;
+    size_t         pitch = tile->BytesPerRow;
+    for (size_t mcu = 0; mcu < mcus; ++mcu)
+    {
+        uint8_t *pix = dst + (mcu / mcu_x) * 16 * pitch + (mcu % mcu_x) * 64;
+        decode16x16i_mcu<4, MCU_ALPHA_PLANE>(pix, pitch, &Y[mcu * 256], &Co[mcu * 64], &Cg[mcu * 64], &A[mcu * 256], Q->Luma.Qidct, Q->Chroma.Qidct);
+    }
+    return true;
+}
+
+/// @summary Retrieves the suffix count table for one statistic of one
+/// coefficient position. See tile_rate_t::Counts.
+/// @param rc The rate control state.
+/// @param plane Zero for the luma plane, one for the chroma planes, and two
+/// for DCT-coded alpha.
+/// @param stat Zero for the non-zero counts, one for the int16 level counts.
+/// @param pos The coefficient position, in natural order.
+/// @return A pointer to 256 suffix counts.
+static inline uint32_t* tile_rate_counts(tile_rate_t const *rc, size_t plane, size_t stat, size_t pos)
+{
+    return &rc->Counts[((plane * 2 + stat) * 64 + pos) * 256];
+}
+
+/// @summary The squared norm of each 1-D basis function of the integer IDCT,
+/// relative to that of the DC basis function. An error of one level in the
+/// coefficient at row r and column c of a block quantized by d adds
+/// d * d * RdoBasisGain[r] * RdoBasisGain[c] / 64 to the sum of squared
+/// errors of the decoded samples.
+static const double RdoBasisGain[8] =
+{
+    1.0, 0.736328125, 0.90625, 1.47265625, 1.0, 1.47265625, 0.90625, 0.736328125
+};
+
+/// @summary Stores the per-position parameters for rate-distortion optimized
+/// quantization with one quantization table at one lambda. See rdo_table_init().
+struct rdo_table_t
+{
+    double   Mu[64];         /// Lambda, in squared levels of the position per byte
+    int32_t  Nonzero[2][64]; /// The smallest |coefficient| given a non-zero level, by sign
+    int32_t  Wide[2][64];    /// The smallest |coefficient| given an int16 level, by sign
+};
+
+/// @summary Selects the level for one coefficient that minimizes the squared
+/// error of the decoded samples plus lambda times the packed size. Packed AC
+/// levels cost two bytes, or three if they do not fit in a signed byte, and
+/// zero-runs are free, so each coefficient is decided independently. A DC
+/// term is always stored, and costs one byte more only if it is wide. The
+/// candidates are zero, the truncated level produced by quantize8x8_base(),
+/// the next level up, and the largest single-byte level.
+/// @param x The unquantized coefficient.
+/// @param d The quantization divisor.
+/// @param mu The Lagrange multiplier, in squared levels per byte.
+/// @param dc Specify true if @a x is the DC term of its block.
+/// @return The signed quantized level.
+static inline int32_t rdo_level(int32_t x, int32_t d, double mu, bool dc)
+{
+    int32_t const lim  = (x < 0) ? 128 : 127;   // the largest single-byte magnitude
+    int32_t const top  = (x < 0) ? 32768 : 32767;
+    int32_t const a    = (x < 0) ? -x : x;
+    int32_t const l0   = a / d;
+    double  const r    = (double) a / (double) d;
+    int32_t       cand[3];
+    size_t        n    = 0;
+    int32_t       best = 0;
+    double        cost = r * r;
+    if (lim < l0) cand[n++] = lim;
+    if (l0  > 0)  cand[n++] = l0;
+    if (l0 < top) cand[n++] = l0 + 1;
+    for (size_t i = 0; i < n; ++i)
+    {
+        double e = r - (double) cand[i];
+        double b = (double) ((cand[i] > lim) ? 3 : 2) - (dc ? 2.0 : 0.0);
+        double j = e * e + mu * b;
+        if (j < cost)
+        {
+            best = cand[i];
+            cost = j;
+        }
+    }
+    return (x < 0) ? -best : best;
+}
+
+/// @summary Calculates the rate-distortion optimized quantization parameters
+/// for one quantization table. Lambda is expressed relative to the squared
+/// error of one DC step of the table, so a given value trades distortion for
+/// size consistently across quality levels. Because the decision for each
+/// coefficient grows monotonically with its magnitude, the sizes it leads to
+/// reduce to per-position thresholds, which are found by bisection.
+/// @param T The parameters to initialize.
+/// @param Q The quantization table.
+/// @param lambda The distortion, in squared DC steps, traded for each byte.
+static void rdo_table_init(rdo_table_t *T, quant_table_t const *Q, double lambda)
+{
+    double d0 = (double) Q->Qfdct[0];
+    for (size_t i = 0; i < 64; ++i)
+    {
+        double  d = (double) Q->Qfdct[i];
+        T->Mu[i]  = lambda * d0 * d0 / (RdoBasisGain[i >> 3] * RdoBasisGain[i & 7] * d * d);
+    }
+    for (size_t i = 0; i < 64; ++i)
+    {
+        for (size_t s = 0; s < 2; ++s)
+        {
+            // find the smallest magnitude in [1, 32768] given a non-zero level,
+            // and the smallest given a level that does not fit in a byte.
+            int32_t const lim = s ? 128 : 127;
+            int32_t const top = s ? 32768 : 32767;
+            for (size_t k = 0; k < 2; ++k)
+            {
+                int32_t lo = 1, hi = top + 1;
+                while (lo < hi)
+                {
+                    int32_t a = (lo + hi) / 2;
+                    int32_t l = rdo_level(s ? -a : a, Q->Qfdct[i], T->Mu[i], i == 0);
+                    int32_t m = (l < 0) ? -l : l;
+                    if (m > (k ? lim : 0)) hi = a;
+                    else                   lo = a + 1;
+                }
+                if (k == 0) T->Nonzero[s][i] = lo;
+                else        T->Wide   [s][i] = lo;
+            }
+        }
+    }
+}
+
+/// @summary Quantizes an 8x8 block of DCT coefficients in place, selecting
+/// each level as by rdo_level().
+/// @param coeff The 64-element array of coefficients to quantize.
+/// @param quant The quantization table.
+/// @param rdo The rate-distortion parameters for @a quant.
+static void quantize8x8_rdo(int16_t *coeff, quant_table_t const *quant, rdo_table_t const *rdo)
+{
+    for (size_t i = 0; i < 64; ++i)
+        coeff[i] = (int16_t) rdo_level(coeff[i], quant->Qfdct[i], rdo->Mu[i], i == 0);
+}
+
+/// @summary Calculates the packed size of the coefficient levels of a run of
+/// blocks quantized by quantize8x8_rdo(), excluding the end-of-block markers
+/// and the first byte of each DC term.
+/// @param C The unquantized coefficients.
+/// @param blocks The number of 8x8 blocks.
+/// @param rdo The rate-distortion parameters.
+/// @param dc_only Specify true to count only the DC terms.
+/// @return The packed size of the levels, in bytes.
+static size_t rdo_plane_size(int16_t const *C, size_t blocks, rdo_table_t const *rdo, bool dc_only)
 {
-    size_t  borders   = (size_t)(config->BorderSize * 2);
-    float   image_w   = (float) (config->ImageWidth);
-    float   image_h   = (float) (config->ImageHeight);
-    float   tile_w    = (float) (config->TileWidth  - borders);
-    float   tile_h    = (float) (config->TileHeight - borders);
-    size_t  tiles_x   = (size_t) ceilf(image_w / tile_w);
-    size_t  tiles_y   = (size_t) ceilf(image_h / tile_h);
-    if (num_x) *num_x = tiles_x;
-    if (num_y) *num_y = tiles_y;
-    return (tiles_x   * tiles_y);
+    size_t const n     = dc_only ? 1 : 64;
+    size_t       bytes = 0;
+    for (size_t b = 0; b < blocks; ++b, C += 64)
+    {
+        int32_t x0 = C[0];
+        bytes += (((x0 < 0) ? -x0 : x0) >= rdo->Wide[x0 < 0][0]) ? 1 : 0;
+        for (size_t i = 1; i < n; ++i)
+        {
+            int32_t x = C[i];
+            int32_t a = (x < 0) ? -x : x;
+            if (a >= rdo->Nonzero[x < 0][i])
+                bytes += (a >= rdo->Wide[x < 0][i]) ? 3 : 2;
+        }
+    }
+    return bytes;
 }
 
-bool tile_alloc(image_tile_t *tile, image_tiler_config_t const *config)
+bool tile_rate_init(tile_rate_t *rc, image_tile_t const *tile, bool lossy_alpha)
 {
-    tile->SourceX         = 0;
-    tile->SourceY         = 0;
-    tile->SourceWidth     = 0;
-    tile->SourceHeight    = 0;
-    tile->TileX           = 0;
-    tile->TileY           = 0;
-    tile->TileIndex       = 0;
-    tile->TileWidth       = 0;
-    tile->TileHeight      = 0;
-    tile->BytesPerRow     = 0;
-    tile->BytesPerTile    = 0;
-    tile->Pixels          = malloc(config->TileWidth * config->TileHeight * 4);
-    return (tile->Pixels != NULL);
+    size_t nbytes = tile_stream_size(tile);
+    size_t mcus   = (tile->TileWidth / 16) * (tile->TileHeight / 16);
+    memset(rc, 0, sizeof(tile_rate_t));
+    if (nbytes == 0)
+        return false;
+
+    rc->Stream     = (int16_t *) malloc(nbytes);
+    rc->Counts     = (uint32_t*) calloc(3 * 2 * 64 * 256, sizeof(uint32_t));
+    rc->AlphaModes = (uint8_t *) malloc(mcus);
+    if (rc->Stream == NULL || rc->Counts == NULL || rc->AlphaModes == NULL)
+    {
+        tile_rate_free(rc);
+        return false;
+    }
+
+    // transform the tile once with a divisor of one everywhere, so that the
+    // stream holds the unquantized coefficients for every quality level.
+    quant_table_t I;
+    int16_t       ones[64];
+    for (size_t i = 0; i < 64; ++i)
+        ones[i] = 1;
+    reciprocal_qtable_int16(&I, ones, ones);
+    encode_tile_planes(rc->Stream, tile, &I, &I);
+    rc->McuCount   = mcus;
+    rc->StreamSize = nbytes;
+
+    // every alpha mode except DCT has a fixed size. the DCT-coded alpha
+    // blocks are transformed once here and counted like a third plane, with
+    // the mode byte, a DC record of at least five bytes and four markers
+    // counted here.
+    // the mode is fixed before the quality is known, so DCT is chosen only
+    // where the unquantized block packs below the raw payload; quantizing
+    // never adds a level, so it then stays smaller at every quality.
+    uint8_t const *A = (uint8_t const*) (rc->Stream + mcus * 384);
+    for (size_t mcu = 0; mcu < mcus; ++mcu)
+    {
+        int32_t mode = alpha_mode16x16(&A[mcu * 256], lossy_alpha ? &I : NULL);
+        switch (mode)
+        {
+            case ALPHA_MODE_OPAQUE:   rc->AlphaSize += 1;       break;
+            case ALPHA_MODE_CONSTANT: rc->AlphaSize += 1 + 1;   break;
+            case ALPHA_MODE_BINARY:   rc->AlphaSize += 1 + 32;  break;
+            case ALPHA_MODE_DCT:      rc->AlphaSize += 1 + 9;   rc->AlphaCount++; break;
+            default:                  rc->AlphaSize += 1 + 256; break;
+        }
+        rc->AlphaModes[mcu] = (uint8_t) mode;
+    }
+    if (rc->AlphaCount > 0)
+    {
+        if ((rc->Alpha = (int16_t*) malloc(rc->AlphaCount * 256 * sizeof(int16_t))) == NULL)
+        {
+            tile_rate_free(rc);
+            return false;
+        }
+        for (size_t mcu = 0, k = 0; mcu < mcus; ++mcu)
+        {
+            int16_t S[256];
+            if (rc->AlphaModes[mcu] != ALPHA_MODE_DCT)
+                continue;
+            alpha_blocks16x16(S, &A[mcu * 256]);
+            fdct8x8iq_batch(&rc->Alpha[k++ * 256], S, &I, 4);
+        }
+    }
+
+    // a coefficient x quantized by d is non-zero when |x| >= d, and needs an
+    // int16 level when x >= 128 * d or x <= -129 * d. d is in [1, 255], so a
+    // histogram of each threshold test clamped to 255 answers either query
+    // for every divisor once it is turned into a suffix count.
+    // bin zero is never queried, so zero and small values skip the update.
+    for (size_t plane = 0; plane < 3; ++plane)
+    {
+        int16_t const *C = (plane == 0) ? rc->Stream : (plane == 1) ? rc->Stream + mcus * 256 : rc->Alpha;
+        size_t    blocks = (plane == 0) ? mcus * 4   : (plane == 1) ? mcus * 2 : rc->AlphaCount * 4;
+        uint32_t     *H0 = tile_rate_counts(rc, plane, 0, 0);
+        uint32_t     *H1 = tile_rate_counts(rc, plane, 1, 0);
+        for (size_t b = 0; b < blocks; ++b, C += 64)
+        {
+            for (size_t i = 0; i < 64; ++i)
+            {
+                int32_t  x = C[i];
+                uint32_t a = (uint32_t) ((x < 0) ? -x : x);
+                if (a == 0)
+                    continue;
+                H0[i * 256 + qmin((int32_t) a, 255)]++;
+                if (a < 128)
+                    continue;
+                uint32_t w = (x < 0) ? a / 129 : a >> 7;
+                H1[i * 256 + qmin((int32_t) w, 255)]++;
+            }
+        }
+        for (size_t stat = 0; stat < 2; ++stat)
+        {
+            for (size_t i = 0; i < 64; ++i)
+            {
+                uint32_t *H = tile_rate_counts(rc, plane, stat, i);
+                for (size_t v = 255; v > 0; --v)
+                    H[v - 1] += H[v];
+            }
+        }
+    }
+    return true;
 }
 
-void tile_free(image_tile_t *tile)
+void tile_rate_free(tile_rate_t *rc)
 {
-    if (tile->Pixels != NULL)
+    free(rc->AlphaModes);
+    free(rc->Alpha);
+    free(rc->Counts);
+    free(rc->Stream);
+    memset(rc, 0, sizeof(tile_rate_t));
+}
+
+/// @summary Calculates the size of the levels of every block of a tile at a
+/// given quality level, excluding the end-of-block markers and the first byte
+/// of each DC term.
+/// @param rc The rate control state.
+/// @param Q The quantization tables of the quality level.
+/// @param dc_only Specify true to count only the DC terms.
+/// @return The size of the levels, in bytes.
+static size_t tile_rate_levels(tile_rate_t const *rc, quant_context_t const *Q, bool dc_only)
+{
+    // each non-zero AC level costs a token byte plus one or two level bytes,
+    // and a DC term costs one more byte if its level is wide. DCT-coded alpha
+    // uses the luma table.
+    size_t bytes = 0;
+    if (rc->Lambda > 0.0f)
     {
-        free(tile->Pixels);
-        tile->Pixels  = NULL;
+        // the levels chosen by RDO do not follow from the threshold counts,
+        // so each coefficient is tested against the per-position thresholds.
+        rdo_table_t Rl, Rc;
+        rdo_table_init(&Rl, &Q->Luma,   rc->Lambda);
+        rdo_table_init(&Rc, &Q->Chroma, rc->Lambda);
+        bytes += rdo_plane_size(rc->Stream, rc->McuCount * 4, &Rl, dc_only);
+        bytes += rdo_plane_size(rc->Stream + rc->McuCount * 256, rc->McuCount * 2, &Rc, dc_only);
+        bytes += rdo_plane_size(rc->Alpha,  rc->AlphaCount * 4, &Rl, dc_only);
+        return bytes;
+    }
+    for (size_t plane = 0; plane < 3; ++plane)
+    {
+        int16_t const *D = (plane == 1) ? Q->Chroma.Qfdct : Q->Luma.Qfdct;
+        bytes += tile_rate_counts(rc, plane, 1, 0)[D[0]];
+        for (size_t i = 1; i < (dc_only ? 1U : 64U); ++i)
+        {
+            bytes += tile_rate_counts(rc, plane, 0, i)[D[i]] * 2;
+            bytes += tile_rate_counts(rc, plane, 1, i)[D[i]];
+        }
     }
+    return bytes;
 }
 
-bool copy_tile(image_tile_t *tile, image_tiler_config_t const *config, size_t index)
+size_t tile_rate_size(tile_rate_t const *rc, int quality)
 {
-    size_t tiles_x = 0;
-    size_t tiles_y = 0;
-    size_t tiles_n = tile_count(&tiles_x, &tiles_y, config);
+    // the page header, and for each MCU a wide-DC mask byte, six DC bytes and
+    // six end-of-block markers. the alpha markers are counted in AlphaSize.
+    return 4 + rc->McuCount * 13 + rc->AlphaSize + tile_rate_levels(rc, quant_context(quality), false);
+}
+
+int tile_rate_quality(tile_rate_t const *rc, size_t budget)
+{
+    for (int quality = 100; quality >= 1; --quality)
+    {
+        if (tile_rate_size(rc, quality) <= budget)
+            return quality;
+    }
+    return 0;
+}
+
+/// @summary Writes the DC terms of a run of quantized blocks as a DC record:
+/// a mask byte with bit b set if the level of block b does not fit in a
+/// signed byte, followed by each level in one byte, or two little-endian
+/// bytes if it is wide. The DC terms are then cleared, so that
+/// pack_coefficients() writes only the AC terms of the blocks.
+/// @param dst The destination buffer, of at least 1 + 2 * block_count bytes.
+/// @param blocks The quantized coefficients, 64 values per block.
+/// @param block_count The number of 8x8 blocks, at most eight.
+/// @return The number of bytes written to @a dst.
+static size_t pack_dc(uint8_t * restrict dst, int16_t * restrict blocks, size_t block_count)
+{
+    uint8_t *out  = dst + 1;
+    uint32_t wide = 0;
+    for (size_t b = 0; b < block_count; ++b)
+    {
+        int16_t level = blocks[b * 64];
+        if (level >= -128 && level <= 127)
+        {
+            *out++ = (uint8_t) level;
+        }
+        else
+        {
+            *out++ = (uint8_t) ((uint16_t) level & 0xFF);
+            *out++ = (uint8_t) ((uint16_t) level >> 8);
+            wide  |= 1U << b;
+        }
+        blocks[b * 64] = 0;
+    }
+    dst[0] = (uint8_t) wide;
+    return (size_t) (out - dst);
+}
+
+/// @summary Reads a DC record written by pack_dc().
+/// @param dc An array of block_count values receiving the quantized DC terms.
+/// @param src The DC record.
+/// @param src_size The number of bytes available at @a src.
+/// @param block_count The number of 8x8 blocks, at most eight.
+/// @return The number of bytes consumed from @a src, or zero if the record is
+/// corrupt or too short.
+static size_t unpack_dc(
+    int16_t       * restrict dc,
+    uint8_t const * restrict src,
+    size_t                   src_size,
+    size_t                   block_count)
+{
+    if (src_size == 0 || (src[0] >> block_count) != 0)
+        return 0;
+
+    uint8_t const *in   = src + 1;
+    uint8_t const *end  = src + src_size;
+    uint32_t       wide = src[0];
+    for (size_t b = 0; b < block_count; ++b)
+    {
+        size_t size = ((wide >> b) & 1) ? 2 : 1;
+        if (in + size > end)
+            return 0;
+        dc[b] = (size == 1) ? (int16_t) (int8_t) in[0] : (int16_t) (in[0] | (in[1] << 8));
+        in   += size;
+    }
+    return (size_t) (in - src);
+}
+
+size_t tile_rate_pack(
+    void              *page,
+    size_t             page_size,
+    tile_rate_t const *rc,
+    int                quality)
+{
+    size_t nbytes = tile_rate_size(rc, quality);
+    if (nbytes > page_size)
+        return 0;
+
+    // the DC section holds the header, the alpha modes and fixed payloads
+    // without the DCT alpha markers, and one DC record per MCU.
+    quant_context_t const *Q = quant_context(quality);
+    size_t         split = 4 + rc->McuCount * 7 + rc->AlphaSize - rc->AlphaCount * 4 + tile_rate_levels(rc, Q, true);
+    size_t         mcus = rc->McuCount;
+    int16_t const *Y    = rc->Stream;
+    int16_t const *Co   = Y  + mcus * 256;
+    int16_t const *Cg   = Co + mcus * 64;
+    uint8_t const *A    = (uint8_t const*) (Cg + mcus * 64);
+    uint8_t       *dc   = (uint8_t*) page + 4;
+    uint8_t       *ac   = (uint8_t*) page + split;
+    bool           rdo  = rc->Lambda > 0.0f;
+    rdo_table_t    Rl, Rc;
+    fixed_quantizer_t const *F = rdo ? NULL : fixed_quantizer(Q->Quality);
+    if (rdo)
+    {
+        rdo_table_init(&Rl, &Q->Luma,   rc->Lambda);
+        rdo_table_init(&Rc, &Q->Chroma, rc->Lambda);
+    }
+
+    // each MCU stores its alpha channel followed by its color blocks, with
+    // the DC terms split from the AC terms, so the decoder reads both
+    // sections front to back in step.
+    uint8_t *hdr = (uint8_t*) page;
+    hdr[0] = (uint8_t) (split & 0xFF);
+    hdr[1] = (uint8_t) (split >> 8);
+    hdr[2] = (uint8_t) (split >> 16);
+    hdr[3] = (uint8_t) (split >> 24);
+    for (size_t mcu = 0, k = 0; mcu < mcus; ++mcu)
+    {
+        int16_t blk[384];
+        if (rc->AlphaModes[mcu] == ALPHA_MODE_DCT)
+        {
+            memcpy(blk, &rc->Alpha[k++ * 256], 256 * sizeof(int16_t));
+            for (size_t b = 0; b < 4; ++b)
+            {
+                if (rdo)    quantize8x8_rdo (&blk[b * 64], &Q->Luma, &Rl);
+                else if (F) F->Luma(&blk[b * 64]);
+                else        quantize8x8_base(&blk[b * 64], &Q->Luma);
+            }
+            *dc++ = ALPHA_MODE_DCT;
+            dc   += pack_dc(dc, blk, 4);
+            ac   += pack_coefficients(ac, blk, 4);
+        }
+        else dc += encode_alpha16x16(dc, &A[mcu * 256], rc->AlphaModes[mcu], &Q->Luma);
+
+        memcpy(&blk[0],   &Y [mcu * 256], 256 * sizeof(int16_t));
+        memcpy(&blk[256], &Co[mcu * 64],  64  * sizeof(int16_t));
+        memcpy(&blk[320], &Cg[mcu * 64],  64  * sizeof(int16_t));
+        for (size_t b = 0; b < 6; ++b)
+        {
+            quant_table_t const *T = (b < 4) ? &Q->Luma : &Q->Chroma;
+            if (rdo)              quantize8x8_rdo (&blk[b * 64], T, (b < 4) ? &Rl : &Rc);
+            else if (F && b < 4)  F->Luma  (&blk[b * 64]);
+            else if (F)           F->Chroma(&blk[b * 64]);
+            else                  quantize8x8_base(&blk[b * 64], T);
+        }
+        dc += pack_dc(dc, blk, 6);
+        ac += pack_coefficients(ac, blk, 6);
+    }
+    return (size_t) (ac - (uint8_t*) page);
+}
+
+size_t encode_tile_budget(
+    void               *page,
+    size_t              page_size,
+    image_tile_t const *tile,
+    int                *quality)
+{
+    return encode_tile_budget_rdo(page, page_size, tile, 0.0f, quality);
+}
+
+size_t encode_tile_budget_rdo(
+    void               *page,
+    size_t              page_size,
+    image_tile_t const *tile,
+    float               lambda,
+    int                *quality)
+{
+    tile_rate_t rc;
+    size_t      nbytes = 0;
+    int         q      = 0;
+    if (tile_rate_init(&rc, tile, true))
+    {
+        rc.Lambda = lambda;
+        if ((q = tile_rate_quality(&rc, page_size)) != 0)
+            nbytes = tile_rate_pack(page, page_size, &rc, q);
+        tile_rate_free(&rc);
+    }
+    if (quality != NULL) *quality = q;
+    return nbytes;
+}
+
+/// @summary The number of page slots per thread in the reorder window of
+/// encode_image(). Workers run at most this far ahead of the emitter.
+static const size_t EncodeSlotsPerThread = 4;
+
+/// @summary The maximum number of threads used by encode_image(), including
+/// the calling thread.
+static const size_t EncodeMaxThreads     = 64;
+
+/// @summary Stores the state shared by the threads of encode_image(). All
+/// fields below Lock are protected by it.
+struct encode_shared_t
+{
+    image_tiler_config_t const *Config;   /// The source image and tiling
+    size_t                PageSize;       /// The byte budget, and the size of each slot
+    float                 Lambda;         /// The RDO quantization lambda
+    size_t                TileCount;      /// The number of tiles in the image
+    uint32_t const       *Order;          /// The tile at each position of the emission order, or NULL for row-major
+    uint32_t             *PageTable;      /// The page of each tile, or NULL if tiles are not deduplicated
+    uint64_t             *Hashes;         /// The tile_hash() of each position, when deduplicating
+    size_t               *Buckets;        /// One plus the position of each unique tile, by hash; zero if empty
+    size_t                BucketMask;     /// The number of buckets, minus one
+    size_t                Window;         /// The number of page slots
+    uint8_t              *Pages;          /// Window * PageSize bytes of page slots
+    size_t               *Sizes;          /// The encoded size of the page in each slot
+    int                  *Quality;        /// The quality level of the page in each slot
+    uint8_t              *Ready;          /// Non-zero when a slot holds its page
+    size_t               *Source;         /// The position of the tile whose page each slot stands for
+#if defined(_WIN32)
+    CRITICAL_SECTION      Lock;           /// Protects the fields that follow
+    CONDITION_VARIABLE    Wake;           /// Signaled when a slot is filled or freed
+#else
+    pthread_mutex_t       Lock;           /// Protects the fields that follow
+    pthread_cond_t        Wake;           /// Signaled when a slot is filled or freed
+#endif
+    size_t                NextClaim;      /// The position of the next tile to be encoded
+    size_t                NextEmit;       /// The position of the next tile to be passed to the callback
+    size_t                NextHashed;     /// The position of the next tile to be checked for duplicates
+    bool                  Abort;          /// Set when a tile fails or the callback stops
+};
+
+/// @summary Stores the per-thread state of encode_image(). Each thread owns
+/// its tile buffer, so no image_tile_t is shared.
+struct encode_worker_t
+{
+    encode_shared_t      *Shared;         /// The shared encoder state
+    image_tile_t          Tile;           /// The tile buffer owned by this thread
+    image_tile_t          Match;          /// The buffer for earlier tiles compared against Tile
+};
+
+static void encode_lock(encode_shared_t *s)
+{
+#if defined(_WIN32)
+    EnterCriticalSection(&s->Lock);
+#else
+    pthread_mutex_lock(&s->Lock);
+#endif
+}
+
+static void encode_unlock(encode_shared_t *s)
+{
+#if defined(_WIN32)
+    LeaveCriticalSection(&s->Lock);
+#else
+    pthread_mutex_unlock(&s->Lock);
+#endif
+}
+
+static void encode_wait(encode_shared_t *s)
+{
+#if defined(_WIN32)
+    SleepConditionVariableCS(&s->Wake, &s->Lock, INFINITE);
+#else
+    pthread_cond_wait(&s->Wake, &s->Lock);
+#endif
+}
+
+static void encode_wake(encode_shared_t *s)
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(&s->Wake);
+#else
+    pthread_cond_broadcast(&s->Wake);
+#endif
+}
+
+/// @summary Determines whether two RGBA8 tiles of the same dimensions hold
+/// exactly the same pixels. Either may be a view with a wider pitch.
+/// @param a The first tile.
+/// @param b The second tile.
+/// @return true if every pixel matches.
+static bool tiles_equal(image_tile_t const *a, image_tile_t const *b)
+{
+    uint8_t const *ra = (uint8_t const*) a->Pixels;
+    uint8_t const *rb = (uint8_t const*) b->Pixels;
+    for (size_t y = 0; y < a->TileHeight; ++y, ra += a->BytesPerRow, rb += b->BytesPerRow)
+    {
+        if (memcmp(ra, rb, a->TileWidth * 4) != 0)
+            return false;
+    }
+    return true;
+}
+
+/// @summary Finds an earlier unique tile with the same pixels as a tile, or
+/// records the tile as unique. Called once per position, in order, by the
+/// thread whose turn it is, so the table is never accessed concurrently and
+/// each duplicate refers to the first tile in emission order with its pixels.
+/// @param w The state of the calling thread.
+/// @param tile The tile at @a position.
+/// @param position The position of the tile in the emission order.
+/// @return The position of the tile whose page holds these pixels, which is
+/// @a position if the tile is unique.
+static size_t encode_image_dedup_tile(encode_worker_t *w, image_tile_t const *tile, size_t position)
+{
+    encode_shared_t *s    = w->Shared;
+    uint64_t         hash = s->Hashes[position];
+    size_t           b    = (size_t) hash & s->BucketMask;
+    for ( ; s->Buckets[b] != 0; b = (b + 1) & s->BucketMask)
+    {
+        // equal hashes are verified against the pixels of the earlier tile,
+        // so a collision costs a comparison but never merges two tiles.
+        size_t         q    = s->Buckets[b] - 1;
+        size_t         qi   = s->Order ? s->Order[q] : q;
+        image_tile_t   view;
+        image_tile_t  *prev = &view;
+        if (s->Hashes[q] != hash)
+            continue;
+        if (!view_tile(&view, s->Config, qi))
+            prev = copy_tile(&w->Match, s->Config, qi) ? &w->Match : NULL;
+        if (prev != NULL && tiles_equal(tile, prev))
+            return q;
+    }
+    s->Buckets[b] = position + 1;
+    return position;
+}
+
+/// @summary Copies and encodes one tile into its page slot. When tiles are
+/// deduplicated, a tile that matches an earlier one is not encoded; its slot
+/// records the position of the earlier tile instead. Called with the lock
+/// held; the lock is released while the tile is encoded.
+/// @param w The state of the calling thread.
+/// @param position The position of the tile in the emission order, claimed
+/// by the caller.
+static void encode_image_tile(encode_worker_t *w, size_t position)
+{
+    encode_shared_t *s      = w->Shared;
+    size_t           slot   = position % s->Window;
+    size_t           index  = s->Order ? s->Order[position] : position;
+    size_t           source = position;
+    int              q      = 0;
+    size_t           n      = 0;
+    image_tile_t     view;
+    image_tile_t    *tile   = &view;
+    encode_unlock(s);
+    // interior tiles are encoded straight from the source image; only the
+    // tiles that need borders or padding are copied.
+    if (!view_tile(&view, s->Config, index))
+        tile = copy_tile(&w->Tile, s->Config, index) ? &w->Tile : NULL;
+    if (s->PageTable != NULL)
+    {
+        // hashing runs in parallel; the duplicate check waits for the tiles
+        // before this one so that the result does not depend on scheduling.
+        // every position takes its turn, even if its tile could not be read.
+        if (tile != NULL)
+            s->Hashes[position] = tile_hash(tile);
+        encode_lock(s);
+        while (!s->Abort && s->NextHashed != position)
+            encode_wait(s);
+        bool turn = !s->Abort;
+        encode_unlock(s);
+        if (turn && tile != NULL)
+            source = encode_image_dedup_tile(w, tile, position);
+        encode_lock(s);
+        s->NextHashed++;
+        encode_wake(s);
+        encode_unlock(s);
+    }
+    if (tile != NULL && source == position)
+        n = encode_tile_budget_rdo(&s->Pages[slot * s->PageSize], s->PageSize, tile, s->Lambda, &q);
+    encode_lock(s);
+    s->Sizes  [slot] = n;
+    s->Quality[slot] = q;
+    s->Source [slot] = source;
+    s->Ready  [slot] = 1;
+    if (position == s->NextEmit)
+        encode_wake(s);
+}
+
+/// @summary Runs a worker thread of encode_image(), claiming tiles in order
+/// until none remain, and waiting whenever the reorder window is full.
+/// @param arg The encode_worker_t of the thread.
+#if defined(_WIN32)
+static unsigned __stdcall encode_image_thread(void *arg)
+#else
+static void* encode_image_thread(void *arg)
+#endif
+{
+    encode_worker_t *w = (encode_worker_t*) arg;
+    encode_shared_t *s = w->Shared;
+    encode_lock(s);
+    for ( ; ; )
+    {
+        while (!s->Abort && s->NextClaim < s->TileCount && s->NextClaim >= s->NextEmit + s->Window)
+            encode_wait(s);
+        if (s->Abort || s->NextClaim >= s->TileCount)
+            break;
+        encode_image_tile(w, s->NextClaim++);
+    }
+    encode_unlock(s);
+    return 0;
+}
 
-    if (index >= tiles_n)
+bool encode_image(
+    image_tiler_config_t const *config,
+    size_t                      page_size,
+    float                       lambda,
+    size_t                      thread_count,
+    encode_page_fn              emit,
+    void                       *context,
+    encode_stats_t             *stats)
+{
+    return encode_image_dedup(config, page_size, lambda, thread_count, NULL, emit, context, stats);
+}
+
+bool encode_image_dedup(
+    image_tiler_config_t const *config,
+    size_t                      page_size,
+    float                       lambda,
+    size_t                      thread_count,
+    uint32_t                   *page_table,
+    encode_page_fn              emit,
+    void                       *context,
+    encode_stats_t             *stats)
+{
+    encode_shared_t s;
+    encode_worker_t workers[EncodeMaxThreads];
+    tile_layout_t   layout;
+    size_t          started = 0;
+    size_t          pages   = 0;
+    size_t          dups    = 0;
+    uint64_t        bytes   = 0;
+    if (config->TileWidth % 16 != 0 || config->TileHeight % 16 != 0 || page_size == 0)
         return false;
+    if (!tile_layout_init(&layout, config, 1, config->TileOrder))
+        return false;
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > EncodeMaxThreads) thread_count = EncodeMaxThreads;
 
-    // convert index into x,y in tile space, and from there, figure
-    // out the tile bounding rectangle on the source image.
-    size_t  tile_y    = index  / tiles_x;
-    size_t  tile_x    = index  % tiles_x;
-    size_t  source_w  = config->TileWidth  - (config->BorderSize * 2); // px
-    size_t  source_h  = config->TileHeight - (config->BorderSize * 2); // px
-    size_t  source_x  = tile_x * source_w; // px
-    size_t  source_y  = tile_y * source_h; // px
+    memset(&s, 0, sizeof(s));
+    s.Config    = config;
+    s.PageSize  = page_size;
+    s.Lambda    = lambda;
+    s.TileCount = tile_count(NULL, NULL, config);
+    s.Order     = (config->TileOrder != TILE_ORDER_ROW_MAJOR) ? layout.TileOfPage : NULL;
+    s.Window    = thread_count * EncodeSlotsPerThread;
+    s.Pages     = (uint8_t*) malloc(s.Window * page_size);
+    s.Sizes     = (size_t *) calloc(s.Window, sizeof(size_t));
+    s.Quality   = (int    *) calloc(s.Window, sizeof(int));
+    s.Ready     = (uint8_t*) calloc(s.Window, sizeof(uint8_t));
+    s.Source    = (size_t *) calloc(s.Window, sizeof(size_t));
+    bool ok     = (s.Pages != NULL && s.Sizes != NULL && s.Quality != NULL && s.Ready != NULL && s.Source != NULL);
+    if (page_table != NULL)
+    {
+        // the bucket table is kept at most half full.
+        size_t nbuckets = 1;
+        while (nbuckets < s.TileCount * 2)
+            nbuckets *= 2;
+        s.PageTable  = page_table;
+        s.Hashes     = (uint64_t*) malloc(s.TileCount * sizeof(uint64_t));
+        s.Buckets    = (size_t  *) calloc(nbuckets, sizeof(size_t));
+        s.BucketMask = nbuckets - 1;
+        ok = ok && s.Hashes != NULL && s.Buckets != NULL;
+    }
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        workers[i].Shared       = &s;
+        workers[i].Match.Pixels = NULL;
+        if (!tile_alloc(&workers[i].Tile, config))
+            ok = false;
+        if (page_table != NULL && !tile_alloc(&workers[i].Match, config))
+            ok = false;
+    }
+    if (!ok)
+    {
+        for (size_t i = 0; i < thread_count; ++i)
+        {
+            tile_free(&workers[i].Match);
+            tile_free(&workers[i].Tile);
+        }
+        free(s.Buckets); free(s.Hashes);
+        free(s.Source); free(s.Ready); free(s.Quality); free(s.Sizes); free(s.Pages);
+        tile_layout_free(&layout);
+        return false;
+    }
 
-    // calculate the pointer to the first row of the tile on the source image.
-    uint32_t *src_row =(uint32_t *)config->Pixels;
-    src_row          +=(source_y * config->ImageWidth);
-    src_row          += source_x;
+#if defined(_WIN32)
+    LARGE_INTEGER freq, t0, t1;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t0);
+    InitializeCriticalSection(&s.Lock);
+    InitializeConditionVariable(&s.Wake);
+    HANDLE    threads[EncodeMaxThreads];
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        if ((threads[started + 1] = (HANDLE) _beginthreadex(NULL, 0, encode_image_thread, &workers[i], 0, NULL)) != NULL)
+            started++;
+    }
+#else
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_mutex_init(&s.Lock, NULL);
+    pthread_cond_init (&s.Wake, NULL);
+    pthread_t threads[EncodeMaxThreads];
+    for (size_t i = 1; i < thread_count; ++i)
+    {
+        if (pthread_create(&threads[started + 1], NULL, encode_image_thread, &workers[i]) == 0)
+            started++;
+    }
+#endif
 
-    // calculate the pointer to the first row of the destination tile.
-    uint32_t *dst_row = (uint32_t*)tile->Pixels;
-    size_t    dst_num = config->TileWidth; // px
-    size_t    pad_right  = 0;              // px
-    size_t    pad_bottom = 0;              // rows
+    // the calling thread passes the pages to the callback in order, and
+    // encodes tiles itself whenever the next page is not ready, so the image
+    // is still encoded if no worker thread could be started.
+    encode_lock(&s);
+    while (s.NextEmit < s.TileCount && !s.Abort)
+    {
+        size_t slot = s.NextEmit % s.Window;
+        if (s.Ready[slot] && s.Source[slot] != s.NextEmit)
+        {
+            // a duplicate shares the page of the earlier tile, which has
+            // already been emitted and entered in the page table.
+            size_t index  = s.Order ? s.Order[s.NextEmit] : s.NextEmit;
+            size_t source = s.Order ? s.Order[s.Source[slot]] : s.Source[slot];
+            page_table[index] = page_table[source];
+            dups++;
+            s.Ready[slot] = 0;
+            s.NextEmit++;
+            encode_wake(&s);
+        }
+        else if (s.Ready[slot])
+        {
+            size_t index = s.Order ? s.Order[s.NextEmit] : s.NextEmit;
+            if (page_table != NULL)
+                page_table[index] = (uint32_t) pages;
+            encode_unlock(&s);
+            bool keep = s.Sizes[slot] != 0 && emit(context, index, &s.Pages[slot * page_size], s.Sizes[slot], s.Quality[slot]);
+            bytes    += s.Sizes[slot];
+            pages++;
+            encode_lock(&s);
+            s.Ready[slot] = 0;
+            s.NextEmit++;
+            s.Abort = !keep;
+            encode_wake(&s);
+        }
+        else if (s.NextClaim < s.TileCount && s.NextClaim < s.NextEmit + s.Window)
+            encode_image_tile(&workers[0], s.NextClaim++);
+        else
+            encode_wait(&s);
+    }
+    ok = !s.Abort;
+    s.Abort = true;
+    encode_wake(&s);
+    encode_unlock(&s);
 
-    // calculate how much padding we have on the right/bottom edges, if any.
-    if (source_x  + source_w > config->ImageWidth)
-    {   // this tile includes data outisde of the right edge of the source.
-        size_t n  = config->ImageWidth - source_x;
-        pad_right = source_w - n;
-        source_w  = n;
+#if defined(_WIN32)
+    for (size_t i = 1; i <= started; ++i)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
     }
-    if (source_y  + source_h > config->ImageHeight)
-    {   // this tile includes data outside of the bottom edge of the source.
-        size_t n  = config->ImageHeight - source_y;
-        pad_bottom= source_h - n;
-        source_h  = n;
+    DeleteCriticalSection(&s.Lock);
+    QueryPerformanceCounter(&t1);
+    double seconds = (double) (t1.QuadPart - t0.QuadPart) / (double) freq.QuadPart;
+#else
+    for (size_t i = 1; i <= started; ++i)
+        pthread_join(threads[i], NULL);
+    pthread_cond_destroy (&s.Wake);
+    pthread_mutex_destroy(&s.Lock);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (double) (t1.tv_sec - t0.tv_sec) + (double) (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+#endif
+    if (stats != NULL)
+    {
+        stats->TileCount      = pages;
+        stats->DuplicateCount = dups;
+        stats->ThreadCount    = started + 1;
+        stats->PageBytes      = bytes;
+        stats->Seconds        = seconds;
+        stats->TilesPerSecond = (seconds > 0.0) ? (double) s.NextEmit / seconds : 0.0;
+    }
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        tile_free(&workers[i].Match);
+        tile_free(&workers[i].Tile);
     }
+    free(s.Buckets); free(s.Hashes);
+    free(s.Source); free(s.Ready); free(s.Quality); free(s.Sizes); free(s.Pages);
+    tile_layout_free(&layout);
+    return ok;
+}
 
-    // generate the top border of the tile.
-    for (size_t i = 0; i < config->BorderSize; ++i)
+/// @summary Stores the state of a band tiler. Each band holds the source
+/// rows of one row of tiles, plus the first row of the next band, which the
+/// bottom border of its tiles samples. All fields below Lock are protected
+/// by it.
+struct band_tiler_t
+{
+    image_tiler_config_t  Config;         /// The tiling; Pixels is unused
+    band_read_fn          Read;           /// Reads rows of the source image
+    void                 *Context;        /// Passed to Read
+    size_t                TilesX;         /// The number of tiles in each band
+    size_t                TilesY;         /// The number of bands
+    size_t                BandStep;       /// The number of source rows between bands
+    size_t                BandPitch;      /// The number of bytes per source row
+    uint8_t              *Bands[2];       /// The resident bands, by band index parity
+    size_t                BandRows[2];    /// The number of rows held by each band
+    image_tile_t          Tile;           /// The buffer for tiles that are copied
+    size_t                Band;           /// The band being tiled; owned by the caller
+    size_t                Column;         /// The next tile within Band; owned by the caller
+    bool                  Threaded;       /// Set when the reader thread is running
+#if defined(_WIN32)
+    HANDLE                Thread;         /// The reader thread
+    CRITICAL_SECTION      Lock;           /// Protects the fields that follow
+    CONDITION_VARIABLE    Wake;           /// Signaled when a band is loaded or released
+#else
+    pthread_t             Thread;         /// The reader thread
+    pthread_mutex_t       Lock;           /// Protects the fields that follow
+    pthread_cond_t        Wake;           /// Signaled when a band is loaded or released
+#endif
+    size_t                Loaded;         /// The number of bands read
+    size_t                Released;       /// The number of bands fully tiled
+    bool                  Failed;         /// Set when a read fails
+    bool                  Stop;           /// Set when the tiler is closed
+};
+
+static void band_lock(band_tiler_t *t)
+{
+#if defined(_WIN32)
+    EnterCriticalSection(&t->Lock);
+#else
+    pthread_mutex_lock(&t->Lock);
+#endif
+}
+
+static void band_unlock(band_tiler_t *t)
+{
+#if defined(_WIN32)
+    LeaveCriticalSection(&t->Lock);
+#else
+    pthread_mutex_unlock(&t->Lock);
+#endif
+}
+
+static void band_wait(band_tiler_t *t)
+{
+#if defined(_WIN32)
+    SleepConditionVariableCS(&t->Wake, &t->Lock, INFINITE);
+#else
+    pthread_cond_wait(&t->Wake, &t->Lock);
+#endif
+}
+
+static void band_wake(band_tiler_t *t)
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(&t->Wake);
+#else
+    pthread_cond_broadcast(&t->Wake);
+#endif
+}
+
+/// @summary Reads one band of the source image into its buffer and records
+/// the result. Called with the lock held; the lock is released during the read.
+/// @param t The band tiler.
+/// @param band The index of the band to read, equal to t->Loaded.
+static void band_tiler_load(band_tiler_t *t, size_t band)
+{
+    size_t first = band * t->BandStep;
+    size_t rows  = t->BandStep + 1;
+    if (rows > t->Config.ImageHeight - first)
+        rows = t->Config.ImageHeight - first;
+    band_unlock(t);
+    bool ok = t->Read(t->Context, t->Bands[band & 1], first, rows);
+    band_lock(t);
+    t->BandRows[band & 1] = rows;
+    t->Failed = t->Failed || !ok;
+    if (ok) t->Loaded++;
+    band_wake(t);
+}
+
+/// @summary Runs the reader thread of a band tiler, reading each band as
+/// soon as the band two before it has been released.
+/// @param arg The band_tiler_t.
+#if defined(_WIN32)
+static unsigned __stdcall band_tiler_thread(void *arg)
+#else
+static void* band_tiler_thread(void *arg)
+#endif
+{
+    band_tiler_t *t = (band_tiler_t*) arg;
+    band_lock(t);
+    while (!t->Stop && !t->Failed && t->Loaded < t->TilesY)
     {
-        read_row_border(dst_row, dst_num, src_row, source_w, pad_right, config);
-        dst_row += dst_num;
+        if (t->Loaded < t->Released + 2)
+            band_tiler_load(t, t->Loaded);
+        else
+            band_wait(t);
     }
+    band_unlock(t);
+    return 0;
+}
 
-    // copy padded rows out of the source image into the tile.
-    for (size_t i = 0; i < source_h; ++i)
+band_tiler_t* band_tiler_open(image_tiler_config_t const *config, band_read_fn read, void *context)
+{
+    if (source_format_size(config->SourceFormat) == 0)
+        return NULL;
+    band_tiler_t *t = (band_tiler_t*) calloc(1, sizeof(band_tiler_t));
+    if (t == NULL)
+        return NULL;
+
+    t->Config        = *config;
+    t->Read          =  read;
+    t->Context       =  context;
+    t->BandStep      =  config->TileHeight - (config->BorderSize * 2);
+    t->BandPitch     =  config->ImageWidth * source_format_size(config->SourceFormat);
+    t->Config.Pixels =  NULL;
+    t->Config.SourcePitch = t->BandPitch;
+    tile_count(&t->TilesX, &t->TilesY, config);
+    t->Bands[0]      = (uint8_t*) malloc((t->BandStep + 1) * t->BandPitch);
+    t->Bands[1]      = (uint8_t*) malloc((t->BandStep + 1) * t->BandPitch);
+    if (t->Bands[0] == NULL || t->Bands[1] == NULL || !tile_alloc(&t->Tile, config))
     {
-        read_row(dst_row, src_row, source_w, pad_right, config);
-        src_row += config->ImageWidth;
-        dst_row += dst_num;
+        tile_free(&t->Tile);
+        free(t->Bands[1]); free(t->Bands[0]);
+        free(t);
+        return NULL;
     }
 
-    // duplicate the last row to pad out the bottom edge.
-    uint32_t *last_row = dst_row - dst_num;
-    for (size_t i = 0; i < pad_bottom; ++i)
+    // if the reader thread cannot be started, bands are read on demand by
+    // band_tiler_next() instead.
+#if defined(_WIN32)
+    InitializeCriticalSection(&t->Lock);
+    InitializeConditionVariable(&t->Wake);
+    t->Thread   = (HANDLE) _beginthreadex(NULL, 0, band_tiler_thread, t, 0, NULL);
+    t->Threaded = (t->Thread != NULL);
+#else
+    pthread_mutex_init(&t->Lock, NULL);
+    pthread_cond_init (&t->Wake, NULL);
+    t->Threaded = (pthread_create(&t->Thread, NULL, band_tiler_thread, t) == 0);
+#endif
+    return t;
+}
+
+bool band_tiler_next(band_tiler_t *tiler, image_tile_t *tile)
+{
+    band_tiler_t *t = tiler;
+    band_lock(t);
+    // the previous tile may point into the current band, so the band is only
+    // released once the caller asks for the tile after its last one.
+    if (t->Column == t->TilesX)
+    {
+        t->Band++;
+        t->Column = 0;
+        t->Released++;
+        band_wake(t);
+    }
+    while (t->Band < t->TilesY && t->Loaded <= t->Band && !t->Failed)
     {
-        uint32_t *row = last_row;
-        for (size_t j = 0; j < dst_num; ++j)
-            *dst_row++= *row++;
+        if (t->Threaded) band_wait(t);
+        else band_tiler_load(t, t->Loaded);
     }
+    // bands read before a failure are still returned.
+    bool ok = (t->Band < t->TilesY && t->Loaded > t->Band);
+    band_unlock(t);
+    if (!ok)
+        return false;
 
-    // generate the bottom border of the tile.
-    for (size_t i = 0; i < config->BorderSize; ++i)
+    // tile the band as if it were the whole image; it holds the rows of one
+    // row of tiles, so the band-relative tile index is just the column.
+    image_tiler_config_t band = t->Config;
+    band.ImageHeight = t->BandRows[t->Band & 1];
+    band.Pixels      = t->Bands[t->Band & 1];
+    if (view_tile(tile, &band, t->Column))
     {
-        read_row_border(dst_row, dst_num, src_row, source_w, pad_right, config);
-        dst_row += dst_num;
+        /* empty */
     }
-
-    // finally, fill out metadata in the tile record and clean up.
-    tile->SourceX       = source_x;
-    tile->SourceY       = source_y;
-    tile->SourceWidth   = source_w;
-    tile->SourceHeight  = source_h;
-    tile->TileX         = tile_x;
-    tile->TileY         = tile_y;
-    tile->TileIndex     = index;
-    tile->TileWidth     = config->TileWidth;
-    tile->TileHeight    = config->TileHeight;
-    tile->BytesPerRow   = config->TileWidth  * 4;
-    tile->BytesPerTile  = config->TileWidth * config->TileHeight * 4;
+    else if (copy_tile(&t->Tile, &band, t->Column))
+    {
+       *tile = t->Tile;
+    }
+    else return false;
+    tile->SourceY  += t->Band * t->BandStep;
+    tile->TileY     = t->Band;
+    tile->TileIndex = t->Band * t->TilesX + t->Column;
+    t->Column++;
     return true;
 }
 
-void quantization_table(
-    int16_t       * restrict Q,
-    int16_t const * restrict Qbase,
-    int                      quality)
+bool band_tiler_close(band_tiler_t *tiler)
 {
-    if (quality < 1)   quality =  1;
-    if (quality > 100) quality =  100;
-    int16_t q = (quality < 50) ? (5000 / quality) : (200 - quality * 2);
-    for (size_t i = 0; i < 64; ++i)
+    band_tiler_t *t = tiler;
+    band_lock(t);
+    t->Stop = true;
+    band_wake(t);
+    band_unlock(t);
+#if defined(_WIN32)
+    if (t->Threaded)
     {
-        int16_t c = (Qbase[i] * q + 50) / 100;
-        *Q++      =  qmin(qmax (c,   1),  255);
+        WaitForSingleObject(t->Thread, INFINITE);
+        CloseHandle(t->Thread);
     }
+    DeleteCriticalSection(&t->Lock);
+#else
+    if (t->Threaded)
+        pthread_join(t->Thread, NULL);
+    pthread_cond_destroy (&t->Wake);
+    pthread_mutex_destroy(&t->Lock);
+#endif
+    bool ok = !t->Failed;
+    tile_free(&t->Tile);
+    free(t->Bands[1]); free(t->Bands[0]);
+    free(t);
+    return ok;
 }
 
-void quantization_table_luma(int16_t *Qluma, int32_t quality)
+size_t tile_page_dc_size(void const *page, size_t page_size)
 {
-    quantization_table(Qluma, JPEGLumaQuant, quality);
+    uint8_t const *hdr = (uint8_t const*) page;
+    if (page_size < 4)
+        return 0;
+    size_t split = (size_t) hdr[0] | ((size_t) hdr[1] << 8) | ((size_t) hdr[2] << 16) | ((size_t) hdr[3] << 24);
+    return (split >= 4) ? split : 0;
 }
 
-void quantization_table_chroma(int16_t *Qchroma, int32_t quality)
+/// @summary Reads the coefficients of a run of blocks of one MCU from the DC
+/// and AC sections of a page, advancing both.
+/// @param blk The destination coefficients, 64 values per block.
+/// @param count The number of 8x8 blocks to read, at most eight.
+/// @param dc The current position in the DC section.
+/// @param dc_end The end of the DC section.
+/// @param ac The current position in the AC section.
+/// @param ac_end The end of the AC section.
+/// @return true if the blocks were read, or false if either section is
+/// truncated or corrupt.
+static bool page_blocks(
+    int16_t        *blk,
+    size_t          count,
+    uint8_t const **dc,
+    uint8_t const  *dc_end,
+    uint8_t const **ac,
+    uint8_t const  *ac_end)
 {
-    quantization_table(Qchroma, JPEGChromaQuant, quality);
+    int16_t d[8];
+    size_t  n = unpack_dc(d, *dc, (size_t) (dc_end - *dc), count);
+    size_t  m = (n != 0) ? unpack_coefficients(blk, NULL, *ac, (size_t) (ac_end - *ac), count) : 0;
+    if (m == 0)
+        return false;
+    for (size_t b = 0; b < count; ++b)
+    {
+        if (blk[b * 64] != 0)
+            return false; // the AC section never stores a DC term.
+        blk[b * 64] = d[b];
+    }
+    *dc += n;
+    *ac += m;
+    return true;
 }
 
-void quantization_table_scale(
-    float         * restrict Qidct,
-    float         * restrict Qfdct,
-    int16_t const * restrict Qbase)
+/// @summary Decodes every MCU of a page written by tile_rate_pack() into
+/// either RGBA8 pixels or block-compressed data.
+/// @param tile The destination tile. For block-compressed output, BytesPerRow
+/// is the number of bytes between rows of 4x4 blocks.
+/// @param format One of bc_format_e, or -1 to output RGBA8 pixels.
+/// @param page The page data.
+/// @param page_size The size of the page data, in bytes.
+/// @param quality The quality level the page was encoded with.
+/// @return true if the page was decoded, or false if it is truncated or corrupt.
+static bool decode_tile_page_mcus(
+    image_tile_t       *tile,
+    int32_t             format,
+    void const         *page,
+    size_t              page_size,
+    int                 quality)
 {
-    float  CSFtable[64];
-    csf_from_qtable(CSFtable, Qbase);
-    scaled_qtable_float(Qidct, Qfdct, CSFtable);
+    size_t split = tile_page_dc_size(page, page_size);
+    if (tile_stream_size(tile) == 0 || split == 0 || split > page_size)
+        return false;
+
+    quant_context_t const *Q = quant_context(quality);
+    size_t         mcu_x  = tile->TileWidth / 16;
+    size_t         mcus   = mcu_x * (tile->TileHeight / 16);
+    uint8_t const *dc     = (uint8_t const*) page + 4;
+    uint8_t const *dc_end = (uint8_t const*) page + split;
+    uint8_t const *ac     = dc_end;
+    uint8_t const *ac_end = (uint8_t const*) page + page_size;
+    uint8_t       *dst    = (uint8_t*) tile->Pixels;
+    size_t         pitch  = tile->BytesPerRow;
+    for (size_t mcu = 0; mcu < mcus; ++mcu)
+    {
+        int16_t        blk[384];
+        uint8_t        alpha[256];
+        uint8_t const *A   = NULL; // opaque blocks skip the alpha channel.
+        size_t         used;
+        if (dc < dc_end && dc[0] == ALPHA_MODE_OPAQUE)
+        {
+            dc++;
+        }
+        else if (dc < dc_end && dc[0] == ALPHA_MODE_DCT)
+        {
+            dc++;
+            if (!page_blocks(blk, 4, &dc, dc_end, &ac, ac_end))
+                return false;
+            alpha_idct16x16(alpha, blk, Q->Luma.Qidct);
+            A = alpha;
+        }
+        else
+        {
+            if ((used = decode_alpha16x16(alpha, dc, (size_t) (dc_end - dc), Q->Luma.Qidct)) == 0)
+                return false;
+            dc += used;
+            A   = alpha;
+        }
+        if (!page_blocks(blk, 6, &dc, dc_end, &ac, ac_end))
+            return false;
+        if (format < 0)
+        {
+            uint8_t *pix = dst + (mcu / mcu_x) * 16 * pitch + (mcu % mcu_x) * 64;
+            decode16x16i_rgba_strided(pix, pitch, &blk[0], &blk[256], &blk[320], A, Q->Luma.Qidct, Q->Chroma.Qidct);
+        }
+        else
+        {
+            uint8_t *bc  = dst + (mcu / mcu_x) * 4 * pitch + (mcu % mcu_x) * 4 * bc_block_size(format);
+            decode16x16i_bc(bc, pitch, format, &blk[0], &blk[256], &blk[320], A, Q->Luma.Qidct, Q->Chroma.Qidct);
+        }
+    }
+    return (dc == dc_end);
 }
 
-void quantization_table_scale(
-    int16_t       * restrict Qidct,
-    int16_t       * restrict Qfdct,
-    int16_t const * restrict Qbase)
+bool decode_tile_page(
+    image_tile_t       *tile,
+    void const         *page,
+    size_t              page_size,
+    int                 quality)
 {
-    scaled_qtable_int16(Qidct, Qfdct, Qbase);
+    return decode_tile_page_mcus(tile, -1, page, page_size, quality);
 }
 
-void qtables_encode(float * restrict Qluma, float * restrict Qchroma, int quality)
+size_t tile_bc_size(image_tile_t const *tile, int32_t format)
 {
-    int16_t Qbase_y[64]; // base quantization table for the luma channel.
-    int16_t Qbase_c[64]; // base quantization table for the chroma channel.
-    float   Qidct_x[64]; // discarded; not used during encode/FDCT.
-    quantization_table_luma  (Qbase_y, quality);
-    quantization_table_chroma(Qbase_c, quality);
-    quantization_table_scale (Qidct_x, Qluma, Qbase_y);
-    quantization_table_scale (Qidct_x, Qchroma, Qbase_c);
+    if (tile_stream_size(tile) == 0)
+        return 0;
+    return (tile->TileWidth / 4) * (tile->TileHeight / 4) * bc_block_size(format);
 }
 
-void qtables_encode(int16_t * restrict Qluma, int16_t * restrict Qchroma, int quality)
+bool decode_tile_page_bc(
+    image_tile_t       *tile,
+    int32_t             format,
+    void const         *page,
+    size_t              page_size,
+    int                 quality)
 {
-    int16_t Qbase_y[64]; // base quantization table for the luma channel.
-    int16_t Qbase_c[64]; // base quantization table for the chroma channel.
-    int16_t Qidct_x[64]; // discarded; not used during encode/FDCT.
-    quantization_table_luma  (Qbase_y, quality);
-    quantization_table_chroma(Qbase_c, quality);
-    quantization_table_scale (Qidct_x, Qluma, Qbase_y);
-    quantization_table_scale (Qidct_x, Qchroma, Qbase_c);
+    return decode_tile_page_mcus(tile, format, page, page_size, quality);
 }
 
-void qtables_decode(float * restrict Qluma, float * restrict Qchroma, int quality)
+/// @summary The weights that sum each segment of the outputs of the 1D
+/// integer IDCT from its inputs, scaled by 16, for 1, 2 and 4 segments. The
+/// weights follow from the butterflies of idct8x8i_base() in exact
+/// arithmetic; the even inputs are shared by mirrored segments, and the odd
+/// inputs change sign.
+static int32_t const IdctSegmentSum[7][8] =
 {
-    int16_t Qbase_y[64]; // base quantization table for the luma channel.
-    int16_t Qbase_c[64]; // base quantization table for the chroma channel.
-    float   Qfdct_x[64]; // discarded; not used during decode/IDCT.
-    quantization_table_luma  (Qbase_y, quality);
-    quantization_table_chroma(Qbase_c, quality);
-    quantization_table_scale (Qluma,   Qfdct_x, Qbase_y);
-    quantization_table_scale (Qchroma, Qfdct_x, Qbase_c);
-}
+    { 128,   0,   0,   0,   0,   0,   0,   0 }, // outputs 0-7
+    {  64,  50,   0, -24,   0,  16,   0, -10 }, // outputs 0-3
+    {  64, -50,   0,  24,   0, -16,   0,  10 }, // outputs 4-7
+    {  32,  35,  28,  18,   0, -12, -12,  -7 }, // outputs 0-1
+    {  32,  15, -28, -42,   0,  28,  12,  -3 }, // outputs 2-3
+    {  32, -15, -28,  42,   0, -28,  12,   3 }, // outputs 4-5
+    {  32, -35,  28, -18,   0,  12, -12,   7 }  // outputs 6-7
+};
 
-void qtables_decode(int16_t * restrict Qluma, int16_t * restrict Qchroma, int quality)
+/// @summary Dequantizes an 8x8 block and computes the mean of each cell of an
+/// n x n grid over its inverse DCT, without performing the transform.
+/// @param dst An n * n element array receiving the means, in row-major order.
+/// @param n The grid size, 1, 2 or 4.
+/// @param src A 64-element buffer containing the quantized DCT coefficients.
+/// @param quant The scaled quantization table for the IDCT.
+static void idct8x8id_means(
+    int16_t       * restrict dst,
+    size_t                   n,
+    int16_t const * restrict src,
+    int16_t const * restrict quant)
 {
-    int16_t Qbase_y[64]; // base quantization table for the luma channel.
-    int16_t Qbase_c[64]; // base quantization table for the chroma channel.
-    int16_t Qfdct_x[64]; // discarded; not used during decode/IDCT.
-    quantization_table_luma  (Qbase_y, quality);
-    quantization_table_chroma(Qbase_c, quality);
-    quantization_table_scale (Qluma,   Qfdct_x, Qbase_y);
-    quantization_table_scale (Qchroma, Qfdct_x, Qbase_c);
+    // sum each row over the column segments, then the rows over the row
+    // segments. a cell sum is divided by its (8/n)^2 samples, the IDCT
+    // descale of 64 and the weight scale of 16 * 16.
+    int32_t const (*W)[8] = &IdctSegmentSum[n - 1];
+    int32_t const  shift  = (n == 1) ? 20 : ((n == 2) ? 18 : 16);
+    int64_t        R[8][4];
+    size_t         rows = 0; // one past the last non-zero row
+    for (size_t i = 0; i < 8; ++i)
+    {
+        int32_t x[8];
+        int32_t any = 0;
+        for (size_t j = 0; j < 8; ++j)
+        {
+            x[j] = src[i * 8 + j] * quant[i * 8 + j];
+            any |= x[j];
+        }
+        if (any == 0)
+        {
+            R[i][0] = R[i][1] = R[i][2] = R[i][3] = 0;
+            continue;
+        }
+        for (size_t c = 0; c < n; ++c)
+        {
+            int64_t sum = 0;
+            for (size_t j = 0; j < 8; ++j)
+                sum += (int64_t) W[c][j] * x[j];
+            R[i][c] = sum;
+        }
+        rows = i + 1;
+    }
+    for (size_t r = 0; r < n; ++r)
+    {
+        for (size_t c = 0; c < n; ++c)
+        {
+            int64_t sum = 0;
+            for (size_t i = 0; i < rows; ++i)
+                sum += W[r][i] * R[i][c];
+            dst[r * n + c] = (int16_t) (sum >> shift);
+        }
+    }
 }
 
-void fdct8x8f(float * restrict dst, float const * restrict src)
+/// @summary Reads the alpha channel of an MCU from a page and reduces it to
+/// an n x n block of means. At 1/8 scale only the DC section is read.
+/// @param dst An n * n element array receiving the reduced alpha channel.
+/// @param n The size of the reduced block, 2 or 4.
+/// @param dc The current position in the DC section, at the mode byte.
+/// @param dc_end The end of the DC section.
+/// @param ac The current position in the AC section.
+/// @param ac_end The end of the AC section.
+/// @param Qidct The 64 scaled quantization coefficients for the luma channel.
+/// @return true if the alpha channel was read, or false if the page is
+/// truncated or corrupt.
+static bool preview_alpha(
+    uint8_t        *dst,
+    size_t          n,
+    uint8_t const **dc,
+    uint8_t const  *dc_end,
+    uint8_t const **ac,
+    uint8_t const  *ac_end,
+    int16_t const  *Qidct)
 {
-    fdct8x8f_base(dst, src);
+    if (*dc < dc_end && (*dc)[0] == ALPHA_MODE_DCT)
+    {
+        int16_t C[256];
+        int16_t m[4];
+        size_t  used;
+        size_t  h = n / 2; // cells per block side
+        if (n == 2)
+        {
+            if ((used = unpack_dc(m, *dc + 1, (size_t) (dc_end - *dc) - 1, 4)) == 0)
+                return false;
+            for (size_t b = 0; b < 4; ++b)
+                dst[b] = clamp((m[b] * Qidct[0]) >> 6);
+            *dc += used + 1;
+        }
+        else
+        {
+            uint8_t const *in = *dc + 1;
+            if (!page_blocks(C, 4, &in, dc_end, ac, ac_end))
+                return false;
+            for (size_t b = 0; b < 4; ++b)
+            {
+                idct8x8id_means(m, h, &C[b * 64], Qidct);
+                for (size_t q = 0; q < 4; ++q)
+                    dst[((b >> 1) * 2 + (q >> 1)) * 4 + (b & 1) * 2 + (q & 1)] = clamp(m[q]);
+            }
+            *dc = in;
+        }
+        return true;
+    }
+
+    // the remaining modes are stored whole in the DC section and are cheap
+    // to expand; average the cells.
+    uint8_t A[256];
+    size_t  used = decode_alpha16x16(A, *dc, (size_t) (dc_end - *dc), Qidct);
+    size_t  cell = 16 / n;
+    if (used == 0)
+        return false;
+    for (size_t y = 0; y < n; ++y)
+    {
+        for (size_t x = 0; x < n; ++x)
+        {
+            uint32_t sum = 0;
+            for (size_t j = 0; j < cell; ++j)
+            {
+                for (size_t i = 0; i < cell; ++i)
+                    sum += A[(y * cell + j) * 16 + x * cell + i];
+            }
+            dst[y * n + x] = (uint8_t) ((sum + (cell * cell) / 2) / (cell * cell));
+        }
+    }
+    *dc += used;
+    return true;
 }
 
-void fdct8x8i(int16_t * restrict dst, int16_t const * restrict src)
+bool decode_tile_page_preview(
+    image_tile_t       *tile,
+    size_t              scale,
+    void const         *page,
+    size_t              page_size,
+    int                 quality)
 {
-    fdct8x8i_base(dst, src);
+    size_t split = tile_page_dc_size(page, page_size);
+    if (tile_stream_size(tile) == 0 || (scale != 4 && scale != 8) || split == 0 || split > page_size)
+        return false;
+
+    // at 1/8 scale the AC section is never read, so the page may be
+    // truncated at the end of the DC section.
+    quant_context_t const *Q = quant_context(quality);
+    int16_t const *Qy     = Q->Luma.Qidct;
+    int16_t const *Qc     = Q->Chroma.Qidct;
+    size_t         n      = 16 / scale; // preview pixels per MCU side
+    size_t         mcu_x  = tile->TileWidth / 16;
+    size_t         mcus   = mcu_x * (tile->TileHeight / 16);
+    uint8_t const *dc     = (uint8_t const*) page + 4;
+    uint8_t const *dc_end = (uint8_t const*) page + split;
+    uint8_t const *ac     = dc_end;
+    uint8_t const *ac_end = (n == 2) ? dc_end : (uint8_t const*) page + page_size;
+    uint8_t       *dst    = (uint8_t*) tile->Pixels;
+    size_t         pitch  = tile->BytesPerRow;
+    for (size_t mcu = 0; mcu < mcus; ++mcu)
+    {
+        int16_t  y[16];  // reduced luma, n x n
+        int16_t  o[16];  // reduced chroma-orange, n x n
+        int16_t  g[16];  // reduced chroma-green, n x n
+        uint8_t  a[16];  // reduced alpha, n x n
+        if (dc < dc_end && dc[0] == ALPHA_MODE_OPAQUE)
+        {
+            memset(a, 0xFF, sizeof(a));
+            dc++;
+        }
+        else if (!preview_alpha(a, n, &dc, dc_end, &ac, ac_end, Qy))
+        {
+            return false;
+        }
+
+        // at 1/8 scale each luma block reduces to its DC term, and the chroma
+        // planes, which have half the resolution of luma, to the DC term of
+        // the MCU. at 1/4 scale the chroma planes are reduced to an n x n
+        // grid covering the MCU.
+        if (n == 2)
+        {
+            int16_t d[6];
+            size_t  used;
+            if ((used = unpack_dc(d, dc, (size_t) (dc_end - dc), 6)) == 0)
+                return false;
+            for (size_t b = 0; b < 4; ++b)
+            {
+                y[b] = (int16_t) ((d[b] * Qy[0]) >> 6);
+                o[b] = (int16_t) ((d[4] * Qc[0]) >> 6);
+                g[b] = (int16_t) ((d[5] * Qc[0]) >> 6);
+            }
+            dc += used;
+        }
+        else
+        {
+            int16_t blk[384];
+            int16_t m[4];
+            if (!page_blocks(blk, 6, &dc, dc_end, &ac, ac_end))
+                return false;
+            for (size_t b = 0; b < 4; ++b)
+            {
+                idct8x8id_means(m, 2, &blk[b * 64], Qy);
+                for (size_t q = 0; q < 4; ++q)
+                    y[((b >> 1) * 2 + (q >> 1)) * 4 + (b & 1) * 2 + (q & 1)] = m[q];
+            }
+            idct8x8id_means(o, n, &blk[256], Qc);
+            idct8x8id_means(g, n, &blk[320], Qc);
+        }
+
+        // convert to RGBA at the preview resolution.
+        uint8_t *out = dst + (mcu / mcu_x) * n * pitch + (mcu % mcu_x) * n * 4;
+        for (size_t j = 0; j < n; ++j, out += pitch)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                int32_t co = o[j * n + i];
+                int32_t cg = g[j * n + i];
+                int32_t t  = y[j * n + i] - (cg >> 1);
+                int32_t G  = cg + t;
+                int32_t B  = t  - (co >> 1);
+                int32_t R  = B  +  co;
+                out[i * 4 + 0] = clamp(R);
+                out[i * 4 + 1] = clamp(G);
+                out[i * 4 + 2] = clamp(B);
+                out[i * 4 + 3] = a[j * n + i];
+            }
+        }
+    }
+    return (dc == dc_end);
 }
 
-void fdct8x8fq(
-    float         * restrict dst,
-    float   const * restrict src,
-    float   const * restrict Qfdct)
+/// @summary The maximum number of threads used to compute a single mipmap
+/// level, including the calling thread.
+static const size_t MipmapMaxThreads  = 16;
+
+/// @summary The minimum number of destination pixels in each band of rows
+/// computed by a separate thread.
+static const size_t MipmapBandPixels  = 65536;
+
+/// @summary The lookup tables used to convert 8-bit sRGB values to 16-bit
+/// linear values and back. See srgb_tables().
+struct srgb_tables_t
 {
-    fdct8x8fq_base(dst, src, Qfdct);
-}
+    uint16_t ToLinear[256];     /// The 16-bit linear value of each sRGB value
+    uint32_t Threshold[257];    /// The smallest linear value encoding to each
+    uint8_t  FromLinear[4096];  /// The sRGB value at the start of each 16 linear values
+};
 
-void fdct8x8iq(
-    int16_t       * restrict dst,
-    int16_t const * restrict src,
-    int16_t const * restrict Qfdct)
+/// @summary Describes a band of rows of a mipmap level computed by a thread.
+struct mipmap_job_t
 {
-    fdct8x8iq_base(dst, src, Qfdct);
-}
+    mipmap_level_t const *Dst;      /// The destination level
+    mipmap_level_t const *Src;      /// The source level
+    size_t                Channels; /// The number of channels per pixel
+    uint32_t              Flags;    /// A combination of mipmap_filter_e
+    size_t                RowBegin; /// The first destination row
+    size_t                RowEnd;   /// One past the last destination row
+};
 
-void idct8x8f(float * restrict dst, float const * restrict src)
+/// @summary Converts an sRGB-encoded value to linear.
+/// @param x The encoded value, in [0, 1].
+/// @return The linear value, in [0, 1].
+static double srgb_decode(double x)
 {
-    idct8x8f_base(dst, src);
+    return (x <= 0.04045) ? (x / 12.92) : pow((x + 0.055) / 1.055, 2.4);
 }
 
-void idct8x8i(int16_t * restrict dst, int16_t const * restrict src)
+/// @summary Retrieves the sRGB conversion tables, building them on first use.
+/// @return The shared, read-only tables.
+static srgb_tables_t const* srgb_tables(void)
 {
-    idct8x8i_base(dst, src);
+    // as for quant_context(), a function-local static is built exactly once
+    // even when first used from several threads.
+    static struct srgb_cache_t
+    {
+        srgb_tables_t T;
+        srgb_cache_t(void)
+        {
+            // the darkest sRGB step is about 20 linear units, so each bucket
+            // of 16 linear values crosses at most one threshold.
+            for (size_t i = 0; i < 256; ++i)
+                T.ToLinear[i]  = (uint16_t) (srgb_decode(i / 255.0) * 65535.0 + 0.5);
+            for (size_t i = 1; i < 256; ++i)
+                T.Threshold[i] = (uint32_t) ceil(srgb_decode((i - 0.5) / 255.0) * 65535.0);
+            T.Threshold[0]     = 0;
+            T.Threshold[256]   = 65536;
+            for (size_t i = 0, c = 0; i < 4096; ++i)
+            {
+                while (T.Threshold[c + 1] <= i * 16) ++c;
+                T.FromLinear[i] = (uint8_t) c;
+            }
+        }
+    } Cache;
+    return &Cache.T;
 }
 
-void idct8x8fd(
-    float         * restrict dst,
-    float   const * restrict src,
-    float   const * restrict Qidct)
+/// @summary Converts a 16-bit linear value to the nearest 8-bit sRGB value.
+/// @param T The sRGB conversion tables.
+/// @param v The linear value, in [0, 65535].
+/// @return The sRGB-encoded value.
+static inline uint8_t srgb_encode(srgb_tables_t const *T, uint32_t v)
 {
-    idct8x8fd_base(dst, src, Qidct);
+    uint32_t c = T->FromLinear[v >> 4];
+    return (uint8_t) ((v >= T->Threshold[c + 1]) ? c + 1 : c);
 }
 
-void idct8x8id(
-    int16_t       * restrict dst,
-    int16_t const * restrict src,
-    int16_t const * restrict Qidct)
+#if IM_ENABLE_SSE2
+/// @summary Box-filters a row of four-channel pixels, four destination
+/// pixels at a time.
+/// @param dst The destination row.
+/// @param r0 The first source row.
+/// @param r1 The second source row.
+/// @param w The number of destination pixels in the row.
+/// @return The number of destination pixels written.
+static size_t mipmap_box4_sse2(
+    uint8_t       * restrict dst,
+    uint8_t const * restrict r0,
+    uint8_t const * restrict r1,
+    size_t                   w)
 {
-    idct8x8id_base(dst, src, Qidct);
+    __m128i const z   = _mm_setzero_si128();
+    __m128i const two = _mm_set1_epi16(2);
+    size_t        x   = 0;
+    for ( ; x + 4 <= w; x += 4)
+    {
+        __m128i a0  = _mm_loadu_si128((__m128i const*) (r0 + x * 8));
+        __m128i a1  = _mm_loadu_si128((__m128i const*) (r0 + x * 8 + 16));
+        __m128i b0  = _mm_loadu_si128((__m128i const*) (r1 + x * 8));
+        __m128i b1  = _mm_loadu_si128((__m128i const*) (r1 + x * 8 + 16));
+        // vertical sums of source pixels 0-1, 2-3, 4-5 and 6-7.
+        __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, z), _mm_unpacklo_epi8(b0, z));
+        __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, z), _mm_unpackhi_epi8(b0, z));
+        __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, z), _mm_unpacklo_epi8(b1, z));
+        __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, z), _mm_unpackhi_epi8(b1, z));
+        // horizontal sums of adjacent pixels give destination pixels 0-3.
+        __m128i d01 = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+        __m128i d23 = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+        d01 = _mm_srli_epi16(_mm_add_epi16(d01, two), 2);
+        d23 = _mm_srli_epi16(_mm_add_epi16(d23, two), 2);
+        _mm_storeu_si128((__m128i*) (dst + x * 4), _mm_packus_epi16(d01, d23));
+    }
+    return x;
 }
 
-void encode16x16i(
-    int16_t       * restrict Y,
-    int16_t       * restrict Co,
-    int16_t       * restrict Cg,
-    uint8_t       * restrict A,
-    int16_t const * restrict Qluma,
-    int16_t const * restrict Qchroma,
-    uint8_t const * restrict RGBA)
+/// @summary Box-filters a row of single-channel pixels, eight destination
+/// pixels at a time.
+/// @param dst The destination row.
+/// @param r0 The first source row.
+/// @param r1 The second source row.
+/// @param w The number of destination pixels in the row.
+/// @return The number of destination pixels written.
+static size_t mipmap_box1_sse2(
+    uint8_t       * restrict dst,
+    uint8_t const * restrict r0,
+    uint8_t const * restrict r1,
+    size_t                   w)
 {
-    int16_t YCoCg[768];
-    int16_t samp00[64];
-    int16_t samp10[64];
-    int16_t samp01[64];
-    int16_t samp11[64];
-    int16_t sampCo[64];
-    int16_t sampCg[64];
+    __m128i const lo  = _mm_set1_epi16(0x00FF);
+    __m128i const two = _mm_set1_epi16(2);
+    size_t        x   = 0;
+    for ( ; x + 8 <= w; x += 8)
+    {
+        __m128i a = _mm_loadu_si128((__m128i const*) (r0 + x * 2));
+        __m128i b = _mm_loadu_si128((__m128i const*) (r1 + x * 2));
+        __m128i s = _mm_add_epi16(
+            _mm_add_epi16(_mm_and_si128(a, lo), _mm_srli_epi16(a, 8)),
+            _mm_add_epi16(_mm_and_si128(b, lo), _mm_srli_epi16(b, 8)));
+        s = _mm_srli_epi16(_mm_add_epi16(s, two), 2);
+        _mm_storel_epi64((__m128i*) (dst + x), _mm_packus_epi16(s, s));
+    }
+    return x;
+}
+#endif
 
-    // perform colorspace conversion and extract the alpha channel.
-    rgba_to_ycocga(YCoCg, A, RGBA);
+/// @summary Filters the remainder of a row of a mipmap level, one pixel at a
+/// time, with any combination of filter flags.
+/// @param dst The destination row.
+/// @param r0 The first source row.
+/// @param r1 The second source row.
+/// @param x The first destination pixel to compute.
+/// @param w The number of destination pixels in the row.
+/// @param channels The number of channels per pixel, 1 or 4.
+/// @param dx The offset of the second source pixel of each pair, in bytes.
+/// @param flags A combination of mipmap_filter_e values.
+static void mipmap_pixels(
+    uint8_t       * restrict dst,
+    uint8_t const * restrict r0,
+    uint8_t const * restrict r1,
+    size_t                   x,
+    size_t                   w,
+    size_t                   channels,
+    size_t                   dx,
+    uint32_t                 flags)
+{
+    srgb_tables_t const *T      = srgb_tables();
+    size_t const         ncolor = (channels == 4) ? 3 : channels;
+    bool const           srgb   = (flags & MIPMAP_FILTER_SRGB ) != 0;
+    bool const           weight = (flags & MIPMAP_FILTER_ALPHA) != 0 && channels == 4;
+    for ( ; x < w; ++x)
+    {
+        uint8_t const *a = r0  + x * 2 * channels;
+        uint8_t const *b = r1  + x * 2 * channels;
+        uint8_t       *o = dst + x * channels;
+        uint32_t       A = 0;
+        if (channels == 4)
+        {
+            A    = a[3] + a[dx + 3] + b[3] + b[dx + 3];
+            o[3] = (uint8_t) ((A + 2) >> 2);
+        }
+        for (size_t c = 0; c < ncolor; ++c)
+        {
+            uint32_t v0 = a[c], v1 = a[dx + c];
+            uint32_t v2 = b[c], v3 = b[dx + c];
+            uint32_t v;
+            if (srgb)
+            {
+                v0 = T->ToLinear[v0]; v1 = T->ToLinear[v1];
+                v2 = T->ToLinear[v2]; v3 = T->ToLinear[v3];
+            }
+            if (weight && A != 0)
+                v = (v0 * a[3] + v1 * a[dx + 3] + v2 * b[3] + v3 * b[dx + 3] + A / 2) / A;
+            else
+                v = (v0 + v1 + v2 + v3 + 2) >> 2;
+            o[c] = srgb ? srgb_encode(T, v) : (uint8_t) v;
+        }
+    }
+}
 
-    // extract and quantize the luma channel into four 8x8 blocks.
-    subblock(samp00, YCoCg, 0, 0, 0);
-    subblock(samp10, YCoCg, 1, 0, 0);
-    subblock(samp01, YCoCg, 0, 1, 0);
-    subblock(samp11, YCoCg, 1, 1, 0);
-    fdct8x8iq_base(&Y[0],   samp00, Qluma);
-    fdct8x8iq_base(&Y[64],  samp10, Qluma);
-    fdct8x8iq_base(&Y[128], samp01, Qluma);
-    fdct8x8iq_base(&Y[192], samp11, Qluma);
+/// @summary Entry point of the worker threads started by generate_mipmaps().
+/// @param arg The mipmap_job_t describing the rows to compute.
+/// @return Zero.
+#if defined(_WIN32)
+static unsigned __stdcall mipmap_thread(void *arg)
+#else
+static void* mipmap_thread(void *arg)
+#endif
+{
+    mipmap_job_t const *job = (mipmap_job_t const*) arg;
+    mipmap_rows(job->Dst, job->Src, job->Channels, job->Flags, job->RowBegin, job->RowEnd);
+    return 0;
+}
 
-    // downsample and quantize the chroma channels into one 8x8 block each.
-    subsample(sampCo, YCoCg, 1);
-    subsample(sampCg, YCoCg, 2);
-    fdct8x8iq_base(Co, sampCo, Qchroma);
-    fdct8x8iq_base(Cg, sampCg, Qchroma);
+void mipmap_rows(
+    mipmap_level_t const *dst,
+    mipmap_level_t const *src,
+    size_t                channels,
+    uint32_t              flags,
+    size_t                row_begin,
+    size_t                row_end)
+{
+    // a source dimension of 1 is sampled twice rather than read past its end.
+    size_t const dx  = (src->Width > 1) ? channels : 0;
+    bool   const box = (flags & MIPMAP_FILTER_SRGB) == 0 && ((flags & MIPMAP_FILTER_ALPHA) == 0 || channels == 1);
+    for (size_t y = row_begin; y < row_end; ++y)
+    {
+        uint8_t const *r0 = (uint8_t const*) src->Pixels + (y * 2) * src->BytesPerRow;
+        uint8_t const *r1 = (src->Height > 1) ? r0 + src->BytesPerRow : r0;
+        uint8_t       *o  = (uint8_t*) dst->Pixels + y * dst->BytesPerRow;
+        size_t         x  = 0;
+#if IM_ENABLE_SSE2
+        if (box)
+        {
+            x = (channels == 4) ? mipmap_box4_sse2(o, r0, r1, dst->Width)
+                                : mipmap_box1_sse2(o, r0, r1, dst->Width);
+        }
+#else
+        (void) box;
+#endif
+        mipmap_pixels(o, r0, r1, x, dst->Width, channels, dx, flags);
+    }
 }
 
-void decode16x16i_rgb(
-    uint8_t       * restrict RGB,
-    int16_t const * restrict Y,
-    int16_t const * restrict Co,
-    int16_t const * restrict Cg,
-    int16_t const * restrict Qluma,
-    int16_t const * restrict Qchroma)
+size_t mipmap_chain_layout(
+    mipmap_level_t       *levels,
+    size_t               *level_count,
+    size_t                width,
+    size_t                height,
+    size_t                channels,
+    size_t                alignment,
+    size_t                max_levels,
+    void                 *buffer)
 {
-    int16_t Yd[256]; // buffer for the dequantized luma blocks
-    int16_t Ym[256]; // buffer for the merged luma samples
-    int16_t Os[256]; // 16x16 chroma-orange samples
-    int16_t Gs[256]; // 16x16 chroma-green samples
-    int16_t Od[64];  // dequantized chroma-orange
-    int16_t Gd[64];  // dequantized chroma-green
+    size_t   count = 0;
+    size_t   total = 0;
+    uint8_t *base  = (uint8_t*) buffer;
+    *level_count = 0;
+    if (width == 0 || height == 0 || channels == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return 0;
 
-    // dequantize and IDCT the four luma blocks into Yd.
-    // merge them back into a single 16x16 block in Ym.
-    idct8x8id_base(&Yd[0],   &Y[0],   Qluma);
-    idct8x8id_base(&Yd[64],  &Y[64],  Qluma);
-    idct8x8id_base(&Yd[128], &Y[128], Qluma);
-    idct8x8id_base(&Yd[192], &Y[192], Qluma);
-    merge_blocks(Ym, Yd);
-
-    // dequantize the 8x8 chroma-orange block, and then
-    // scale it back up to 16x16 to match the luma channel.
-    // do the same for the the chroma-green channel.
-    idct8x8id_base(Od, Co, Qchroma);
-    idct8x8id_base(Gd, Cg, Qchroma);
-    scale_block(Os, Od);
-    scale_block(Gs, Gd);
-
-    // now convert from YCoCg back to RGB. the IDCT may have
-    // resulted in values outside of the valid range, so clamping
-    // to the range [0, 255] is necessary.
-    for (size_t i = 0; i < 256; ++i)
+    for (size_t w = width, h = height; ; w = (w > 1) ? w >> 1 : 1, h = (h > 1) ? h >> 1 : 1)
     {
-        int32_t y = Ym[i];
-        int32_t co= Os[i];
-        int32_t cg= Gs[i];
-        int16_t t = y  - (cg >> 1);
-        int16_t g = cg +  t;
-        int16_t b = t  - (co >> 1);
-        int16_t r = b  +  co;
-        *RGB++    = clamp(r);
-        *RGB++    = clamp(g);
-        *RGB++    = clamp(b);
+        mipmap_level_t *level = &levels[count++];
+        level->Width       = w;
+        level->Height      = h;
+        level->BytesPerRow = (w * channels + (alignment - 1)) & ~(alignment - 1);
+        level->Pixels      = (base != NULL) ? base + total : NULL;
+        total += level->BytesPerRow * h;
+        if ((w == 1 && h == 1) || count == max_levels)
+            break;
     }
+    *level_count = count;
+    return total;
 }
 
-void decode16x16i_rgba(
-    uint8_t       * restrict RGBA,
-    int16_t const * restrict Y,
-    int16_t const * restrict Co,
-    int16_t const * restrict Cg,
-    uint8_t const * restrict A,
-    int16_t const * restrict Qluma,
-    int16_t const * restrict Qchroma)
+bool generate_mipmaps(
+    mipmap_level_t const *levels,
+    size_t                level_count,
+    size_t                channels,
+    uint32_t              flags,
+    size_t                thread_count)
 {
-    int16_t Yd[256]; // buffer for the dequantized luma blocks
-    int16_t Ym[256]; // buffer for the merged luma samples
-    int16_t Os[256]; // 16x16 chroma-orange samples
-    int16_t Gs[256]; // 16x16 chroma-green samples
-    int16_t Od[64];  // dequantized chroma-orange
-    int16_t Gd[64];  // dequantized chroma-green
+    if (channels != 1 && channels != 4)
+        return false;
+    for (size_t i = 1; i < level_count; ++i)
+    {
+        size_t w = levels[i - 1].Width  >> 1;
+        size_t h = levels[i - 1].Height >> 1;
+        if (levels[i].Width != (w ? w : 1) || levels[i].Height != (h ? h : 1))
+            return false;
+    }
+    if (thread_count < 1) thread_count = 1;
+    if (thread_count > MipmapMaxThreads) thread_count = MipmapMaxThreads;
 
-    // dequantize and IDCT the four luma blocks into Yd.
-    // merge them back into a single 16x16 block in Ym.
-    idct8x8id_base(&Yd[0],   &Y[0],   Qluma);
-    idct8x8id_base(&Yd[64],  &Y[64],  Qluma);
-    idct8x8id_base(&Yd[128], &Y[128], Qluma);
-    idct8x8id_base(&Yd[192], &Y[192], Qluma);
-    merge_blocks(Ym, Yd);
-
-    // dequantize the 8x8 chroma-orange block, and then
-    // scale it back up to 16x16 to match the luma channel.
-    // do the same for the the chroma-green channel.
-    idct8x8id_base(Od, Co, Qchroma);
-    idct8x8id_base(Gd, Cg, Qchroma);
-    scale_block(Os, Od);
-    scale_block(Gs, Gd);
-
-    // now convert from YCoCg back to RGB. the IDCT may have
-    // resulted in values outside of the valid range, so clamping
-    // to the range [0, 255] is necessary.
-    for (size_t i = 0; i < 256; ++i)
+    for (size_t i = 1; i < level_count; ++i)
     {
-        int32_t y = Ym[i];
-        int32_t co= Os[i];
-        int32_t cg= Gs[i];
-        int16_t t = y  - (cg >> 1);
-        int16_t g = cg +  t;
-        int16_t b = t  - (co >> 1);
-        int16_t r = b  +  co;
-        *RGBA++   = clamp(r);
-        *RGBA++   = clamp(g);
-        *RGBA++   = clamp(b);
-        *RGBA++   =*A++;
+        // each level depends on the one above it, so only the rows within a
+        // level are split. small levels are not worth a thread.
+        mipmap_level_t const *dst   = &levels[i];
+        mipmap_level_t const *src   = &levels[i - 1];
+        size_t                bands = (dst->Width * dst->Height) / MipmapBandPixels;
+        if (bands > thread_count) bands = thread_count;
+        if (bands > dst->Height)  bands = dst->Height;
+        if (bands < 1) bands = 1;
+
+        mipmap_job_t jobs[MipmapMaxThreads];
+        size_t const rows = (dst->Height + bands - 1) / bands;
+        for (size_t j = 0; j < bands; ++j)
+        {
+            jobs[j].Dst      = dst;
+            jobs[j].Src      = src;
+            jobs[j].Channels = channels;
+            jobs[j].Flags    = flags;
+            jobs[j].RowBegin = j * rows;
+            jobs[j].RowEnd   = (j + 1) * rows < dst->Height ? (j + 1) * rows : dst->Height;
+        }
+
+        // bands whose thread cannot be started are run on the calling thread.
+#if defined(_WIN32)
+        HANDLE    threads[MipmapMaxThreads];
+        for (size_t j = 1; j < bands; ++j)
+            threads[j] = (HANDLE) _beginthreadex(NULL, 0, mipmap_thread, &jobs[j], 0, NULL);
+        mipmap_thread(&jobs[0]);
+        for (size_t j = 1; j < bands; ++j)
+        {
+            if (threads[j] != NULL)
+            {
+                WaitForSingleObject(threads[j], INFINITE);
+                CloseHandle(threads[j]);
+            }
+            else mipmap_thread(&jobs[j]);
+        }
+#else
+        pthread_t threads[MipmapMaxThreads];
+        bool      started[MipmapMaxThreads];
+        for (size_t j = 1; j < bands; ++j)
+            started[j] = pthread_create(&threads[j], NULL, mipmap_thread, &jobs[j]) == 0;
+        mipmap_thread(&jobs[0]);
+        for (size_t j = 1; j < bands; ++j)
+        {
+            if (started[j]) pthread_join(threads[j], NULL);
+            else mipmap_thread(&jobs[j]);
+        }
+#endif
     }
+    return true;
 }
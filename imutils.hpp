@@ -42,6 +42,141 @@ enum border_mode_e
     BORDER_MODE_DEFAULT   = BORDER_CLAMP_TO_EDGE
 };
 
+/// @summary Defines the pixel formats of source images accepted by the image
+/// tiler. Tiles are always output in RGBA8 format; other formats are expanded
+/// as each row is copied into the tile.
+enum source_format_e
+{
+    /// @summary Four 8-bit channels, copied as-is.
+    SOURCE_FORMAT_RGBA8   = 0,
+    /// @summary Three 8-bit channels. Alpha is set to 255.
+    SOURCE_FORMAT_RGB8    = 1,
+    /// @summary One 8-bit gray channel, copied to red, green and blue. Alpha
+    /// is set to 255.
+    SOURCE_FORMAT_R8      = 2,
+    /// @summary One 8-bit gray channel, copied to red, green and blue, and
+    /// one 8-bit alpha channel.
+    SOURCE_FORMAT_RG8     = 3,
+    /// @summary Four 16-bit channels, rounded to the nearest 8-bit value.
+    SOURCE_FORMAT_RGBA16  = 4
+};
+
+/// @summary Defines the orders in which the tiles of an image are emitted and
+/// laid out in a package. The space-filling curves keep tiles that are close
+/// on the image close in the package, so that the pages of a region can be
+/// read with fewer, longer sequential reads.
+enum tile_order_e
+{
+    /// @summary Row by row, left to right.
+    TILE_ORDER_ROW_MAJOR  = 0,
+    /// @summary Along a Z-order (Morton) curve, which visits each aligned
+    /// 2x2 block of tiles before moving on to the next.
+    TILE_ORDER_MORTON     = 1,
+    /// @summary Along a Hilbert curve, which also visits aligned blocks one
+    /// at a time, and on which consecutive tiles are always adjacent.
+    TILE_ORDER_HILBERT    = 2
+};
+
+/// @summary Defines the instruction set levels for which kernels may be
+/// selected at runtime. Each level implies support for the levels below it.
+enum cpu_isa_e
+{
+    /// @summary Portable C++ kernels; always available.
+    CPU_ISA_SCALAR        = 0,
+    /// @summary x86 SSE2 kernels.
+    CPU_ISA_SSE2          = 1,
+    /// @summary x86 AVX2 kernels.
+    CPU_ISA_AVX2          = 2,
+    /// @summary x86 AVX-512F. Selects the AVX2 kernels where no AVX-512
+    /// implementation exists.
+    CPU_ISA_AVX512        = 3,
+    /// @summary Select the highest level supported by the host CPU.
+    CPU_ISA_BEST          =-1
+};
+
+/// @summary Defines the encodings of the alpha channel of a 16x16 MCU. Each
+/// encoded MCU starts with a one-byte mode followed by its payload.
+enum alpha_mode_e
+{
+    /// @summary Every alpha value is 255. There is no payload.
+    ALPHA_MODE_OPAQUE     = 0,
+    /// @summary Every alpha value is equal. The payload is the value.
+    ALPHA_MODE_CONSTANT   = 1,
+    /// @summary Every alpha value is 0 or 255. The payload is a 256-bit mask
+    /// in row-major order, least-significant bit first.
+    ALPHA_MODE_BINARY     = 2,
+    /// @summary Lossy. The alpha channel is coded as four 8x8 blocks with the
+    /// luma quantization table, packed as by pack_coefficients().
+    ALPHA_MODE_DCT        = 3,
+    /// @summary The payload is the 256 untransformed alpha values.
+    ALPHA_MODE_RAW        = 4
+};
+
+/// @summary Counts the blocks decoded by each of the integer IDCT paths.
+struct idct_counters_t
+{
+    uint64_t DcOnly;         /// Blocks with only a DC coefficient
+    uint64_t Sparse4x4;      /// Blocks limited to the top-left 4x4 coefficients
+    uint64_t Full;           /// Blocks requiring the full transform
+};
+
+/// @summary Stores an integer quantization table together with the reciprocal
+/// form of its divisors, so that quantization is a multiply and a shift.
+struct quant_table_t
+{
+    int16_t  Qidct[64];      /// Dequantization multipliers for the IDCT
+    int16_t  Qfdct[64];      /// Quantization divisors for the FDCT
+    uint16_t Recip[64];      /// Reciprocal multipliers, ceil(2^Shift / Qfdct)
+    uint16_t Shift[64];      /// Right shift applied to |coefficient| * Recip
+};
+
+/// @summary Stores the luma and chroma quantization tables for the integer
+/// codec at a single quality level. See quant_context_init() and
+/// quant_context().
+struct quant_context_t
+{
+    int32_t       Quality;   /// The quality level, in [1, 100]
+    quant_table_t Luma;      /// Tables for the luma (Y) channel
+    quant_table_t Chroma;    /// Tables for the chroma (Co, Cg) channels
+};
+
+/// @summary Defines the block-compressed formats output by the transcoder.
+/// Blocks are 4x4 pixels, stored in row-major order within each row of
+/// blocks, as expected by glCompressedTexSubImage2D.
+enum bc_format_e
+{
+    /// @summary Opaque RGB, 8 bytes per block. Upload with
+    /// GL_COMPRESSED_RGB_S3TC_DXT1_EXT.
+    BC_FORMAT_BC1         = 0,
+    /// @summary RGBA, 16 bytes per block. Upload with
+    /// GL_COMPRESSED_RGBA_S3TC_DXT5_EXT.
+    BC_FORMAT_BC3         = 1,
+    /// @summary Opaque YCoCg in a BC3 block, 16 bytes per block. Upload with
+    /// GL_COMPRESSED_RGBA_S3TC_DXT5_EXT. Luma is stored in alpha, and the
+    /// chroma in red and green with a per-block scale in blue. The shader
+    /// reconstructs, with each component in [0, 1]:
+    ///   s  = 1.0 / ((255.0 / 8.0) * b + 1.0)
+    ///   Co = (r - 128.0 / 255.0) * s
+    ///   Cg = (g - 128.0 / 255.0) * s
+    ///   R  = a + Co - Cg, G = a + Cg, B = a - Co - Cg
+    BC_FORMAT_BC3_YCOCG   = 2
+};
+
+/// @summary Defines the flags that select the filter used to build mipmaps.
+/// Flags may be combined; the default is a plain 2x2 box filter.
+enum mipmap_filter_e
+{
+    /// @summary Average each channel of the 2x2 source pixels directly.
+    MIPMAP_FILTER_BOX     = 0,
+    /// @summary The color channels are sRGB-encoded. They are averaged in
+    /// linear space and encoded again; alpha is always averaged directly.
+    MIPMAP_FILTER_SRGB    = (1 << 0),
+    /// @summary Weight each color by its alpha, so that fully transparent
+    /// pixels do not bleed their color into the level below. Only applies
+    /// to four-channel images.
+    MIPMAP_FILTER_ALPHA   = (1 << 1)
+};
+
 /// @summary Describes a single tile output by the image tiler.
 struct image_tile_t
 {
@@ -59,6 +194,33 @@ struct image_tile_t
     void    *Pixels;         /// The output pixel data
 };
 
+/// @summary Stores the unquantized coefficients of a tile together with the
+/// statistics needed to compute its packed page size at any quality level
+/// without quantizing it again. See tile_rate_init(). Set Lambda after
+/// initialization to enable rate-distortion optimized quantization.
+struct tile_rate_t
+{
+    size_t    McuCount;      /// The number of 16x16 MCUs in the tile
+    size_t    StreamSize;    /// The size of Stream, in bytes
+    int16_t  *Stream;        /// Unquantized coefficients and alpha, planar
+    uint32_t *Counts;        /// Per-plane, per-position threshold counts
+    size_t    AlphaSize;     /// The size of the alpha modes and fixed payloads
+    size_t    AlphaCount;    /// The number of MCUs with DCT-coded alpha
+    int16_t  *Alpha;         /// Unquantized coefficients of DCT-coded alpha
+    uint8_t  *AlphaModes;    /// The alpha_mode_e of each MCU
+    float     Lambda;        /// The RDO quantization lambda, or zero to truncate
+};
+
+/// @summary Describes a single level of a mipmap chain in host memory. The
+/// levels are typically laid out as given by mipmap_chain_layout().
+struct mipmap_level_t
+{
+    size_t   Width;          /// The width of the level, in pixels
+    size_t   Height;         /// The height of the level, in pixels
+    size_t   BytesPerRow;    /// The number of bytes per-row
+    void    *Pixels;         /// The first pixel of the level
+};
+
 /// @summary Describes the image tiler configuration options.
 struct image_tiler_config_t
 {
@@ -69,12 +231,93 @@ struct image_tiler_config_t
     size_t   BorderSize;     /// The border dimension, in pixels
     int32_t  BorderMode;     /// One of the chunker_border_e values
     uint32_t BorderColor;    /// A one-pixel buffer for the border color
+    int32_t  SourceFormat;   /// One of the source_format_e values
+    size_t   SourcePitch;    /// The number of bytes per row of Pixels, or zero if rows are tightly packed
+    int32_t  TileOrder;      /// One of the tile_order_e values, used by encode_image()
     void    *Pixels;         /// The source image pixels
 };
 
+/// @summary Maps the tiles of a mipmap chain to the pages of a package, in
+/// one of the tile_order_e orders. See tile_layout_init(). Tiles are named by
+/// their raster index, LevelBase[level] + tile_y * TilesX[level] + tile_x.
+struct tile_layout_t
+{
+    int32_t   Order;         /// One of the tile_order_e values
+    size_t    LevelCount;    /// The number of mipmap levels
+    size_t    PageCount;     /// The number of tiles over all levels
+    size_t   *TilesX;        /// The number of tiles in a row, per level
+    size_t   *TilesY;        /// The number of tiles in a column, per level
+    size_t   *LevelBase;     /// The raster index of the first tile of each level
+    uint32_t *PageOfTile;    /// The page index of each tile, by raster index
+    uint32_t *TileOfPage;    /// The raster index of the tile in each page
+};
+
+/// @summary Represents a tiler that streams a source image through memory in
+/// horizontal bands. This structure should be considered opaque. See
+/// band_tiler_open().
+struct band_tiler_t;
+
+/// @summary Reads a run of rows of a source image for a band_tiler_t. Rows
+/// are in the configured SourceFormat, stored contiguously with no padding;
+/// each is ImageWidth * source_format_size(SourceFormat) bytes.
+/// Called on a background thread, one call at a time, in increasing row order.
+/// @param context The opaque pointer passed to band_tiler_open().
+/// @param dst The destination of the first row.
+/// @param first_row The zero-based index of the first row to read.
+/// @param row_count The number of rows to read.
+/// @return true if every row was read, or false to stop tiling.
+typedef bool (*band_read_fn)(void *context, void *dst, size_t first_row, size_t row_count);
+
+/// @summary Stores the statistics reported by encode_image().
+struct encode_stats_t
+{
+    size_t   TileCount;      /// The number of pages passed to the callback
+    size_t   DuplicateCount; /// The number of tiles that share the page of an earlier tile
+    size_t   ThreadCount;    /// The number of threads that encoded tiles, including the caller
+    uint64_t PageBytes;      /// The total size of the pages, in bytes
+    double   Seconds;        /// The wall-clock time taken, in seconds
+    double   TilesPerSecond; /// The number of tiles encoded per second
+};
+
+/// @summary Receives each page encoded by encode_image(), in the TileOrder of
+/// the configuration, on the thread that called encode_image(). The page
+/// memory is only valid for the duration of the call.
+/// @param context The opaque pointer passed to encode_image().
+/// @param index The zero-based row-major index of the tile, as for copy_tile().
+/// @param page The encoded page.
+/// @param page_size The size of the page, in bytes.
+/// @param quality The quality level of the page, required by the decoder.
+/// @return true to continue encoding, or false to stop.
+typedef bool (*encode_page_fn)(void *context, size_t index, void const *page, size_t page_size, int quality);
+
 /*///////////////
 //  Functions  //
 ///////////////*/
+/// @summary Queries the host CPU (via cpuid and xgetbv on x86) for the highest
+/// instruction set level it supports, whether or not kernels were compiled in.
+/// @return One of the cpu_isa_e values, excluding CPU_ISA_BEST.
+int32_t cpu_isa_supported(void);
+
+/// @summary Selects the set of DCT kernels used by all imutils entry points.
+/// The best available set is selected automatically at program startup; call
+/// this to force a lower level for testing or benchmarking. The request is
+/// clamped to what the host CPU supports and what the build compiled in. This
+/// function is not thread-safe; call it before starting any worker threads.
+/// @param isa One of the cpu_isa_e values. Specify CPU_ISA_BEST to restore
+/// the default selection.
+/// @return The cpu_isa_e value of the kernel set actually selected.
+int32_t select_kernels(int32_t isa);
+
+/// @summary Retrieves the instruction set level of the active kernel set.
+/// @return One of the cpu_isa_e values, excluding CPU_ISA_BEST.
+int32_t kernel_isa(void);
+
+/// @summary Retrieves the number of bytes used to store one pixel of a source
+/// image in a given format.
+/// @param format One of source_format_e.
+/// @return The pixel size, in bytes, or zero if the format is not recognized.
+size_t source_format_size(int32_t format);
+
 /// @summary Calculates the number of tiles output gi
 /// @param num_x On return, stores the number of tiles in a single row.
 /// @param num_y On return, stores the number of tiles in a single column.
@@ -95,13 +338,101 @@ bool tile_alloc(image_tile_t *tile, image_tiler_config_t const *config);
 /// @param tile The tile to free.
 void tile_free(image_tile_t *tile);
 
-/// @summary Extracts a single tile from the source image.
+/// @summary Extracts a single tile from the source image, converting it from
+/// the source format to RGBA8 as each row is copied.
 /// @param tile The destination tile memory.
 /// @param config The chunker configuration describing the input image.
 /// @param index The zero-based index of the tile to retrieve.
 /// @return true if the tile was copied successfully.
 bool copy_tile(image_tile_t *tile, image_tiler_config_t const *config, size_t index);
 
+/// @summary Describes a single tile as a window into the source image, without
+/// copying it. This is only possible for RGBA8 sources, and for tiles with no
+/// border that lie wholly inside the image; for all other tiles, use
+/// copy_tile(). On success, Pixels
+/// points into config->Pixels, BytesPerRow is the pitch of the source image and
+/// BytesPerTile is the size the tile would have if it were copied. The view is
+/// valid only while the source image is, and must not be passed to tile_free().
+/// @param tile The tile to fill out. Left unchanged if the call fails.
+/// @param config The chunker configuration describing the input image.
+/// @param index The zero-based index of the tile to retrieve.
+/// @return true if the tile was described in place, or false if the index is
+/// out of range or the tile must be copied.
+bool view_tile(image_tile_t *tile, image_tiler_config_t const *config, size_t index);
+
+/// @summary Computes a 64-bit hash of the RGBA8 pixels of a tile, eight
+/// 32-bit lanes at a time. The hash depends only on the tile dimensions and
+/// pixels, not on BytesPerRow or on the kernel set selected.
+/// @param tile The tile, as output by copy_tile() or view_tile().
+/// @return The hash value.
+uint64_t tile_hash(image_tile_t const *tile);
+
+/// @summary Starts tiling an image too large to hold in memory. The source is
+/// read in bands one tile row high, plus the row below it that the bottom
+/// border samples. At most two bands are resident. A background thread reads
+/// the next band while the tiles of the current band are returned.
+/// @param config The image tiler configuration. The Pixels, SourcePitch and
+/// TileOrder fields are ignored; tiles are always returned in row-major order.
+/// @param read The function that reads rows of the source image.
+/// @param context An opaque pointer passed to @a read.
+/// @return The tiler, or NULL if memory could not be allocated. Close the
+/// tiler with band_tiler_close().
+band_tiler_t* band_tiler_open(image_tiler_config_t const *config, band_read_fn read, void *context);
+
+/// @summary Retrieves the next tile from a band tiler, in the same order and
+/// with the same contents as copy_tile() over the whole image. Tiles that
+/// view_tile() would accept point into the resident band; others are copied
+/// into a buffer owned by the tiler. Either way, the tile is valid only until
+/// the next call, and must not be passed to tile_free().
+/// @param tiler The band tiler.
+/// @param tile On return, describes the tile.
+/// @return true if a tile was returned, or false if every tile has been
+/// returned or a band could not be read.
+bool band_tiler_next(band_tiler_t *tiler, image_tile_t *tile);
+
+/// @summary Stops a band tiler and frees its memory.
+/// @param tiler The band tiler to close.
+/// @return true if every band that was needed was read successfully.
+bool band_tiler_close(band_tiler_t *tiler);
+
+/// @summary Computes the package layout of the tiles of a mipmap chain. Each
+/// level is half the size of the level above it, rounded down and at least 1,
+/// and is tiled with the same tile size and border as level 0. The levels are
+/// stored one after another, starting with level 0, and the tiles of each
+/// level in the given order. The curve orders walk the smallest power-of-two
+/// square grid that covers the level, skipping the cells with no tile.
+/// @param layout The layout to initialize. Free it with tile_layout_free().
+/// @param config The image tiler configuration of level 0. Only the image and
+/// tile dimensions and BorderSize are used.
+/// @param level_count The number of mipmap levels, at least 1.
+/// @param order One of the tile_order_e values.
+/// @return true if the layout was computed, or false if an argument is not
+/// valid or memory could not be allocated.
+bool tile_layout_init(tile_layout_t *layout, image_tiler_config_t const *config, size_t level_count, int32_t order);
+
+/// @summary Frees the memory of a layout initialized by tile_layout_init().
+/// @param layout The layout to free.
+void tile_layout_free(tile_layout_t *layout);
+
+/// @summary Finds the page of a package that holds a tile. The file offset of
+/// fixed-size pages is the page index times the page size.
+/// @param layout The package layout.
+/// @param tile_x The column index of the tile within its level.
+/// @param tile_y The row index of the tile within its level.
+/// @param level The mipmap level of the tile.
+/// @return The zero-based page index, or PageCount if there is no such tile.
+size_t tile_page_index(tile_layout_t const *layout, size_t tile_x, size_t tile_y, size_t level);
+
+/// @summary Finds the tile held by a page of a package; the inverse of
+/// tile_page_index().
+/// @param layout The package layout.
+/// @param page The zero-based page index.
+/// @param tile_x On return, stores the column index of the tile within its level.
+/// @param tile_y On return, stores the row index of the tile within its level.
+/// @param level On return, stores the mipmap level of the tile.
+/// @return true if the page exists, or false if it is out of range.
+bool tile_page_position(tile_layout_t const *layout, size_t page, size_t *tile_x, size_t *tile_y, size_t *level);
+
 /// @summary Calculates a set of quantization coefficients given a set of base
 /// coefficients and a user-controllable quality factor. The quantization table
 /// does not include scale factors.
@@ -191,6 +522,28 @@ void qtables_decode(float * restrict Qluma, float * restrict Qchroma, int qualit
 /// @param quality The user-controllable quality factor, in [1, 100].
 void qtables_decode(int16_t * restrict Qluma, int16_t * restrict Qchroma, int quality);
 
+/// @summary Calculates the quantization tables used by the integer codec at a
+/// given quality level, including the reciprocal multipliers for the FDCT.
+/// @param ctx The quantization context to initialize.
+/// @param quality The user-controllable quality factor, in [1, 100].
+void quant_context_init(quant_context_t *ctx, int quality);
+
+/// @summary Retrieves the shared, read-only quantization context for a given
+/// quality level. Contexts for all 100 levels are built once, on first use,
+/// and may be used from any thread.
+/// @param quality The user-controllable quality factor, clamped to [1, 100].
+/// @return The quantization context for the quality level.
+quant_context_t const* quant_context(int quality);
+
+/// @summary Quantizes an 8x8 block of integer DCT coefficients in place with
+/// the table for a quality level, truncating toward zero. The quality levels
+/// the tools ship at (50, 75, 85, 90 and 95) use quantizers generated with
+/// the table folded in at compile time; other levels use the runtime table.
+/// @param coeff The 64-element block of coefficients, as output by fdct8x8i().
+/// @param quality The user-controllable quality factor, clamped to [1, 100].
+/// @param chroma true to use the chroma table, false to use the luma table.
+void quantize8x8i(int16_t *coeff, int quality, bool chroma);
+
 /// @summary Executes a forward discrete cosine transform operation for an 8x8
 /// block of input data representing a single color channel. The FDCT is a
 /// floating-point implementation of AA&N.
@@ -229,6 +582,58 @@ void fdct8x8iq(
     int16_t const * restrict src,
     int16_t const * restrict Qfdct);
 
+/// @summary Executes the floating-point forward DCT with quantization for a
+/// contiguous run of 8x8 blocks that share a single quantization table.
+/// Groups of eight blocks are transformed in parallel, one block per SIMD
+/// lane, when AVX2 and FMA are available. Fused multiply-adds round
+/// differently, so the output may differ from fdct8x8fq() in the last bit.
+/// @param dst A buffer of 64 * count values to be filled with quantized DCT
+/// coefficient values.
+/// @param src A buffer of 64 * count values containing the 8x8 blocks of
+/// sample values, stored one block after another.
+/// @param Qfdct The scaled quantization table for the FDCT.
+/// @param count The number of 8x8 blocks to transform.
+void fdct8x8fq_batch(
+    float       * restrict dst,
+    float const * restrict src,
+    float const * restrict Qfdct,
+    size_t                 count);
+
+/// @summary Executes a forward discrete cosine transform operation with
+/// quantization and descaling for a contiguous run of 8x8 blocks that share
+/// a single quantization table. Groups of eight blocks are transformed in
+/// parallel using SIMD instructions where available; the output is always
+/// bit-for-bit identical to calling fdct8x8iq() on each block.
+/// @param dst A buffer of 64 * count values to be filled with descaled and
+/// quantized DCT coefficient values.
+/// @param src A buffer of 64 * count values containing the 8x8 blocks of
+/// sample values, stored one block after another.
+/// @param Qfdct The scaled quantization table for the FDCT.
+/// @param count The number of 8x8 blocks to transform.
+void fdct8x8iq_batch(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict Qfdct,
+    size_t                   count);
+
+/// @summary Executes a forward discrete cosine transform operation with
+/// quantization for a contiguous run of 8x8 blocks, using the precomputed
+/// reciprocal multipliers of a quantization table in place of division.
+/// The output is identical to the fdct8x8iq_batch() overload that accepts
+/// the Qfdct divisors directly.
+/// @param dst A buffer of 64 * count values to be filled with descaled and
+/// quantized DCT coefficient values.
+/// @param src A buffer of 64 * count values containing the 8x8 blocks of
+/// sample values, stored one block after another.
+/// @param Q The quantization table, typically &quant_context(q)->Luma or
+/// &quant_context(q)->Chroma.
+/// @param count The number of 8x8 blocks to transform.
+void fdct8x8iq_batch(
+    int16_t             * restrict dst,
+    int16_t       const * restrict src,
+    quant_table_t const * restrict Q,
+    size_t                         count);
+
 /// @summary Executes an inverse discrete cosine transform operation for an 8x8
 /// block of input data representing a single color channel. The IDCT is a
 /// floating-point implementation of the AA&N method.
@@ -255,6 +660,22 @@ void idct8x8fd(
     float const * restrict src,
     float const * restrict Qidct);
 
+/// @summary Executes the floating-point inverse DCT with dequantization for a
+/// contiguous run of 8x8 blocks that share a single quantization table.
+/// Groups of eight blocks are transformed in parallel, one block per SIMD
+/// lane, when AVX2 and FMA are available. Fused multiply-adds round
+/// differently, so the output may differ from idct8x8fd() in the last bit.
+/// @param dst A buffer of 64 * count values to be filled with sample values.
+/// @param src A buffer of 64 * count values containing the quantized DCT
+/// coefficients, stored one block after another.
+/// @param Qidct The scaled quantization table for the IDCT.
+/// @param count The number of 8x8 blocks to transform.
+void idct8x8fd_batch(
+    float       * restrict dst,
+    float const * restrict src,
+    float const * restrict Qidct,
+    size_t                 count);
+
 /// @summary Executes an inverse discrete cosine transform operation with
 /// dequantization and descaling for an 8x8 block of input data representing
 /// the quantized DCT coefficients for a single color channel. The IDCT is an
@@ -267,6 +688,28 @@ void idct8x8id(
     int16_t const * restrict src,
     int16_t const * restrict Qidct);
 
+/// @summary Executes an inverse discrete cosine transform operation with
+/// dequantization and descaling for an 8x8 block of quantized coefficients,
+/// using an end-of-block index to select a reduced transform without
+/// inspecting the coefficients. The output is identical to idct8x8id().
+/// @param dst A 64-element buffer to be filled with de-quantized sample data.
+/// @param src A 64-element buffer containing the quantized DCT coefficients.
+/// @param Qidct The scaled quantization table for the IDCT.
+/// @param eob The number of zig-zag ordered coefficients up to and including
+/// the last non-zero coefficient, as returned by unpack_coefficients().
+void idct8x8id_eob(
+    int16_t       * restrict dst,
+    int16_t const * restrict src,
+    int16_t const * restrict Qidct,
+    size_t                   eob);
+
+/// @summary Retrieves the number of blocks decoded by each integer IDCT path
+/// (DC-only, 4x4 and full) on the calling thread. idct8x8id(), idct8x8id_eob()
+/// and the decode16x16i and decode_tile functions select the path per block.
+/// @param counters On return, stores the counts. May be NULL.
+/// @param reset Specify true to reset the counts for the calling thread.
+void idct_counters(idct_counters_t *counters, bool reset);
+
 /// @summary Transforms an input block of 16x16 RGBA8 pixels into a form more
 /// amenable to compression via traditional lossless methods. Note that the
 /// quantization table does not need to be stored with the output; it will
@@ -287,6 +730,22 @@ void encode16x16i(
     int16_t const * restrict Qchroma,
     uint8_t const * restrict RGBA);
 
+/// @summary Transforms an input block of 16x16 RGBA8 pixels as encode16x16i()
+/// does, quantizing with the reciprocal tables of a quantization context.
+/// @param Y A buffer of 256 values to store the four 8x8 blocks of luma.
+/// @param Co A buffer of 64 values to store the 8x8 block of chroma-orange.
+/// @param Cg A buffer of 64 values to store the 8x8 block of chroma-green.
+/// @param A A buffer of 256 values to store the 16x16 block of alpha.
+/// @param ctx The quantization context, as returned by quant_context().
+/// @param RGBA The 16x16 (1024 byte) block of RGBA8 input pixels.
+void encode16x16i(
+    int16_t               * restrict Y,
+    int16_t               * restrict Co,
+    int16_t               * restrict Cg,
+    uint8_t               * restrict A,
+    quant_context_t const * restrict ctx,
+    uint8_t const         * restrict RGBA);
+
 /// @summary Transforms an input block of 16x16 quantized DCT coefficients for
 /// each of the luma (Y), chroma-orange (Co) and chroma-green (Cg) channels
 /// back into RGB sample data.
@@ -317,7 +776,8 @@ void decode16x16i_rgb(
 /// coefficients for the chroma-orange channel.
 /// @param Cg A 64-element array specifying the 8x8 block of quantized DCT
 /// coefficients for the chroma-green channel.
-/// @param A A 256-element array specifying the untransformed alpha channel.
+/// @param A A 256-element array specifying the untransformed alpha channel,
+/// or NULL if the block is fully opaque.
 /// @param Qy The 64 scaled quantization coefficients for the luma channel.
 /// @param Qc The 64 scaled quantization coefficients for the chroma channels.
 void decode16x16i_rgba(
@@ -329,4 +789,523 @@ void decode16x16i_rgba(
     int16_t const * restrict Qluma,
     int16_t const * restrict Qchroma);
 
+/// @summary Transforms an input block of 16x16 quantized DCT coefficients back
+/// into RGB sample data, writing each row of the output directly into a larger
+/// destination image, such as a tile or a mapped pixel buffer.
+/// @param dst The destination of the top-left pixel of the 16x16 block. Each
+/// row writes 48 bytes.
+/// @param pitch The number of bytes between the start of consecutive rows in
+/// the destination.
+/// @param Y A 256-element array specifying the four 8x8 blocks of quantized
+/// DCT coefficients for the luma channel.
+/// @param Co A 64-element array specifying the 8x8 block of quantized DCT
+/// coefficients for the chroma-orange channel.
+/// @param Cg A 64-element array specifying the 8x8 block of quantized DCT
+/// coefficients for the chroma-green channel.
+/// @param Qy The 64 scaled quantization coefficients for the luma channel.
+/// @param Qc The 64 scaled quantization coefficients for the chroma channels.
+void decode16x16i_rgb_strided(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma);
+
+/// @summary Transforms an input block of 16x16 quantized DCT coefficients back
+/// into RGBA sample data, writing each row of the output directly into a larger
+/// destination image, such as a tile or a mapped pixel buffer.
+/// @param dst The destination of the top-left pixel of the 16x16 block. Each
+/// row writes 64 bytes.
+/// @param pitch The number of bytes between the start of consecutive rows in
+/// the destination.
+/// @param Y A 256-element array specifying the four 8x8 blocks of quantized
+/// DCT coefficients for the luma channel.
+/// @param Co A 64-element array specifying the 8x8 block of quantized DCT
+/// coefficients for the chroma-orange channel.
+/// @param Cg A 64-element array specifying the 8x8 block of quantized DCT
+/// coefficients for the chroma-green channel.
+/// @param A A 256-element array specifying the untransformed alpha channel,
+/// or NULL if the block is fully opaque.
+/// @param Qy The 64 scaled quantization coefficients for the luma channel.
+/// @param Qc The 64 scaled quantization coefficients for the chroma channels.
+void decode16x16i_rgba_strided(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    uint8_t const * restrict A,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma);
+
+/// @summary Retrieves the number of bytes used to store a 4x4 block of pixels
+/// in a block-compressed format.
+/// @param format One of bc_format_e.
+/// @return The block size, in bytes.
+size_t bc_block_size(int32_t format);
+
+/// @summary Compresses a 16x16 block of RGBA8 pixels into 4x4 blocks of a
+/// block-compressed format. BC1 ignores the alpha channel.
+/// @param dst The destination of the top-left 4x4 block.
+/// @param pitch The number of bytes between the start of consecutive rows of
+/// 4x4 blocks in the destination.
+/// @param format One of bc_format_e. For BC_FORMAT_BC3_YCOCG the source must
+/// already be in the scaled YCoCg layout.
+/// @param src The top-left pixel of the 16x16 block.
+/// @param src_pitch The number of bytes between rows of @a src.
+void compress16x16_bc(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int32_t                  format,
+    uint8_t const * restrict src,
+    size_t                   src_pitch);
+
+/// @summary Transforms an input block of 16x16 quantized DCT coefficients
+/// and transcodes the result to a block-compressed format without writing
+/// the decoded pixels to memory. BC_FORMAT_BC3_YCOCG is built directly from
+/// the YCoCg samples output by the IDCT.
+/// @param dst The destination of the top-left 4x4 block. The MCU writes four
+/// rows of four blocks.
+/// @param pitch The number of bytes between the start of consecutive rows of
+/// 4x4 blocks in the destination.
+/// @param format One of bc_format_e.
+/// @param Y A 256-element array specifying the four 8x8 blocks of quantized
+/// DCT coefficients for the luma channel.
+/// @param Co A 64-element array specifying the 8x8 block of quantized DCT
+/// coefficients for the chroma-orange channel.
+/// @param Cg A 64-element array specifying the 8x8 block of quantized DCT
+/// coefficients for the chroma-green channel.
+/// @param A A 256-element array specifying the untransformed alpha channel,
+/// or NULL if the block is fully opaque. Only BC_FORMAT_BC3 stores alpha.
+/// @param Qy The 64 scaled quantization coefficients for the luma channel.
+/// @param Qc The 64 scaled quantization coefficients for the chroma channels.
+void decode16x16i_bc(
+    uint8_t       * restrict dst,
+    size_t                   pitch,
+    int32_t                  format,
+    int16_t const * restrict Y,
+    int16_t const * restrict Co,
+    int16_t const * restrict Cg,
+    uint8_t const * restrict A,
+    int16_t const * restrict Qluma,
+    int16_t const * restrict Qchroma);
+
+/// @summary Calculates the size of the coefficient stream for a tile. The tile
+/// is divided into 16x16 MCUs in row-major order, and the stream stores each
+/// channel as a contiguous plane: all luma blocks (4 x 64 int16 per MCU), then
+/// all chroma-orange blocks (64 int16 per MCU), then all chroma-green blocks
+/// (64 int16 per MCU), then the alpha channel (256 bytes per MCU).
+/// @param tile The tile. TileWidth and TileHeight must be multiples of 16.
+/// @return The number of bytes required to store the stream, or zero if the
+/// tile dimensions are not supported.
+size_t tile_stream_size(image_tile_t const *tile);
+
+/// @summary Encodes an entire RGBA8 tile into a coefficient stream. The
+/// quantization tables are computed once for the whole tile. The tile pixels
+/// are read using the tile BytesPerRow value as the row pitch, so a tile may
+/// also be used to describe any other pitched RGBA8 buffer.
+/// @param stream The destination buffer.
+/// @param stream_size The size of the destination buffer, in bytes.
+/// @param tile The source tile.
+/// @param quality The user-controllable quality factor, in [1, 100].
+/// @return The number of bytes written to the stream, or zero if the tile
+/// dimensions are not supported or the stream buffer is too small.
+size_t encode_tile(
+    void               *stream,
+    size_t              stream_size,
+    image_tile_t const *tile,
+    int                 quality);
+
+/// @summary Decodes a coefficient stream produced by encode_tile() into an
+/// RGBA8 tile. Rows are written using the tile BytesPerRow value as the row
+/// pitch, so the destination may be a mapped pixel buffer.
+/// @param tile The destination tile. The TileWidth, TileHeight, BytesPerRow
+/// and Pixels fields must be set.
+/// @param stream The coefficient stream.
+/// @param stream_size The size of the coefficient stream, in bytes.
+/// @param quality The quality factor the stream was encoded with.
+/// @return true if the tile was decoded successfully.
+bool decode_tile(
+    image_tile_t       *tile,
+    void const         *stream,
+    size_t              stream_size,
+    int                 quality);
+
+/// @summary Calculates the maximum number of bytes output by pack_coefficients
+/// for a given number of 8x8 blocks.
+/// @param block_count The number of 8x8 blocks of coefficients.
+/// @return The maximum packed size, in bytes.
+size_t coefficient_pack_bound(size_t block_count);
+
+/// @summary Packs blocks of quantized DCT coefficients (as output by the
+/// integer FDCT) into a byte stream of zig-zag ordered (run, level) pairs,
+/// each block terminated with an end-of-block marker. Each pair is a token
+/// byte holding the zero-run length in the upper six bits and the level size
+/// in the lower two bits (1 = int8, 2 = int16, little-endian), followed by the
+/// level. The end-of-block marker is a zero byte.
+/// @param dst The destination buffer, of at least coefficient_pack_bound()
+/// bytes.
+/// @param src The source coefficients, 64 values per block.
+/// @param block_count The number of 8x8 blocks to pack.
+/// @return The number of bytes written to @a dst.
+size_t pack_coefficients(
+    uint8_t       * restrict dst,
+    int16_t const * restrict src,
+    size_t                   block_count);
+
+/// @summary Unpacks a stream produced by pack_coefficients() into dense blocks
+/// of coefficients, suitable for passing directly to the integer IDCT.
+/// @param dst The destination coefficients, 64 values per block.
+/// @param eob An optional array of block_count values that receives, for each
+/// block, the number of zig-zag ordered coefficients up to and including the
+/// last non-zero coefficient. May be NULL.
+/// @param src The packed coefficient stream.
+/// @param src_size The size of the packed coefficient stream, in bytes.
+/// @param block_count The number of 8x8 blocks to unpack.
+/// @return The number of bytes consumed from @a src, or zero if the stream is
+/// corrupt or too short.
+size_t unpack_coefficients(
+    int16_t       * restrict dst,
+    uint8_t       * restrict eob,
+    uint8_t const * restrict src,
+    size_t                   src_size,
+    size_t                   block_count);
+
+/// @summary Selects the encoding for the alpha channel of a 16x16 MCU. The
+/// lossless opaque, constant and binary modes are selected where they apply;
+/// any other block uses ALPHA_MODE_DCT if its packed coefficients are smaller
+/// than the 256-byte raw payload, or ALPHA_MODE_RAW otherwise.
+/// @param A A 256-element array specifying the alpha channel, in row-major order.
+/// @param Q The luma quantization table used to size ALPHA_MODE_DCT, or NULL
+/// to select only the lossless modes.
+/// @return One of alpha_mode_e.
+int32_t alpha_mode16x16(uint8_t const *A, quant_table_t const *Q);
+
+/// @summary Calculates the maximum number of bytes output by encode_alpha16x16.
+/// @return The maximum encoded size of the alpha channel of one MCU, in bytes.
+size_t alpha_pack_bound(void);
+
+/// @summary Encodes the alpha channel of a 16x16 MCU using a given mode.
+/// @param dst The destination buffer, of at least alpha_pack_bound() bytes.
+/// @param A A 256-element array specifying the alpha channel, in row-major
+/// order. The values must be representable in the given mode.
+/// @param mode One of alpha_mode_e, typically as returned by alpha_mode16x16().
+/// ALPHA_MODE_DCT is written as ALPHA_MODE_RAW if its packed coefficients
+/// are not smaller than the raw samples.
+/// @param Q The luma quantization table, used by ALPHA_MODE_DCT.
+/// @return The number of bytes written to @a dst, including the mode byte.
+size_t encode_alpha16x16(
+    uint8_t             * restrict dst,
+    uint8_t const       * restrict A,
+    int32_t                        mode,
+    quant_table_t const * restrict Q);
+
+/// @summary Decodes the alpha channel of a 16x16 MCU written by
+/// encode_alpha16x16(). The result can be passed to decode16x16i_rgba().
+/// @param A A 256-element array where the alpha channel will be written.
+/// @param src The encoded alpha channel, starting with the mode byte.
+/// @param src_size The number of bytes available at @a src.
+/// @param Qidct The 64 scaled quantization coefficients for the luma channel.
+/// @return The number of bytes consumed from @a src, or zero if the data is
+/// corrupt or too short.
+size_t decode_alpha16x16(
+    uint8_t       * restrict A,
+    uint8_t const * restrict src,
+    size_t                   src_size,
+    int16_t const * restrict Qidct);
+
+/// @summary Prepares a tile for rate-controlled encoding. The tile is
+/// converted and transformed once, and the unquantized coefficients are kept
+/// along with per-position statistics, so that the page size at any quality
+/// can be computed exactly from a few table lookups and only the final
+/// quality needs to be quantized. Free the state with tile_rate_free().
+/// @param rc The rate control state to initialize.
+/// @param tile The source tile. TileWidth and TileHeight must be multiples of
+/// 16, and the pixels are RGBA8 with a row pitch of BytesPerRow.
+/// @param lossy_alpha Specify true to code alpha blocks that are not opaque,
+/// constant or binary with ALPHA_MODE_DCT where their unquantized coefficients
+/// pack smaller than the raw samples, or false to store them raw.
+/// @return true if the tile is supported and memory was allocated.
+bool tile_rate_init(tile_rate_t *rc, image_tile_t const *tile, bool lossy_alpha);
+
+/// @summary Frees the memory allocated by tile_rate_init().
+/// @param rc The rate control state to free.
+void tile_rate_free(tile_rate_t *rc);
+
+/// @summary Calculates the exact size of the page written by tile_rate_pack()
+/// at a given quality level.
+/// @param rc The rate control state.
+/// @param quality The user-controllable quality factor, in [1, 100].
+/// @return The page size, in bytes.
+size_t tile_rate_size(tile_rate_t const *rc, int quality);
+
+/// @summary Finds the highest quality level whose page fits a byte budget.
+/// @param rc The rate control state.
+/// @param budget The maximum page size, in bytes.
+/// @return The quality level, in [1, 100], or zero if the page does not fit
+/// even at quality 1.
+int tile_rate_quality(tile_rate_t const *rc, size_t budget);
+
+/// @summary Quantizes the coefficients held by a rate control state and
+/// writes them to a page. The page starts with the little-endian 32-bit
+/// offset of its AC section, followed by the DC section, which stores each
+/// MCU in row-major order as its alpha channel and a DC record of its blocks
+/// Y0, Y1, Y2, Y3, Co, Cg. A DC record is a mask byte, with bit b set if the
+/// level of block b needs two bytes, followed by each level in one byte or
+/// two little-endian bytes. Alpha is encoded as by encode_alpha16x16(),
+/// except that DCT-coded alpha stores a DC record of its four blocks. The AC
+/// section stores the remaining coefficients of each MCU, packed as by
+/// pack_coefficients() with the DC terms zero, first any DCT-coded alpha
+/// blocks and then the color blocks.
+/// @param page The destination buffer.
+/// @param page_size The size of the destination buffer, in bytes.
+/// @param rc The rate control state.
+/// @param quality The user-controllable quality factor, in [1, 100].
+/// @return The number of bytes written, equal to tile_rate_size(), or zero if
+/// the page does not fit in the buffer.
+size_t tile_rate_pack(
+    void              *page,
+    size_t             page_size,
+    tile_rate_t const *rc,
+    int                quality);
+
+/// @summary Encodes a tile into a page of at most page_size bytes, at the
+/// highest quality level that fits. Alpha blocks that are not opaque,
+/// constant or binary are DCT-coded.
+/// @param page The destination buffer.
+/// @param page_size The byte budget for the page, and the size of @a page.
+/// @param tile The source tile. TileWidth and TileHeight must be multiples of 16.
+/// @param quality On return, stores the quality level selected, or zero if
+/// the tile does not fit. The decoder requires this value. May be NULL.
+/// @return The number of bytes written to the page, or zero on failure.
+size_t encode_tile_budget(
+    void               *page,
+    size_t              page_size,
+    image_tile_t const *tile,
+    int                *quality);
+
+/// @summary Encodes a tile into a page of at most page_size bytes, as for
+/// encode_tile_budget(), with rate-distortion optimized quantization. Each
+/// coefficient is given the level, among zero, its truncated level, the next
+/// level up and the largest single-byte level, that minimizes the squared
+/// error of the decoded samples plus lambda times its packed size. The page
+/// format is unchanged, and the decoder needs only the quality level.
+/// @param page The destination buffer.
+/// @param page_size The byte budget for the page, and the size of @a page.
+/// @param tile The source tile. TileWidth and TileHeight must be multiples of 16.
+/// @param lambda The distortion traded for each byte saved, in units of the
+/// squared error of one DC quantization step. Values from 4 to 8 are
+/// typical. Specify zero for the truncating quantizer of encode_tile_budget().
+/// @param quality On return, stores the quality level selected, or zero if
+/// the tile does not fit. The decoder requires this value. May be NULL.
+/// @return The number of bytes written to the page, or zero on failure.
+size_t encode_tile_budget_rdo(
+    void               *page,
+    size_t              page_size,
+    image_tile_t const *tile,
+    float               lambda,
+    int                *quality);
+
+/// @summary Splits an image into tiles and encodes each into a page, as by
+/// encode_tile_budget_rdo(), on a pool of threads. Tiles that view_tile()
+/// accepts are read in place; each thread copies the others into a buffer of
+/// its own. Threads claim tiles in the configured TileOrder so that no thread
+/// runs more than a small window ahead of the oldest unfinished tile. The
+/// pages are passed to the callback in that order, which is the page order of
+/// a single-level tile_layout_t, so the output does not depend on the number
+/// of threads or on scheduling.
+/// @param config The image tiler configuration. TileWidth and TileHeight
+/// must be multiples of 16.
+/// @param page_size The byte budget for each page.
+/// @param lambda The RDO quantization lambda, or zero to truncate.
+/// @param thread_count The number of threads to use, including the caller.
+/// @param emit The function receiving each page.
+/// @param context An opaque pointer passed to @a emit.
+/// @param stats On return, stores the throughput achieved. May be NULL.
+/// @return true if every tile was encoded and passed to @a emit, or false if
+/// a tile did not fit in the budget, memory could not be allocated, or
+/// @a emit returned false.
+bool encode_image(
+    image_tiler_config_t const *config,
+    size_t                      page_size,
+    float                       lambda,
+    size_t                      thread_count,
+    encode_page_fn              emit,
+    void                       *context,
+    encode_stats_t             *stats);
+
+/// @summary Splits an image into tiles and encodes each distinct tile once,
+/// as encode_image(). Each tile is hashed with tile_hash() after it is read.
+/// A tile whose pixels exactly match an earlier tile, in emission order, is
+/// neither encoded nor passed to the callback; its page table entry refers
+/// to the page of the earlier tile instead. The pages passed to the callback
+/// are those encode_image() would pass, less the duplicates.
+/// @param config The image tiler configuration. TileWidth and TileHeight
+/// must be multiples of 16.
+/// @param page_size The byte budget for each page.
+/// @param lambda The RDO quantization lambda, or zero to truncate.
+/// @param thread_count The number of threads to use, including the caller.
+/// @param page_table An array of tile_count() entries. On return, the entry
+/// of each tile, by row-major index, stores the zero-based number of the
+/// page holding its pixels, counting pages in the order they were passed to
+/// @a emit. Specify NULL to encode every tile, as encode_image().
+/// @param emit The function receiving each page.
+/// @param context An opaque pointer passed to @a emit.
+/// @param stats On return, stores the throughput achieved. May be NULL.
+/// @return true if every tile was encoded or matched and every page passed
+/// to @a emit, or false if a tile did not fit in the budget, memory could
+/// not be allocated, or @a emit returned false.
+bool encode_image_dedup(
+    image_tiler_config_t const *config,
+    size_t                      page_size,
+    float                       lambda,
+    size_t                      thread_count,
+    uint32_t                   *page_table,
+    encode_page_fn              emit,
+    void                       *context,
+    encode_stats_t             *stats);
+
+/// @summary Reads the size of the leading part of a page written by
+/// tile_rate_pack() that decode_tile_page_preview() needs at 1/8 scale: the
+/// header and the DC section.
+/// @param page The page data, of which at least the first four bytes are
+/// required.
+/// @param page_size The number of bytes available at @a page.
+/// @return The offset of the AC section, in bytes, or zero if the page is too
+/// short or corrupt.
+size_t tile_page_dc_size(void const *page, size_t page_size);
+
+/// @summary Decodes a page written by tile_rate_pack() or encode_tile_budget()
+/// into an RGBA8 tile.
+/// @param tile The destination tile. TileWidth, TileHeight, BytesPerRow and
+/// Pixels must be set, and the dimensions must match the encoded tile.
+/// @param page The page data.
+/// @param page_size The size of the page data, in bytes. Any bytes past the
+/// end of the packed coefficients are ignored.
+/// @param quality The quality level the page was encoded with.
+/// @return true if the page was decoded, or false if it is truncated or corrupt.
+bool decode_tile_page(
+    image_tile_t       *tile,
+    void const         *page,
+    size_t              page_size,
+    int                 quality);
+
+/// @summary Calculates the size of a tile transcoded to a block-compressed
+/// format with tightly packed rows of blocks.
+/// @param tile The tile. TileWidth and TileHeight must be multiples of 16.
+/// @param format One of bc_format_e.
+/// @return The number of bytes, or zero if the tile is not supported.
+size_t tile_bc_size(image_tile_t const *tile, int32_t format);
+
+/// @summary Decodes a page written by tile_rate_pack() or encode_tile_budget()
+/// straight to a block-compressed format. The output can be uploaded with the
+/// compressed path of transfer_pixels_h2d, with TransferWidth and
+/// TransferHeight set to the tile dimensions and TransferSize set to
+/// tile_bc_size() when BytesPerRow is (TileWidth / 4) * bc_block_size().
+/// @param tile The destination tile. TileWidth, TileHeight, BytesPerRow and
+/// Pixels must be set, and the dimensions must match the encoded tile.
+/// BytesPerRow is the number of bytes between rows of 4x4 blocks.
+/// @param format One of bc_format_e.
+/// @param page The page data.
+/// @param page_size The size of the page data, in bytes.
+/// @param quality The quality level the page was encoded with.
+/// @return true if the page was decoded, or false if it is truncated or corrupt.
+bool decode_tile_page_bc(
+    image_tile_t       *tile,
+    int32_t             format,
+    void const         *page,
+    size_t              page_size,
+    int                 quality);
+
+/// @summary Decodes a reduced-resolution preview of a page written by
+/// tile_rate_pack() or encode_tile_budget(). At 1/4 scale each preview pixel
+/// is the mean of the 4x4 area of the full decode it covers, computed
+/// directly from the coefficients without an IDCT. At 1/8 scale only the DC
+/// section is read: each pixel takes the mean luma of its 8x8 area and the
+/// mean chroma of its MCU, and the page may be truncated at
+/// tile_page_dc_size() bytes.
+/// @param tile The full-size destination tile. TileWidth and TileHeight must
+/// match the encoded tile. Pixels receives (TileWidth / scale) x
+/// (TileHeight / scale) RGBA8 pixels, with BytesPerRow bytes between rows.
+/// @param scale The reduction factor, 4 or 8.
+/// @param page The page data.
+/// @param page_size The size of the page data, in bytes.
+/// @param quality The quality level the page was encoded with.
+/// @return true if the preview was decoded, or false if the scale is not
+/// supported or the page is truncated or corrupt.
+bool decode_tile_page_preview(
+    image_tile_t       *tile,
+    size_t              scale,
+    void const         *page,
+    size_t              page_size,
+    int                 quality);
+
+/// @summary Lays out every level of a 2D mipmap chain one after another in a
+/// single buffer. Each level halves the dimensions of the level above it, down
+/// to 1x1, and its rows are padded to the alignment, so the levels match those
+/// given by describe_mipmaps() in glutils.hpp for an 8-bit format and can be
+/// uploaded with transfer_pixels_h2d() once generate_mipmaps() fills them.
+/// @param levels An array receiving the levels, with room for max_levels
+/// entries, or 8 * sizeof(size_t) entries if max_levels is zero.
+/// @param level_count On return, stores the number of levels in the chain.
+/// @param width The width of level 0, in pixels.
+/// @param height The height of level 0, in pixels.
+/// @param channels The number of 8-bit channels per pixel.
+/// @param alignment The row alignment, in bytes, a power of two. This is the
+/// GL_UNPACK_ALIGNMENT of the upload, by default 4.
+/// @param max_levels The maximum number of levels, or 0 for the full chain.
+/// @param buffer The buffer storing the chain, or NULL to compute only the
+/// layout, in which case the Pixels of each level are NULL.
+/// @return The size of the chain, in bytes, or zero if the dimensions or
+/// alignment are not valid.
+size_t mipmap_chain_layout(
+    mipmap_level_t       *levels,
+    size_t               *level_count,
+    size_t                width,
+    size_t                height,
+    size_t                channels,
+    size_t                alignment,
+    size_t                max_levels,
+    void                 *buffer);
+
+/// @summary Computes rows of one mipmap level from the level above it with a
+/// 2x2 filter. Each destination pixel covers source pixels (2x, 2y) through
+/// (2x+1, 2y+1); a trailing odd source row or column is dropped, and a source
+/// dimension of 1 is sampled twice. Disjoint row ranges of the same level may
+/// be computed on different threads.
+/// @param dst The destination level. Its dimensions must be those of @a src
+/// halved, and at least 1.
+/// @param src The source level.
+/// @param channels The number of 8-bit channels per pixel, 1 or 4. With four
+/// channels, the last is alpha.
+/// @param flags A combination of mipmap_filter_e values.
+/// @param row_begin The first destination row to compute.
+/// @param row_end One past the last destination row to compute.
+void mipmap_rows(
+    mipmap_level_t const *dst,
+    mipmap_level_t const *src,
+    size_t                channels,
+    uint32_t              flags,
+    size_t                row_begin,
+    size_t                row_end);
+
+/// @summary Generates levels 1 through level_count - 1 of a mipmap chain from
+/// level 0. Large levels are split into bands of rows computed in parallel.
+/// @param levels The levels of the chain, with level 0 holding the source.
+/// @param level_count The number of levels in the chain.
+/// @param channels The number of 8-bit channels per pixel, 1 or 4.
+/// @param flags A combination of mipmap_filter_e values.
+/// @param thread_count The maximum number of threads to use, including the
+/// calling thread. Specify 0 or 1 to run on the calling thread only.
+/// @return true if the chain was generated, or false if the channel count is
+/// not supported or a level has the wrong dimensions.
+bool generate_mipmaps(
+    mipmap_level_t const *levels,
+    size_t                level_count,
+    size_t                channels,
+    uint32_t              flags,
+    size_t                thread_count);
+
 #endif /* !defined(IM_UTILS_HPP) */
@@ -11,6 +11,7 @@
 ////////////////*/
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <assert.h>
 #include "ioutils.hpp"
@@ -210,24 +211,608 @@ void file_contents_free(void *buffer)
     if (buffer) free(buffer);
 }
 
+/*/////////////////////////////
+//  Finite State Entropy     //
+/////////////////////////////*/
+/// @summary The number of input bytes coded with a single set of probability
+/// tables. Each block is coded independently as raw, RLE or FSE data.
+#define FSE_BLOCK_SIZE          65536U
+
+/// @summary The largest and smallest supported table sizes, as log2(entries).
+#define FSE_MAX_TABLE_LOG       12U
+#define FSE_MIN_TABLE_LOG       5U
+
+/// @summary The number of interleaved coder states. Symbol i is coded with
+/// state (i % FSE_NUM_STATES), so the decoder has four independent dependency
+/// chains per iteration.
+#define FSE_NUM_STATES          4U
+
+/// @summary The number of zero bytes at the start of each bitstream. These
+/// are never consumed; they allow the decoder to refill its bit container
+/// with a single unaligned 8-byte load without checking the lower bound.
+#define FSE_BITSTREAM_PAD       8U
+
+/// @summary Defines the block types in a compressed stream. Each block starts
+/// with a one-byte type tag.
+enum fse_block_e
+{
+    /// @summary The block is stored uncompressed.
+    FSE_BLOCK_RAW               = 0,
+    /// @summary The block is a single repeated byte, stored once.
+    FSE_BLOCK_RLE               = 1,
+    /// @summary The block is entropy coded. The tag is followed by the table
+    /// log, the maximum symbol value, the normalized counts as LEB128 values,
+    /// the 32-bit bitstream size, and the bitstream.
+    FSE_BLOCK_FSE               = 2
+};
+
+/// @summary A single entry in the decoding table, indexed by state.
+struct fse_decode_t
+{
+    uint16_t      NewState;             /// Base of the next state
+    uint8_t       Symbol;               /// The decoded byte value
+    uint8_t       NumBits;              /// Bits to read to form the next state
+};
+
+/// @summary Per-symbol encoding transform. See fse_build_encoder().
+struct fse_symbol_t
+{
+    int32_t       DeltaFindState;       /// Offset of the symbol's state range
+    uint32_t      DeltaNumBits;         /// Bias used to compute bits to output
+};
+
+/// @summary Forward bitstream writer used by the encoder. Bits are appended
+/// at the low end of a 64-bit container, and whole bytes are stored forward.
+struct fse_bitwriter_t
+{
+    uint64_t      Bits;                 /// The bit container
+    uint32_t      Count;                /// The number of valid bits in Bits
+    uint8_t      *Ptr;                  /// The next byte to be stored
+};
+
+/// @summary Backward bitstream reader used by the decoder. Bits are consumed
+/// from the top of a 64-bit container loaded from Ptr.
+struct fse_bitreader_t
+{
+    uint64_t      Bits;                 /// The bit container
+    uint32_t      Consumed;             /// The number of bits consumed from Bits
+    uint8_t const*Ptr;                  /// The address Bits was loaded from
+    uint8_t const*Start;                /// The first byte of the bitstream
+};
+
+/// @summary Computes the index of the most significant set bit.
+/// @param v The value, which must be non-zero.
+/// @return The bit index, in [0, 31].
+static inline uint32_t fse_highbit(uint32_t v)
+{
+#if defined(__GNUC__)
+    return 31U - (uint32_t) __builtin_clz(v);
+#else
+    uint32_t r = 0;
+    while (v >>= 1) ++r;
+    return r;
+#endif
+}
+
+/// @summary Loads a little-endian 64-bit value from an unaligned address.
+static inline uint64_t fse_read64(void const *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/// @summary Stores a little-endian 64-bit value to an unaligned address.
+static inline void fse_write64(void *p, uint64_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+/// @summary Appends up to 56 bits to the bitstream. Call fse_bits_flush()
+/// before the container can overflow.
+static inline void fse_bits_add(fse_bitwriter_t *w, uint32_t value, uint32_t nbits)
+{
+    uint64_t mask = (((uint64_t) 1) << nbits) - 1;
+    w->Bits  |= ((uint64_t) value & mask) << w->Count;
+    w->Count += nbits;
+}
+
+/// @summary Stores all whole bytes in the container. This always writes
+/// eight bytes, so the output buffer needs eight bytes of slack.
+static inline void fse_bits_flush(fse_bitwriter_t *w)
+{
+    uint32_t nbytes = w->Count >> 3;
+    fse_write64(w->Ptr, w->Bits);
+    w->Ptr   += nbytes;
+    w->Bits >>= nbytes * 8;
+    w->Count &= 7;
+}
+
+/// @summary Refills the reader container after consuming up to 56 bits.
+/// @return false if the reader has moved before the start of the bitstream,
+/// which happens only for corrupt input.
+static inline bool fse_bits_reload(fse_bitreader_t *r)
+{
+    r->Ptr      -= r->Consumed >> 3;
+    r->Consumed &= 7;
+    if (r->Ptr < r->Start)
+        return false;
+    r->Bits      = fse_read64(r->Ptr);
+    return true;
+}
+
+/// @summary Reads bits from the top of the reader container.
+/// @param nbits The number of bits to read, in [0, 56].
+static inline uint32_t fse_bits_read(fse_bitreader_t *r, uint32_t nbits)
+{
+    // the double shift keeps the shift amount below 64 when nbits is zero.
+    uint32_t v   = (uint32_t) (((r->Bits << r->Consumed) >> 1) >> (63 - nbits));
+    r->Consumed += nbits;
+    return v;
+}
+
+/// @summary Chooses the table log for a block, trading table construction
+/// and header size against precision of the normalized probabilities.
+/// @param n The number of bytes in the block.
+/// @param max_symbol The largest byte value present in the block.
+static uint32_t fse_table_log(size_t n, uint32_t max_symbol)
+{
+    uint32_t n_log2    = fse_highbit((uint32_t) n);
+    uint32_t from_size = (n_log2 > 2) ? n_log2 - 2 : 0;
+    uint32_t from_syms = fse_highbit(max_symbol) + 2;
+    uint32_t log2_size = (from_size < FSE_MAX_TABLE_LOG) ? from_size : FSE_MAX_TABLE_LOG;
+    if (log2_size < from_syms)         log2_size = from_syms;
+    if (log2_size < FSE_MIN_TABLE_LOG) log2_size = FSE_MIN_TABLE_LOG;
+    if (log2_size > FSE_MAX_TABLE_LOG) log2_size = FSE_MAX_TABLE_LOG;
+    return log2_size;
+}
+
+/// @summary Scales symbol counts so that they sum to the table size. Every
+/// symbol that occurs is assigned a probability of at least 1/table_size.
+/// @param norm The 256-element array of normalized counts.
+/// @param count The 256-element array of symbol counts.
+/// @param n The total number of symbols.
+/// @param max_symbol The largest symbol value present.
+/// @param table_log The log2 of the table size.
+static void fse_normalize(
+    uint16_t       * restrict norm,
+    uint32_t const * restrict count,
+    size_t                    n,
+    uint32_t                  max_symbol,
+    uint32_t                  table_log)
+{
+    uint32_t const table_size = 1U << table_log;
+    uint32_t       total      = 0;
+    uint32_t       largest    = 0;
+    for (uint32_t s = 0; s <= max_symbol; ++s)
+    {
+        uint64_t  scaled = ((uint64_t) count[s] << table_log) + (n >> 1);
+        uint32_t  v      = (uint32_t) (scaled / n);
+        if (count[s] != 0 && v == 0) v = 1;
+        norm[s] = (uint16_t) v;
+        total  += v;
+        if (count[s] > count[largest]) largest = s;
+    }
+    // rounding and the minimum of one can leave the sum off by at most one
+    // per symbol. take any excess from the most probable symbols.
+    while (total > table_size)
+    {
+        uint32_t m = largest;
+        for (uint32_t s = 0; s <= max_symbol; ++s)
+        {
+            if (norm[s] > norm[m]) m = s;
+        }
+        norm[m]--;
+        total--;
+    }
+    norm[largest] = (uint16_t) (norm[largest] + (table_size - total));
+}
+
+/// @summary Distributes symbols over the state table. Each symbol occupies
+/// norm[s] cells, spread so that its states are roughly evenly spaced.
+/// @param table The table_size-element array of symbols, indexed by state.
+/// @param norm The normalized counts.
+/// @param max_symbol The largest symbol value present.
+/// @param table_log The log2 of the table size.
+static void fse_spread(
+    uint8_t        * restrict table,
+    uint16_t const * restrict norm,
+    uint32_t                  max_symbol,
+    uint32_t                  table_log)
+{
+    uint32_t const table_size = 1U << table_log;
+    uint32_t const table_mask = table_size - 1;
+    uint32_t const step       = (table_size >> 1) + (table_size >> 3) + 3;
+    uint32_t       pos        = 0;
+    for (uint32_t s = 0; s <= max_symbol; ++s)
+    {
+        for (uint32_t i = 0; i < norm[s]; ++i)
+        {
+            table[pos] = (uint8_t) s;
+            pos = (pos + step) & table_mask;
+        }
+    }
+}
+
+/// @summary Builds the encoder state table and per-symbol transforms.
+/// @param state_table The table_size-element array of encoder states.
+/// @param symbol_tt The 256-element array of per-symbol transforms.
+/// @param norm The normalized counts.
+/// @param max_symbol The largest symbol value present.
+/// @param table_log The log2 of the table size.
+static void fse_build_encoder(
+    uint16_t       * restrict state_table,
+    fse_symbol_t   * restrict symbol_tt,
+    uint16_t const * restrict norm,
+    uint32_t                  max_symbol,
+    uint32_t                  table_log)
+{
+    uint32_t const table_size = 1U << table_log;
+    uint8_t        spread[1U << FSE_MAX_TABLE_LOG];
+    uint32_t       cumul [257];
+
+    fse_spread(spread, norm, max_symbol, table_log);
+    cumul[0] = 0;
+    for (uint32_t s = 0; s <= max_symbol; ++s)
+        cumul[s + 1] = cumul[s] + norm[s];
+
+    // states for each symbol are stored contiguously, in the order that the
+    // symbol appears in the spread table.
+    for (uint32_t u = 0; u < table_size; ++u)
+        state_table[cumul[spread[u]]++] = (uint16_t) (table_size + u);
+
+    uint32_t total = 0;
+    for (uint32_t s = 0; s <= max_symbol; ++s)
+    {
+        if (norm[s] == 0)
+        {
+            symbol_tt[s].DeltaFindState = 0;
+            symbol_tt[s].DeltaNumBits   = 0;
+        }
+        else if (norm[s] == 1)
+        {
+            symbol_tt[s].DeltaFindState = (int32_t) total - 1;
+            symbol_tt[s].DeltaNumBits   = (table_log << 16) - table_size;
+            total++;
+        }
+        else
+        {
+            uint32_t max_bits_out = table_log - fse_highbit(norm[s] - 1U);
+            uint32_t min_state    = (uint32_t) norm[s] << max_bits_out;
+            symbol_tt[s].DeltaFindState = (int32_t) total - (int32_t) norm[s];
+            symbol_tt[s].DeltaNumBits   = (max_bits_out << 16) - min_state;
+            total += norm[s];
+        }
+    }
+}
+
+/// @summary Builds the decoding table.
+/// @param dtable The table_size-element decoding table.
+/// @param norm The normalized counts.
+/// @param max_symbol The largest symbol value present.
+/// @param table_log The log2 of the table size.
+static void fse_build_decoder(
+    fse_decode_t   * restrict dtable,
+    uint16_t const * restrict norm,
+    uint32_t                  max_symbol,
+    uint32_t                  table_log)
+{
+    uint32_t const table_size = 1U << table_log;
+    uint8_t        spread[1U << FSE_MAX_TABLE_LOG];
+    uint32_t       next  [256];
+
+    fse_spread(spread, norm, max_symbol, table_log);
+    for (uint32_t s = 0; s <= max_symbol; ++s)
+        next[s] = norm[s];
+
+    for (uint32_t u = 0; u < table_size; ++u)
+    {
+        uint32_t s      = spread[u];
+        uint32_t state  = next[s]++;
+        uint32_t nbits  = table_log - fse_highbit(state);
+        dtable[u].Symbol   = (uint8_t)  s;
+        dtable[u].NumBits  = (uint8_t)  nbits;
+        dtable[u].NewState = (uint16_t) ((state << nbits) - table_size);
+    }
+}
+
+/// @summary Encodes one symbol, updating the coder state.
+static inline void fse_encode(
+    fse_bitwriter_t    *w,
+    uint32_t           *state,
+    fse_symbol_t const *tt,
+    uint16_t const     *state_table)
+{
+    uint32_t nbits = (*state + tt->DeltaNumBits) >> 16;
+    fse_bits_add(w, *state, nbits);
+    *state = state_table[(int32_t) (*state >> nbits) + tt->DeltaFindState];
+}
+
+/// @summary Entropy codes a single block.
+/// @param dst The destination buffer, positioned after the block type tag.
+/// @param src The source bytes.
+/// @param n The number of source bytes, at most FSE_BLOCK_SIZE.
+/// @param count The 256-element symbol histogram for the block.
+/// @param max_symbol The largest symbol value present.
+/// @param limit The maximum number of bytes to write. If the coded block may
+/// exceed this, nothing is written.
+/// @return The number of bytes written, or zero if the block should be stored.
+static size_t fse_compress_block(
+    uint8_t        * restrict dst,
+    uint8_t  const * restrict src,
+    size_t                    n,
+    uint32_t const * restrict count,
+    uint32_t                  max_symbol,
+    size_t                    limit)
+{
+    uint16_t      norm[256];
+    uint16_t      state_table[1U << FSE_MAX_TABLE_LOG];
+    fse_symbol_t  symbol_tt[256];
+    uint32_t      table_log = fse_table_log(n, max_symbol);
+    uint8_t      *out       = dst;
+
+    fse_normalize(norm, count, n, max_symbol, table_log);
+    fse_build_encoder(state_table, symbol_tt, norm, max_symbol, table_log);
+
+    // compute an upper bound on the coded size before writing anything,
+    // so that incompressible blocks are detected up front.
+    uint64_t max_bits = FSE_NUM_STATES * table_log + 8;
+    size_t   hdr_size = 2 + 4;
+    for (uint32_t s = 0; s <= max_symbol; ++s)
+    {
+        if (count[s] != 0)
+            max_bits += (uint64_t) count[s] * (table_log - fse_highbit(norm[s]) + 1);
+        hdr_size += (norm[s] < 128) ? 1 : 2;
+    }
+    if (hdr_size + FSE_BITSTREAM_PAD + (size_t) ((max_bits + 7) >> 3) >= limit)
+        return 0;
+
+    // header: table log, max symbol, normalized counts, bitstream size.
+    *out++ = (uint8_t) table_log;
+    *out++ = (uint8_t) max_symbol;
+    for (uint32_t s = 0; s <= max_symbol; ++s)
+    {
+        if (norm[s] < 128)
+        {
+            *out++ = (uint8_t) norm[s];
+        }
+        else
+        {
+            *out++ = (uint8_t) ((norm[s] & 0x7F) | 0x80);
+            *out++ = (uint8_t) (norm[s] >> 7);
+        }
+    }
+    uint8_t *size_ptr = out;
+    out += 4;
+
+    fse_bitwriter_t w;
+    w.Bits  = 0;
+    w.Count = 0;
+    w.Ptr   = out;
+    memset(w.Ptr, 0, FSE_BITSTREAM_PAD);
+    w.Ptr  += FSE_BITSTREAM_PAD;
+
+    // symbols are coded last-to-first so that they decode first-to-last.
+    // at most four symbols of up to 12 bits each are added between flushes.
+    uint32_t const table_size = 1U << table_log;
+    uint32_t       state[FSE_NUM_STATES] = { table_size, table_size, table_size, table_size };
+    size_t         i = n;
+    while ((i & (FSE_NUM_STATES - 1)) != 0)
+    {
+        --i;
+        fse_encode(&w, &state[i & 3], &symbol_tt[src[i]], state_table);
+        fse_bits_flush(&w);
+    }
+    while (i > 0)
+    {
+        fse_encode(&w, &state[3], &symbol_tt[src[i - 1]], state_table);
+        fse_encode(&w, &state[2], &symbol_tt[src[i - 2]], state_table);
+        fse_encode(&w, &state[1], &symbol_tt[src[i - 3]], state_table);
+        fse_encode(&w, &state[0], &symbol_tt[src[i - 4]], state_table);
+        fse_bits_flush(&w);
+        i -= 4;
+    }
+
+    // store the final states, in reverse order of the decoder reading them,
+    // followed by a single set bit marking the end of the stream.
+    fse_bits_add(&w, state[3], table_log);
+    fse_bits_add(&w, state[2], table_log);
+    fse_bits_flush(&w);
+    fse_bits_add(&w, state[1], table_log);
+    fse_bits_add(&w, state[0], table_log);
+    fse_bits_add(&w, 1, 1);
+    fse_bits_flush(&w);
+    if (w.Count > 0) w.Ptr++;
+
+    uint32_t bitstream_size = (uint32_t) (w.Ptr - out);
+    size_ptr[0] = (uint8_t) (bitstream_size >>  0);
+    size_ptr[1] = (uint8_t) (bitstream_size >>  8);
+    size_ptr[2] = (uint8_t) (bitstream_size >> 16);
+    size_ptr[3] = (uint8_t) (bitstream_size >> 24);
+    return (size_t) (w.Ptr - dst);
+}
+
+/// @summary Decodes a single entropy coded block.
+/// @param dst The destination buffer.
+/// @param src The source buffer, positioned after the block type tag.
+/// @param src_size The number of bytes available at @a src.
+/// @param n The exact number of bytes to decode.
+/// @return The number of source bytes consumed, or zero if the block is
+/// corrupt or extends past the end of the source buffer.
+static size_t fse_decompress_block(
+    uint8_t        * restrict dst,
+    uint8_t  const * restrict src,
+    size_t                    src_size,
+    size_t                    n)
+{
+    fse_decode_t   dtable[1U << FSE_MAX_TABLE_LOG];
+    uint16_t       norm[256];
+    uint8_t const *in         = src;
+    uint8_t const *end        = src + src_size;
+    uint32_t       total      = 0;
+    if (src_size < 2)
+        return 0;
+    uint32_t       table_log  = *in++;
+    uint32_t       max_symbol = *in++;
+    if (table_log < FSE_MIN_TABLE_LOG || table_log > FSE_MAX_TABLE_LOG)
+        return 0;
+
+    for (uint32_t s = 0; s <= max_symbol; ++s)
+    {
+        if (in >= end)
+            return 0;
+        uint32_t v = *in++;
+        if (v & 0x80)
+        {
+            if (in >= end)
+                return 0;
+            v = (v & 0x7F) | ((uint32_t) *in++ << 7);
+        }
+        norm[s] = (uint16_t) v;
+        total  += v;
+    }
+    if (total != (1U << table_log) || (size_t) (end - in) < 4)
+        return 0;
+
+    uint32_t bitstream_size = (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+    in += 4;
+    if (bitstream_size < FSE_BITSTREAM_PAD + 1 || bitstream_size > (size_t) (end - in) || in[bitstream_size - 1] == 0)
+        return 0;
+
+    fse_build_decoder(dtable, norm, max_symbol, table_log);
+
+    // position the reader on the end mark, then read the initial states.
+    fse_bitreader_t r;
+    r.Start    = in;
+    r.Ptr      = in + bitstream_size - 8;
+    r.Bits     = fse_read64(r.Ptr);
+    r.Consumed = 8 - fse_highbit(in[bitstream_size - 1]);
+    uint32_t s0 = fse_bits_read(&r, table_log);
+    uint32_t s1 = fse_bits_read(&r, table_log);
+    if (!fse_bits_reload(&r))
+        return 0;
+    uint32_t s2 = fse_bits_read(&r, table_log);
+    uint32_t s3 = fse_bits_read(&r, table_log);
+
+    // each state is an independent dependency chain, so the four table
+    // lookups in an iteration can proceed in parallel.
+    size_t i = 0;
+    for ( ; i + FSE_NUM_STATES <= n; i += FSE_NUM_STATES)
+    {
+        if (!fse_bits_reload(&r))
+            return 0;
+        fse_decode_t d0 = dtable[s0];
+        fse_decode_t d1 = dtable[s1];
+        fse_decode_t d2 = dtable[s2];
+        fse_decode_t d3 = dtable[s3];
+        dst[i + 0] = d0.Symbol;
+        dst[i + 1] = d1.Symbol;
+        dst[i + 2] = d2.Symbol;
+        dst[i + 3] = d3.Symbol;
+        s0 = d0.NewState + fse_bits_read(&r, d0.NumBits);
+        s1 = d1.NewState + fse_bits_read(&r, d1.NumBits);
+        s2 = d2.NewState + fse_bits_read(&r, d2.NumBits);
+        s3 = d3.NewState + fse_bits_read(&r, d3.NumBits);
+    }
+    uint32_t state[FSE_NUM_STATES] = { s0, s1, s2, s3 };
+    for ( ; i < n; ++i)
+    {
+        if (!fse_bits_reload(&r))
+            return 0;
+        fse_decode_t d = dtable[state[i & 3]];
+        dst[i] = d.Symbol;
+        state[i & 3] = d.NewState + fse_bits_read(&r, d.NumBits);
+    }
+    return (size_t) (in - src) + bitstream_size;
+}
+
 size_t compression_bound(size_t input_size)
 {
-    (void) input_size;
-    return 0;
+    // a block is never larger than its stored form; the final flush of the
+    // bit writer may touch up to eight bytes past the end of the last block.
+    size_t nblocks = (input_size + FSE_BLOCK_SIZE - 1) / FSE_BLOCK_SIZE;
+    return input_size + nblocks + 8;
 }
 
 size_t compress_data(void * restrict dst, void const * restrict src, size_t n)
 {
-    (void) dst;
-    (void) src;
-    (void) n;
-    return 0;
+    uint8_t       *out = (uint8_t      *) dst;
+    uint8_t const *in  = (uint8_t const*) src;
+    while (n > 0)
+    {
+        size_t   block_size = (n < FSE_BLOCK_SIZE) ? n : FSE_BLOCK_SIZE;
+        uint32_t count[256] = { 0 };
+        uint32_t max_symbol = 0;
+        size_t   coded      = 0;
+
+        for (size_t i = 0; i < block_size; ++i)
+            count[in[i]]++;
+        for (uint32_t s = 0; s < 256; ++s)
+        {
+            if (count[s] != 0) max_symbol = s;
+        }
+
+        if (count[in[0]] == block_size)
+        {   // the block is a single repeated byte.
+            out[0] = FSE_BLOCK_RLE;
+            out[1] = in[0];
+            coded  = 1;
+        }
+        else if ((coded = fse_compress_block(out + 1, in, block_size, count, max_symbol, block_size)) != 0)
+        {
+            out[0] = FSE_BLOCK_FSE;
+        }
+        else
+        {   // the block is incompressible; store it.
+            out[0] = FSE_BLOCK_RAW;
+            memcpy(out + 1, in, block_size);
+            coded  = block_size;
+        }
+        out += coded + 1;
+        in  += block_size;
+        n   -= block_size;
+    }
+    return (size_t) (out - (uint8_t*) dst);
 }
 
-size_t decompress_data(void * restrict dst, void const * restrict src, size_t n)
+size_t decompress_data(void * restrict dst, void const * restrict src, size_t src_size, size_t n)
 {
-    (void) dst;
-    (void) src;
-    (void) n;
-    return 0;
+    uint8_t       *out = (uint8_t      *) dst;
+    uint8_t const *in  = (uint8_t const*) src;
+    uint8_t const *end = in + src_size;
+    size_t         len = n;
+    while (n > 0)
+    {
+        size_t block_size = (n < FSE_BLOCK_SIZE) ? n : FSE_BLOCK_SIZE;
+        size_t consumed   = 0;
+        if (in >= end)
+            return 0;
+        size_t avail      = (size_t) (end - in) - 1;
+        switch (*in++)
+        {
+            case FSE_BLOCK_RAW:
+                if (avail < block_size)
+                    return 0;
+                memcpy(out, in, block_size);
+                consumed = block_size;
+                break;
+            case FSE_BLOCK_RLE:
+                if (avail < 1)
+                    return 0;
+                memset(out, in[0], block_size);
+                consumed = 1;
+                break;
+            case FSE_BLOCK_FSE:
+                consumed = fse_decompress_block(out, in, avail, block_size);
+                break;
+            default:
+                break;
+        }
+        if (consumed == 0)
+            return 0;
+        out += block_size;
+        in  += consumed;
+        n   -= block_size;
+    }
+    return len;
 }
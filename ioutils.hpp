@@ -280,9 +280,11 @@ size_t   compression_bound(size_t input_size);
 
 /// @summary Compresses input data using the Finite State Entropy system:
 /// http://fastcompression.blogspot.com/2014/01/fse-decoding-how-it-works.html
-/// The compression is lossless.
+/// The compression is lossless. The input is split into 64KB blocks, each of
+/// which is stored raw, as a single repeated byte, or entropy coded with its
+/// own normalized probability table.
 /// @param dst The destination buffer. This should be at least as many bytes as
-/// returned by calling compression_bound_fse(size_in_bytes).
+/// returned by calling compression_bound(size_in_bytes).
 /// @param src The source data buffer.
 /// @param size_in_bytes The size of the source data, in bytes.
 /// @return The number of bytes of compressed data written to @a dst.
@@ -296,11 +298,15 @@ size_t   compress_data(
 /// @param dst The destination buffer. This should be large enough to hold the
 /// entire uncompressed output.
 /// @param src The buffer containing the compressed source data.
+/// @param src_size The size of the compressed source data, in bytes. No byte
+/// past the end of @a src is read.
 /// @param size_in_bytes The exact size of the uncompressed output, in bytes.
-/// @return The number of bytes of decompressed data written to @a dst.
+/// @return The number of bytes of decompressed data written to @a dst, or zero
+/// if the compressed data is corrupt or truncated.
 size_t   decompress_data(
     void       * restrict dst,
     void const * restrict src,
+    size_t                src_size,
     size_t                size_in_bytes);
 
 // the compression API needs to support streaming.
@@ -1,183 +1,1789 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ioutils.hpp"
 #include "imutils.hpp"
 
-template <typename T>
-static void print_8x8_dec(T const *I)
+static void random_coefficients(int16_t *C, size_t n)
 {
-    for (size_t row = 0, i = 0; row < 8; ++row, i += 8)
+    // dense, sparse, full-range, DC-only and top-left 4x4 coefficient blocks.
+    for (size_t i = 0; i < 64; ++i)
     {
-        printf(
-            "% 5d % 5d % 5d % 5d  % 5d % 5d % 5d % 5d\n",
-            (int) I[i+0], (int) I[i+1], (int) I[i+2], (int) I[i+3],
-            (int) I[i+4], (int) I[i+5], (int) I[i+6], (int) I[i+7]);
+        switch (n % 5)
+        {
+            case 0:  C[i] = (int16_t) ((rand() % 2048) - 1024); break;
+            case 1:  C[i] = (int16_t) ((i < 10) ? (rand() % 64) - 32 : 0); break;
+            case 2:  C[i] = (int16_t) ((rand() % 65536) - 32768); break;
+            case 3:  C[i] = (int16_t) ((i == 0) ? (rand() % 65536) - 32768 : 0); break;
+            default: C[i] = (int16_t) (((i & 7) < 4 && i < 32) ? (rand() % 65536) - 32768 : 0); break;
+        }
+    }
+}
+
+static void random_samples(int16_t *S, size_t n)
+{
+    // smooth, noisy and saturated sample blocks.
+    for (size_t i = 0; i < 64; ++i)
+    {
+        switch (n % 3)
+        {
+            case 0:  S[i] = (int16_t) ((i * 4) - 128 + (rand() % 8)); break;
+            case 1:  S[i] = (int16_t) ((rand() % 511) - 255); break;
+            default: S[i] = (int16_t) ((rand() & 1) ? 255 : -255); break;
+        }
+    }
+}
+
+static bool nearly_equal(float const *a, float const *b, size_t n)
+{
+    // outputs near zero are the difference of much larger intermediates, so
+    // the tolerance scales with the largest magnitude in the block.
+    float m = 1.0f;
+    for (size_t i = 0; i < n; ++i)
+        m = (fabsf(a[i]) > m) ? fabsf(a[i]) : m;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (fabsf(a[i] - b[i]) > m * 1e-5f)
+            return false;
+    }
+    return true;
+}
+
+static bool test_kernels(int32_t isa)
+{
+    // compare the kernels for the given ISA against the portable kernels
+    // for every quality level; the integer output must be bit-for-bit
+    // identical.
+    size_t  const nblocks = 40;
+    size_t  failed = 0;
+    size_t  tested = 0;
+    int16_t Qidct[2][64];
+    int16_t Qfdct[2][64];
+    int16_t C[nblocks * 64];
+    int16_t S[nblocks * 64];
+    int16_t R[nblocks * 64];
+    int16_t D[nblocks * 64];
+    float   Fq[2][64];
+    float   Fs[nblocks * 64];
+    float   Fr[nblocks * 64];
+    float   Fd[nblocks * 64];
+    srand(1);
+    for (int quality = 1; quality <= 100; ++quality)
+    {
+        qtables_decode(Qidct[0], Qidct[1], quality);
+        qtables_encode(Qfdct[0], Qfdct[1], quality);
+        for (size_t n = 0; n < nblocks; ++n)
+        {
+            random_coefficients(&C[n * 64], n);
+            random_samples(&S[n * 64], n);
+        }
+        for (size_t q = 0; q < 2; ++q)
+        {
+            // the float kernels may fuse multiply-adds, so they are only
+            // required to match the portable kernels to within rounding.
+            qtables_encode(Fq[0], Fq[1], quality);
+            for (size_t i = 0; i < nblocks * 64; ++i)
+                Fs[i] = (float) S[i];
+            select_kernels(CPU_ISA_SCALAR);
+            fdct8x8fq_batch(Fr, Fs, Fq[q], nblocks - 1);
+            select_kernels(isa);
+            fdct8x8fq_batch(Fd, Fs, Fq[q], nblocks - 1);
+            for (size_t n = 0; n < nblocks - 1; ++n, ++tested)
+                if (!nearly_equal(&Fr[n * 64], &Fd[n * 64], 64)) failed++;
+            qtables_decode(Fq[0], Fq[1], quality);
+            for (size_t i = 0; i < nblocks * 64; ++i)
+                Fs[i] = (float) C[i];
+            select_kernels(CPU_ISA_SCALAR);
+            idct8x8fd_batch(Fr, Fs, Fq[q], nblocks - 1);
+            select_kernels(isa);
+            idct8x8fd_batch(Fd, Fs, Fq[q], nblocks - 1);
+            for (size_t n = 0; n < nblocks - 1; ++n, ++tested)
+                if (!nearly_equal(&Fr[n * 64], &Fd[n * 64], 64)) failed++;
+
+            select_kernels(CPU_ISA_SCALAR);
+            for (size_t n = 0; n < nblocks; ++n)
+                idct8x8id(&R[n * 64], &C[n * 64], Qidct[q]);
+            select_kernels(isa);
+            for (size_t n = 0; n < nblocks; ++n)
+                idct8x8id(&D[n * 64], &C[n * 64], Qidct[q]);
+            for (size_t n = 0; n < nblocks; ++n, ++tested)
+                if (memcmp(&R[n * 64], &D[n * 64], 64 * sizeof(int16_t)) != 0) failed++;
+
+            // an end-of-block index of 64 forces the full transform, which
+            // must match the reduced DC-only and 4x4 paths taken above.
+            for (size_t n = 0; n < nblocks; ++n)
+                idct8x8id_eob(&D[n * 64], &C[n * 64], Qidct[q], 64);
+            for (size_t n = 0; n < nblocks; ++n, ++tested)
+                if (memcmp(&R[n * 64], &D[n * 64], 64 * sizeof(int16_t)) != 0) failed++;
+
+            // odd block count exercises both the batched and tail paths.
+            select_kernels(CPU_ISA_SCALAR);
+            fdct8x8iq_batch(R, S, Qfdct[q], nblocks - 1);
+            select_kernels(isa);
+            fdct8x8iq_batch(D, S, Qfdct[q], nblocks - 1);
+            for (size_t n = 0; n < nblocks - 1; ++n, ++tested)
+                if (memcmp(&R[n * 64], &D[n * 64], 64 * sizeof(int16_t)) != 0) failed++;
+
+            // the reciprocal multiply-shift must match truncating division
+            // of the unquantized transform, and the cached context tables.
+            quant_context_t const *ctx = quant_context(quality);
+            fdct8x8iq_batch(D, S, q ? &ctx->Chroma : &ctx->Luma, nblocks - 1);
+            for (size_t n = 0; n < nblocks - 1; ++n, ++tested)
+            {
+                int16_t T[64];
+                fdct8x8i(T, &S[n * 64]);
+                for (size_t i = 0; i < 64; ++i)
+                    T[i] /= Qfdct[q][i];
+                if (memcmp(T, &D[n * 64], sizeof(T)) != 0 || memcmp(&R[n * 64], &D[n * 64], sizeof(T)) != 0) failed++;
+            }
+        }
+    }
+    idct_counters_t counts;
+    idct_counters(&counts, true);
+    select_kernels(CPU_ISA_BEST);
+    printf("kernels (isa %d): %s (%u of %u blocks differ; idct paths dc %u, 4x4 %u, full %u)\n", (int) isa, failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested,
+        (unsigned) counts.DcOnly, (unsigned) counts.Sparse4x4, (unsigned) counts.Full);
+    return (failed == 0);
+}
+
+static bool test_quantize(void)
+{
+    // the quantizers generated for the shipped quality levels and the
+    // runtime-table quantizer used for the others must both match
+    // truncating division by the quality level's table.
+    size_t  const nblocks = 40;
+    size_t  failed = 0;
+    size_t  tested = 0;
+    int16_t Qfdct[2][64];
+    srand(5);
+    for (int quality = 1; quality <= 100; ++quality)
+    {
+        qtables_encode(Qfdct[0], Qfdct[1], quality);
+        for (size_t n = 0; n < nblocks; ++n)
+        {
+            int16_t C[64];
+            int16_t T[64];
+            random_coefficients(C, n);
+            for (size_t q = 0; q < 2; ++q, ++tested)
+            {
+                memcpy(T, C, sizeof(T));
+                quantize8x8i(T, quality, q != 0);
+                for (size_t i = 0; i < 64; ++i)
+                {
+                    if (T[i] != C[i] / Qfdct[q][i])
+                    {
+                        failed++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // the divisor-table entry points cache reciprocal tables per thread.
+    // when a third table was cached after the luma table, looking up the
+    // chroma table must not evict the luma table: encoding must still match
+    // truncating division of the unquantized transform, which a table of
+    // ones produces.
+    for (int quality = 10; quality <= 100; quality += 30, ++tested)
+    {
+        int16_t Qother[2][64], Qones[64];
+        uint8_t RGBA[1024], A[256];
+        int16_t Y[256], Co[64], Cg[64], T[64];
+        int16_t Yr[256], Cor[64], Cgr[64];
+        for (size_t i = 0; i < 64; ++i)
+            Qones[i] = 1;
+        for (size_t i = 0; i < 1024; ++i)
+            RGBA[i] = (uint8_t) (rand() & 0xFF);
+        qtables_encode(Qfdct[0], Qfdct[1], quality);
+        qtables_encode(Qother[0], Qother[1], 101 - quality);
+        encode16x16i(Yr, Cor, Cgr, A, Qones, Qones, RGBA);
+        fdct8x8iq(T, Yr, Qother[0]);
+        fdct8x8iq(T, Yr, Qfdct[0]);
+        fdct8x8iq(T, Yr, Qother[1]);
+        encode16x16i(Y, Co, Cg, A, Qfdct[0], Qfdct[1], RGBA);
+        bool ok = true;
+        for (size_t i = 0; i < 256; ++i)
+            ok = ok && Y[i] == Yr[i] / Qfdct[0][i % 64];
+        for (size_t i = 0; i < 64; ++i)
+            ok = ok && Co[i] == Cor[i] / Qfdct[1][i] && Cg[i] == Cgr[i] / Qfdct[1][i];
+
+        // divisors of zero or less quantize as if they were one.
+        int16_t S[64], U[64];
+        memcpy(Qother[0], Qfdct[0], sizeof(Qother[0]));
+        Qother[0][0] = 0;
+        Qother[0][9] = -3;
+        for (size_t i = 0; i < 64; ++i)
+            S[i] = (int16_t) (rand() % 256);
+        fdct8x8iq(U, S, Qones);
+        fdct8x8iq(T, S, Qother[0]);
+        for (size_t i = 0; i < 64; ++i)
+            ok = ok && T[i] == U[i] / ((i == 0 || i == 9) ? 1 : Qfdct[0][i]);
+        if (!ok) failed++;
+    }
+    printf("quantize: %s (%u of %u blocks differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
+
+static bool test_tile(void)
+{
+    // encode and decode a whole tile, and compare the results against the
+    // per-MCU encode16x16i() and decode16x16i_rgba() functions.
+    size_t const  W = 80, H = 48, P = W * 4 + 32;
+    size_t        failed = 0;
+    size_t        tested = 0;
+    image_tile_t  tile;
+    uint8_t      *src  = (uint8_t*) malloc(P * H);
+    uint8_t      *dst  = (uint8_t*) malloc(P * H);
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth   = W;
+    tile.TileHeight  = H;
+    tile.BytesPerRow = P;
+    tile.Pixels      = src;
+    size_t   nbytes  = tile_stream_size(&tile);
+    uint8_t *stream  = (uint8_t*) malloc(nbytes);
+    srand(1);
+    for (size_t i = 0; i < P * H; ++i)
+        src[i] = (uint8_t) (((i % P) + (i / P) * 3 + (rand() % 16)) & 0xFF);
+
+    for (int quality = 1; quality <= 100; quality += 33)
+    {
+        int16_t Qe[2][64], Qd[2][64];
+        qtables_encode(Qe[0], Qe[1], quality);
+        qtables_decode(Qd[0], Qd[1], quality);
+        if (encode_tile(stream, nbytes, &tile, quality) != nbytes) failed++;
+        tile.Pixels = dst;
+        if (!decode_tile(&tile, stream, nbytes, quality)) failed++;
+        tile.Pixels = src;
+
+        size_t         mcus = (W / 16) * (H / 16);
+        int16_t const *Ys   = (int16_t const*) stream;
+        int16_t const *Os   = Ys + mcus * 256;
+        int16_t const *Gs   = Os + mcus * 64;
+        uint8_t const *As   = (uint8_t const*) (Gs + mcus * 64);
+        for (size_t m = 0; m < mcus; ++m, ++tested)
+        {
+            uint8_t RGBA[1024], A[256], D[1024];
+            int16_t Y[256], Co[64], Cg[64];
+            size_t  x = (m % (W / 16)) * 64, y = (m / (W / 16)) * 16;
+            for (size_t r = 0; r < 16; ++r)
+                memcpy(&RGBA[r * 64], &src[(y + r) * P + x], 64);
+            encode16x16i(Y, Co, Cg, A, Qe[0], Qe[1], RGBA);
+            decode16x16i_rgba(D, Y, Co, Cg, A, Qd[0], Qd[1]);
+            bool ok = memcmp(Y,  &Ys[m * 256], sizeof(Y))  == 0 &&
+                      memcmp(Co, &Os[m * 64],  sizeof(Co)) == 0 &&
+                      memcmp(Cg, &Gs[m * 64],  sizeof(Cg)) == 0 &&
+                      memcmp(A,  &As[m * 256], sizeof(A))  == 0;
+            for (size_t r = 0; r < 16; ++r)
+                ok = ok && memcmp(&D[r * 64], &dst[(y + r) * P + x], 64) == 0;
+            if (!ok) failed++;
+        }
+    }
+    free(stream);
+    free(dst);
+    free(src);
+    printf("tile: %s (%u of %u MCUs differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
+
+static bool test_compress(void)
+{
+    // round-trip the coefficient stream of a tile through the entropy coder
+    // at several quality levels, and a few degenerate inputs. truncated data
+    // must be rejected, and neither it nor corrupted data may be read past
+    // its end; each is decoded from a buffer of its exact size.
+    size_t const  W = 128, H = 128, P = W * 4;
+    size_t        failed = 0;
+    size_t        tested = 0;
+    image_tile_t  tile;
+    uint8_t      *src  = (uint8_t*) malloc(P * H);
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth   = W;
+    tile.TileHeight  = H;
+    tile.BytesPerRow = P;
+    tile.Pixels      = src;
+    size_t   nbytes  = tile_stream_size(&tile);
+    size_t   bound   = compression_bound(nbytes);
+    uint8_t *stream  = (uint8_t*) malloc(nbytes);
+    uint8_t *packed  = (uint8_t*) malloc(bound);
+    uint8_t *output  = (uint8_t*) malloc(nbytes);
+    srand(1);
+    for (size_t i = 0; i < P * H; ++i)
+        src[i] = (uint8_t) ((i % 4) == 3 ? 0xFF : (((i % P) / 4 + (i / P) * 2 + (rand() % 8)) & 0xFF));
+
+    for (int quality = 0; quality <= 100; quality += 25)
+    {
+        size_t n = nbytes;
+        if (quality == 0)
+        {   // a buffer of random bytes, which must be stored.
+            for (size_t i = 0; i < n; ++i)
+                stream[i] = (uint8_t) rand();
+        }
+        else encode_tile(stream, nbytes, &tile, quality);
+
+        for (size_t size = n; size > 0; size = (size > 100) ? size / 7 : 0, ++tested)
+        {
+            size_t c = compress_data(packed, stream, size);
+            size_t d = decompress_data(output, packed, c, size);
+            if (c > bound || d != size || memcmp(output, stream, size) != 0)
+                failed++;
+            size_t const cuts[4] = { 0, 1, c / 2, c - 1 };
+            for (size_t k = 0; k < 4; ++k)
+            {
+                uint8_t *part = (uint8_t*) malloc(cuts[k] + 1);
+                memcpy(part, packed, cuts[k]);
+                if (decompress_data(output, part, cuts[k], size) != 0)
+                    failed++;
+                free(part);
+            }
+            uint8_t *bad = (uint8_t*) malloc(c);
+            for (size_t k = 0; k < 16; ++k)
+            {   // the result is unspecified, but must stay within the buffer.
+                memcpy(bad, packed, c);
+                bad[rand() % c] = (k & 1) ? 0xFF : (uint8_t) rand();
+                decompress_data(output, bad, c, size);
+            }
+            free(bad);
+            if (size == n && quality > 0)
+                printf("compress: quality %3d, %u -> %u bytes\n", quality, (unsigned) n, (unsigned) c);
+        }
+    }
+    memset(stream, 0x55, nbytes);
+    size_t c = compress_data(packed, stream, nbytes);
+    if (decompress_data(output, packed, c, nbytes) != nbytes || memcmp(output, stream, nbytes) != 0)
+        failed++;
+    tested++;
+
+    free(output);
+    free(packed);
+    free(stream);
+    free(src);
+    printf("compress: %s (%u of %u buffers differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
+
+static bool test_pack(void)
+{
+    // round-trip the coefficient blocks of a tile through the run-length
+    // packer, and compare the packed size against the dense coefficients.
+    size_t const  W = 128, H = 128, P = W * 4;
+    size_t const  blocks = (W / 16) * (H / 16) * 6;
+    size_t        failed = 0;
+    size_t        tested = 0;
+    image_tile_t  tile;
+    uint8_t      *src  = (uint8_t*) malloc(P * H);
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth   = W;
+    tile.TileHeight  = H;
+    tile.BytesPerRow = P;
+    tile.Pixels      = src;
+    size_t   nbytes  = tile_stream_size(&tile);
+    size_t   bound   = coefficient_pack_bound(blocks);
+    uint8_t *stream  = (uint8_t*) malloc(nbytes);
+    uint8_t *packed  = (uint8_t*) malloc(bound);
+    int16_t *output  = (int16_t*) malloc(blocks * 64 * sizeof(int16_t));
+    uint8_t *eob     = (uint8_t*) malloc(blocks);
+    uint8_t *entropy = (uint8_t*) malloc(compression_bound(bound));
+    srand(1);
+    for (size_t i = 0; i < P * H; ++i)
+        src[i] = (uint8_t) ((i % 4) == 3 ? 0xFF : (((i % P) / 4 + (i / P) * 2 + (rand() % 8)) & 0xFF));
+
+    for (int quality = 0; quality <= 100; quality += 25, ++tested)
+    {
+        int16_t const *coeff = (int16_t const*) stream;
+        if (quality == 0)
+        {   // full-range random coefficients; every block is dense.
+            for (size_t i = 0; i < blocks * 64; ++i)
+                ((int16_t*) stream)[i] = (int16_t) ((rand() % 65536) - 32768);
+        }
+        else encode_tile(stream, nbytes, &tile, quality);
+
+        size_t c = pack_coefficients(packed, coeff, blocks);
+        size_t d = unpack_coefficients(output, eob, packed, c, blocks);
+        bool  ok = (c <= bound && d == c && memcmp(output, coeff, blocks * 64 * sizeof(int16_t)) == 0);
+        for (size_t b = 0; ok && b < blocks; ++b)
+        {   // only an all-zero block has an empty end-of-block index.
+            bool zero = true;
+            for (size_t k = 0; k < 64; ++k)
+                zero = zero && coeff[b * 64 + k] == 0;
+            ok = eob[b] <= 64 && zero == (eob[b] == 0);
+        }
+        if (!ok) failed++;
+        if (unpack_coefficients(output, NULL, packed, c - 1, blocks) != 0)
+            failed++;
+        if (quality > 0)
+        {
+            size_t z = compress_data(entropy, packed, c);
+            printf("pack: quality %3d, %u -> %u bytes (%u compressed)\n", quality, (unsigned) (blocks * 128), (unsigned) c, (unsigned) z);
+        }
     }
-    printf("\n");
+    free(entropy);
+    free(eob);
+    free(output);
+    free(packed);
+    free(stream);
+    free(src);
+    printf("pack: %s (%u of %u tiles differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
 }
 
-static void print_8x8_hex(int16_t const *I)
+static bool test_alpha(void)
 {
-    for (size_t row = 0, i = 0; row < 8; ++row, i += 8)
+    // each block must select the expected mode, the lossless modes must
+    // round-trip exactly, smooth DCT-coded alpha must stay within the error
+    // of the luma path (+/-10 for a ramp at any quality), noise must fall
+    // back to raw since its coefficients pack larger than the samples, and
+    // truncated data must be rejected.
+    int32_t const  expect[5][2] =
     {
-        printf(
-            "%04X %04X %04X %04X  %04X %04X %04X %04X\n",
-            (int) I[i+0], (int) I[i+1], (int) I[i+2], (int) I[i+3],
-            (int) I[i+4], (int) I[i+5], (int) I[i+6], (int) I[i+7]);
+        { ALPHA_MODE_OPAQUE,   ALPHA_MODE_OPAQUE   },
+        { ALPHA_MODE_CONSTANT, ALPHA_MODE_CONSTANT },
+        { ALPHA_MODE_BINARY,   ALPHA_MODE_BINARY   },
+        { ALPHA_MODE_RAW,      ALPHA_MODE_DCT      },
+        { ALPHA_MODE_RAW,      ALPHA_MODE_RAW      }
+    };
+    quant_context_t const *Q = quant_context(90);
+    size_t   failed = 0;
+    size_t   tested = 0;
+    size_t   bound  = alpha_pack_bound();
+    uint8_t *enc    = (uint8_t*) malloc(bound);
+    uint8_t  src[256];
+    uint8_t  dec[256];
+    uint8_t  rgba[1024];
+    srand(1);
+    for (size_t k = 0; k < 5; ++k)
+    {
+        for (size_t i = 0; i < 256; ++i)
+        {
+            switch (k)
+            {
+                case 0:  src[i] = 0xFF; break;
+                case 1:  src[i] = 0x80; break;
+                case 2:  src[i] = ((i & 15) + (i >> 4) < 20) ? 0xFF : 0x00; break;
+                case 3:  src[i] = (uint8_t) ((i & 15) * 8 + (i >> 4) * 4 + 32); break;
+                default: src[i] = (uint8_t) (rand() & 0xFF); break;
+            }
+        }
+        for (size_t lossy = 0; lossy < 2; ++lossy, ++tested)
+        {
+            int32_t mode  = alpha_mode16x16(src, lossy ? &Q->Luma : NULL);
+            size_t  n     = encode_alpha16x16(enc, src, mode, &Q->Luma);
+            size_t  d     = decode_alpha16x16(dec, enc, n, Q->Luma.Qidct);
+            int32_t error = 0;
+            for (size_t i = 0; i < 256; ++i)
+            {
+                int32_t e = (int32_t) dec[i] - (int32_t) src[i];
+                error = (e < 0) ? ((-e > error) ? -e : error) : ((e > error) ? e : error);
+            }
+            bool ok = (mode == expect[k][lossy] && n <= bound && d == n);
+            ok = ok && ((mode != ALPHA_MODE_DCT) ? (error == 0) : (k != 3 || error <= 10));
+            ok = ok && decode_alpha16x16(dec, enc, n - 1, Q->Luma.Qidct) == 0;
+            if (!ok) failed++;
+            printf("alpha: block %u, %s: mode %d, %3u bytes, max error %d\n", (unsigned) k, lossy ? "lossy   " : "lossless", mode, (unsigned) n, error);
+        }
+
+        // rate control fixes the mode before the quality is known, and must
+        // make the same choice for these blocks.
+        image_tile_t tile;
+        tile_rate_t  rc;
+        memset(&tile, 0, sizeof(tile));
+        for (size_t i = 0; i < 256; ++i)
+        {
+            rgba[i * 4 + 0] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = (uint8_t) i;
+            rgba[i * 4 + 3] = src[i];
+        }
+        tile.TileWidth   = 16;
+        tile.TileHeight  = 16;
+        tile.BytesPerRow = 64;
+        tile.Pixels      = rgba;
+        if (!tile_rate_init(&rc, &tile, true) || rc.AlphaModes[0] != expect[k][1])
+            failed++;
+        tile_rate_free(&rc);
+        tested++;
     }
-    printf("\n");
+
+    // a NULL alpha channel decodes as opaque.
+    int16_t Y[256], Co[64], Cg[64];
+    uint8_t rgba0[1024], rgba1[1024];
+    for (size_t b = 0; b < 4; ++b)
+        random_coefficients(&Y[b * 64], 1);
+    random_coefficients(Co, 1);
+    random_coefficients(Cg, 1);
+    memset(src, 0xFF, 256);
+    decode16x16i_rgba(rgba0, Y, Co, Cg, src,  Q->Luma.Qidct, Q->Chroma.Qidct);
+    decode16x16i_rgba(rgba1, Y, Co, Cg, NULL, Q->Luma.Qidct, Q->Chroma.Qidct);
+    if (memcmp(rgba0, rgba1, sizeof(rgba0)) != 0)
+        failed++;
+    tested++;
+    free(enc);
+    printf("alpha: %s (%u of %u blocks differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
 }
 
-template <typename T>
-static void print_16x16_dec(T const *B)
+static bool test_rate(void)
 {
-    for (size_t row = 0, i = 0; row < 16; ++row, i += 16)
+    // the predicted page size must be exact, pages with lossless alpha must
+    // decode to the same pixels as the planar stream, pages with lossy alpha
+    // must only differ in the alpha of DCT-coded MCUs, and the budgeted
+    // encoder must select the highest quality that fits.
+    size_t const  W = 128, H = 96, P = W * 4 + 16;
+    size_t        failed = 0;
+    size_t        tested = 0;
+    image_tile_t  tile;
+    image_tile_t  out;
+    tile_rate_t   rc;
+    tile_rate_t   rl;
+    uint8_t      *src  = (uint8_t*) malloc(P * H);
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth   = W;
+    tile.TileHeight  = H;
+    tile.BytesPerRow = P;
+    tile.Pixels      = src;
+    out              = tile;
+    out.BytesPerRow  = W * 4;
+    size_t   nbytes  = tile_stream_size(&tile);
+    uint8_t *stream  = (uint8_t*) malloc(nbytes);
+    uint8_t *page    = (uint8_t*) malloc(nbytes * 2);
+    uint8_t *expect  = (uint8_t*) malloc(W * H * 4);
+    uint8_t *actual  = (uint8_t*) malloc(W * H * 4);
+    srand(1);
+    for (size_t i = 0; i < P * H; ++i)
+    {   // cycle the MCUs through opaque, constant, binary and smooth alpha.
+        size_t x = (i % P) / 4, y = i / P;
+        size_t a = 0xFF;
+        switch ((x / 16 + y / 16) % 4)
+        {
+            case 1:  a = 0x40; break;
+            case 2:  a = ((x ^ y) & 4) ? 0xFF : 0x00; break;
+            case 3:  a = 0xFF - y; break;
+            default: break;
+        }
+        src[i] = (uint8_t) ((i % 4) == 3 ? a : ((x + y * 2 + (rand() % 32)) & 0xFF));
+    }
+
+    tile_rate_init(&rc, &tile, true);
+    tile_rate_init(&rl, &tile, false);
+    for (int quality = 1; quality <= 100; quality += 11, ++tested)
+    {
+        encode_tile(stream, nbytes, &tile, quality);
+        out.Pixels = expect;
+        decode_tile(&out, stream, nbytes, quality);
+        out.Pixels = actual;
+        size_t n = tile_rate_pack(page, nbytes * 2, &rl, quality);
+        if (n == 0 || n != tile_rate_size(&rl, quality) || !decode_tile_page(&out, page, nbytes * 2, quality) ||
+            memcmp(expect, actual, W * H * 4) != 0 || decode_tile_page(&out, page, n - 1, quality))
+            failed++;
+        size_t m = tile_rate_pack(page, nbytes * 2, &rc, quality);
+        if (m == 0 || m != tile_rate_size(&rc, quality) || !decode_tile_page(&out, page, nbytes * 2, quality) ||
+            decode_tile_page(&out, page, m - 1, quality))
+            failed++;
+        for (size_t i = 0; i < W * H * 4; ++i)
+        {   // only the smooth alpha blocks are lossy.
+            size_t x = (i % (W * 4)) / 4, y = i / (W * 4);
+            if (expect[i] != actual[i] && ((i % 4) != 3 || (x / 16 + y / 16) % 4 != 3))
+            {
+                failed++;
+                break;
+            }
+        }
+        if (quality % 3 == 1)
+            printf("rate: quality %3d, %5u bytes with lossless alpha, %5u bytes with lossy alpha\n", quality, (unsigned) n, (unsigned) m);
+    }
+    size_t const budgets[] = { 8192, 12800, 14336, 16384, 24576, 65536 };
+    for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); ++i, ++tested)
+    {
+        int    q = 0;
+        size_t n = encode_tile_budget(page, budgets[i], &tile, &q);
+        bool  ok = (q == 0) ? (n == 0 && tile_rate_size(&rc, 1) > budgets[i])
+                            : (n > 0 && n <= budgets[i] && (q == 100 || tile_rate_size(&rc, q + 1) > budgets[i]));
+        if (!ok) failed++;
+        printf("rate: budget %5u bytes -> quality %3d, %5u bytes\n", (unsigned) budgets[i], q, (unsigned) n);
+    }
+
+    // with RDO quantization the predicted size must still be exact, and when
+    // the budget limits the quality, the page must decode at least as close
+    // to the source as without.
+    tile_rate_t rr;
+    tile_rate_init(&rr, &tile, true);
+    rr.Lambda = 6.0f;
+    for (int quality = 1; quality <= 100; quality += 11, ++tested)
     {
-        printf(
-            "%3d %3d %3d %3d  %3d %3d %3d %3d  %3d %3d %3d %3d  %3d %3d %3d %3d\n",
-            (int) B[i+0],  (int) B[i+1],  (int) B[i+2],  (int) B[i+3],
-            (int) B[i+4],  (int) B[i+5],  (int) B[i+6],  (int) B[i+7],
-            (int) B[i+8],  (int) B[i+9],  (int) B[i+10], (int) B[i+11],
-            (int) B[i+12], (int) B[i+13], (int) B[i+14], (int) B[i+15]);
+        size_t n = tile_rate_pack(page, nbytes * 2, &rr, quality);
+        if (n == 0 || n != tile_rate_size(&rr, quality) || !decode_tile_page(&out, page, n, quality))
+            failed++;
     }
-    printf("\n");
+    for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); ++i, ++tested)
+    {
+        int      q0 = 0, q1 = 0;
+        uint64_t e0 = 0, e1 = 0;
+        size_t   n0 = encode_tile_budget(page, budgets[i], &tile, &q0);
+        out.Pixels  = expect;
+        if (n0 != 0) decode_tile_page(&out, page, n0, q0);
+        size_t   n1 = encode_tile_budget_rdo(page, budgets[i], &tile, rr.Lambda, &q1);
+        out.Pixels  = actual;
+        if (n1 != 0) decode_tile_page(&out, page, n1, q1);
+        for (size_t y = 0; y < H; ++y)
+        {
+            for (size_t x = 0; x < W * 4; ++x)
+            {
+                int32_t d0 = (int32_t) expect[y * W * 4 + x] - src[y * P + x];
+                int32_t d1 = (int32_t) actual[y * W * 4 + x] - src[y * P + x];
+                e0 += (uint64_t) (d0 * d0);
+                e1 += (uint64_t) (d1 * d1);
+            }
+        }
+        bool ok = (q1 == 0) ? (n1 == 0 && tile_rate_size(&rr, 1) > budgets[i])
+                            : (n1 > 0 && n1 <= budgets[i] && (q1 == 100 || tile_rate_size(&rr, q1 + 1) > budgets[i]) && (n0 == 0 || q0 == 100 || e1 <= e0));
+        if (!ok) failed++;
+        printf("rate: budget %5u bytes -> quality %3d, %5u bytes with RDO, error %5.2f vs %5.2f\n", (unsigned) budgets[i], q1, (unsigned) n1,
+            (double) e1 / (W * H * 4), (double) e0 / (W * H * 4));
+    }
+    tile_rate_free(&rr);
+    tile_rate_free(&rl);
+    tile_rate_free(&rc);
+    free(actual);
+    free(expect);
+    free(page);
+    free(stream);
+    free(src);
+    printf("rate: %s (%u of %u pages differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
 }
 
-static void print_16x16_hex(uint8_t const *B)
+static void bc_decode_block(uint8_t *rgba, size_t pitch, uint8_t const *block, int32_t format)
 {
-    for (size_t row = 0, i = 0; row < 16; ++row, i += 16)
+    // a straightforward decoder for BC1 and BC3 blocks, as the hardware
+    // would sample them, used as the reference for the transcoder.
+    uint8_t const *color = (format == BC_FORMAT_BC1) ? block : block + 8;
+    uint32_t c[2]  = { (uint32_t) (color[0] | (color[1] << 8)), (uint32_t) (color[2] | (color[3] << 8)) };
+    int32_t  p[4][3];
+    for (size_t i = 0; i < 2; ++i)
+    {
+        p[i][0] = (int32_t) (((c[i] >> 11) & 31) << 3 | ((c[i] >> 13) & 7));
+        p[i][1] = (int32_t) (((c[i] >>  5) & 63) << 2 | ((c[i] >>  9) & 3));
+        p[i][2] = (int32_t) (( c[i]        & 31) << 3 | ((c[i] >>  2) & 7));
+    }
+    for (size_t k = 0; k < 3; ++k)
     {
-        printf(
-            "%02X %02X %02X %02X  %02X %02X %02X %02X  %02X %02X %02X %02X  %02X %02X %02X %02X\n",
-            (int) B[i+0],  (int) B[i+1],  (int) B[i+2],  (int) B[i+3],
-            (int) B[i+4],  (int) B[i+5],  (int) B[i+6],  (int) B[i+7],
-            (int) B[i+8],  (int) B[i+9],  (int) B[i+10], (int) B[i+11],
-            (int) B[i+12], (int) B[i+13], (int) B[i+14], (int) B[i+15]);
+        bool four = (c[0] > c[1]) || (format != BC_FORMAT_BC1);
+        p[2][k] = four ? (2 * p[0][k] + p[1][k]) / 3 : (p[0][k] + p[1][k]) / 2;
+        p[3][k] = four ? (p[0][k] + 2 * p[1][k]) / 3 : 0;
+    }
+    int32_t  a[8] = { block[0], block[1] };
+    uint64_t abits = 0;
+    for (size_t i = 0; i < 6; ++i)
+        abits |= (uint64_t) block[2 + i] << (i * 8);
+    for (int32_t k = 1; k < 7; ++k)
+        a[k + 1] = (a[0] > a[1]) ? ((7 - k) * a[0] + k * a[1]) / 7 : ((k < 5) ? ((5 - k) * a[0] + k * a[1]) / 5 : (k == 5 ? 0 : 255));
+    uint32_t ix = (uint32_t) (color[4] | (color[5] << 8) | (color[6] << 16) | ((uint32_t) color[7] << 24));
+    for (size_t i = 0; i < 16; ++i)
+    {
+        uint8_t *px = rgba + (i >> 2) * pitch + (i & 3) * 4;
+        int32_t const *e = p[(ix >> (i * 2)) & 3];
+        int32_t  A = (format == BC_FORMAT_BC1) ? 255 : a[(abits >> (i * 3)) & 7];
+        if (format == BC_FORMAT_BC3_YCOCG)
+        {   // the shader reconstruction, in integer form.
+            int32_t s  = e[2] / 8 + 1;
+            int32_t co = (e[0] - 128) * 2 / s;
+            int32_t cg = (e[1] - 128) * 2 / s;
+            int32_t r  = A + (co - cg) / 2, g = A + cg / 2, b = A - (co + cg) / 2;
+            px[0] = (uint8_t) (r < 0 ? 0 : (r > 255 ? 255 : r));
+            px[1] = (uint8_t) (g < 0 ? 0 : (g > 255 ? 255 : g));
+            px[2] = (uint8_t) (b < 0 ? 0 : (b > 255 ? 255 : b));
+            px[3] = 255;
+        }
+        else
+        {
+            px[0] = (uint8_t) e[0];
+            px[1] = (uint8_t) e[1];
+            px[2] = (uint8_t) e[2];
+            px[3] = (uint8_t) A;
+        }
     }
-    printf("\n");
 }
 
-static void merge_int16(int16_t * restrict dst, int16_t const * restrict src)
+static bool test_bc(void)
 {
-    // combine four 8x8 blocks stored in a contiguous array back into a
-    // single 16x16 block. the 8x8 blocks are stored in natural order.
-    int16_t const * restrict src0 = &src[0];     // src[0...63]
-    int16_t const * restrict src1 = &src[64];    // src[64...127]
-    int16_t const * restrict src2 = &src[128];   // src[128...191]
-    int16_t const * restrict src3 = &src[192];   // src[192...255]
-    int16_t       * restrict dst0 = &dst[0];     // col[0...7],  row[0...7]
-    int16_t       * restrict dst1 = &dst[8];     // col[8...15], row[0...7]
-    int16_t       * restrict dst2 = &dst[128];   // col[0...7],  row[8...15]
-    int16_t       * restrict dst3 = &dst[128+8]; // col[8...15], row[8...15]
-    for (size_t i = 0; i < 8; ++i)
+    // transcode a page to each block-compressed format, decode the blocks
+    // with a reference decoder, and compare against the RGBA8 decode. the
+    // opaque and binary alpha blocks of BC3 must be exact.
+    size_t const  W = 128, H = 64, P = W * 4;
+    size_t        failed = 0;
+    size_t        tested = 0;
+    image_tile_t  tile;
+    image_tile_t  out;
+    tile_rate_t   rc;
+    uint8_t      *src    = (uint8_t*) malloc(P * H);
+    uint8_t      *expect = (uint8_t*) malloc(P * H);
+    uint8_t      *actual = (uint8_t*) malloc(P * H);
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth   = W;
+    tile.TileHeight  = H;
+    tile.BytesPerRow = P;
+    tile.Pixels      = src;
+    srand(1);
+    for (size_t y = 0; y < H; ++y)
     {
-        // copy each row from source to destination.
-        for (size_t j = 0; j < 8; ++j)
+        for (size_t x = 0; x < W; ++x)
         {
-            // copy each column from source to destination.
-            dst0[j] = src0[j];
-            dst1[j] = src1[j];
-            dst2[j] = src2[j];
-            dst3[j] = src3[j];
+            uint8_t *px = &src[y * P + x * 4];
+            px[0] = (uint8_t) ((x * 2 + (rand() % 16)) & 0xFF);
+            px[1] = (uint8_t) ((y * 3 + x / 2) & 0xFF);
+            px[2] = (uint8_t) ((x < W / 2) ? 48 + (rand() % 8) : 208 - y);
+            px[3] = (uint8_t) (((x / 16) % 3 == 0) ? 0xFF : (((x / 16) % 3 == 1) ? (((x ^ y) & 8) ? 0xFF : 0x00) : 0xFF - y * 2));
         }
-        src0 +=  8; dst0 += 16;
-        src1 +=  8; dst1 += 16;
-        src2 +=  8; dst2 += 16;
-        src3 +=  8; dst3 += 16;
     }
+    size_t   nbytes = tile_stream_size(&tile);
+    uint8_t *page   = (uint8_t*) malloc(nbytes);
+    tile_rate_init(&rc, &tile, false);
+    size_t   n      = tile_rate_pack(page, nbytes, &rc, 75);
+    out             = tile;
+    out.Pixels      = expect;
+    decode_tile_page(&out, page, n, 75);
+
+    int32_t const formats[3] = { BC_FORMAT_BC1, BC_FORMAT_BC3, BC_FORMAT_BC3_YCOCG };
+    char const   *names  [3] = { "bc1", "bc3", "bc3-ycocg" };
+    for (size_t f = 0; f < 3; ++f, ++tested)
+    {
+        int32_t  format = formats[f];
+        size_t   bs     = bc_block_size(format);
+        size_t   size   = tile_bc_size(&tile, format);
+        uint8_t *blocks = (uint8_t*) malloc(size);
+        out.Pixels      = blocks;
+        out.BytesPerRow = (W / 4) * bs;
+        bool ok = decode_tile_page_bc(&out, format, page, n, 75) && !decode_tile_page_bc(&out, format, page, n - 1, 75);
+        for (size_t by = 0; by < H / 4; ++by)
+        {
+            for (size_t bx = 0; bx < W / 4; ++bx)
+                bc_decode_block(&actual[by * 4 * P + bx * 16], P, &blocks[by * out.BytesPerRow + bx * bs], format);
+        }
+        double  mse   = 0.0;
+        int32_t aerr  = 0;
+        for (size_t i = 0; i < P * H; ++i)
+        {
+            int32_t d = (int32_t) actual[i] - (int32_t) expect[i];
+            if ((i % 4) != 3)
+                mse += d * d;
+            else if (format == BC_FORMAT_BC3 && ((i % P) / 64) % 3 != 2 && d != 0)
+                aerr++;
+        }
+        mse /= (double) (W * H * 3);
+        double psnr = 10.0 * log10(255.0 * 255.0 / (mse > 0.0 ? mse : 1e-9));
+        ok = ok && aerr == 0 && psnr >= ((format == BC_FORMAT_BC1) ? 30.0 : 32.0);
+        if (!ok) failed++;
+        printf("bc: %-9s %5u bytes (%2ux smaller than RGBA8), PSNR %.2f dB\n", names[f], (unsigned) size, (unsigned) (W * H * 4 / size), psnr);
+        free(blocks);
+    }
+    tile_rate_free(&rc);
+    free(page);
+    free(actual);
+    free(expect);
+    free(src);
+    printf("bc: %s (%u of %u formats differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
 }
 
-static void scale_int16(int16_t * restrict dst, int16_t const * restrict src)
+/// @summary Computes the expected pixel of a 1/8 scale preview from a full
+/// decode: the mean luma and alpha of its 8x8 area, with the mean chroma of
+/// its 16x16 MCU.
+/// @param rgba The four channels of the expected pixel.
+/// @param full The full decode.
+/// @param pitch The number of bytes between rows of @a full.
+/// @param x The preview column.
+/// @param y The preview row.
+static void preview8_expect(int32_t *rgba, uint8_t const *full, size_t pitch, size_t x, size_t y)
 {
-    // scale an 8x8 block into a 16x16 block using pixel doubling.
-    int16_t const * restrict srcRow  = src;
-    int16_t       * restrict dstRow0 =&dst[0];
-    int16_t       * restrict dstRow1 =&dst[16];
-    for (size_t i = 0; i < 8; ++i)
+    double luma = 0.0, co = 0.0, cg = 0.0, alpha = 0.0;
+    for (size_t j = 0; j < 16; ++j)
     {
-        // copy each row from source to destination.
-        for (size_t j = 0; j < 8; ++j)
+        for (size_t i = 0; i < 16; ++i)
         {
-            // each sample in src becomes a 2x2 block in dst.
-            dstRow0[j * 2 + 0] = srcRow[j];
-            dstRow0[j * 2 + 1] = srcRow[j];
-            dstRow1[j * 2 + 0] = srcRow[j];
-            dstRow1[j * 2 + 1] = srcRow[j];
+            uint8_t const *px = &full[((y / 2) * 16 + j) * pitch + ((x / 2) * 16 + i) * 4];
+            int32_t        o  = px[0] - px[2];
+            int32_t        t  = px[2] + (o >> 1);
+            int32_t        g  = px[1] - t;
+            co += o;
+            cg += g;
+            if (j / 8 == y % 2 && i / 8 == x % 2)
+            {
+                luma  += t + (g >> 1);
+                alpha += px[3];
+            }
         }
-        srcRow     += 8;
-        dstRow0    += 32;
-        dstRow1    += 32;
     }
+    int32_t Y = (int32_t) floor(luma  / 64.0  + 0.5);
+    int32_t O = (int32_t) floor(co    / 256.0 + 0.5);
+    int32_t G = (int32_t) floor(cg    / 256.0 + 0.5);
+    int32_t t = Y - (G >> 1);
+    rgba[1] = G + t;
+    rgba[2] = t - (O >> 1);
+    rgba[0] = rgba[2] + O;
+    rgba[3] = (int32_t) floor(alpha / 64.0 + 0.5);
+    for (size_t c = 0; c < 4; ++c)
+        rgba[c] = (rgba[c] < 0) ? 0 : ((rgba[c] > 255) ? 255 : rgba[c]);
 }
 
-static void generate_rgba(uint8_t  *dst, uint8_t start, size_t count)
+static bool test_preview(void)
 {
+    // at 1/4 scale the preview must match a box-filtered full decode, and at
+    // 1/8 scale the 8x8 luma and 16x16 chroma means of the full decode, up to
+    // the rounding and clamping of the individual pixels. truncated pages
+    // must be rejected, except that the 1/8 scale preview must decode,
+    // unchanged, from the page cut after its DC section.
+    size_t const  W = 128, H = 96, P = W * 4;
+    size_t        failed = 0;
+    size_t        tested = 0;
+    image_tile_t  tile;
+    image_tile_t  out;
+    tile_rate_t   rc;
+    uint8_t      *src  = (uint8_t*) malloc(P * H);
+    uint8_t      *full = (uint8_t*) malloc(P * H);
+    uint8_t      *prev = (uint8_t*) malloc(P * H);
+    uint8_t      *part = (uint8_t*) malloc(P * H);
+    memset(&tile, 0, sizeof(tile));
+    tile.TileWidth   = W;
+    tile.TileHeight  = H;
+    tile.BytesPerRow = P;
+    tile.Pixels      = src;
+    srand(1);
+    for (size_t y = 0; y < H; ++y)
+    {
+        for (size_t x = 0; x < W; ++x)
+        {
+            uint8_t *px = &src[y * P + x * 4];
+            px[0] = (uint8_t) (x + (rand() % 16));
+            px[1] = (uint8_t) ((y * 2 + x / 2) & 0xFF);
+            px[2] = (uint8_t) ((x < W / 2) ? 48 + (rand() % 8) : 208 - y);
+            px[3] = (uint8_t) (((x / 16) % 3 == 0) ? 0xFF : (((x / 16) % 3 == 1) ? (((x ^ y) & 8) ? 0xFF : 0x00) : 0xFF - y * 2));
+        }
+    }
+    size_t   nbytes = tile_stream_size(&tile);
+    uint8_t *page   = (uint8_t*) malloc(nbytes);
+    tile_rate_init(&rc, &tile, true);
+    for (int quality = 20; quality <= 100; quality += 40)
+    {
+        size_t n   = tile_rate_pack(page, nbytes, &rc, quality);
+        out        = tile;
+        out.Pixels = full;
+        decode_tile_page(&out, page, n, quality);
+        for (size_t scale = 4; scale <= 8; scale += 4, ++tested)
+        {
+            int32_t error = 0;
+            size_t  cut   = (scale == 8) ? tile_page_dc_size(page, n) : n;
+            out.Pixels    = part;
+            bool ok = cut > 4 && cut <= n && decode_tile_page_preview(&out, scale, page, cut, quality) && !decode_tile_page_preview(&out, scale, page, cut - 1, quality);
+            out.Pixels    = prev;
+            ok = ok && decode_tile_page_preview(&out, scale, page, n, quality);
+            for (size_t y = 0; y < H / scale; ++y)
+            {
+                ok = ok && memcmp(&prev[y * P], &part[y * P], (W / scale) * 4) == 0;
+                for (size_t x = 0; x < W / scale; ++x)
+                {
+                    int32_t expect[4];
+                    if (scale == 8)
+                        preview8_expect(expect, full, P, x, y);
+                    for (size_t c = 0; c < 4; ++c)
+                    {
+                        int32_t sum = 0;
+                        for (size_t j = 0; j < scale; ++j)
+                        {
+                            for (size_t i = 0; i < scale; ++i)
+                                sum += full[(y * scale + j) * P + (x * scale + i) * 4 + c];
+                        }
+                        if (scale == 4)
+                            expect[c] = sum / (int32_t) (scale * scale);
+                        int32_t e = (int32_t) prev[y * P + x * 4 + c] - expect[c];
+                        error = (e < 0) ? ((-e > error) ? -e : error) : ((e > error) ? e : error);
+                    }
+                }
+            }
+            ok = ok && error <= 2;
+            if (!ok) failed++;
+            printf("preview: quality %3d, 1/%u scale, max error %d, %5u of %5u bytes read\n", quality, (unsigned) scale, error, (unsigned) cut, (unsigned) n);
+        }
+    }
+    tile_rate_free(&rc);
+    free(page);
+    free(part);
+    free(prev);
+    free(full);
+    free(src);
+    printf("preview: %s (%u of %u previews differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
+
+static double srgb_to_linear(double x)
+{
+    return (x <= 0.04045) ? (x / 12.92) : pow((x + 0.055) / 1.055, 2.4);
+}
+
+static double linear_to_srgb(double x)
+{
+    return (x <= 0.0031308) ? (x * 12.92) : (1.055 * pow(x, 1.0 / 2.4) - 0.055);
+}
+
+static bool test_mipmap(void)
+{
+    // every level is checked against a floating-point filter of the level
+    // above it, and the threaded chain must match the single-threaded one.
+    // the box filter is exact; the weighted and sRGB filters may round the
+    // other way, or lose a step to the 16-bit linear tables.
+    size_t const   W = 1030, H = 517;
+    char const    *names[4] = { "box", "srgb", "alpha", "srgb+alpha" };
+    size_t         failed   = 0;
+    size_t         tested   = 0;
+    mipmap_level_t levels[16];
+    mipmap_level_t single[16];
+    size_t         count    = 0;
+    size_t         total    = 0;
+    for (size_t w = W, h = H; ; w = (w > 1) ? w >> 1 : 1, h = (h > 1) ? h >> 1 : 1)
+    {
+        levels[count].Width       = w;
+        levels[count].Height      = h;
+        levels[count].BytesPerRow = (w * 4 + 3) & ~size_t(3);
+        levels[count].Pixels      = (void*) total;
+        total += levels[count++].BytesPerRow * h;
+        if (w == 1 && h == 1) break;
+    }
+    uint8_t *chain = (uint8_t*) malloc(total);
+    uint8_t *check = (uint8_t*) malloc(total);
     for (size_t i = 0; i < count; ++i)
     {
-        *dst++  = (uint8_t)start  + i + 0;
-        *dst++  = (uint8_t)start  + i + 1;
-        *dst++  = (uint8_t)start  + i + 2;
-        *dst++  = 0xFF;
+        single[i] = levels[i];
+        levels[i].Pixels = chain + (size_t) levels[i].Pixels;
+        single[i].Pixels = check + (size_t) single[i].Pixels;
+    }
+
+    srand(7);
+    for (size_t n = 0; n < 2; ++n)
+    {
+        size_t channels = (n == 0) ? 4 : 1;
+        for (uint32_t flags = 0; flags < 4; ++flags, ++tested)
+        {
+            int32_t error = 0;
+            bool    ok    = true;
+            for (size_t y = 0; y < H; ++y)
+            {
+                uint8_t *row = (uint8_t*) levels[0].Pixels + y * levels[0].BytesPerRow;
+                for (size_t i = 0; i < W * channels; ++i)
+                    row[i] = (uint8_t) (((i / channels + y) & 32) ? rand() : (rand() & 0x0F));
+                if (channels == 4)
+                {
+                    for (size_t x = 0; x < W; ++x)
+                        row[x * 4 + 3] = (uint8_t) ((x % 5 == 0) ? 0 : row[x * 4 + 3]);
+                }
+            }
+            for (size_t i = 0; i < count; ++i)
+                single[i].BytesPerRow = levels[i].BytesPerRow;
+            memcpy(single[0].Pixels, levels[0].Pixels, levels[0].BytesPerRow * H);
+            ok = ok && generate_mipmaps(levels, count, channels, flags, 4);
+            ok = ok && generate_mipmaps(single, count, channels, flags, 1);
+            ok = ok && memcmp(chain, check, total) == 0;
+            for (size_t i = 1; i < count; ++i)
+            {
+                mipmap_level_t const &s = levels[i - 1];
+                mipmap_level_t const &d = levels[i];
+                size_t dx = (s.Width  > 1) ? 1 : 0;
+                size_t dy = (s.Height > 1) ? 1 : 0;
+                for (size_t y = 0; y < d.Height; ++y)
+                {
+                    for (size_t x = 0; x < d.Width; ++x)
+                    {
+                        uint8_t const *p[4] =
+                        {
+                            (uint8_t const*) s.Pixels + (y * 2     ) * s.BytesPerRow + (x * 2     ) * channels,
+                            (uint8_t const*) s.Pixels + (y * 2     ) * s.BytesPerRow + (x * 2 + dx) * channels,
+                            (uint8_t const*) s.Pixels + (y * 2 + dy) * s.BytesPerRow + (x * 2     ) * channels,
+                            (uint8_t const*) s.Pixels + (y * 2 + dy) * s.BytesPerRow + (x * 2 + dx) * channels
+                        };
+                        uint8_t const *o = (uint8_t const*) d.Pixels + y * d.BytesPerRow + x * channels;
+                        for (size_t c = 0; c < channels; ++c)
+                        {
+                            bool   color  = (channels == 1 || c < 3);
+                            bool   srgb   = color && (flags & MIPMAP_FILTER_SRGB);
+                            bool   weight = color && (flags & MIPMAP_FILTER_ALPHA) && channels == 4;
+                            double sum    = 0.0;
+                            double wsum   = 0.0;
+                            for (size_t k = 0; k < 4; ++k)
+                            {
+                                double v = srgb ? srgb_to_linear(p[k][c] / 255.0) * 255.0 : p[k][c];
+                                double a = weight ? p[k][3] : 1.0;
+                                sum  += v * a;
+                                wsum += a;
+                            }
+                            if (wsum == 0.0)
+                            {
+                                for (size_t k = 0; k < 4; ++k)
+                                    sum += srgb ? srgb_to_linear(p[k][c] / 255.0) * 255.0 : p[k][c];
+                                wsum = 4.0;
+                            }
+                            double  v = srgb ? linear_to_srgb(sum / wsum / 255.0) * 255.0 : sum / wsum;
+                            int32_t e = (int32_t) o[c] - (int32_t) floor(v + 0.5);
+                            error = (e < 0) ? ((-e > error) ? -e : error) : ((e > error) ? e : error);
+                        }
+                    }
+                }
+            }
+            ok = ok && error <= ((flags == MIPMAP_FILTER_BOX) ? 0 : 1);
+            if (!ok) failed++;
+            printf("mipmap: %u channel %-10s %u levels, max error %d\n", (unsigned) channels, names[flags], (unsigned) count, error);
+        }
     }
+    // a chain with the wrong dimensions is rejected.
+    levels[1].Width++;
+    if (generate_mipmaps(levels, count, 4, MIPMAP_FILTER_BOX, 1) || generate_mipmaps(levels, 1, 3, MIPMAP_FILTER_BOX, 1))
+        failed++;
+    free(check);
+    free(chain);
+    printf("mipmap: %s (%u of %u chains differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
 }
 
-static void transform_block(uint8_t const *rgba, int quality)
+static bool test_mipmap_chain(void)
 {
-    int16_t Qluma[64];
-    int16_t Qchroma[64];
-    qtables_encode(Qluma, Qchroma, quality);
+    // the layout must give each level half the size of the one above it,
+    // padded rows and contiguous storage, and the box-filtered chain must
+    // match an integer 2x2 average of the level above, texel for texel.
+    size_t const sizes[4][2] = { { 37, 12 }, { 1, 9 }, { 64, 64 }, { 300, 5 } };
+    size_t       failed = 0;
+    size_t       tested = 0;
+    srand(11);
+    for (size_t k = 0; k < 4; ++k)
+    {
+        for (size_t n = 0; n < 2; ++n)
+        {
+            for (size_t align = 1; align <= 8; align *= 2, ++tested)
+            {
+                mipmap_level_t levels[64];
+                mipmap_level_t sized[64];
+                size_t         count    = 0;
+                size_t         expect   = 0;
+                size_t         channels = (n == 0) ? 4 : 1;
+                size_t         W = sizes[k][0], H = sizes[k][1];
+                size_t         total    = mipmap_chain_layout(sized, &count, W, H, channels, align, 0, NULL);
+                uint8_t       *chain    = (uint8_t*) malloc(total);
+                bool           ok       = mipmap_chain_layout(levels, &count, W, H, channels, align, 0, chain) == total;
+                for (size_t m = (W > H) ? W : H; m > 0; m >>= 1)
+                    expect++;
+                ok = ok && count == expect && sized[0].Pixels == NULL;
+                for (size_t i = 0, offset = 0; ok && i < count; ++i)
+                {
+                    size_t w = (W >> i) ? (W >> i) : 1;
+                    size_t h = (H >> i) ? (H >> i) : 1;
+                    size_t p = ((w * channels + align - 1) / align) * align;
+                    ok = levels[i].Width == w && levels[i].Height == h && levels[i].BytesPerRow == p &&
+                         levels[i].Pixels == chain + offset && sized[i].BytesPerRow == p;
+                    offset += p * h;
+                    ok = ok && (i + 1 < count || offset == total);
+                }
+                for (size_t i = 0; ok && i < levels[0].BytesPerRow * H; ++i)
+                    chain[i] = (uint8_t) rand();
+                ok = ok && generate_mipmaps(levels, count, channels, MIPMAP_FILTER_BOX, 1);
+                for (size_t i = 1; ok && i < count; ++i)
+                {
+                    mipmap_level_t const &s  = levels[i - 1];
+                    mipmap_level_t const &d  = levels[i];
+                    size_t                dx = (s.Width  > 1) ? channels    : 0;
+                    size_t                dy = (s.Height > 1) ? s.BytesPerRow : 0;
+                    for (size_t y = 0; y < d.Height; ++y)
+                    {
+                        uint8_t const *r = (uint8_t const*) s.Pixels + y * 2 * s.BytesPerRow;
+                        uint8_t const *o = (uint8_t const*) d.Pixels + y * d.BytesPerRow;
+                        for (size_t x = 0; x < d.Width * channels; ++x)
+                        {
+                            uint8_t const *p = r + (x / channels) * 2 * channels + (x % channels);
+                            ok = ok && o[x] == ((p[0] + p[dx] + p[dy] + p[dx + dy] + 2) >> 2);
+                        }
+                    }
+                }
+                if (!ok) failed++;
+                free(chain);
+            }
+        }
+    }
+    // a chain can be limited to fewer levels, and bad arguments are rejected.
+    mipmap_level_t levels[64];
+    size_t         count = 0;
+    if (mipmap_chain_layout(levels, &count, 37, 12, 4, 4, 2, NULL) != 148 * 12 + 72 * 6 || count != 2)
+        failed++;
+    if (mipmap_chain_layout(levels, &count, 0, 12, 4, 4, 0, NULL) != 0 || count != 0 ||
+        mipmap_chain_layout(levels, &count, 37, 12, 4, 3, 0, NULL) != 0)
+        failed++;
+    tested++;
+    printf("mipmap: %s (%u of %u chain layouts differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
 
-    printf("Qluma_encode:\n");
-    print_8x8_dec(Qluma);
-    printf("Qchroma_encode:\n");
-    print_8x8_dec(Qchroma);
+/// @summary Collects the pages emitted by encode_image() for test_encode().
+struct encode_sink_t
+{
+    uint8_t *Data;           /// The concatenated pages
+    size_t  *Offset;         /// The offset of each page in Data
+    int     *Quality;        /// The quality level of each page
+    size_t   Count;          /// The number of pages received
+    size_t   Size;           /// The number of bytes used in Data
+    size_t   Limit;          /// The number of pages to accept before stopping
+    bool     InOrder;        /// false if a page arrived out of tile order
+};
 
-    int16_t Y[256]; // 4 8x8 blocks
-    int16_t Co[64]; // 1 8x8 block
-    int16_t Cg[64]; // 1 8x8 block
-    uint8_t A[256]; // 1 16x16 block; not transformed or quantized
-    encode16x16i(Y, Co, Cg, A, Qluma, Qchroma, rgba);
+static bool encode_sink(void *context, size_t index, void const *page, size_t page_size, int quality)
+{
+    encode_sink_t *sink = (encode_sink_t*) context;
+    if (index != sink->Count)
+        sink->InOrder = false;
+    sink->Offset [sink->Count] = sink->Size;
+    sink->Quality[sink->Count] = quality;
+    memcpy(&sink->Data[sink->Size], page, page_size);
+    sink->Size += page_size;
+    sink->Count++;
+    return sink->Count < sink->Limit;
+}
 
-    printf("Y:\n");
-    print_8x8_dec(&Y[0]);
-    print_8x8_dec(&Y[64]);
-    print_8x8_dec(&Y[128]);
-    print_8x8_dec(&Y[192]);
+static bool test_encode(void)
+{
+    // the threaded encoder must emit every page in tile order, identical to
+    // encoding the tiles one at a time, for any number of threads, and must
+    // stop as soon as the callback asks it to.
+    size_t const         W = 520, H = 300, B = 16384;
+    size_t               failed = 0;
+    size_t               tested = 0;
+    image_tiler_config_t config;
+    image_tile_t         tile;
+    uint8_t             *src  = (uint8_t*) malloc(W * H * 4);
+    uint8_t             *page = (uint8_t*) malloc(B);
+    srand(7);
+    for (size_t i = 0; i < W * H * 4; ++i)
+    {
+        size_t x = (i / 4) % W, y = i / (W * 4);
+        src[i] = (uint8_t) (((i % 4) == 3) ? 0xFF : ((x * (i % 4 + 1) + y + (rand() % 16)) & 0xFF));
+    }
+    config.TileWidth    = 64;
+    config.TileHeight   = 64;
+    config.ImageWidth   = W;
+    config.ImageHeight  = H;
+    config.BorderSize   = 2;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = src;
+    size_t const ntiles = tile_count(NULL, NULL, &config);
 
-    int16_t M[256]; // 8x8 blocks merged back into one 4x4 block.
-    merge_int16(M, Y);
-    printf("Ymerged:\n");
-    print_16x16_dec(M);
+    encode_sink_t expect;
+    encode_sink_t actual;
+    expect.Data    = (uint8_t*) malloc(ntiles * B);
+    expect.Offset  = (size_t *) malloc(ntiles * sizeof(size_t));
+    expect.Quality = (int    *) malloc(ntiles * sizeof(int));
+    expect.Count   = 0;
+    expect.Size    = 0;
+    expect.Limit   = SIZE_MAX;
+    expect.InOrder = true;
+    actual         = expect;
+    actual.Data    = (uint8_t*) malloc(ntiles * B);
+    actual.Offset  = (size_t *) malloc(ntiles * sizeof(size_t));
+    actual.Quality = (int    *) malloc(ntiles * sizeof(int));
+    tile_alloc(&tile, &config);
+    for (size_t i = 0; i < ntiles; ++i)
+    {
+        int    q = 0;
+        copy_tile(&tile, &config, i);
+        size_t n = encode_tile_budget_rdo(page, B, &tile, 6.0f, &q);
+        encode_sink(&expect, i, page, n, q);
+    }
 
-    int16_t Os[256];
-    int16_t Gs[256];
-    scale_int16(Os, Co);
-    scale_int16(Gs, Cg);
+    size_t const threads[] = { 1, 2, 4, 7, 16 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t, ++tested)
+    {
+        encode_stats_t stats;
+        actual.Count   = 0;
+        actual.Size    = 0;
+        actual.Limit   = SIZE_MAX;
+        actual.InOrder = true;
+        bool ok = encode_image(&config, B, 6.0f, threads[t], encode_sink, &actual, &stats) &&
+                  actual.InOrder && actual.Count == ntiles && actual.Size == expect.Size &&
+                  stats.TileCount == ntiles && stats.PageBytes == expect.Size &&
+                  memcmp(actual.Data, expect.Data, expect.Size) == 0 &&
+                  memcmp(actual.Quality, expect.Quality, ntiles * sizeof(int)) == 0;
+        if (!ok) failed++;
+        printf("encode: %2u threads, %u tiles, %u bytes, %.0f tiles/sec\n", (unsigned) stats.ThreadCount,
+            (unsigned) stats.TileCount, (unsigned) stats.PageBytes, stats.TilesPerSecond);
+    }
+    // stopping early returns false after exactly the accepted pages.
+    actual.Count = 0;
+    actual.Size  = 0;
+    actual.Limit = 3;
+    if (encode_image(&config, B, 6.0f, 4, encode_sink, &actual, NULL) || actual.Count != 3)
+        failed++;
+    // a budget too small for a tile fails.
+    actual.Count = 0;
+    actual.Size  = 0;
+    actual.Limit = SIZE_MAX;
+    if (encode_image(&config, 64, 0.0f, 4, encode_sink, &actual, NULL) || actual.Count != 0)
+        failed++;
+    tested += 2;
 
-    printf("Co:\n");
-    print_8x8_dec(Co);
+    tile_free(&tile);
+    free(actual.Quality); free(actual.Offset); free(actual.Data);
+    free(expect.Quality); free(expect.Offset); free(expect.Data);
+    free(page);
+    free(src);
+    printf("encode: %s (%u of %u runs differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
 
-    printf("Coscaled:\n");
-    print_16x16_dec(Os);
+static bool test_view(void)
+{
+    // unbordered interior tiles are viewed in place and must match a copy;
+    // edge tiles and bordered tiles must be refused. the encoder reads views
+    // directly, so its pages must match encoding copies.
+    size_t const         W = 520, H = 300, B = 16384;
+    size_t               failed = 0;
+    size_t               tested = 0;
+    size_t               views  = 0;
+    image_tiler_config_t config;
+    image_tile_t         tile;
+    image_tile_t         view;
+    uint8_t             *src  = (uint8_t*) malloc(W * H * 4);
+    uint8_t             *page = (uint8_t*) malloc(B);
+    srand(11);
+    for (size_t i = 0; i < W * H * 4; ++i)
+        src[i] = (uint8_t) (((i % (W * 4)) + (i / (W * 4)) * 5 + (rand() % 32)) & 0xFF);
+    config.TileWidth    = 64;
+    config.TileHeight   = 64;
+    config.ImageWidth   = W;
+    config.ImageHeight  = H;
+    config.BorderSize   = 0;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = src;
+    size_t const ntiles = tile_count(NULL, NULL, &config);
 
-    printf("Cg:\n");
-    print_8x8_dec(Cg);
+    encode_sink_t expect;
+    encode_sink_t actual;
+    expect.Data    = (uint8_t*) malloc(ntiles * B);
+    expect.Offset  = (size_t *) malloc(ntiles * sizeof(size_t));
+    expect.Quality = (int    *) malloc(ntiles * sizeof(int));
+    expect.Count   = 0;
+    expect.Size    = 0;
+    expect.Limit   = SIZE_MAX;
+    expect.InOrder = true;
+    actual         = expect;
+    actual.Data    = (uint8_t*) malloc(ntiles * B);
+    actual.Offset  = (size_t *) malloc(ntiles * sizeof(size_t));
+    actual.Quality = (int    *) malloc(ntiles * sizeof(int));
+    tile_alloc(&tile, &config);
+    for (size_t i = 0; i < ntiles; ++i, ++tested)
+    {
+        int    q = 0;
+        copy_tile(&tile, &config, i);
+        size_t n = encode_tile_budget_rdo(page, B, &tile, 6.0f, &q);
+        encode_sink(&expect, i, page, n, q);
 
-    printf("Cgscaled:\n");
-    print_16x16_dec(Gs);
+        bool inside = tile.SourceX + 64 <= W && tile.SourceY + 64 <= H;
+        bool ok     = view_tile(&view, &config, i) == inside;
+        if  (ok && inside)
+        {
+            views++;
+            ok = view.TileIndex == i && view.SourceX == tile.SourceX && view.SourceY == tile.SourceY &&
+                 view.BytesPerRow == W * 4 && view.BytesPerTile == tile.BytesPerTile;
+            for (size_t r = 0; ok && r < 64; ++r)
+                ok = memcmp((uint8_t*) view.Pixels + r * view.BytesPerRow, (uint8_t*) tile.Pixels + r * tile.BytesPerRow, 64 * 4) == 0;
+        }
+        if (!ok) failed++;
+    }
+    // bordered tiles and out-of-range indices are never views.
+    config.BorderSize = 2;
+    if (view_tile(&view, &config, 0)) failed++;
+    config.BorderSize = 0;
+    if (view_tile(&view, &config, ntiles)) failed++;
+    tested += 2;
 
-    // now do the decode part:
-    qtables_decode(Qluma, Qchroma, quality);
-    printf("Qluma_decode:\n");
-    print_8x8_dec(Qluma);
-    printf("Qchroma_decode:\n");
-    print_8x8_dec(Qchroma);
+    size_t const threads[] = { 1, 4 };
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t, ++tested)
+    {
+        actual.Count   = 0;
+        actual.Size    = 0;
+        actual.InOrder = true;
+        bool ok = encode_image(&config, B, 6.0f, threads[t], encode_sink, &actual, NULL) &&
+                  actual.InOrder && actual.Count == ntiles && actual.Size == expect.Size &&
+                  memcmp(actual.Data, expect.Data, expect.Size) == 0 &&
+                  memcmp(actual.Quality, expect.Quality, ntiles * sizeof(int)) == 0;
+        if (!ok) failed++;
+    }
+
+    tile_free(&tile);
+    free(actual.Quality); free(actual.Offset); free(actual.Data);
+    free(expect.Quality); free(expect.Offset); free(expect.Data);
+    free(page);
+    free(src);
+    printf("view: %s (%u of %u checks differ; %u of %u tiles viewed in place)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested,
+        (unsigned) views, (unsigned) ntiles);
+    return (failed == 0);
+}
+
+struct band_source_t
+{
+    uint8_t const *Pixels;   /// The whole source image, in RGBA8 format
+    size_t         Pitch;    /// The number of bytes per row of Pixels
+    size_t         NextRow;  /// The first row the next read must start at or before
+    size_t         MaxRows;  /// The largest number of rows read at once
+    size_t         FailRow;  /// Reads covering this row fail
+    bool           InOrder;  /// Cleared if the reads move backwards
+};
 
-    uint8_t RGBA[1024];
-    decode16x16i_rgba(RGBA, Y, Co, Cg, A, Qluma, Qchroma);
-    printf("RGBA input:\n");
-    print_16x16_dec(rgba);
-    printf("RGBA output:\n");
-    print_16x16_dec(RGBA);
+static bool band_source_read(void *context, void *dst, size_t first_row, size_t row_count)
+{
+    band_source_t *src = (band_source_t*) context;
+    if (first_row + 1 < src->NextRow) src->InOrder = false;
+    if (row_count > src->MaxRows) src->MaxRows = row_count;
+    if (first_row <= src->FailRow && src->FailRow < first_row + row_count)
+        return false;
+    memcpy(dst, src->Pixels + first_row * src->Pitch, row_count * src->Pitch);
+    src->NextRow = first_row + row_count;
+    return true;
+}
+
+static bool test_band(void)
+{
+    // the band tiler must return the same tiles as copy_tile() over the whole
+    // image, in order, while reading forward one band at a time, and must
+    // stop when a read fails.
+    size_t const         W = 300, H = 250;
+    size_t               failed = 0;
+    size_t               tested = 0;
+    image_tiler_config_t config;
+    image_tile_t         tile;
+    image_tile_t         band;
+    uint8_t             *src = (uint8_t*) malloc(W * H * 4);
+    srand(13);
+    for (size_t i = 0; i < W * H * 4; ++i)
+        src[i] = (uint8_t) (rand() & 0xFF);
+    config.TileWidth    = 64;
+    config.TileHeight   = 64;
+    config.ImageWidth   = W;
+    config.ImageHeight  = H;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = src;
+    tile_alloc(&tile, &config);
+
+    for (size_t border = 0; border <= 2; border += 2)
+    {
+        band_source_t source = { src, W * 4, 0, 0, SIZE_MAX, true };
+        config.BorderSize    = border;
+        size_t const  ntiles = tile_count(NULL, NULL, &config);
+        size_t        count  = 0;
+        band_tiler_t *tiler  = band_tiler_open(&config, band_source_read, &source);
+        while (tiler != NULL && band_tiler_next(tiler, &band))
+        {
+            bool ok = copy_tile(&tile, &config, count) &&
+                      band.TileIndex  == tile.TileIndex  && band.TileX       == tile.TileX       &&
+                      band.TileY      == tile.TileY      && band.SourceX     == tile.SourceX     &&
+                      band.SourceY    == tile.SourceY    && band.SourceWidth == tile.SourceWidth &&
+                      band.SourceHeight == tile.SourceHeight;
+            for (size_t r = 0; ok && r < tile.TileHeight; ++r)
+                ok = memcmp((uint8_t*) band.Pixels + r * band.BytesPerRow, (uint8_t*) tile.Pixels + r * tile.BytesPerRow, tile.TileWidth * 4) == 0;
+            if (!ok) failed++;
+            count++;
+            tested++;
+        }
+        if (tiler == NULL || !band_tiler_close(tiler) || count != ntiles || !source.InOrder ||
+            source.MaxRows > config.TileHeight - border * 2 + 1)
+            failed++;
+        tested++;
+
+        // row 130 is only in the third band, so a failed read of it ends
+        // the tiles after the first two rows of tiles.
+        band_source_t broken = { src, W * 4, 0, 0, 130, true };
+        size_t        before = 0;
+        size_t        tiles_x;
+        tile_count(&tiles_x, NULL, &config);
+        tiler = band_tiler_open(&config, band_source_read, &broken);
+        while (tiler != NULL && band_tiler_next(tiler, &band))
+            before++;
+        if (tiler == NULL || band_tiler_close(tiler) || before != 2 * tiles_x)
+            failed++;
+        tested++;
+    }
+
+    tile_free(&tile);
+    free(src);
+    printf("band: %s (%u of %u checks differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
+
+static bool test_formats(void)
+{
+    // tiles cut from RGB8, gray, gray-alpha and 16-bit sources with padded
+    // rows must match tiles cut from the same image expanded to tight RGBA8
+    // beforehand, with every kernel set.
+    size_t const         W = 203, H = 77;
+    size_t               failed = 0;
+    size_t               tested = 0;
+    int32_t const        formats[] = { SOURCE_FORMAT_RGB8, SOURCE_FORMAT_R8, SOURCE_FORMAT_RG8, SOURCE_FORMAT_RGBA16 };
+    image_tiler_config_t config;
+    image_tiler_config_t expand;
+    image_tile_t         tile;
+    image_tile_t         want;
+    uint8_t             *rgba = (uint8_t*) malloc(W * H * 4);
+    uint8_t             *src  = (uint8_t*) malloc((W * 8 + 24) * H);
+    config.TileWidth    = 48;
+    config.TileHeight   = 32;
+    config.ImageWidth   = W;
+    config.ImageHeight  = H;
+    config.BorderSize   = 2;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = rgba;
+    expand = config;
+    tile_alloc(&tile, &config);
+    tile_alloc(&want, &config);
+    srand(17);
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f)
+    {
+        size_t const bpp   = source_format_size(formats[f]);
+        size_t const pitch = W * bpp + 24;
+        for (size_t y = 0; y < H; ++y)
+        {
+            uint8_t *row = src  + y * pitch;
+            uint8_t *out = rgba + y * W * 4;
+            for (size_t x = 0; x < W; ++x, out += 4)
+            {
+                uint16_t c[4];
+                for (size_t k = 0; k < 4; ++k)
+                    c[k] = (uint16_t) (rand() & 0xFFFF);
+                switch (formats[f])
+                {
+                    case SOURCE_FORMAT_RGB8:
+                        for (size_t k = 0; k < 3; ++k) row[x * 3 + k] = out[k] = (uint8_t) c[k];
+                        out[3] = 0xFF;
+                        break;
+                    case SOURCE_FORMAT_R8:
+                        row[x] = out[0] = out[1] = out[2] = (uint8_t) c[0];
+                        out[3] = 0xFF;
+                        break;
+                    case SOURCE_FORMAT_RG8:
+                        row[x * 2 + 0] = out[0] = out[1] = out[2] = (uint8_t) c[0];
+                        row[x * 2 + 1] = out[3] = (uint8_t) c[1];
+                        break;
+                    default:
+                        memcpy(&row[x * 8], c, sizeof(c));
+                        for (size_t k = 0; k < 4; ++k)
+                            out[k] = (uint8_t) ((c[k] * 2 + 257) / 514);
+                        break;
+                }
+            }
+        }
+        config.SourceFormat = formats[f];
+        config.SourcePitch  = pitch;
+        config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+        config.Pixels       = src;
+        for (int32_t isa = CPU_ISA_SCALAR; isa <= cpu_isa_supported(); ++isa)
+        {
+            select_kernels(isa);
+            for (size_t i = 0; i < tile_count(NULL, NULL, &config); ++i, ++tested)
+            {
+                bool ok = copy_tile(&tile, &config, i) && copy_tile(&want, &expand, i) &&
+                          memcmp(tile.Pixels, want.Pixels, want.BytesPerTile) == 0;
+                if (!ok) failed++;
+            }
+        }
+        select_kernels(CPU_ISA_BEST);
+    }
+    tile_free(&want);
+    tile_free(&tile);
+    free(src);
+    free(rgba);
+    printf("formats: %s (%u of %u tiles differ)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
+
+/// @summary Sorts a set of pages and counts the runs of consecutive pages
+/// needed to read them.
+static size_t count_page_runs(size_t *pages, size_t count)
+{
+    size_t runs = 0;
+    for (size_t i = 1; i < count; ++i)
+    {
+        for (size_t j = i; j > 0 && pages[j - 1] > pages[j]; --j)
+        {
+            size_t t = pages[j]; pages[j] = pages[j - 1]; pages[j - 1] = t;
+        }
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i == 0 || pages[i] != pages[i - 1] + 1)
+            runs++;
+    }
+    return runs;
+}
+
+static bool test_order(void)
+{
+    // every order must map the tiles of a mipmap chain one-to-one onto pages
+    // and back. a 4x4 block of tiles always spans four runs of pages in
+    // row-major order; on average it must span fewer than 3.7 along the
+    // Hilbert curve (3.63 measured) and fewer than 6 along the Morton curve
+    // (5.84 measured). the encoder must emit the row-major pages in the
+    // order of the layout.
+    size_t const         W = 1000, H = 700, L = 6, B = 16384;
+    int32_t const        orders[] = { TILE_ORDER_ROW_MAJOR, TILE_ORDER_MORTON, TILE_ORDER_HILBERT };
+    char const          *names [] = { "row-major", "morton", "hilbert" };
+    double               runs  [] = { 0.0, 0.0, 0.0 };
+    size_t               failed = 0;
+    size_t               tested = 0;
+    image_tiler_config_t config;
+    config.TileWidth    = 64;
+    config.TileHeight   = 64;
+    config.ImageWidth   = W;
+    config.ImageHeight  = H;
+    config.BorderSize   = 2;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = NULL;
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); ++o)
+    {
+        tile_layout_t layout;
+        size_t        windows = 0;
+        tested++;
+        if (!tile_layout_init(&layout, &config, L, orders[o]))
+        {
+            failed++;
+            continue;
+        }
+        uint8_t *seen = (uint8_t*) calloc(layout.PageCount, 1);
+        bool     ok   = true;
+        for (size_t l = 0; l < L; ++l)
+        {
+            for (size_t y = 0; y < layout.TilesY[l]; ++y)
+            {
+                for (size_t x = 0; x < layout.TilesX[l]; ++x)
+                {
+                    size_t px = 0, py = 0, pl = 0;
+                    size_t p  = tile_page_index(&layout, x, y, l);
+                    if (p >= layout.PageCount || seen[p]++ || p < layout.LevelBase[l] ||
+                       !tile_page_position(&layout, p, &px, &py, &pl) || px != x || py != y || pl != l)
+                        ok = false;
+                }
+            }
+            if (tile_page_index(&layout, layout.TilesX[l], 0, l) != layout.PageCount)
+                ok = false;
+        }
+        if (tile_page_index(&layout, 0, 0, L) != layout.PageCount || tile_page_position(&layout, layout.PageCount, NULL, NULL, NULL))
+            ok = false;
+        for (size_t y = 0; y + 4 <= layout.TilesY[0]; ++y)
+        {
+            for (size_t x = 0; x + 4 <= layout.TilesX[0]; ++x, ++windows)
+            {
+                size_t pages[16];
+                for (size_t i = 0; i < 16; ++i)
+                    pages[i] = tile_page_index(&layout, x + (i % 4), y + (i / 4), 0);
+                runs[o] += (double) count_page_runs(pages, 16);
+            }
+        }
+        runs[o] /= (double) windows;
+        printf("order: %-9s %u pages, %.2f runs per 4x4 block\n", names[o], (unsigned) layout.PageCount, runs[o]);
+        if (!ok) failed++;
+        free(seen);
+        tile_layout_free(&layout);
+    }
+    if (runs[0] != 4.0 || runs[1] >= 6.0 || runs[2] >= 3.7 || runs[2] >= runs[0])
+        failed++;
+    tested++;
+
+    // encode a smaller image in Hilbert order with several threads.
+    uint8_t      *src  = (uint8_t*) malloc(300 * 200 * 4);
+    uint8_t      *page = (uint8_t*) malloc(B);
+    image_tile_t  tile;
+    tile_layout_t layout;
+    for (size_t i = 0; i < 300 * 200 * 4; ++i)
+        src[i] = (uint8_t) (((i % 4) == 3) ? 0xFF : ((i / 4) * (i % 4 + 1) + rand() % 8) & 0xFF);
+    config.ImageWidth   = 300;
+    config.ImageHeight  = 200;
+    config.TileOrder    = TILE_ORDER_HILBERT;
+    config.Pixels       = src;
+    size_t const ntiles = tile_count(NULL, NULL, &config);
+
+    encode_sink_t expect;
+    encode_sink_t actual;
+    expect.Data    = (uint8_t*) malloc(ntiles * B);
+    expect.Offset  = (size_t *) malloc(ntiles * sizeof(size_t));
+    expect.Quality = (int    *) malloc(ntiles * sizeof(int));
+    expect.Count   = 0;
+    expect.Size    = 0;
+    expect.Limit   = SIZE_MAX;
+    expect.InOrder = true;
+    actual         = expect;
+    actual.Data    = (uint8_t*) malloc(ntiles * B);
+    actual.Offset  = (size_t *) malloc(ntiles * sizeof(size_t));
+    actual.Quality = (int    *) malloc(ntiles * sizeof(int));
+    tile_alloc(&tile, &config);
+    tile_layout_init(&layout, &config, 1, TILE_ORDER_HILBERT);
+    for (size_t i = 0; i < ntiles; ++i)
+    {
+        int    q = 0;
+        copy_tile(&tile, &config, layout.TileOfPage[i]);
+        size_t n = encode_tile_budget_rdo(page, B, &tile, 0.0f, &q);
+        encode_sink(&expect, i, page, n, q);
+    }
+    bool ok = encode_image(&config, B, 0.0f, 3, encode_sink, &actual, NULL) &&
+              actual.Count == ntiles && actual.Size == expect.Size && !actual.InOrder &&
+              memcmp(actual.Data, expect.Data, expect.Size) == 0 &&
+              memcmp(actual.Quality, expect.Quality, ntiles * sizeof(int)) == 0;
+    if (!ok) failed++;
+    tested++;
+
+    tile_layout_free(&layout);
+    tile_free(&tile);
+    free(actual.Quality); free(actual.Offset); free(actual.Data);
+    free(expect.Quality); free(expect.Offset); free(expect.Data);
+    free(page);
+    free(src);
+    printf("order: %s (%u of %u checks fail)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
+}
+
+/// @summary Retrieves a page collected by encode_sink().
+static uint8_t const* encode_sink_page(encode_sink_t const *sink, size_t page, size_t *page_size)
+{
+    size_t end = (page + 1 < sink->Count) ? sink->Offset[page + 1] : sink->Size;
+    *page_size = end - sink->Offset[page];
+    return &sink->Data[sink->Offset[page]];
+}
+
+static bool test_dedup(void)
+{
+    // the tile hash must not depend on the pitch or the kernel set. an image
+    // made of a few repeated tiles must be stored as one page per distinct
+    // tile, with the page table pointing every tile at a page identical to
+    // the one it would have had on its own, for any order and thread count.
+    size_t const         W = 512, H = 320, T = 64, B = 16384;
+    size_t               failed = 0;
+    size_t               tested = 0;
+    uint8_t             *src    = (uint8_t*) malloc(W * H * 4);
+    uint8_t             *page   = (uint8_t*) malloc(B);
+    image_tiler_config_t config;
+    image_tile_t         tile;
+    image_tile_t         view;
+    for (size_t y = 0; y < H; ++y)
+    {
+        for (size_t x = 0; x < W; ++x)
+        {
+            // tiles cycle through solid, transparent and textured patterns,
+            // except for every seventh tile, which is noise.
+            size_t   t  = (y / T) * (W / T) + (x / T);
+            uint8_t *px = &src[(y * W + x) * 4];
+            switch ((t % 7 == 6) ? 3 : (t % 3))
+            {
+                case 0: px[0] = 20; px[1] = 60; px[2] = 140; px[3] = 0xFF; break;
+                case 1: px[0] = px[1] = px[2] = px[3] = 0; break;
+                case 2: px[0] = (uint8_t) (x % T * 4); px[1] = (uint8_t) (y % T * 4); px[2] = 90; px[3] = 0xFF; break;
+                default: px[0] = (uint8_t) rand(); px[1] = (uint8_t) rand(); px[2] = (uint8_t) rand(); px[3] = 0xFF; break;
+            }
+        }
+    }
+    config.TileWidth    = T;
+    config.TileHeight   = T;
+    config.ImageWidth   = W;
+    config.ImageHeight  = H;
+    config.BorderSize   = 0;
+    config.BorderMode   = BORDER_CLAMP_TO_EDGE;
+    config.BorderColor  = 0;
+    config.SourceFormat = SOURCE_FORMAT_RGBA8;
+    config.SourcePitch  = 0;
+    config.TileOrder    = TILE_ORDER_ROW_MAJOR;
+    config.Pixels       = src;
+    size_t const ntiles = tile_count(NULL, NULL, &config);
+
+    tile_alloc(&tile, &config);
+    for (size_t i = 0; i < ntiles; ++i, ++tested)
+    {
+        copy_tile(&tile, &config, i);
+        view_tile(&view, &config, i);
+        uint64_t h = tile_hash(&view);
+        bool    ok = tile_hash(&tile) == h;
+        for (int32_t isa = CPU_ISA_SCALAR; isa <= cpu_isa_supported(); ++isa)
+        {
+            select_kernels(isa);
+            ok = ok && tile_hash(&tile) == h;
+        }
+        select_kernels(CPU_ISA_BEST);
+        ((uint8_t*) tile.Pixels)[tile.BytesPerTile - 1] ^= 1;
+        ok = ok && tile_hash(&tile) != h;
+        if (!ok) failed++;
+    }
+
+    encode_sink_t expect;
+    encode_sink_t actual;
+    uint32_t     *table  = (uint32_t*) malloc(ntiles * sizeof(uint32_t));
+    expect.Data    = (uint8_t*) malloc(ntiles * B);
+    expect.Offset  = (size_t *) malloc(ntiles * sizeof(size_t));
+    expect.Quality = (int    *) malloc(ntiles * sizeof(int));
+    expect.Count   = 0;
+    expect.Size    = 0;
+    expect.Limit   = SIZE_MAX;
+    expect.InOrder = true;
+    actual         = expect;
+    actual.Data    = (uint8_t*) malloc(ntiles * B);
+    actual.Offset  = (size_t *) malloc(ntiles * sizeof(size_t));
+    actual.Quality = (int    *) malloc(ntiles * sizeof(int));
+    for (size_t i = 0; i < ntiles; ++i)
+    {
+        int    q = 0;
+        copy_tile(&tile, &config, i);
+        size_t n = encode_tile_budget_rdo(page, B, &tile, 0.0f, &q);
+        encode_sink(&expect, i, page, n, q);
+    }
+
+    int32_t const orders [] = { TILE_ORDER_ROW_MAJOR, TILE_ORDER_HILBERT };
+    size_t  const threads[] = { 1, 3 };
+    for (size_t o = 0; o < sizeof(orders) / sizeof(orders[0]); ++o)
+    {
+        for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t, ++tested)
+        {
+            encode_stats_t stats;
+            config.TileOrder = orders[o];
+            actual.Count     = 0;
+            actual.Size      = 0;
+            bool ok = encode_image_dedup(&config, B, 0.0f, threads[t], table, encode_sink, &actual, &stats) &&
+                      stats.TileCount == actual.Count && stats.TileCount + stats.DuplicateCount == ntiles &&
+                      stats.DuplicateCount > ntiles / 2;
+            for (size_t i = 0; ok && i < ntiles; ++i)
+            {
+                size_t         na = 0, ne = 0;
+                uint8_t const *pa = encode_sink_page(&actual, table[i], &na);
+                uint8_t const *pe = encode_sink_page(&expect, i, &ne);
+                ok = table[i] < actual.Count && na == ne && memcmp(pa, pe, ne) == 0 &&
+                     actual.Quality[table[i]] == expect.Quality[i];
+            }
+            if (!ok) failed++;
+            printf("dedup: order %d, %u threads, %u tiles stored as %u pages\n", (int) orders[o],
+                (unsigned) threads[t], (unsigned) ntiles, (unsigned) actual.Count);
+        }
+    }
+
+    free(table);
+    tile_free(&tile);
+    free(actual.Quality); free(actual.Offset); free(actual.Data);
+    free(expect.Quality); free(expect.Offset); free(expect.Data);
+    free(page);
+    free(src);
+    printf("dedup: %s (%u of %u checks fail)\n", failed ? "FAIL" : "PASS", (unsigned) failed, (unsigned) tested);
+    return (failed == 0);
 }
 
 void transform_colorspace(uint8_t const *rgba)
@@ -243,11 +1849,31 @@ int main(int argc, char **argv)
     (void) argc; // unused
     (void) argv; // unused
 
-    uint8_t  RGBA[1024];
-    generate_rgba(RGBA, 0, 256);
-    transform_block(RGBA,  10);
-    //transform_colorspace(RGBA);
     //ycocg_range();
-    return 0;
+
+    bool passed = true;
+    for (int32_t isa = CPU_ISA_SSE2; isa <= cpu_isa_supported(); ++isa)
+    {
+        if (select_kernels(isa) == isa)
+            passed = test_kernels(isa) && passed;
+    }
+    select_kernels(CPU_ISA_BEST);
+    passed = test_quantize() && passed;
+    passed = test_tile() && passed;
+    passed = test_compress() && passed;
+    passed = test_pack() && passed;
+    passed = test_alpha() && passed;
+    passed = test_rate() && passed;
+    passed = test_bc() && passed;
+    passed = test_preview() && passed;
+    passed = test_mipmap() && passed;
+    passed = test_mipmap_chain() && passed;
+    passed = test_encode() && passed;
+    passed = test_view() && passed;
+    passed = test_band() && passed;
+    passed = test_formats() && passed;
+    passed = test_order() && passed;
+    passed = test_dedup() && passed;
+    return passed ? 0 : 1;
 }
 